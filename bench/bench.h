@@ -0,0 +1,131 @@
+#pragma once
+
+/*
+ * Minimal microbenchmark harness (Linux host only).
+ *
+ * Each benchmark is a function that performs a single operation,
+ * it is run in a loop calibrated to take at least BENCH_MIN_TIME_NS,
+ * the best of BENCH_REPETITIONS runs is reported.
+ *
+ * Results are printed in human readable form and, if bench_open_csv() has been
+ * called, appended as CSV lines (name,ns_per_op,cycles_per_op), so that results
+ * of different commits can be compared with any tool. Benchmarks with names not
+ * containing the filter (bench_set_filter()) are skipped.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#   include <x86intrin.h>
+#   define BENCH_HAVE_CYCLES 1
+#else
+#   define BENCH_HAVE_CYCLES 0
+#endif
+
+#define BENCH_MIN_TIME_NS   (20 * 1000 * 1000)
+#define BENCH_REPETITIONS   5
+
+// forces the compiler to assume that the memory has been read and modified
+#define bench_clobber(ptr)  __asm__ volatile("" : : "g"(ptr) : "memory")
+
+typedef void (*BenchFunction)(void *context);
+
+typedef struct {
+    double ns_per_op;
+    double cycles_per_op;  // TSC reference cycles, 0 if not available
+} BenchResult;
+
+static FILE *bench_csv = NULL;
+static const char *bench_filter = NULL;
+
+
+static inline uint64_t bench_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline uint64_t bench_cycles(void) {
+#if BENCH_HAVE_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static bool bench_open_csv(const char *path) {
+    bench_csv = fopen(path, "w");
+    if (bench_csv == NULL)
+        return false;
+    fprintf(bench_csv, "name,ns_per_op,cycles_per_op\n");
+    return true;
+}
+
+static void bench_close_csv(void) {
+    if (bench_csv != NULL)
+        fclose(bench_csv);
+    bench_csv = NULL;
+}
+
+static void bench_set_filter(const char *filter) {
+    bench_filter = filter;
+}
+
+static bool bench_selected(const char *name) {
+    return bench_filter == NULL || strstr(name, bench_filter) != NULL;
+}
+
+// prints result (also of benchmarks with their own loop) and appends it to CSV
+static void bench_report(const char *name, BenchResult result) {
+    printf("%-50s %10.2f ns/op %10.1f cycles/op\n", name, result.ns_per_op, result.cycles_per_op);
+    if (bench_csv != NULL)
+        fprintf(bench_csv, "%s,%.3f,%.1f\n", name, result.ns_per_op, result.cycles_per_op);
+}
+
+static BenchResult bench_run(const char *name, BenchFunction function, void *context) {
+    BenchResult best = {0};
+    if (!bench_selected(name))
+        return best;
+
+    // find number of iterations that takes long enough
+    long iterations = 1;
+    while (1) {
+        uint64_t start = bench_time_ns();
+        for (long i = 0; i < iterations; i++)
+            function(context);
+        if (bench_time_ns() - start >= BENCH_MIN_TIME_NS)
+            break;
+        iterations *= 2;
+    }
+
+    for (int r = 0; r < BENCH_REPETITIONS; r++) {
+        uint64_t start_ns = bench_time_ns();
+        uint64_t start_cycles = bench_cycles();
+        for (long i = 0; i < iterations; i++)
+            function(context);
+        uint64_t cycles = bench_cycles() - start_cycles;
+        uint64_t ns = bench_time_ns() - start_ns;
+        BenchResult result = {
+            .ns_per_op = (double) ns / iterations,
+            .cycles_per_op = (double) cycles / iterations,
+        };
+        if (r == 0 || result.ns_per_op < best.ns_per_op)
+            best = result;
+    }
+
+    bench_report(name, best);
+    return best;
+}
+
+// prints throughput of a benchmark that processes n_bytes per operation
+static void bench_print_throughput(const char *name, BenchResult result, int n_bytes) {
+    if (result.ns_per_op == 0)
+        return;
+    // bytes per ns = GB/s, report in MB/s
+    printf("%-50s %10.1f MB/s\n", name, n_bytes / result.ns_per_op * 1000);
+}
+
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "bench.h"
+#include "dynamixel.h"
+#include "io_task.h"
+#include "io_capture.h"
+#include "virtual_bus.h"
+#include "replay_uart.h"
+
+/*
+ * Bus-traffic capture (io_capture.h): host cost of a control cycle (sync write
+ * and reads of 6 virtual servos, virtual time) with and without capturing it
+ * (the ring is drained after each cycle, as by its consumer), and replay
+ * (replay_uart.h) of the captured cycles through another IO task, per transaction.
+ */
+
+#define CAPTURE_BENCH_N_SERVOS   6
+#define CAPTURE_BENCH_N_CYCLES   500
+#define CAPTURE_BENCH_RING_SIZE  (1 << 18)
+
+typedef struct {
+    DynamixelIOTaskHandle io_task;
+    DynamixelVirtualBus bus;
+    DynamixelVirtualServo servos[CAPTURE_BENCH_N_SERVOS];
+    DynamixelPacket packet;
+    uint8_t sync_data[CAPTURE_BENCH_N_SERVOS * 3];
+    DynamixelIOCaptureRing ring;
+    uint8_t ring_buffer[CAPTURE_BENCH_RING_SIZE];
+    uint8_t drained[4096];
+    uint8_t log[CAPTURE_BENCH_RING_SIZE + sizeof(DynamixelIOCaptureHeader)];
+    DynamixelIOTaskHandle replay_task;
+    DynamixelReplayUART replay;
+    bool drain;
+    bool ok;
+} CaptureBenchContext;
+
+
+static void capture_bench_transfer(CaptureBenchContext *ctx, int response_size) {
+    DynamixelIOResponse response;
+    dynamixel_io_send_request(&ctx->io_task, &ctx->packet, response_size, false);
+    dynamixel_io_wait_response(&ctx->io_task, &response);
+    ctx->ok = ctx->ok && response.status == dio_OK;
+}
+
+static void bench_capture_cycle(void *context) {
+    CaptureBenchContext *ctx = context;
+    capture_bench_transfer(ctx, dynamixel_prepare_sync_write(&ctx->packet,
+                DYNAMIXEL_GOAL_POSITION_L, ctx->sync_data, CAPTURE_BENCH_N_SERVOS, 2));
+    for (int i = 0; i < CAPTURE_BENCH_N_SERVOS; i++)
+        capture_bench_transfer(ctx,
+                dynamixel_prepare_read(&ctx->packet, i + 1, DYNAMIXEL_PRESENT_POSITION_L, 2));
+    while (ctx->drain && dynamixel_capture_ring_read(&ctx->ring, ctx->drained, sizeof(ctx->drained)) > 0)
+        ;
+}
+
+static void run_capture_benchmarks(void) {
+    static CaptureBenchContext ctx;
+    if (!bench_selected("capture/"))
+        return;
+    for (int i = 0; i < CAPTURE_BENCH_N_SERVOS; i++) {
+        dynamixel_virtual_servo_init(&ctx.servos[i], i + 1);
+        dynamixel_virtual_servo_write_u8(&ctx.servos[i], DYNAMIXEL_RETURN_DELAY_TIME, 0);
+        ctx.sync_data[3 * i] = i + 1;
+        ctx.sync_data[3 * i + 1] = i * 16;
+        ctx.sync_data[3 * i + 2] = 0x01;
+    }
+    dynamixel_virtual_bus_init(&ctx.bus, &ctx.io_task, ctx.servos,
+            CAPTURE_BENCH_N_SERVOS, 1000000, true);
+    dynamixel_io_task_create_with_driver(&ctx.io_task, "dxl", 1, 1,
+            dynamixel_virtual_bus_driver(&ctx.bus), 12, 100);
+    dynamixel_capture_ring_init(&ctx.ring, ctx.ring_buffer, sizeof(ctx.ring_buffer));
+    ctx.ok = true;
+
+    bench_run("capture/cycle_6_servos_off", bench_capture_cycle, &ctx);
+    dynamixel_io_task_set_capture(&ctx.io_task, &ctx.ring);
+    ctx.drain = true;
+    bench_run("capture/cycle_6_servos", bench_capture_cycle, &ctx);
+
+    // log of whole cycles for the replay
+    ctx.drain = false;
+    dynamixel_capture_ring_read(&ctx.ring, ctx.drained, sizeof(ctx.drained));
+    for (int i = 0; i < CAPTURE_BENCH_N_CYCLES; i++)
+        bench_capture_cycle(&ctx);
+    dynamixel_io_task_set_capture(&ctx.io_task, NULL);
+    DynamixelIOCaptureHeader header;
+    dynamixel_capture_header_init(&header, dio_PROTOCOL_1);
+    memcpy(ctx.log, &header, sizeof(header));
+    size_t log_size = sizeof(header) + dynamixel_capture_ring_read(&ctx.ring,
+            &ctx.log[sizeof(header)], sizeof(ctx.log) - sizeof(header));
+    if (!ctx.ok || ctx.ring.n_dropped > 0) {
+        printf("%-50s failed\n", "capture/cycle_6_servos");
+        return;
+    }
+
+    // each replay needs its own IO task (they are never deleted), so it is run once
+    dynamixel_replay_uart_init(&ctx.replay, &ctx.replay_task, ctx.log, log_size);
+    dynamixel_io_task_create_with_driver(&ctx.replay_task, "replay", 1, 1,
+            dynamixel_replay_uart_driver(&ctx.replay), 12, 100);
+    int n_different;
+    uint64_t start_ns = bench_time_ns();
+    uint64_t start_cycles = bench_cycles();
+    int n_transactions = dynamixel_replay_run(&ctx.replay, &n_different);
+    uint64_t cycles = bench_cycles() - start_cycles;
+    uint64_t ns = bench_time_ns() - start_ns;
+    if (n_transactions != CAPTURE_BENCH_N_CYCLES * (CAPTURE_BENCH_N_SERVOS + 1) || n_different > 0
+            || ctx.replay.n_mismatches > 0) {
+        printf("%-50s failed\n", "capture/replay_transaction");
+        return;
+    }
+    BenchResult result = {
+        .ns_per_op = (double) ns / n_transactions,
+        .cycles_per_op = (double) cycles / n_transactions,
+    };
+    bench_report("capture/replay_transaction", result);
+    printf("%-50s %10.1f MB/s of log\n", "capture/replay_transaction", log_size / (double) ns * 1000);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "bench.h"
+#include "conversions.h"
+#include "dynamixel.h"
+
+/*
+ * Conversions of positions of a whole servo group each control cycle:
+ * scalar float functions from dynamixel.h versus batch float and fixed-point
+ * functions from conversions.h (rounding errors are documented there).
+ */
+
+#define CONVERSIONS_BENCH_N_SERVOS  32
+
+typedef struct {
+    uint16_t angles[CONVERSIONS_BENCH_N_SERVOS];
+    float rad[CONVERSIONS_BENCH_N_SERVOS];
+    int32_t rad_q16[CONVERSIONS_BENCH_N_SERVOS];
+    int16_t pi_q15[CONVERSIONS_BENCH_N_SERVOS];
+} ConversionsBenchContext;
+
+
+static void bench_angle2rad_scalar(void *context) {
+    ConversionsBenchContext *ctx = context;
+    for (int i = 0; i < CONVERSIONS_BENCH_N_SERVOS; i++)
+        ctx->rad[i] = dynamixel_angle2rad(ctx->angles[i]);
+    bench_clobber(ctx->rad);
+}
+
+static void bench_angle2rad_batch(void *context) {
+    ConversionsBenchContext *ctx = context;
+    dynamixel_angles2rad(ctx->angles, ctx->rad, CONVERSIONS_BENCH_N_SERVOS);
+    bench_clobber(ctx->rad);
+}
+
+static void bench_angle2rad_batch_q16(void *context) {
+    ConversionsBenchContext *ctx = context;
+    dynamixel_angles2rad_q16(ctx->angles, ctx->rad_q16, CONVERSIONS_BENCH_N_SERVOS);
+    bench_clobber(ctx->rad_q16);
+}
+
+static void bench_rad2angle_scalar(void *context) {
+    ConversionsBenchContext *ctx = context;
+    for (int i = 0; i < CONVERSIONS_BENCH_N_SERVOS; i++)
+        ctx->angles[i] = dynamixel_rad2angle(ctx->rad[i]);
+    bench_clobber(ctx->angles);
+}
+
+static void bench_rad2angle_batch(void *context) {
+    ConversionsBenchContext *ctx = context;
+    dynamixel_rad2angles(ctx->rad, ctx->angles, CONVERSIONS_BENCH_N_SERVOS);
+    bench_clobber(ctx->angles);
+}
+
+static void bench_rad2angle_batch_q16(void *context) {
+    ConversionsBenchContext *ctx = context;
+    dynamixel_rad2angles_q16(ctx->rad_q16, ctx->angles, CONVERSIONS_BENCH_N_SERVOS);
+    bench_clobber(ctx->angles);
+}
+
+static void bench_pi2angle_batch_q15(void *context) {
+    ConversionsBenchContext *ctx = context;
+    dynamixel_pi2angles_q15(ctx->pi_q15, ctx->angles, CONVERSIONS_BENCH_N_SERVOS);
+    bench_clobber(ctx->angles);
+}
+
+
+static void run_conversions_benchmarks(void) {
+    ConversionsBenchContext ctx;
+    for (int i = 0; i < CONVERSIONS_BENCH_N_SERVOS; i++)
+        ctx.angles[i] = i * 31;
+    dynamixel_angles2rad(ctx.angles, ctx.rad, CONVERSIONS_BENCH_N_SERVOS);
+    dynamixel_angles2rad_q16(ctx.angles, ctx.rad_q16, CONVERSIONS_BENCH_N_SERVOS);
+    dynamixel_angles2pi_q15(ctx.angles, ctx.pi_q15, CONVERSIONS_BENCH_N_SERVOS);
+
+    // whole group of servos per operation
+    bench_run("angle2rad_x32/scalar_float", bench_angle2rad_scalar, &ctx);
+    bench_run("angle2rad_x32/batch_float", bench_angle2rad_batch, &ctx);
+    bench_run("angle2rad_x32/batch_q16", bench_angle2rad_batch_q16, &ctx);
+    bench_run("rad2angle_x32/scalar_float", bench_rad2angle_scalar, &ctx);
+    bench_run("rad2angle_x32/batch_float", bench_rad2angle_batch, &ctx);
+    bench_run("rad2angle_x32/batch_q16", bench_rad2angle_batch_q16, &ctx);
+    bench_run("pi2angle_x32/batch_q15", bench_pi2angle_batch_q15, &ctx);
+}
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "packet_bench.h"
+#include "packet_template_bench.h"
+#include "protocol2_bench.h"
+#include "conversions_bench.h"
+#ifdef DYNAMIXEL_WITH_POSIX
+#   include "virtual_bus_bench.h"
+#   include "fault_bench.h"
+#   include "capture_bench.h"
+#endif
+
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--csv FILE] [--filter SUBSTRING]\n", program);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            if (!bench_open_csv(argv[++i])) {
+                perror(argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            bench_set_filter(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    run_packet_benchmarks();
+    run_packet_template_benchmarks();
+    run_protocol2_benchmarks();
+    run_conversions_benchmarks();
+#ifdef DYNAMIXEL_WITH_POSIX
+    run_virtual_bus_benchmarks();
+    run_fault_benchmarks();
+    run_capture_benchmarks();
+#endif
+
+    bench_close_csv();
+    return 0;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "bench.h"
+#include "dynamixel.h"
+#include "io_task.h"
+#include "virtual_bus.h"
+
+/*
+ * Cost of each error recovery path of the IO task: reads from a virtual servo
+ * (virtual time) with one class of faults injected at FAULT_BENCH_RATE.
+ *
+ * For each class it reports time lost per fault (the failed transfer, including
+ * its timeout), in bus time and host time (timeouts are real waits of the IO task,
+ * plus UART reset), and throughput of successful reads relative to the fault-free bus.
+ * CSV lines faults/<class>/bus and faults/<class>/host are ns per fault.
+ */
+
+#define FAULT_BENCH_N_TRANSFERS   2000
+#define FAULT_BENCH_RATE          0.1f
+#define FAULT_BENCH_SEED          12345
+
+typedef struct {
+    uint64_t bus_ns;
+    uint64_t host_ns;
+    int n_ok;
+    uint32_t n_faults;
+} FaultBenchResult;
+
+static const char *const fault_bench_names[dvb_N_FAULTS] = {
+    [dvb_FAULT_WRITE_ERROR] = "write_error",
+    [dvb_FAULT_DROPPED_BYTE] = "dropped_byte",
+    [dvb_FAULT_CORRUPTED_CHECKSUM] = "corrupted_checksum",
+    [dvb_FAULT_LATE_RESPONSE] = "late_response",
+    [dvb_FAULT_MISSING_SERVO] = "missing_servo",
+    [dvb_FAULT_SPURIOUS_NOTIFICATION] = "spurious_notification",
+};
+
+
+// fault < 0 - without faults
+static FaultBenchResult fault_bench_run(DynamixelIOTaskHandle *io_task,
+        DynamixelVirtualBus *bus, int fault) {
+    FaultBenchResult result = {0};
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+
+    dynamixel_virtual_bus_seed(bus, FAULT_BENCH_SEED);
+    if (fault >= 0) {
+        dynamixel_virtual_bus_set_fault_rate(bus, (DynamixelVirtualBusFault) fault, FAULT_BENCH_RATE);
+        result.n_faults = bus->fault_counts[fault];
+    }
+    uint64_t start_bus_us = dynamixel_virtual_bus_time_us(bus);
+    uint64_t start_ns = bench_time_ns();
+    for (int i = 0; i < FAULT_BENCH_N_TRANSFERS; i++) {
+        int response_size = dynamixel_prepare_read(&packet, 1, DYNAMIXEL_PRESENT_POSITION_L, 2);
+        dynamixel_io_send_request(io_task, &packet, response_size, false);
+        dynamixel_io_wait_response(io_task, &response);
+        result.n_ok += response.status == dio_OK;
+    }
+    result.host_ns = bench_time_ns() - start_ns;
+    result.bus_ns = (dynamixel_virtual_bus_time_us(bus) - start_bus_us) * 1000;
+    if (fault >= 0) {
+        dynamixel_virtual_bus_set_fault_rate(bus, (DynamixelVirtualBusFault) fault, 0);
+        result.n_faults = bus->fault_counts[fault] - result.n_faults;
+    }
+    return result;
+}
+
+static void run_fault_benchmarks(void) {
+    static DynamixelIOTaskHandle io_task;
+    static DynamixelVirtualBus bus;
+    static DynamixelVirtualServo servo;
+    char name[64];
+    bool any_selected = false;
+    for (int fault = 0; fault < dvb_N_FAULTS; fault++) {
+        snprintf(name, sizeof(name), "faults/%s", fault_bench_names[fault]);
+        any_selected = any_selected || bench_selected(name);
+    }
+    if (!any_selected)
+        return;
+
+    dynamixel_virtual_servo_init(&servo, 1);
+    dynamixel_virtual_servo_write_u8(&servo, DYNAMIXEL_RETURN_DELAY_TIME, 0);
+    dynamixel_virtual_bus_init(&bus, &io_task, &servo, 1, 1000000, true);
+    dynamixel_io_task_create_with_driver(&io_task, "dxl", 1, 1,
+            dynamixel_virtual_bus_driver(&bus), 12, 100);
+
+    FaultBenchResult base = fault_bench_run(&io_task, &bus, -1);
+    double base_bus_ns = (double) base.bus_ns / FAULT_BENCH_N_TRANSFERS;
+    double base_host_ns = (double) base.host_ns / FAULT_BENCH_N_TRANSFERS;
+    double base_throughput = base.n_ok * 1e9 / base.bus_ns;
+    printf("%-50s %10.1f us/op of bus time %10.1f us/op of host time, %.0f ok/s\n",
+            "faults/none", base_bus_ns / 1000, base_host_ns / 1000, base_throughput);
+
+    for (int fault = 0; fault < dvb_N_FAULTS; fault++) {
+        snprintf(name, sizeof(name), "faults/%s", fault_bench_names[fault]);
+        if (!bench_selected(name))
+            continue;
+        FaultBenchResult result = fault_bench_run(&io_task, &bus, fault);
+        if (result.n_faults == 0)
+            continue;
+
+        BenchResult bus_cost = {
+            .ns_per_op = (result.bus_ns - base_bus_ns * result.n_ok) / result.n_faults,
+        };
+        BenchResult host_cost = {
+            .ns_per_op = (result.host_ns - base_host_ns * result.n_ok) / result.n_faults,
+        };
+        double throughput = result.n_ok * 1e9 / result.bus_ns;
+        printf("%-50s %u faults, %d ok of %d, %.0f ok/s (%.1f%% lost)\n", name,
+                result.n_faults, result.n_ok, FAULT_BENCH_N_TRANSFERS, throughput,
+                100 * (1 - throughput / base_throughput));
+        snprintf(name, sizeof(name), "faults/%s/bus", fault_bench_names[fault]);
+        bench_report(name, bus_cost);
+        snprintf(name, sizeof(name), "faults/%s/host", fault_bench_names[fault]);
+        bench_report(name, host_cost);
+    }
+}
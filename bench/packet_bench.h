@@ -0,0 +1,211 @@
+#pragma once
+
+#include "bench.h"
+#include "dynamixel.h"
+#include "packet_parser.h"
+
+/*
+ * Packet layer: low level packet functions, all dynamixel_prepare_* builders,
+ * sync-write assembly for groups of different size and verification of responses.
+ */
+
+#define PACKET_BENCH_MAX_N_SERVOS       40
+#define PACKET_BENCH_MAX_N_PARAMETERS   DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS
+
+typedef struct {
+    DynamixelPacket packet;
+    // for large sync-writes
+    uint8_t storage[DYNAMIXEL_PACKET_STORAGE_SIZE(PACKET_BENCH_MAX_N_PARAMETERS)];
+    uint8_t data[8];
+    uint8_t sync_data[PACKET_BENCH_MAX_N_SERVOS * 3];
+    int n_servos;
+    DynamixelPacket status;
+    DynamixelPacketParser parser;
+    uint8_t id;
+} PacketBenchContext;
+
+
+static void bench_packet_init(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_packet_init(&ctx->packet, ctx->id, DYNAMIXEL_INST_WRITE);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_packet_add_parameter(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_packet_init(&ctx->packet, ctx->id, DYNAMIXEL_INST_WRITE);
+    for (int i = 0; i < 8; i++)
+        dynamixel_packet_add_parameter(&ctx->packet, ctx->data[i]);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_packet_add_parameters(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_packet_init(&ctx->packet, ctx->id, DYNAMIXEL_INST_WRITE);
+    dynamixel_packet_add_parameters(&ctx->packet, ctx->data, 8);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_packet_add_parameter_u16(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_packet_init(&ctx->packet, ctx->id, DYNAMIXEL_INST_WRITE);
+    for (int i = 0; i < 4; i++)
+        dynamixel_packet_add_parameter_u16(&ctx->packet, ctx->data[i]);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_packet_compute_checksum(void *context) {
+    PacketBenchContext *ctx = context;
+    uint8_t checksum = dynamixel_packet_compute_checksum(&ctx->packet);
+    bench_clobber(&checksum);
+}
+
+static void bench_prepare_ping(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_prepare_ping(&ctx->packet, ctx->id);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_prepare_action(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_prepare_action(&ctx->packet, ctx->id);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_prepare_reset(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_prepare_reset(&ctx->packet, ctx->id);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_prepare_write(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_prepare_write(&ctx->packet, ctx->id, DYNAMIXEL_GOAL_POSITION_L, ctx->data, 4);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_prepare_read(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_prepare_read(&ctx->packet, ctx->id, DYNAMIXEL_PRESENT_POSITION_L, 4);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_prepare_reg_write(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_prepare_reg_write(&ctx->packet, ctx->id, DYNAMIXEL_GOAL_POSITION_L, ctx->data, 4);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_prepare_set_register_u8(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_prepare_set_register_u8(&ctx->packet, ctx->id, DYNAMIXEL_LED, 1);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_prepare_set_register_u16(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_prepare_set_register_u16(&ctx->packet, ctx->id, DYNAMIXEL_GOAL_POSITION_L, 512);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_prepare_read_register_u8(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_prepare_read_register_u8(&ctx->packet, ctx->id, DYNAMIXEL_PRESENT_TEMPERATURE);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_prepare_read_register_u16(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_prepare_read_register_u16(&ctx->packet, ctx->id, DYNAMIXEL_PRESENT_POSITION_L);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_prepare_bulk_read(void *context) {
+    PacketBenchContext *ctx = context;
+    // 2 servos, 2 bytes each
+    uint8_t data[] = {2, ctx->id, DYNAMIXEL_PRESENT_POSITION_L, 2, ctx->id + 1, DYNAMIXEL_PRESENT_POSITION_L};
+    dynamixel_prepare_bulk_read(&ctx->packet, data, 2);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_sync_write(void *context) {
+    PacketBenchContext *ctx = context;
+    dynamixel_prepare_sync_write_sized((DynamixelPacket *) ctx->storage, PACKET_BENCH_MAX_N_PARAMETERS,
+            DYNAMIXEL_GOAL_POSITION_L, ctx->sync_data, ctx->n_servos, 2);
+    bench_clobber(ctx->storage);
+}
+
+static void bench_sync_write_incremental(void *context) {
+    PacketBenchContext *ctx = context;
+    DynamixelPacket *packet = (DynamixelPacket *) ctx->storage;
+    dynamixel_prepare_sync_write_init_sized(packet, PACKET_BENCH_MAX_N_PARAMETERS,
+            DYNAMIXEL_GOAL_POSITION_L, 2);
+    for (int i = 0; i < ctx->n_servos; i++)
+        dynamixel_prepare_sync_write_add_next_sized(packet, PACKET_BENCH_MAX_N_PARAMETERS,
+                ctx->sync_data[3 * i], &ctx->sync_data[3 * i + 1]);
+    dynamixel_prepare_sync_write_end_sized(packet, PACKET_BENCH_MAX_N_PARAMETERS);
+    bench_clobber(ctx->storage);
+}
+
+static void bench_response_checksum_isok(void *context) {
+    PacketBenchContext *ctx = context;
+    bool is_ok = dynamixel_packet_checksum_isok(&ctx->status);
+    bench_clobber(&is_ok);
+}
+
+static void bench_response_parser(void *context) {
+    PacketBenchContext *ctx = context;
+    DynamixelParserResult result = dynamixel_packet_parser_feed(&ctx->parser,
+            dynamixel_packet_data(&ctx->status), dynamixel_packet_size(&ctx->status), NULL);
+    bench_clobber(&result);
+}
+
+
+static void run_packet_benchmarks(void) {
+    static PacketBenchContext ctx;
+    ctx.id = 1;
+    for (int i = 0; i < 8; i++)
+        ctx.data[i] = i * 17;
+    for (int i = 0; i < PACKET_BENCH_MAX_N_SERVOS; i++) {
+        ctx.sync_data[3 * i] = i + 1;
+        ctx.sync_data[3 * i + 1] = i * 7;
+        ctx.sync_data[3 * i + 2] = 0x01;
+    }
+
+    bench_run("packet/init", bench_packet_init, &ctx);
+    bench_run("packet/add_parameter_x8", bench_packet_add_parameter, &ctx);
+    bench_run("packet/add_parameters_8", bench_packet_add_parameters, &ctx);
+    bench_run("packet/add_parameter_u16_x4", bench_packet_add_parameter_u16, &ctx);
+    dynamixel_prepare_write(&ctx.packet, ctx.id, DYNAMIXEL_GOAL_POSITION_L, ctx.data, 8);
+    bench_run("packet/compute_checksum_8", bench_packet_compute_checksum, &ctx);
+
+    bench_run("prepare/ping", bench_prepare_ping, &ctx);
+    bench_run("prepare/action", bench_prepare_action, &ctx);
+    bench_run("prepare/reset", bench_prepare_reset, &ctx);
+    bench_run("prepare/write_4", bench_prepare_write, &ctx);
+    bench_run("prepare/read_4", bench_prepare_read, &ctx);
+    bench_run("prepare/reg_write_4", bench_prepare_reg_write, &ctx);
+    bench_run("prepare/set_register_u8", bench_prepare_set_register_u8, &ctx);
+    bench_run("prepare/set_register_u16", bench_prepare_set_register_u16, &ctx);
+    bench_run("prepare/read_register_u8", bench_prepare_read_register_u8, &ctx);
+    bench_run("prepare/read_register_u16", bench_prepare_read_register_u16, &ctx);
+    bench_run("prepare/bulk_read_2", bench_prepare_bulk_read, &ctx);
+
+    const int n_servos[] = {1, 2, 5, 10, 20, 40};
+    for (unsigned i = 0; i < sizeof(n_servos) / sizeof(*n_servos); i++) {
+        char name[64];
+        ctx.n_servos = n_servos[i];
+        snprintf(name, sizeof(name), "sync_write_u16/%d_servos", n_servos[i]);
+        bench_run(name, bench_sync_write, &ctx);
+        snprintf(name, sizeof(name), "sync_write_u16_incremental/%d_servos", n_servos[i]);
+        bench_run(name, bench_sync_write_incremental, &ctx);
+    }
+
+    // status packet with present position
+    dynamixel_packet_init(&ctx.status, ctx.id, 0);
+    dynamixel_packet_add_parameter_u16(&ctx.status, 512);
+    dynamixel_packet_add_checksum(&ctx.status);
+    dynamixel_packet_parser_init(&ctx.parser, &ctx.packet);
+    bench_run("response/checksum_isok", bench_response_checksum_isok, &ctx);
+    bench_run("response/parser", bench_response_parser, &ctx);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "bench.h"
+#include "dynamixel.h"
+#include "packet_template.h"
+
+/*
+ * Packets sent every control cycle: assembling them from scratch with
+ * dynamixel_prepare_* versus updating prebuilt templates.
+ */
+
+#define TEMPLATE_BENCH_N_SERVOS  7
+
+typedef struct {
+    DynamixelPacket packet;
+    DynamixelPacketTemplate tpl;
+    uint8_t ids[TEMPLATE_BENCH_N_SERVOS];
+    uint16_t positions[TEMPLATE_BENCH_N_SERVOS];
+    int cycle;
+} TemplateBenchContext;
+
+
+static void bench_goal_position_prepare(void *context) {
+    TemplateBenchContext *ctx = context;
+    ctx->cycle++;
+    dynamixel_prepare_sync_write_init(&ctx->packet, DYNAMIXEL_GOAL_POSITION_L, 2);
+    for (int i = 0; i < TEMPLATE_BENCH_N_SERVOS; i++) {
+        uint16_t position = ctx->positions[i] + ctx->cycle;
+        uint8_t data[2] = {position & 0xff, position >> 8};
+        dynamixel_prepare_sync_write_add_next(&ctx->packet, ctx->ids[i], data);
+    }
+    dynamixel_prepare_sync_write_end(&ctx->packet);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_goal_position_template(void *context) {
+    TemplateBenchContext *ctx = context;
+    ctx->cycle++;
+    for (int i = 0; i < TEMPLATE_BENCH_N_SERVOS; i++) {
+        uint16_t position = ctx->positions[i] + ctx->cycle;
+        uint8_t data[2] = {position & 0xff, position >> 8};
+        dynamixel_packet_template_set_sync_write_data(&ctx->tpl, i, data);
+    }
+    bench_clobber(&ctx->tpl);
+}
+
+// new value every cycle (broadcast, no response, so the template is sent as it is)
+static void bench_torque_limit_prepare(void *context) {
+    TemplateBenchContext *ctx = context;
+    uint16_t limit = ctx->cycle++ & 0x3ff;
+    dynamixel_prepare_set_register_u16(&ctx->packet, DYNAMIXEL_BROADCASTING_ID,
+            DYNAMIXEL_TORQUE_LIMIT_L, limit);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_torque_limit_template(void *context) {
+    TemplateBenchContext *ctx = context;
+    uint16_t limit = ctx->cycle++ & 0x3ff;
+    dynamixel_packet_template_set_parameter_u16(&ctx->tpl, 1, limit);
+    bench_clobber(&ctx->tpl);
+}
+
+static void bench_present_position_prepare(void *context) {
+    TemplateBenchContext *ctx = context;
+    uint8_t id = ctx->ids[ctx->cycle++ % TEMPLATE_BENCH_N_SERVOS];
+    dynamixel_prepare_read_register_u16(&ctx->packet, id, DYNAMIXEL_PRESENT_POSITION_L);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_present_position_template(void *context) {
+    // response would overwrite the packet (IO task without an rx pool, see
+    // dynamixel_io_task_set_rx_pool()), so template has to be copied
+    TemplateBenchContext *ctx = context;
+    uint8_t id = ctx->ids[ctx->cycle++ % TEMPLATE_BENCH_N_SERVOS];
+    dynamixel_packet_template_set_id(&ctx->tpl, id);
+    dynamixel_packet_template_copy(&ctx->tpl, &ctx->packet);
+    bench_clobber(&ctx->packet);
+}
+
+
+static void run_packet_template_benchmarks(void) {
+    TemplateBenchContext ctx = {0};
+    for (int i = 0; i < TEMPLATE_BENCH_N_SERVOS; i++) {
+        ctx.ids[i] = i + 1;
+        ctx.positions[i] = 100 * i;
+    }
+
+    bench_run("goal_position_sync_write/prepare", bench_goal_position_prepare, &ctx);
+    dynamixel_prepare_sync_write_init(&ctx.tpl.packet, DYNAMIXEL_GOAL_POSITION_L, 2);
+    for (int i = 0; i < TEMPLATE_BENCH_N_SERVOS; i++) {
+        uint8_t data[2] = {ctx.positions[i] & 0xff, ctx.positions[i] >> 8};
+        dynamixel_prepare_sync_write_add_next(&ctx.tpl.packet, ctx.ids[i], data);
+    }
+    dynamixel_packet_template_init(&ctx.tpl, dynamixel_prepare_sync_write_end(&ctx.tpl.packet));
+    bench_run("goal_position_sync_write/template", bench_goal_position_template, &ctx);
+
+    bench_run("torque_limit_broadcast/prepare", bench_torque_limit_prepare, &ctx);
+    dynamixel_packet_template_init(&ctx.tpl, dynamixel_prepare_set_register_u16(&ctx.tpl.packet,
+                DYNAMIXEL_BROADCASTING_ID, DYNAMIXEL_TORQUE_LIMIT_L, 0));
+    bench_run("torque_limit_broadcast/template", bench_torque_limit_template, &ctx);
+
+    bench_run("present_position_read/prepare", bench_present_position_prepare, &ctx);
+    dynamixel_packet_template_init(&ctx.tpl, dynamixel_prepare_read_register_u16(&ctx.tpl.packet,
+                1, DYNAMIXEL_PRESENT_POSITION_L));
+    bench_run("present_position_read/template", bench_present_position_template, &ctx);
+}
+
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string.h>
+
+#include "bench.h"
+#include "protocol2.h"
+
+/*
+ * Protocol 2.0 codec: CRC (table-driven vs bit-by-bit), encoding of packets
+ * sent every control cycle and decoding of status packets.
+ */
+
+#define PROTOCOL2_BENCH_N_SERVOS   6
+#define PROTOCOL2_BENCH_CRC_LEN    64
+
+typedef struct {
+    Dynamixel2Packet packet;
+    Dynamixel2Packet status;                  // encoded status packet
+    int status_size;
+    Dynamixel2PacketParser parser;
+    uint8_t ids[PROTOCOL2_BENCH_N_SERVOS];
+    uint32_t positions[PROTOCOL2_BENCH_N_SERVOS];
+    uint8_t buffer[PROTOCOL2_BENCH_CRC_LEN];
+    int cycle;
+} Protocol2BenchContext;
+
+
+// reference implementation from the protocol specification
+static uint16_t crc16_bitwise(uint16_t crc, const uint8_t *data, int data_len) {
+    for (int i = 0; i < data_len; i++) {
+        crc ^= (uint16_t) data[i] << 8;
+        for (int bit = 0; bit < 8; bit++)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1;
+    }
+    return crc;
+}
+
+static void bench_crc16_bitwise(void *context) {
+    Protocol2BenchContext *ctx = context;
+    uint16_t crc = crc16_bitwise(0, ctx->buffer, PROTOCOL2_BENCH_CRC_LEN);
+    bench_clobber(&crc);
+}
+
+static void bench_crc16_table(void *context) {
+    Protocol2BenchContext *ctx = context;
+    uint16_t crc = dynamixel2_crc16(0, ctx->buffer, PROTOCOL2_BENCH_CRC_LEN);
+    bench_clobber(&crc);
+}
+
+static void bench_encode_sync_write(void *context) {
+    Protocol2BenchContext *ctx = context;
+    uint8_t data[PROTOCOL2_BENCH_N_SERVOS * 5];
+    ctx->cycle++;
+    for (int i = 0; i < PROTOCOL2_BENCH_N_SERVOS; i++) {
+        uint32_t position = ctx->positions[i] + ctx->cycle;
+        data[5 * i] = ctx->ids[i];
+        memcpy(&data[5 * i + 1], &position, 4);
+    }
+    dynamixel2_prepare_sync_write(&ctx->packet, 116, data, PROTOCOL2_BENCH_N_SERVOS, 4);
+    bench_clobber(&ctx->packet);
+}
+
+static void bench_decode_status(void *context) {
+    // decoding is done in place, so the packet has to be copied first
+    Protocol2BenchContext *ctx = context;
+    memcpy(dynamixel2_packet_data(&ctx->packet), dynamixel2_packet_data(&ctx->status),
+            ctx->status_size);
+    bool ok = dynamixel2_packet_decode(&ctx->packet, ctx->status_size);
+    bench_clobber(&ok);
+}
+
+static void bench_parse_status(void *context) {
+    Protocol2BenchContext *ctx = context;
+    DynamixelParserResult result = dynamixel2_packet_parser_feed(&ctx->parser,
+            dynamixel2_packet_data(&ctx->status), ctx->status_size, NULL);
+    bench_clobber(&result);
+}
+
+
+static void run_protocol2_benchmarks(void) {
+    Protocol2BenchContext ctx = {0};
+    for (int i = 0; i < PROTOCOL2_BENCH_N_SERVOS; i++) {
+        ctx.ids[i] = i + 1;
+        ctx.positions[i] = 1000 * i;
+    }
+    for (int i = 0; i < PROTOCOL2_BENCH_CRC_LEN; i++)
+        ctx.buffer[i] = i * 37;
+
+    BenchResult result;
+    result = bench_run("protocol2_crc16_64B/bitwise", bench_crc16_bitwise, &ctx);
+    bench_print_throughput("protocol2_crc16_64B/bitwise", result, PROTOCOL2_BENCH_CRC_LEN);
+    result = bench_run("protocol2_crc16_64B/table", bench_crc16_table, &ctx);
+    bench_print_throughput("protocol2_crc16_64B/table", result, PROTOCOL2_BENCH_CRC_LEN);
+
+    bench_run("protocol2_goal_position_sync_write/encode", bench_encode_sync_write, &ctx);
+
+    // status packet with 4-byte present position, which contains 0xff 0xff 0xfd (stuffed)
+    dynamixel2_packet_init(&ctx.status, 1, DYNAMIXEL2_INST_STATUS);
+    uint8_t status_data[] = {0x00, 0xff, 0xff, 0xfd, 0x00};
+    dynamixel2_packet_add_parameters(&ctx.status, status_data, sizeof(status_data));
+    dynamixel2_packet_add_crc(&ctx.status);
+    ctx.status_size = dynamixel2_packet_size(&ctx.status);
+    dynamixel2_packet_parser_init(&ctx.parser, &ctx.packet, DYNAMIXEL2_MAX_N_PARAMETERS);
+
+    result = bench_run("protocol2_present_position_status/decode", bench_decode_status, &ctx);
+    bench_print_throughput("protocol2_present_position_status/decode", result, ctx.status_size);
+    result = bench_run("protocol2_present_position_status/parser", bench_parse_status, &ctx);
+    bench_print_throughput("protocol2_present_position_status/parser", result, ctx.status_size);
+}
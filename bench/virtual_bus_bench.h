@@ -0,0 +1,329 @@
+#pragma once
+
+#include "bench.h"
+#include "dynamixel.h"
+#include "io_task.h"
+#include "virtual_bus.h"
+
+/*
+ * IO task with virtual AX-12 servos (virtual time): host cost of a request
+ * (queues, task switches, parsing) and modelled bus time of a control cycle.
+ * In real time: latency of a transaction (bus time and wakeups of the IO task),
+ * with reception started by the task or chained from write completion; for both
+ * the wakeups of the IO task per transaction are counted in its trace.
+ * Under load (a task keeping the queue full of background reads): round trip of
+ * a sync write sent as a normal request (behind the reads) or a control one.
+ * Backlog: bursts of sync writes without waiting for them (as from a control loop
+ * faster than the bus), bus time with and without coalescing of pending writes.
+ * Pooled: the batch of reads prepared once, responses received into the rx pool.
+ */
+
+
+#define VIRTUAL_BUS_BENCH_N_SERVOS   6
+// trace events of the latest transactions, wakeups are counted in them
+#define VIRTUAL_BUS_BENCH_TRACE_SIZE 1024
+
+typedef struct {
+    DynamixelIOTaskHandle io_task;
+    DynamixelVirtualBus bus;
+    DynamixelVirtualServo servos[VIRTUAL_BUS_BENCH_N_SERVOS];
+    DynamixelPacket packet;
+    DynamixelPacket read_packets[VIRTUAL_BUS_BENCH_N_SERVOS];
+    DynamixelIOBatchItem batch[VIRTUAL_BUS_BENCH_N_SERVOS];
+    DynamixelIOCompletion completion;
+    uint8_t sync_data[VIRTUAL_BUS_BENCH_N_SERVOS * 3];
+    int n_ops;
+    bool ok;
+    // background load
+    DynamixelIOPriority sync_priority;
+    DynamixelPacket load_packets[VIRTUAL_BUS_BENCH_N_SERVOS];
+    DynamixelIOCompletion load_completion;
+    SemaphoreHandle_t load_done;
+    bool load_stop;
+    // backlog
+    DynamixelIOCoalescedWrite coalesced[2];
+    bool coalesce;
+    // rx pool
+    DynamixelIORxPool rx_pool;
+    uint8_t rx_storage[VIRTUAL_BUS_BENCH_N_SERVOS * 16];
+    // wakeups
+    DynamixelIOTraceEvent trace[VIRTUAL_BUS_BENCH_TRACE_SIZE];
+    DynamixelIOTraceEvent trace_copy[VIRTUAL_BUS_BENCH_TRACE_SIZE];
+} VirtualBusBenchContext;
+
+
+static void virtual_bus_bench_transfer(VirtualBusBenchContext *ctx, int response_size) {
+    DynamixelIOResponse response;
+    dynamixel_io_send_request(&ctx->io_task, &ctx->packet, response_size, false);
+    dynamixel_io_wait_response(&ctx->io_task, &response);
+    ctx->ok = ctx->ok && response.status == dio_OK;
+}
+
+static void bench_virtual_bus_ping(void *context) {
+    VirtualBusBenchContext *ctx = context;
+    virtual_bus_bench_transfer(ctx, dynamixel_prepare_ping(&ctx->packet, 1));
+    ctx->n_ops++;
+}
+
+static void bench_virtual_bus_read(void *context) {
+    VirtualBusBenchContext *ctx = context;
+    virtual_bus_bench_transfer(ctx,
+            dynamixel_prepare_read(&ctx->packet, 1, DYNAMIXEL_PRESENT_POSITION_L, 4));
+    ctx->n_ops++;
+}
+
+// what ServoGroup does in a control loop: sync write of goal positions, then reads
+static void bench_virtual_bus_cycle(void *context) {
+    VirtualBusBenchContext *ctx = context;
+    virtual_bus_bench_transfer(ctx, dynamixel_prepare_sync_write(&ctx->packet,
+                DYNAMIXEL_GOAL_POSITION_L, ctx->sync_data, VIRTUAL_BUS_BENCH_N_SERVOS, 2));
+    for (int i = 0; i < VIRTUAL_BUS_BENCH_N_SERVOS; i++)
+        virtual_bus_bench_transfer(ctx,
+                dynamixel_prepare_read(&ctx->packet, i + 1, DYNAMIXEL_PRESENT_POSITION_L, 2));
+    ctx->n_ops++;
+}
+
+// the same reads, all queued at once (the IO task does not wait for the caller)
+static void bench_virtual_bus_cycle_pipelined(void *context) {
+    VirtualBusBenchContext *ctx = context;
+    virtual_bus_bench_transfer(ctx, dynamixel_prepare_sync_write(&ctx->packet,
+                DYNAMIXEL_GOAL_POSITION_L, ctx->sync_data, VIRTUAL_BUS_BENCH_N_SERVOS, 2));
+    for (int i = 0; i < VIRTUAL_BUS_BENCH_N_SERVOS; i++) {
+        int response_size = dynamixel_prepare_read(&ctx->read_packets[i], i + 1,
+                DYNAMIXEL_PRESENT_POSITION_L, 2);
+        dynamixel_io_send_request_to(&ctx->io_task, &ctx->read_packets[i], response_size,
+                &ctx->completion);
+    }
+    for (int i = 0; i < VIRTUAL_BUS_BENCH_N_SERVOS; i++) {
+        DynamixelIOResponse response;
+        dynamixel_io_wait_completion(&ctx->completion, &response);
+        ctx->ok = ctx->ok && response.status == dio_OK;
+    }
+    ctx->n_ops++;
+}
+
+// the same reads as one batch request (one hand-off to the IO task and back)
+static void bench_virtual_bus_cycle_batched(void *context) {
+    VirtualBusBenchContext *ctx = context;
+    virtual_bus_bench_transfer(ctx, dynamixel_prepare_sync_write(&ctx->packet,
+                DYNAMIXEL_GOAL_POSITION_L, ctx->sync_data, VIRTUAL_BUS_BENCH_N_SERVOS, 2));
+    for (int i = 0; i < VIRTUAL_BUS_BENCH_N_SERVOS; i++) {
+        ctx->batch[i].packet = &ctx->read_packets[i];
+        ctx->batch[i].response_size = dynamixel_prepare_read(&ctx->read_packets[i], i + 1,
+                DYNAMIXEL_PRESENT_POSITION_L, 2);
+    }
+    DynamixelIOResponse response;
+    dynamixel_io_send_request_batch(&ctx->io_task, ctx->batch, VIRTUAL_BUS_BENCH_N_SERVOS,
+            &ctx->completion);
+    dynamixel_io_wait_completion(&ctx->completion, &response);
+    ctx->ok = ctx->ok && response.status == dio_OK;
+    ctx->n_ops++;
+}
+
+// the same, with the reads left intact by the responses (no preparing in the cycle)
+static void bench_virtual_bus_cycle_batched_pooled(void *context) {
+    VirtualBusBenchContext *ctx = context;
+    virtual_bus_bench_transfer(ctx, dynamixel_prepare_sync_write(&ctx->packet,
+                DYNAMIXEL_GOAL_POSITION_L, ctx->sync_data, VIRTUAL_BUS_BENCH_N_SERVOS, 2));
+    DynamixelIOResponse response;
+    dynamixel_io_send_request_batch(&ctx->io_task, ctx->batch, VIRTUAL_BUS_BENCH_N_SERVOS,
+            &ctx->completion);
+    dynamixel_io_wait_completion(&ctx->completion, &response);
+    ctx->ok = ctx->ok && response.status == dio_OK;
+    dynamixel_io_release_response(&ctx->io_task, &response);
+    ctx->n_ops++;
+}
+
+static void bench_virtual_bus_sync_under_load(void *context) {
+    VirtualBusBenchContext *ctx = context;
+    DynamixelIORequest request = {
+        .packet = &ctx->packet,
+        .response_size = dynamixel_prepare_sync_write(&ctx->packet, DYNAMIXEL_GOAL_POSITION_L,
+                ctx->sync_data, VIRTUAL_BUS_BENCH_N_SERVOS, 2),
+        .n_responses = 1,
+        .priority = ctx->sync_priority
+    };
+    DynamixelIOResponse response;
+    dynamixel_io_submit(&ctx->io_task, &request);
+    dynamixel_io_wait_response(&ctx->io_task, &response);
+    ctx->ok = ctx->ok && response.status == dio_OK;
+    ctx->n_ops++;
+}
+
+static void bench_virtual_bus_sync_backlog(void *context) {
+    VirtualBusBenchContext *ctx = context;
+    // as many as there are packets, each is queued until the ping below
+    for (int i = 0; i < VIRTUAL_BUS_BENCH_N_SERVOS; i++) {
+        ctx->sync_data[1] = i;
+        if (ctx->coalesce) {
+            ctx->ok = dynamixel_io_sync_write_coalesced(&ctx->io_task, DYNAMIXEL_GOAL_POSITION_L,
+                    ctx->sync_data, VIRTUAL_BUS_BENCH_N_SERVOS, 2, dio_PRIORITY_NORMAL) && ctx->ok;
+            continue;
+        }
+        dynamixel_prepare_sync_write(&ctx->read_packets[i], DYNAMIXEL_GOAL_POSITION_L,
+                ctx->sync_data, VIRTUAL_BUS_BENCH_N_SERVOS, 2);
+        dynamixel_io_send_request(&ctx->io_task, &ctx->read_packets[i], 0, true);
+    }
+    // waits for the burst to be sent
+    virtual_bus_bench_transfer(ctx, dynamixel_prepare_ping(&ctx->packet, 1));
+    ctx->n_ops++;
+}
+
+static void virtual_bus_bench_submit_load(VirtualBusBenchContext *ctx, DynamixelPacket *packet, uint8_t id) {
+    DynamixelIORequest request = {
+        .packet = packet,
+        .response_size = dynamixel_prepare_read(packet, id, DYNAMIXEL_PRESENT_TEMPERATURE, 1),
+        .n_responses = 1,
+        .completion = &ctx->load_completion,
+        .priority = dio_PRIORITY_BACKGROUND
+    };
+    dynamixel_io_submit(&ctx->io_task, &request);
+}
+
+// keeps a read of each servo in the queue until load_stop is set
+static void virtual_bus_bench_load(void *arguments) {
+    VirtualBusBenchContext *ctx = arguments;
+    for (int i = 0; i < VIRTUAL_BUS_BENCH_N_SERVOS; i++)
+        virtual_bus_bench_submit_load(ctx, &ctx->load_packets[i], i + 1);
+    while (!__atomic_load_n(&ctx->load_stop, __ATOMIC_RELAXED)) {
+        DynamixelIOResponse response;
+        dynamixel_io_wait_completion(&ctx->load_completion, &response);
+        virtual_bus_bench_submit_load(ctx, response.packet, response.packet - ctx->load_packets + 1);
+    }
+    for (int i = 0; i < VIRTUAL_BUS_BENCH_N_SERVOS; i++) {
+        DynamixelIOResponse response;
+        dynamixel_io_wait_completion(&ctx->load_completion, &response);
+    }
+    xSemaphoreGive(ctx->load_done);
+    vTaskDelete(NULL);
+}
+
+static void virtual_bus_bench_run_under_load(VirtualBusBenchContext *ctx, const char *name,
+        DynamixelIOPriority priority) {
+    if (!bench_selected(name))
+        return;
+    ctx->ok = true;
+    ctx->sync_priority = priority;
+    __atomic_store_n(&ctx->load_stop, false, __ATOMIC_RELAXED);
+    xTaskCreate(virtual_bus_bench_load, "load", configMINIMAL_STACK_SIZE, ctx, 1, NULL);
+    dynamixel_io_task_reset_queue_stats(&ctx->io_task);
+    BenchResult result = bench_run(name, bench_virtual_bus_sync_under_load, ctx);
+    DynamixelIOQueueStats stats;
+    dynamixel_io_task_get_queue_stats(&ctx->io_task, priority, &stats);
+    __atomic_store_n(&ctx->load_stop, true, __ATOMIC_RELAXED);
+    xSemaphoreTake(ctx->load_done, portMAX_DELAY);
+    if (result.ns_per_op == 0 || stats.n_requests == 0)
+        return;
+    // ticks are microseconds on the host
+    printf("%-50s %10.1f us average, %u us max queue wait%s\n", name,
+            (double) stats.total_wait / stats.n_requests, (unsigned) stats.max_wait,
+            ctx->ok ? "" : " (ERRORS)");
+}
+
+static void virtual_bus_bench_run(VirtualBusBenchContext *ctx, const char *name,
+        BenchFunction function) {
+    ctx->ok = true;
+    ctx->n_ops = 0;
+    uint64_t start_us = dynamixel_virtual_bus_time_us(&ctx->bus);
+    BenchResult result = bench_run(name, function, ctx);
+    if (result.ns_per_op == 0)
+        return;
+    double bus_us = (double) (dynamixel_virtual_bus_time_us(&ctx->bus) - start_us) / ctx->n_ops;
+    printf("%-50s %10.1f us/op of bus time%s\n", name, bus_us, ctx->ok ? "" : " (ERRORS)");
+}
+
+// the same with the trace of the IO task, prints its wakeups per transaction (counted
+// between the first and the last transaction finished in the trace)
+static void virtual_bus_bench_run_traced(VirtualBusBenchContext *ctx, const char *name,
+        BenchFunction function) {
+    if (!bench_selected(name))
+        return;
+    dynamixel_io_task_set_trace(&ctx->io_task, ctx->trace, VIRTUAL_BUS_BENCH_TRACE_SIZE);
+    virtual_bus_bench_run(ctx, name, function);
+    // (stopping the trace discards it)
+    int n_events = dynamixel_io_task_read_trace(&ctx->io_task, ctx->trace_copy,
+            VIRTUAL_BUS_BENCH_TRACE_SIZE);
+    dynamixel_io_task_set_trace(&ctx->io_task, NULL, 0);
+    int n_done = -1;
+    int n_woken = 0;
+    int n_woken_counted = 0;
+    for (int i = 0; i < n_events; i++) {
+        if (ctx->trace_copy[i].type == dio_TRACE_WOKEN) {
+            n_woken++;
+        } else if (ctx->trace_copy[i].type == dio_TRACE_DONE) {
+            if (n_done >= 0)
+                n_woken_counted = n_woken;
+            else
+                n_woken = 0;
+            n_done++;
+        }
+    }
+    if (n_done <= 0)
+        return;
+    printf("%-50s %10.2f wakeups of the IO task per transaction\n", name,
+            (double) n_woken_counted / n_done);
+}
+
+static void run_virtual_bus_real_time_benchmarks(void) {
+    static VirtualBusBenchContext ctx;
+    if (!bench_selected("virtual_bus_real_time/ping"))
+        return;
+    dynamixel_virtual_servo_init(&ctx.servos[0], 1);
+    dynamixel_virtual_servo_write_u8(&ctx.servos[0], DYNAMIXEL_RETURN_DELAY_TIME, 0);
+    dynamixel_virtual_bus_init(&ctx.bus, &ctx.io_task, ctx.servos, 1, 1000000, false);
+    // generous timeouts, scheduling latency of the host is not an error here
+    dynamixel_io_task_create_with_driver(&ctx.io_task, "dxl", 1, 1,
+            dynamixel_virtual_bus_driver(&ctx.bus), 1000, 10000);
+
+    // 120us of bus time, the rest is turnaround of the host
+    virtual_bus_bench_run_traced(&ctx, "virtual_bus_real_time/ping", bench_virtual_bus_ping);
+    dynamixel_io_task_set_chained_reception(&ctx.io_task, true);
+    virtual_bus_bench_run_traced(&ctx, "virtual_bus_real_time/ping_chained", bench_virtual_bus_ping);
+}
+
+static void run_virtual_bus_benchmarks(void) {
+    static VirtualBusBenchContext ctx;
+    for (int i = 0; i < VIRTUAL_BUS_BENCH_N_SERVOS; i++) {
+        dynamixel_virtual_servo_init(&ctx.servos[i], i + 1);
+        // minimal return delay, as used in control loops
+        dynamixel_virtual_servo_write_u8(&ctx.servos[i], DYNAMIXEL_RETURN_DELAY_TIME, 0);
+        ctx.sync_data[3 * i] = i + 1;
+        ctx.sync_data[3 * i + 1] = i * 16;
+        ctx.sync_data[3 * i + 2] = 0x01;
+    }
+    dynamixel_virtual_bus_init(&ctx.bus, &ctx.io_task, ctx.servos,
+            VIRTUAL_BUS_BENCH_N_SERVOS, 1000000, true);
+    dynamixel_io_task_create_with_driver(&ctx.io_task, "dxl", 1, VIRTUAL_BUS_BENCH_N_SERVOS,
+            dynamixel_virtual_bus_driver(&ctx.bus), 12, 100);
+    dynamixel_io_completion_create(&ctx.completion, VIRTUAL_BUS_BENCH_N_SERVOS);
+    dynamixel_io_completion_create(&ctx.load_completion, VIRTUAL_BUS_BENCH_N_SERVOS);
+    ctx.load_done = xSemaphoreCreateBinary();
+
+    virtual_bus_bench_run(&ctx, "virtual_bus/ping", bench_virtual_bus_ping);
+    virtual_bus_bench_run_traced(&ctx, "virtual_bus/read_4", bench_virtual_bus_read);
+    virtual_bus_bench_run(&ctx, "virtual_bus/cycle_6_servos", bench_virtual_bus_cycle);
+    virtual_bus_bench_run(&ctx, "virtual_bus/cycle_6_servos_pipelined", bench_virtual_bus_cycle_pipelined);
+    virtual_bus_bench_run(&ctx, "virtual_bus/cycle_6_servos_batched", bench_virtual_bus_cycle_batched);
+    dynamixel_io_rx_pool_create(&ctx.rx_pool, ctx.rx_storage, 16, VIRTUAL_BUS_BENCH_N_SERVOS);
+    dynamixel_io_task_set_rx_pool(&ctx.io_task, &ctx.rx_pool);
+    for (int i = 0; i < VIRTUAL_BUS_BENCH_N_SERVOS; i++) {
+        ctx.batch[i].packet = &ctx.read_packets[i];
+        ctx.batch[i].response_size = dynamixel_prepare_read(&ctx.read_packets[i], i + 1,
+                DYNAMIXEL_PRESENT_POSITION_L, 2);
+    }
+    virtual_bus_bench_run(&ctx, "virtual_bus/cycle_6_servos_batched_pooled",
+            bench_virtual_bus_cycle_batched_pooled);
+    dynamixel_io_task_set_rx_pool(&ctx.io_task, NULL);
+    dynamixel_io_task_set_chained_reception(&ctx.io_task, true);
+    virtual_bus_bench_run_traced(&ctx, "virtual_bus/read_4_chained", bench_virtual_bus_read);
+    dynamixel_io_task_set_chained_reception(&ctx.io_task, false);
+    virtual_bus_bench_run_under_load(&ctx, "virtual_bus/sync_write_under_load", dio_PRIORITY_NORMAL);
+    virtual_bus_bench_run_under_load(&ctx, "virtual_bus/sync_write_under_load_control", dio_PRIORITY_CONTROL);
+    virtual_bus_bench_run(&ctx, "virtual_bus/sync_write_backlog", bench_virtual_bus_sync_backlog);
+    ctx.coalesce = true;
+    dynamixel_io_task_set_coalescing(&ctx.io_task, ctx.coalesced, 2);
+    virtual_bus_bench_run(&ctx, "virtual_bus/sync_write_backlog_coalesced", bench_virtual_bus_sync_backlog);
+    dynamixel_io_task_set_coalescing(&ctx.io_task, NULL, 0);
+
+    run_virtual_bus_real_time_benchmarks();
+}
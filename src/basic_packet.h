@@ -0,0 +1,108 @@
+#pragma once
+
+#include "dynamixel.h"
+#include "control_table.h"
+
+
+namespace Dynamixel {
+
+/*
+ * Packet with capacity given at compile time.
+ *
+ * DynamixelPacket can hold only DYNAMIXEL_MAX_N_PARAMETERS, which is kept
+ * small for small MCUs. BasicPacket<N> has the same memory layout, but can
+ * hold N parameters (up to the limit of the protocol), e.g. for sync-writes
+ * to many servos at once. It can be used everywhere where DynamixelPacket
+ * is expected through get().
+ */
+template<int N>
+class __attribute__ ((__packed__)) BasicPacket {
+    static_assert(N >= 2, "Packet must have space for at least read parameters");
+    static_assert(N <= DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS, "Packet too long for the protocol");
+public:
+    static constexpr int max_n_parameters = N;
+
+    DynamixelPacket *get() { return reinterpret_cast<DynamixelPacket *>(storage); }
+    DynamixelPacket *operator->() { return get(); }
+
+    // counterparts of dynamixel_prepare_* functions
+    int prepare_simple_instruction(uint8_t id, uint8_t instruction) {
+        return dynamixel_prepare_simple_instruction_sized(get(), N, id, instruction);
+    }
+    int prepare_ping(uint8_t id) {
+        return prepare_simple_instruction(id, DYNAMIXEL_INST_PING);
+    }
+    int prepare_write(uint8_t id, uint8_t address, const uint8_t *data, int data_len) {
+        return dynamixel_prepare_write_sized(get(), N, id, address, data, data_len);
+    }
+    int prepare_read(uint8_t id, uint8_t address, int data_len) {
+        return dynamixel_prepare_read_sized(get(), N, id, address, data_len);
+    }
+    int prepare_reg_write(uint8_t id, uint8_t address, const uint8_t *data, int data_len) {
+        return dynamixel_prepare_reg_write_sized(get(), N, id, address, data, data_len);
+    }
+    int prepare_sync_write(uint8_t address, const uint8_t *data, int n_actuators, int data_len_for_each) {
+        return dynamixel_prepare_sync_write_sized(get(), N, address, data, n_actuators, data_len_for_each);
+    }
+    int prepare_sync_write_init(uint8_t address, int data_len_for_each) {
+        return dynamixel_prepare_sync_write_init_sized(get(), N, address, data_len_for_each);
+    }
+    int prepare_sync_write_add_next(uint8_t id, const uint8_t *actuator_data) {
+        return dynamixel_prepare_sync_write_add_next_sized(get(), N, id, actuator_data);
+    }
+    int prepare_sync_write_end() {
+        return dynamixel_prepare_sync_write_end_sized(get(), N);
+    }
+    int prepare_bulk_read(const uint8_t *data, int n_actuators) {
+        return dynamixel_prepare_bulk_read_sized(get(), N, data, n_actuators);
+    }
+    int prepare_bulk_read_init() {
+        return dynamixel_prepare_bulk_read_init_sized(get(), N);
+    }
+    int prepare_bulk_read_add_next(uint8_t id, uint8_t address, int data_len) {
+        return dynamixel_prepare_bulk_read_add_next_sized(get(), N, id, address, data_len);
+    }
+    int prepare_bulk_read_end() {
+        return dynamixel_prepare_bulk_read_end_sized(get(), N);
+    }
+
+    // responses are received into the same storage, e.g. all status packets of bulk read
+    static constexpr int storage_size = DYNAMIXEL_PACKET_STORAGE_SIZE(N);
+
+    // typed counterparts (see control_table.h)
+    template<const Register &R>
+    int prepare_write(uint8_t id, uint16_t value) {
+        return Dynamixel::prepare_write<R>(*this, id, value);
+    }
+    template<const Register &R, uint16_t Value>
+    int prepare_write(uint8_t id) {
+        return Dynamixel::prepare_write<R, Value>(*this, id);
+    }
+    template<const Register &R>
+    int prepare_read(uint8_t id) {
+        return Dynamixel::prepare_read<R>(*this, id);
+    }
+    template<const Register &R>
+    int prepare_sync_write_init() {
+        return Dynamixel::prepare_sync_write_init<R>(*this);
+    }
+    template<const Register &R>
+    int prepare_bulk_read_add_next(uint8_t id) {
+        return Dynamixel::prepare_bulk_read_add_next<R>(*this, id);
+    }
+
+    int space_remaining() {
+        return dynamixel_packet_space_remaining_sized(get(), N);
+    }
+
+private:
+    uint8_t storage[storage_size];
+};
+
+// packet with the default capacity
+using Packet = BasicPacket<DYNAMIXEL_MAX_N_PARAMETERS>;
+// packet that can hold anything that servos can receive
+using MaxPacket = BasicPacket<DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS>;
+
+
+} // namespace Dynamixel
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <stdint.h>
+#include <type_traits>
+
+#include "dynamixel.h"
+
+
+namespace Dynamixel {
+
+/*
+ * Description of a register (or a block of registers) in the control table.
+ *
+ * Unlike the addresses in defines.h, descriptors know their width, access mode,
+ * memory area and the range of valid values, so the typed helpers below can
+ * reject invalid accesses at compile time (e.g. writing a read-only register),
+ * instead of sending a packet and getting a range/instruction error back.
+ *
+ * Descriptors are passed as template parameters:
+ *   MaxPacket packet;
+ *   int response_size = prepare_write<AX::GOAL_POSITION>(packet, id, 512);
+ *   int response_size = prepare_read<AX::PRESENT_POSITION>(packet, id);
+ *   prepare_write<AX::PRESENT_POSITION>(...);  // does not compile
+ *
+ * Adjacent registers can be merged at compile time to access them with one packet:
+ *   constexpr Register GOAL = coalesce(AX::GOAL_POSITION, AX::MOVING_SPEED);
+ */
+enum class Access: uint8_t {
+    READ_ONLY,
+    READ_WRITE,
+};
+
+enum class Area: uint8_t {
+    EEPROM,    // persistent, writes are slow and wear the memory out
+    RAM,       // reset to defaults on power up
+};
+
+struct Register {
+    uint8_t address;
+    uint8_t size;             // in bytes
+    Access access;
+    Area area;
+    bool is_volatile;         // value is changed by the servo itself (e.g. present position)
+    uint16_t min;             // range of valid values (only for registers of size 1 or 2)
+    uint16_t max;
+
+    constexpr bool is_writable() const { return access == Access::READ_WRITE; }
+    constexpr bool contains(uint32_t value) const { return value >= min && value <= max; }
+    constexpr int end() const { return address + size; }
+};
+
+// merges registers that are adjacent in the control table into one block (fails compilation
+// if they are not adjacent or in different areas), the block is writable only if both are,
+// range is not checked for blocks
+constexpr Register coalesce(Register first, Register second) {
+    return first.end() != second.address ? throw "coalesced registers must be adjacent"
+        : first.area != second.area ? throw "coalesced registers must be in the same area"
+        : Register{first.address, static_cast<uint8_t>(first.size + second.size),
+            first.is_writable() && second.is_writable() ? Access::READ_WRITE : Access::READ_ONLY,
+            first.area, first.is_volatile || second.is_volatile, 0, 0xffff};
+}
+
+
+/*
+ * Control table of AX-12 and AX-18 servos.
+ */
+namespace AX {
+    // EEPROM area
+    constexpr Register MODEL_NUMBER          {0x00, 2, Access::READ_ONLY,  Area::EEPROM, false, 0, 0xffff};
+    constexpr Register VERSION               {0x02, 1, Access::READ_ONLY,  Area::EEPROM, false, 0, 0xff};
+    constexpr Register ID                    {0x03, 1, Access::READ_WRITE, Area::EEPROM, false, 0, 253};
+    constexpr Register BAUD_RATE             {0x04, 1, Access::READ_WRITE, Area::EEPROM, false, 0, 254};
+    constexpr Register RETURN_DELAY_TIME     {0x05, 1, Access::READ_WRITE, Area::EEPROM, false, 0, 254};
+    constexpr Register CW_ANGLE_LIMIT        {0x06, 2, Access::READ_WRITE, Area::EEPROM, false, 0, 1023};
+    constexpr Register CCW_ANGLE_LIMIT       {0x08, 2, Access::READ_WRITE, Area::EEPROM, false, 0, 1023};
+    constexpr Register LIMIT_TEMPERATURE     {0x0b, 1, Access::READ_WRITE, Area::EEPROM, false, 0, 150};
+    constexpr Register DOWN_LIMIT_VOLTAGE    {0x0c, 1, Access::READ_WRITE, Area::EEPROM, false, 50, 250};
+    constexpr Register UP_LIMIT_VOLTAGE      {0x0d, 1, Access::READ_WRITE, Area::EEPROM, false, 50, 250};
+    constexpr Register MAX_TORQUE            {0x0e, 2, Access::READ_WRITE, Area::EEPROM, false, 0, 1023};
+    constexpr Register RETURN_LEVEL          {0x10, 1, Access::READ_WRITE, Area::EEPROM, false, 0, 2};
+    constexpr Register ALARM_LED             {0x11, 1, Access::READ_WRITE, Area::EEPROM, false, 0, 0x7f};
+    constexpr Register ALARM_SHUTDOWN        {0x12, 1, Access::READ_WRITE, Area::EEPROM, false, 0, 0x7f};
+    constexpr Register DOWN_CALIBRATION      {0x14, 2, Access::READ_ONLY,  Area::EEPROM, false, 0, 0xffff};
+    constexpr Register UP_CALIBRATION        {0x16, 2, Access::READ_ONLY,  Area::EEPROM, false, 0, 0xffff};
+    // RAM area
+    constexpr Register TORQUE_ENABLE         {0x18, 1, Access::READ_WRITE, Area::RAM, false, 0, 1};
+    constexpr Register LED                   {0x19, 1, Access::READ_WRITE, Area::RAM, false, 0, 1};
+    constexpr Register CW_COMPLIANCE_MARGIN  {0x1a, 1, Access::READ_WRITE, Area::RAM, false, 0, 0xff};
+    constexpr Register CCW_COMPLIANCE_MARGIN {0x1b, 1, Access::READ_WRITE, Area::RAM, false, 0, 0xff};
+    constexpr Register CW_COMPLIANCE_SLOPE   {0x1c, 1, Access::READ_WRITE, Area::RAM, false, 0, 0xfe};
+    constexpr Register CCW_COMPLIANCE_SLOPE  {0x1d, 1, Access::READ_WRITE, Area::RAM, false, 0, 0xfe};
+    constexpr Register GOAL_POSITION         {0x1e, 2, Access::READ_WRITE, Area::RAM, false, 0, 1023};
+    constexpr Register MOVING_SPEED          {0x20, 2, Access::READ_WRITE, Area::RAM, false, 0, 2047};
+    constexpr Register TORQUE_LIMIT          {0x22, 2, Access::READ_WRITE, Area::RAM, false, 0, 1023};
+    constexpr Register PRESENT_POSITION      {0x24, 2, Access::READ_ONLY,  Area::RAM, true,  0, 1023};
+    constexpr Register PRESENT_SPEED         {0x26, 2, Access::READ_ONLY,  Area::RAM, true,  0, 2047};
+    constexpr Register PRESENT_LOAD          {0x28, 2, Access::READ_ONLY,  Area::RAM, true,  0, 2047};
+    constexpr Register PRESENT_VOLTAGE       {0x2a, 1, Access::READ_ONLY,  Area::RAM, true,  0, 0xff};
+    constexpr Register PRESENT_TEMPERATURE   {0x2b, 1, Access::READ_ONLY,  Area::RAM, true,  0, 0xff};
+    constexpr Register REGISTERED            {0x2c, 1, Access::READ_WRITE, Area::RAM, true,  0, 1};
+    constexpr Register MOVING                {0x2e, 1, Access::READ_ONLY,  Area::RAM, true,  0, 1};
+    constexpr Register LOCK                  {0x2f, 1, Access::READ_WRITE, Area::RAM, false, 0, 1};
+    constexpr Register PUNCH                 {0x30, 2, Access::READ_WRITE, Area::RAM, false, 32, 1023};
+
+    // blocks commonly accessed together
+    constexpr Register GOAL_POSITION_AND_SPEED = coalesce(GOAL_POSITION, MOVING_SPEED);
+    constexpr Register PRESENT_POSITION_AND_SPEED = coalesce(PRESENT_POSITION, PRESENT_SPEED);
+
+    static_assert(GOAL_POSITION.address == DYNAMIXEL_GOAL_POSITION_L, "Wrong control table");
+    static_assert(PRESENT_POSITION.address == DYNAMIXEL_PRESENT_POSITION_L, "Wrong control table");
+    static_assert(PUNCH.address == DYNAMIXEL_PUNCH_L, "Wrong control table");
+    static_assert(GOAL_POSITION_AND_SPEED.size == 4 && GOAL_POSITION_AND_SPEED.is_writable(),
+            "Wrong coalescing");
+} // namespace AX
+
+
+template<int N>
+class BasicPacket;
+
+// read-only registers leave no matching function (instead of a static_assert,
+// so that it can be checked, e.g. by tests)
+template<const Register &R>
+using EnableIfWritable = typename std::enable_if<R.is_writable(), int>::type;
+
+namespace detail {
+
+template<const Register &R>
+int prepare_write_value(DynamixelPacket *packet, int max_n_parameters, uint8_t id, uint16_t value) {
+    static_assert(R.size == 1 || R.size == 2, "Only 1 or 2 byte registers can be written by value");
+    if (!R.contains(value))
+        return -1;
+    uint8_t data[] = {static_cast<uint8_t>(value & 0xff), static_cast<uint8_t>(value >> 8)};
+    return dynamixel_prepare_write_sized(packet, max_n_parameters, id, R.address, data, R.size);
+}
+
+} // namespace detail
+
+/*
+ * Typed counterparts of dynamixel_prepare_* functions for packets of any capacity
+ * (BasicPacket<N>, see basic_packet.h). Values are little endian, as always.
+ */
+template<const Register &R, int N, EnableIfWritable<R> = 0>
+int prepare_write(BasicPacket<N> &packet, uint8_t id, const uint8_t *data) {
+    return dynamixel_prepare_write_sized(packet.get(), N, id, R.address, data, R.size);
+}
+
+// writes a value of 1 or 2 byte register, returns -1 if the value is out of range
+template<const Register &R, int N, EnableIfWritable<R> = 0>
+int prepare_write(BasicPacket<N> &packet, uint8_t id, uint16_t value) {
+    return detail::prepare_write_value<R>(packet.get(), N, id, value);
+}
+
+// value checked at compile time
+template<const Register &R, uint16_t Value, int N, EnableIfWritable<R> = 0>
+int prepare_write(BasicPacket<N> &packet, uint8_t id) {
+    static_assert(R.contains(Value), "Value out of register range");
+    return detail::prepare_write_value<R>(packet.get(), N, id, Value);
+}
+
+template<const Register &R, int N>
+int prepare_read(BasicPacket<N> &packet, uint8_t id) {
+    return dynamixel_prepare_read_sized(packet.get(), N, id, R.address, R.size);
+}
+
+template<const Register &R, int N, EnableIfWritable<R> = 0>
+int prepare_sync_write_init(BasicPacket<N> &packet) {
+    return dynamixel_prepare_sync_write_init_sized(packet.get(), N, R.address, R.size);
+}
+
+template<const Register &R, int N>
+int prepare_bulk_read_add_next(BasicPacket<N> &packet, uint8_t id) {
+    return dynamixel_prepare_bulk_read_add_next_sized(packet.get(), N, id, R.address, R.size);
+}
+
+// the same for DynamixelPacket (of the default capacity)
+template<const Register &R, EnableIfWritable<R> = 0>
+int prepare_write(DynamixelPacket *packet, uint8_t id, uint16_t value) {
+    return detail::prepare_write_value<R>(packet, DYNAMIXEL_MAX_N_PARAMETERS, id, value);
+}
+
+template<const Register &R, uint16_t Value, EnableIfWritable<R> = 0>
+int prepare_write(DynamixelPacket *packet, uint8_t id) {
+    static_assert(R.contains(Value), "Value out of register range");
+    return detail::prepare_write_value<R>(packet, DYNAMIXEL_MAX_N_PARAMETERS, id, Value);
+}
+
+template<const Register &R>
+int prepare_read(DynamixelPacket *packet, uint8_t id) {
+    return dynamixel_prepare_read_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS, id, R.address, R.size);
+}
+
+
+} // namespace Dynamixel
@@ -0,0 +1,185 @@
+#include "conversions.h"
+
+// exact values (DYNAMIXEL_MAX_*_RAD use float)
+#define MAX_ANGLE_RAD     (DYNAMIXEL_MAX_ANGLE_DEG * 3.14159265358979323846 / 180)
+#define MAX_SPEED_RADPS   (DYNAMIXEL_SPEED_MAX_RPM * 2 * 3.14159265358979323846 / 60)
+#define ROUND(x)          ((int32_t) ((x) + 0.5))
+
+// Constants are scaled so that products always fit in 32 bits
+// (inputs are clamped to the range of registers first).
+// angle -> rad Q16: rad_q16 = angle * K, K in Q12
+#define ANGLE2RAD_Q16_K       ROUND(MAX_ANGLE_RAD / DYNAMIXEL_MAX_ANGLE_INT * 65536 * 4096)
+// largest angle in rad Q16
+#define MAX_ANGLE_RAD_Q16     ROUND(MAX_ANGLE_RAD * 65536)
+// rad Q12 -> angle: angle = rad_q12 * K, K in Q8 (result in Q20)
+#define RAD2ANGLE_Q16_K       ROUND(DYNAMIXEL_MAX_ANGLE_INT / MAX_ANGLE_RAD * 256)
+// (2 * angle - 1023) -> pi Q15: K in Q12
+#define CENTER_ANGLE          DYNAMIXEL_MAX_ANGLE_INT  // doubled center position
+#define ANGLE2PI_Q15_K        ROUND(DYNAMIXEL_MAX_ANGLE_DEG / 2.0 / DYNAMIXEL_MAX_ANGLE_INT / 180 * 32768 * 4096)
+#define MAX_ANGLE_PI_Q15      ROUND(DYNAMIXEL_MAX_ANGLE_DEG / 2.0 / 180 * 32768)
+// pi Q15 -> (2 * angle - 1023): K in Q20
+#define PI_Q152ANGLE_K        ROUND(1 / (DYNAMIXEL_MAX_ANGLE_DEG / 2.0 / DYNAMIXEL_MAX_ANGLE_INT / 180 * 32768) * (1 << 20))
+// speed -> rad/s Q16: K in Q12 (needs unsigned product)
+#define SPEED2RADPS_Q16_K     ((uint32_t) ROUND(MAX_SPEED_RADPS / DYNAMIXEL_SPEED_MAX_VALUE * 65536 * 4096))
+#define MAX_SPEED_RADPS_Q16   ROUND(MAX_SPEED_RADPS * 65536)
+// rad/s Q12 -> speed: K in Q9 (result in Q21)
+#define RADPS2SPEED_Q16_K     ((uint32_t) ROUND(DYNAMIXEL_SPEED_MAX_VALUE / MAX_SPEED_RADPS * 512))
+// for float conversions
+#define ANGLE2RAD_F           ((float) (MAX_ANGLE_RAD / DYNAMIXEL_MAX_ANGLE_INT))
+#define RAD2ANGLE_F           ((float) (DYNAMIXEL_MAX_ANGLE_INT / MAX_ANGLE_RAD))
+#define SPEED2RADPS_F         ((float) (MAX_SPEED_RADPS / DYNAMIXEL_SPEED_MAX_VALUE))
+#define RADPS2SPEED_F         ((float) (DYNAMIXEL_SPEED_MAX_VALUE / MAX_SPEED_RADPS))
+
+#define SPEED_MAGNITUDE(value)  ((value) & DYNAMIXEL_SPEED_MAX_VALUE)
+#define SPEED_IS_CW(value)      (((value) & DYNAMIXEL_GOAL_SPEED_DIRECTION_MASK) != 0)
+
+
+// inline versions, so that batch functions can be vectorized
+static inline int32_t angle2rad_q16(uint16_t angle) {
+    angle = angle > DYNAMIXEL_MAX_ANGLE_INT ? DYNAMIXEL_MAX_ANGLE_INT : angle;
+    return (angle * ANGLE2RAD_Q16_K + (1 << 11)) >> 12;
+}
+
+static inline uint16_t rad2angle_q16(int32_t rad_q16) {
+    rad_q16 = rad_q16 < 0 ? 0 : rad_q16;
+    rad_q16 = rad_q16 > MAX_ANGLE_RAD_Q16 ? MAX_ANGLE_RAD_Q16 : rad_q16;
+    int32_t rad_q12 = (rad_q16 + 8) >> 4;
+    return (rad_q12 * RAD2ANGLE_Q16_K + (1 << 19)) >> 20;
+}
+
+static inline int16_t angle2pi_q15(uint16_t angle) {
+    angle = angle > DYNAMIXEL_MAX_ANGLE_INT ? DYNAMIXEL_MAX_ANGLE_INT : angle;
+    int32_t centered = 2 * (int32_t) angle - CENTER_ANGLE;
+    // division instead of shift, so that rounding is symmetric
+    int32_t scaled = centered * ANGLE2PI_Q15_K;
+    return (scaled + (scaled < 0 ? -(1 << 11) : (1 << 11))) / (1 << 12);
+}
+
+static inline uint16_t pi2angle_q15(int16_t pi_q15) {
+    int32_t value = pi_q15;
+    value = value < -MAX_ANGLE_PI_Q15 ? -MAX_ANGLE_PI_Q15 : value;
+    value = value > MAX_ANGLE_PI_Q15 ? MAX_ANGLE_PI_Q15 : value;
+    // angle = (value / K + 1023) / 2, always non-negative
+    uint32_t doubled_q20 = (uint32_t) (value * PI_Q152ANGLE_K + (CENTER_ANGLE << 20));
+    uint16_t angle = (doubled_q20 + (1 << 20)) >> 21;
+    return angle > DYNAMIXEL_MAX_ANGLE_INT ? DYNAMIXEL_MAX_ANGLE_INT : angle;
+}
+
+static inline int32_t speed2radps_q16(uint16_t speed) {
+    int32_t magnitude = (SPEED_MAGNITUDE(speed) * SPEED2RADPS_Q16_K + (1 << 11)) >> 12;
+    return SPEED_IS_CW(speed) ? -magnitude : magnitude;
+}
+
+static inline uint16_t radps2speed_q16(int32_t radps_q16) {
+    uint32_t magnitude = radps_q16 < 0 ? -radps_q16 : radps_q16;
+    magnitude = magnitude > MAX_SPEED_RADPS_Q16 ? MAX_SPEED_RADPS_Q16 : magnitude;
+    uint32_t radps_q12 = (magnitude + 8) >> 4;
+    uint16_t speed = (radps_q12 * RADPS2SPEED_Q16_K + (1 << 20)) >> 21;
+    return radps_q16 < 0 ? speed | DYNAMIXEL_GOAL_SPEED_DIRECTION_MASK : speed;
+}
+
+static inline float speed2radps(uint16_t speed) {
+    float magnitude = SPEED_MAGNITUDE(speed) * SPEED2RADPS_F;
+    return SPEED_IS_CW(speed) ? -magnitude : magnitude;
+}
+
+static inline uint16_t radps2speed(float radps) {
+    float magnitude = radps < 0 ? -radps : radps;
+    magnitude = magnitude * RADPS2SPEED_F + 0.5f;
+    magnitude = magnitude > DYNAMIXEL_SPEED_MAX_VALUE ? DYNAMIXEL_SPEED_MAX_VALUE : magnitude;
+    uint16_t speed = (uint16_t) magnitude;
+    return radps < 0 ? speed | DYNAMIXEL_GOAL_SPEED_DIRECTION_MASK : speed;
+}
+
+static inline uint16_t rad2angle(float rad) {
+    float angle = rad * RAD2ANGLE_F + 0.5f;
+    angle = angle < 0 ? 0 : angle;
+    angle = angle > DYNAMIXEL_MAX_ANGLE_INT ? DYNAMIXEL_MAX_ANGLE_INT : angle;
+    return (uint16_t) angle;
+}
+
+
+int32_t dynamixel_angle2rad_q16(uint16_t angle_int) {
+    return angle2rad_q16(angle_int);
+}
+
+uint16_t dynamixel_rad2angle_q16(int32_t angle_rad_q16) {
+    return rad2angle_q16(angle_rad_q16);
+}
+
+int16_t dynamixel_angle2pi_q15(uint16_t angle_int) {
+    return angle2pi_q15(angle_int);
+}
+
+uint16_t dynamixel_pi2angle_q15(int16_t angle_pi_q15) {
+    return pi2angle_q15(angle_pi_q15);
+}
+
+float dynamixel_speed2radps(uint16_t speed_int) {
+    return speed2radps(speed_int);
+}
+
+uint16_t dynamixel_radps2speed(float speed_radps) {
+    return radps2speed(speed_radps);
+}
+
+int32_t dynamixel_speed2radps_q16(uint16_t speed_int) {
+    return speed2radps_q16(speed_int);
+}
+
+uint16_t dynamixel_radps2speed_q16(int32_t speed_radps_q16) {
+    return radps2speed_q16(speed_radps_q16);
+}
+
+/*  */
+
+void dynamixel_angles2rad(const uint16_t *angles_int, float *angles_rad, int n) {
+    for (int i = 0; i < n; i++)
+        angles_rad[i] = angles_int[i] * ANGLE2RAD_F;
+}
+
+void dynamixel_rad2angles(const float *angles_rad, uint16_t *angles_int, int n) {
+    for (int i = 0; i < n; i++)
+        angles_int[i] = rad2angle(angles_rad[i]);
+}
+
+void dynamixel_angles2rad_q16(const uint16_t *angles_int, int32_t *angles_rad_q16, int n) {
+    for (int i = 0; i < n; i++)
+        angles_rad_q16[i] = angle2rad_q16(angles_int[i]);
+}
+
+void dynamixel_rad2angles_q16(const int32_t *angles_rad_q16, uint16_t *angles_int, int n) {
+    for (int i = 0; i < n; i++)
+        angles_int[i] = rad2angle_q16(angles_rad_q16[i]);
+}
+
+void dynamixel_angles2pi_q15(const uint16_t *angles_int, int16_t *angles_pi_q15, int n) {
+    for (int i = 0; i < n; i++)
+        angles_pi_q15[i] = angle2pi_q15(angles_int[i]);
+}
+
+void dynamixel_pi2angles_q15(const int16_t *angles_pi_q15, uint16_t *angles_int, int n) {
+    for (int i = 0; i < n; i++)
+        angles_int[i] = pi2angle_q15(angles_pi_q15[i]);
+}
+
+void dynamixel_speeds2radps(const uint16_t *speeds_int, float *speeds_radps, int n) {
+    for (int i = 0; i < n; i++)
+        speeds_radps[i] = speed2radps(speeds_int[i]);
+}
+
+void dynamixel_radps2speeds(const float *speeds_radps, uint16_t *speeds_int, int n) {
+    for (int i = 0; i < n; i++)
+        speeds_int[i] = radps2speed(speeds_radps[i]);
+}
+
+void dynamixel_speeds2radps_q16(const uint16_t *speeds_int, int32_t *speeds_radps_q16, int n) {
+    for (int i = 0; i < n; i++)
+        speeds_radps_q16[i] = speed2radps_q16(speeds_int[i]);
+}
+
+void dynamixel_radps2speeds_q16(const int32_t *speeds_radps_q16, uint16_t *speeds_int, int n) {
+    for (int i = 0; i < n; i++)
+        speeds_int[i] = radps2speed_q16(speeds_radps_q16[i]);
+}
+
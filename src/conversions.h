@@ -0,0 +1,69 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Conversions between register values and SI units for MCUs without FPU
+ * and for whole groups of servos.
+ *
+ * Fixed-point formats:
+ *   Q16 - int32_t with 16 fractional bits (1.0 = 65536)
+ *   Q15 - int16_t with 15 fractional bits (1.0 = 32768)
+ *
+ * Angles (register 0-1023 = 0-300 deg, see dynamixel_angle2rad()):
+ *  - *_q16: radians in Q16, 0 = position 0 (the same as float versions)
+ *  - *pi*_q15: fraction of pi (not radians) in Q15 relative to the center
+ *      position (150 deg), i.e. -150 deg .. 150 deg = -0.8333 .. 0.8333
+ * Speeds (register 0-1023 = 0-114 RPM, see DYNAMIXEL_SPEED_FROM_RADPS):
+ *  - rad/s, positive is counter-clockwise, negative values are encoded
+ *    with DYNAMIXEL_GOAL_SPEED_DIRECTION_MASK (clockwise, as in wheel mode
+ *    and in present speed register)
+ *
+ * All the conversions use only 32-bit integer arithmetic. Conversions to
+ * registers round to the nearest value and saturate instead of asserting.
+ * Rounding errors (verified by tests for whole ranges):
+ *  - register -> rad Q16: at most 1 LSB of Q16 (1.5e-5 rad)
+ *  - register -> Q15: at most 1 LSB of Q15
+ *  - register -> rad/s Q16: at most 1 LSB of Q16
+ *  - SI -> register: at most 0.53 register unit (so register -> SI -> register
+ *    always gives the same value)
+ *
+ * Batch functions convert whole arrays (e.g. positions of a servo group)
+ * and are written to be auto-vectorized by the compiler on hosts with SIMD.
+ */
+
+#include <stdint.h>
+
+#include "defines.h"
+
+/* --- Scalar conversions --- */
+int32_t dynamixel_angle2rad_q16(uint16_t angle_int);
+uint16_t dynamixel_rad2angle_q16(int32_t angle_rad_q16);
+int16_t dynamixel_angle2pi_q15(uint16_t angle_int);
+uint16_t dynamixel_pi2angle_q15(int16_t angle_pi_q15);
+
+float dynamixel_speed2radps(uint16_t speed_int);
+uint16_t dynamixel_radps2speed(float speed_radps);
+int32_t dynamixel_speed2radps_q16(uint16_t speed_int);
+uint16_t dynamixel_radps2speed_q16(int32_t speed_radps_q16);
+
+/* --- Batch conversions --- */
+void dynamixel_angles2rad(const uint16_t *angles_int, float *angles_rad, int n);
+void dynamixel_rad2angles(const float *angles_rad, uint16_t *angles_int, int n);
+void dynamixel_angles2rad_q16(const uint16_t *angles_int, int32_t *angles_rad_q16, int n);
+void dynamixel_rad2angles_q16(const int32_t *angles_rad_q16, uint16_t *angles_int, int n);
+void dynamixel_angles2pi_q15(const uint16_t *angles_int, int16_t *angles_pi_q15, int n);
+void dynamixel_pi2angles_q15(const int16_t *angles_pi_q15, uint16_t *angles_int, int n);
+
+void dynamixel_speeds2radps(const uint16_t *speeds_int, float *speeds_radps, int n);
+void dynamixel_radps2speeds(const float *speeds_radps, uint16_t *speeds_int, int n);
+void dynamixel_speeds2radps_q16(const uint16_t *speeds_int, int32_t *speeds_radps_q16, int n);
+void dynamixel_radps2speeds_q16(const int32_t *speeds_radps_q16, uint16_t *speeds_int, int n);
+
+
+#ifdef __cplusplus
+}
+#endif
+
@@ -7,6 +7,11 @@ extern "C" {
 /* Model number for AX12 servos */
 #define DYNAMIXEL_AX12_MODEL_NUMBER           0x0c
 #define DYNAMIXEL_AX18_MODEL_NUMBER           0x12
+/* Model numbers of MX servos (protocol 1.0 firmware), they support BULK_READ */
+#define DYNAMIXEL_MX12W_MODEL_NUMBER          0x168
+#define DYNAMIXEL_MX28_MODEL_NUMBER           0x1d
+#define DYNAMIXEL_MX64_MODEL_NUMBER           0x136
+#define DYNAMIXEL_MX106_MODEL_NUMBER          0x140
 
 /* --- MEMORY ADDRESSING --- */
 // EEPROM area
@@ -74,6 +79,7 @@ extern "C" {
 #define DYNAMIXEL_INST_SYSTEM_WRITE           0x0D
 #define DYNAMIXEL_INST_SYNC_WRITE             0x83
 #define DYNAMIXEL_INST_SYNC_REG_WRITE         0x84
+#define DYNAMIXEL_INST_BULK_READ              0x92  // MX series and newer
 
 /* Broadcasting ID */
 #define DYNAMIXEL_BROADCASTING_ID             0xFE
@@ -47,6 +47,7 @@ void dynamixel_servos_discovery(DynamixelIOTaskHandle *io_task,
         if (is_ok && response.status == dio_OK) {
             model_number_ok = true;
             model_number = ((uint16_t) (response.data[1]) << 8) | (response.data[0] & 0xff);
+            dynamixel_io_release_response(io_task, &response);
         }
 
         // to use a loop
@@ -62,6 +63,7 @@ void dynamixel_servos_discovery(DynamixelIOTaskHandle *io_task,
             if (is_ok && response.status == dio_OK) {
                 *oks[j] = true;
                 *registers[j] = response.data[0];
+                dynamixel_io_release_response(io_task, &response);
             }
         }
 
@@ -106,7 +108,10 @@ static bool ping_servo(DynamixelIOTaskHandle *io_task, DynamixelPacket *packet,
     // wait for response
     DynamixelIOResponse response;
     is_ok = dynamixel_io_wait_response(io_task, &response);
+    if (!is_ok)
+        return false;
+    dynamixel_io_release_response(io_task, &response);
 
-    return is_ok && response.status == dio_OK;
+    return response.status == dio_OK;
 }
 
@@ -1,14 +1,70 @@
 #include <assert.h>
+#include <stddef.h>
 #include "dynamixel.h"
 
 #define CHECKSUM 1   // be more verbose
 
 
 int dynamixel_prepare_write(DynamixelPacket *packet, uint8_t id, uint8_t address, const uint8_t *data, int data_len) {
-    dynamixel_packet_init(packet, id, DYNAMIXEL_INST_WRITE);
-    bool is_ok = dynamixel_packet_add_parameter(packet, address);
-    is_ok = is_ok && dynamixel_packet_add_parameters(packet, data, data_len);
-    is_ok = is_ok && dynamixel_packet_add_checksum(packet);
+    return dynamixel_prepare_write_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS, id, address, data, data_len);
+}
+
+int dynamixel_prepare_read(DynamixelPacket *packet, uint8_t id, uint8_t address, int data_len) {
+    return dynamixel_prepare_read_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS, id, address, data_len);
+}
+
+int dynamixel_prepare_reg_write(DynamixelPacket *packet, uint8_t id, uint8_t address, const uint8_t *data, int data_len) {
+    return dynamixel_prepare_reg_write_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS, id, address, data, data_len);
+}
+
+int dynamixel_prepare_sync_write(DynamixelPacket *packet, uint8_t address, const uint8_t *data, int n_actuators, int data_len_for_each) {
+    return dynamixel_prepare_sync_write_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS,
+            address, data, n_actuators, data_len_for_each);
+}
+
+int dynamixel_prepare_sync_write_init(DynamixelPacket *packet, uint8_t address, int data_len_for_each) {
+    return dynamixel_prepare_sync_write_init_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS,
+            address, data_len_for_each);
+}
+
+int dynamixel_prepare_sync_write_add_next(DynamixelPacket *packet, uint8_t id, const uint8_t *actuator_data) {
+    return dynamixel_prepare_sync_write_add_next_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS, id, actuator_data);
+}
+
+int dynamixel_prepare_sync_write_end(DynamixelPacket *packet) {
+    return dynamixel_prepare_sync_write_end_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS);
+}
+
+int dynamixel_prepare_bulk_read(DynamixelPacket *packet, const uint8_t *data, int n_actuators) {
+    return dynamixel_prepare_bulk_read_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS, data, n_actuators);
+}
+
+int dynamixel_prepare_bulk_read_init(DynamixelPacket *packet) {
+    return dynamixel_prepare_bulk_read_init_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS);
+}
+
+int dynamixel_prepare_bulk_read_add_next(DynamixelPacket *packet, uint8_t id, uint8_t address, int data_len) {
+    return dynamixel_prepare_bulk_read_add_next_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS,
+            id, address, data_len);
+}
+
+int dynamixel_prepare_bulk_read_end(DynamixelPacket *packet) {
+    return dynamixel_prepare_bulk_read_end_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS);
+}
+
+int dynamixel_prepare_simple_instruction(DynamixelPacket *packet, uint8_t id, uint8_t instruction) {
+    return dynamixel_prepare_simple_instruction_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS, id, instruction);
+}
+
+/*  */
+
+int dynamixel_prepare_write_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, uint8_t address, const uint8_t *data, int data_len)
+{
+    dynamixel_packet_init_sized(packet, max_n_parameters, id, DYNAMIXEL_INST_WRITE);
+    bool is_ok = dynamixel_packet_add_parameter_sized(packet, max_n_parameters, address);
+    is_ok = is_ok && dynamixel_packet_add_parameters_sized(packet, max_n_parameters, data, data_len);
+    is_ok = is_ok && dynamixel_packet_add_checksum_sized(packet, max_n_parameters);
     if (!is_ok)
         return -1;
     if (id == DYNAMIXEL_BROADCASTING_ID)
@@ -16,12 +72,13 @@ int dynamixel_prepare_write(DynamixelPacket *packet, uint8_t id, uint8_t address
     return DYNAMIXEL_PACKET_BASE_SIZE + CHECKSUM;
 }
 
-
-int dynamixel_prepare_read(DynamixelPacket *packet, uint8_t id, uint8_t address, int data_len) {
-    dynamixel_packet_init(packet, id, DYNAMIXEL_INST_READ);
+int dynamixel_prepare_read_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, uint8_t address, int data_len)
+{
+    dynamixel_packet_init_sized(packet, max_n_parameters, id, DYNAMIXEL_INST_READ);
     uint8_t data[] = {address, data_len};
-    bool is_ok = dynamixel_packet_add_parameters(packet, data, 2);
-    is_ok = is_ok && dynamixel_packet_add_checksum(packet);
+    bool is_ok = dynamixel_packet_add_parameters_sized(packet, max_n_parameters, data, 2);
+    is_ok = is_ok && dynamixel_packet_add_checksum_sized(packet, max_n_parameters);
     if (!is_ok)
         return -1;
     if (id == DYNAMIXEL_BROADCASTING_ID)
@@ -29,11 +86,13 @@ int dynamixel_prepare_read(DynamixelPacket *packet, uint8_t id, uint8_t address,
     return DYNAMIXEL_PACKET_BASE_SIZE + data_len + CHECKSUM;
 }
 
-int dynamixel_prepare_reg_write(DynamixelPacket *packet, uint8_t id, uint8_t address, const uint8_t *data, int data_len) {
-    dynamixel_packet_init(packet, id, DYNAMIXEL_INST_REG_WRITE);
-    bool is_ok = dynamixel_packet_add_parameter(packet, address);
-    is_ok = is_ok && dynamixel_packet_add_parameters(packet, data, data_len);
-    is_ok = is_ok && dynamixel_packet_add_checksum(packet);
+int dynamixel_prepare_reg_write_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, uint8_t address, const uint8_t *data, int data_len)
+{
+    dynamixel_packet_init_sized(packet, max_n_parameters, id, DYNAMIXEL_INST_REG_WRITE);
+    bool is_ok = dynamixel_packet_add_parameter_sized(packet, max_n_parameters, address);
+    is_ok = is_ok && dynamixel_packet_add_parameters_sized(packet, max_n_parameters, data, data_len);
+    is_ok = is_ok && dynamixel_packet_add_checksum_sized(packet, max_n_parameters);
     if (!is_ok)
         return -1;
     if (id == DYNAMIXEL_BROADCASTING_ID)
@@ -41,46 +100,109 @@ int dynamixel_prepare_reg_write(DynamixelPacket *packet, uint8_t id, uint8_t add
     return DYNAMIXEL_PACKET_BASE_SIZE + CHECKSUM;
 }
 
-int dynamixel_prepare_sync_write(DynamixelPacket *packet, uint8_t address, const uint8_t *data, int n_actuators, int data_len_for_each) {
-    dynamixel_packet_init(packet, DYNAMIXEL_BROADCASTING_ID, DYNAMIXEL_INST_SYNC_WRITE);
-    bool is_ok = dynamixel_packet_add_parameter(packet, address);
-    is_ok = is_ok && dynamixel_packet_add_parameter(packet, data_len_for_each);
-    is_ok = is_ok && dynamixel_packet_add_parameters(packet, data, (data_len_for_each + 1) * n_actuators);
-    is_ok = is_ok && dynamixel_packet_add_checksum(packet);
+int dynamixel_prepare_sync_write_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t address, const uint8_t *data, int n_actuators, int data_len_for_each)
+{
+    dynamixel_packet_init_sized(packet, max_n_parameters, DYNAMIXEL_BROADCASTING_ID, DYNAMIXEL_INST_SYNC_WRITE);
+    bool is_ok = dynamixel_packet_add_parameter_sized(packet, max_n_parameters, address);
+    is_ok = is_ok && dynamixel_packet_add_parameter_sized(packet, max_n_parameters, data_len_for_each);
+    is_ok = is_ok && dynamixel_packet_add_parameters_sized(packet, max_n_parameters,
+            data, (data_len_for_each + 1) * n_actuators);
+    is_ok = is_ok && dynamixel_packet_add_checksum_sized(packet, max_n_parameters);
     if (!is_ok)
         return -1;
     return 0; // always broadcasting
 }
 
-int dynamixel_prepare_sync_write_init(DynamixelPacket *packet, uint8_t address, int data_len_for_each) {
-    dynamixel_packet_init(packet, DYNAMIXEL_BROADCASTING_ID, DYNAMIXEL_INST_SYNC_WRITE);
-    bool is_ok = dynamixel_packet_add_parameter(packet, address);
-    is_ok = is_ok && dynamixel_packet_add_parameter(packet, data_len_for_each);
+int dynamixel_prepare_sync_write_init_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t address, int data_len_for_each)
+{
+    dynamixel_packet_init_sized(packet, max_n_parameters, DYNAMIXEL_BROADCASTING_ID, DYNAMIXEL_INST_SYNC_WRITE);
+    bool is_ok = dynamixel_packet_add_parameter_sized(packet, max_n_parameters, address);
+    is_ok = is_ok && dynamixel_packet_add_parameter_sized(packet, max_n_parameters, data_len_for_each);
     if (!is_ok)
         return -1;
     return 0;
 }
 
-int dynamixel_prepare_sync_write_add_next(DynamixelPacket *packet, uint8_t id, const uint8_t *actuator_data) {
+int dynamixel_prepare_sync_write_add_next_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, const uint8_t *actuator_data)
+{
     int data_len_for_each = packet->parameters_with_checksum[1]; // it is the second parameter
-    bool is_ok = dynamixel_packet_add_parameter(packet, id);
-    is_ok = is_ok && dynamixel_packet_add_parameters(packet, actuator_data, data_len_for_each);
+    bool is_ok = dynamixel_packet_add_parameter_sized(packet, max_n_parameters, id);
+    is_ok = is_ok && dynamixel_packet_add_parameters_sized(packet, max_n_parameters,
+            actuator_data, data_len_for_each);
     if (!is_ok)
         return -1;
     return 0;
 }
 
-int dynamixel_prepare_sync_write_end(DynamixelPacket *packet) {
-    bool is_ok = dynamixel_packet_add_checksum(packet);
+int dynamixel_prepare_sync_write_end_sized(DynamixelPacket *packet, int max_n_parameters) {
+    bool is_ok = dynamixel_packet_add_checksum_sized(packet, max_n_parameters);
     if (!is_ok)
         return -1;
     return 0;
 }
 
+int dynamixel_prepare_bulk_read_sized(DynamixelPacket *packet, int max_n_parameters,
+        const uint8_t *data, int n_actuators)
+{
+    bool is_ok = dynamixel_prepare_bulk_read_init_sized(packet, max_n_parameters) == 0;
+    is_ok = is_ok && dynamixel_packet_add_parameters_sized(packet, max_n_parameters,
+            data, 3 * n_actuators);
+    if (!is_ok)
+        return -1;
+    return dynamixel_prepare_bulk_read_end_sized(packet, max_n_parameters);
+}
 
-int dynamixel_prepare_simple_instruction(DynamixelPacket *packet, uint8_t id, uint8_t instruction) {
-    dynamixel_packet_init(packet, id, instruction);
-    dynamixel_packet_add_checksum(packet);
+int dynamixel_prepare_bulk_read_init_sized(DynamixelPacket *packet, int max_n_parameters) {
+    dynamixel_packet_init_sized(packet, max_n_parameters, DYNAMIXEL_BROADCASTING_ID, DYNAMIXEL_INST_BULK_READ);
+    // the first parameter is always 0x00
+    bool is_ok = dynamixel_packet_add_parameter_sized(packet, max_n_parameters, 0x00);
+    if (!is_ok)
+        return -1;
+    return 0;
+}
+
+int dynamixel_prepare_bulk_read_add_next_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, uint8_t address, int data_len)
+{
+    uint8_t data[] = {data_len, id, address};
+    bool is_ok = dynamixel_packet_add_parameters_sized(packet, max_n_parameters, data, 3);
+    if (!is_ok)
+        return -1;
+    return 0;
+}
+
+int dynamixel_prepare_bulk_read_end_sized(DynamixelPacket *packet, int max_n_parameters) {
+    bool is_ok = dynamixel_packet_add_checksum_sized(packet, max_n_parameters);
+    if (!is_ok)
+        return -1;
+    // each servo sends status packet with its data
+    int response_size = 0;
+    int n_parameters = dynamixel_packet_n_parameters(packet);
+    for (int i = 1; i + 2 < n_parameters; i += 3)
+        response_size += DYNAMIXEL_PACKET_BASE_SIZE + packet->parameters_with_checksum[i] + CHECKSUM;
+    return response_size;
+}
+
+DynamixelPacket *dynamixel_status_packets_next(uint8_t *data, int data_len, int *offset) {
+    int remaining = data_len - *offset;
+    if (remaining < DYNAMIXEL_PACKET_BASE_SIZE + CHECKSUM)
+        return NULL;
+    DynamixelPacket *packet = (DynamixelPacket *) &data[*offset];
+    int size = dynamixel_packet_size(packet);
+    if (packet->length < 2 || size > remaining)
+        return NULL;
+    *offset += size;
+    return packet;
+}
+
+int dynamixel_prepare_simple_instruction_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, uint8_t instruction)
+{
+    dynamixel_packet_init_sized(packet, max_n_parameters, id, instruction);
+    dynamixel_packet_add_checksum_sized(packet, max_n_parameters);
     assert(packet->length == 0x02);
     if (id == DYNAMIXEL_BROADCASTING_ID)
         return 0;  // no responese when breadcasting
@@ -88,6 +210,8 @@ int dynamixel_prepare_simple_instruction(DynamixelPacket *packet, uint8_t id, ui
     return DYNAMIXEL_PACKET_BASE_SIZE + CHECKSUM;
 }
 
+/*  */
+
 int dynamixel_prepare_ping(DynamixelPacket *packet, uint8_t id) {
     return dynamixel_prepare_simple_instruction(packet, id, DYNAMIXEL_INST_PING);
 }
@@ -46,6 +46,22 @@ int dynamixel_prepare_sync_write_init(DynamixelPacket *packet, uint8_t address,
 int dynamixel_prepare_sync_write_add_next(DynamixelPacket *packet, uint8_t id, const uint8_t *actuator_data);
 int dynamixel_prepare_sync_write_end(DynamixelPacket *packet);
 
+// Bulk read (MX series, not supported by AX servos) reads data from many servos using
+// one instruction packet, address and data length may be different for each servo.
+// Each servo responds with separate status packet, in the order in which they are listed,
+// so the functions return the size of all status packets (see dynamixel_status_packets_next()).
+// Expects data to be an array in format: {L1, id1, address1, L2, id2, address2, ...}
+int dynamixel_prepare_bulk_read(DynamixelPacket *packet, const uint8_t *data, int n_actuators);
+// incremental interface, like for sync-write
+int dynamixel_prepare_bulk_read_init(DynamixelPacket *packet);
+int dynamixel_prepare_bulk_read_add_next(DynamixelPacket *packet, uint8_t id, uint8_t address, int data_len);
+int dynamixel_prepare_bulk_read_end(DynamixelPacket *packet);
+
+// Iterates over status packets stored one after another (as received for bulk read),
+// offset must be 0 at first and is moved past the returned packet,
+// returns NULL when there is no next packet (or it does not fit into data_len)
+DynamixelPacket *dynamixel_status_packets_next(uint8_t *data, int data_len, int *offset);
+
 // convenient wrappers around simple reading and writing of a single register
 int dynamixel_prepare_set_register_u8(DynamixelPacket *packet, uint8_t id, uint8_t address, uint8_t value);
 int dynamixel_prepare_set_register_u16(DynamixelPacket *packet, uint8_t id, uint8_t address, uint16_t value);
@@ -53,6 +69,34 @@ int dynamixel_prepare_read_register_u8(DynamixelPacket *packet, uint8_t id, uint
 int dynamixel_prepare_read_register_u16(DynamixelPacket *packet, uint8_t id, uint8_t address);
 
 
+/*
+ * Variants of the functions above for packets with capacity different than
+ * DYNAMIXEL_MAX_N_PARAMETERS (see DYNAMIXEL_PACKET_STORAGE_SIZE in packet.h),
+ * e.g. for sync-writes to many servos (up to DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS).
+ */
+int dynamixel_prepare_simple_instruction_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, uint8_t instruction);
+int dynamixel_prepare_write_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, uint8_t address, const uint8_t *data, int data_len);
+int dynamixel_prepare_read_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, uint8_t address, int data_len);
+int dynamixel_prepare_reg_write_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, uint8_t address, const uint8_t *data, int data_len);
+int dynamixel_prepare_sync_write_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t address, const uint8_t *data, int n_actuators, int data_len_for_each);
+int dynamixel_prepare_sync_write_init_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t address, int data_len_for_each);
+int dynamixel_prepare_sync_write_add_next_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, const uint8_t *actuator_data);
+int dynamixel_prepare_sync_write_end_sized(DynamixelPacket *packet, int max_n_parameters);
+int dynamixel_prepare_bulk_read_sized(DynamixelPacket *packet, int max_n_parameters,
+        const uint8_t *data, int n_actuators);
+int dynamixel_prepare_bulk_read_init_sized(DynamixelPacket *packet, int max_n_parameters);
+int dynamixel_prepare_bulk_read_add_next_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, uint8_t address, int data_len);
+int dynamixel_prepare_bulk_read_end_sized(DynamixelPacket *packet, int max_n_parameters);
+
+
 /*
  * Angle conversions
  * Internally angles 0-300 deg are represented as 0-1023
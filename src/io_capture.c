@@ -0,0 +1,126 @@
+#include <string.h>
+
+#include "io_capture.h"
+
+// copies into the ring at the given (wrapping) position
+static void copy_in(DynamixelIOCaptureRing *ring, uint32_t position, const void *data, uint32_t len)
+{
+    if (len == 0)
+        return;
+    uint32_t start = position & (ring->size - 1);
+    uint32_t first = len < ring->size - start ? len : ring->size - start;
+    memcpy(&ring->buffer[start], data, first);
+    memcpy(ring->buffer, (const uint8_t *) data + first, len - first);
+}
+
+static void copy_out(DynamixelIOCaptureRing *ring, uint32_t position, uint8_t *out, uint32_t len)
+{
+    uint32_t start = position & (ring->size - 1);
+    uint32_t first = len < ring->size - start ? len : ring->size - start;
+    memcpy(out, &ring->buffer[start], first);
+    memcpy(out + first, ring->buffer, len - first);
+}
+
+bool dynamixel_capture_ring_init(DynamixelIOCaptureRing *ring, uint8_t *buffer, uint32_t size)
+{
+    if (buffer == NULL || size == 0 || (size & (size - 1)) != 0)
+        return false;
+    ring->buffer = buffer;
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->n_dropped = 0;
+    ring->reserved = 0;
+    return true;
+}
+
+bool dynamixel_capture_ring_begin(DynamixelIOCaptureRing *ring,
+        const uint8_t *tx_data, uint16_t tx_length, uint16_t max_rx_length)
+{
+    uint32_t len = sizeof(DynamixelIOCaptureRecord) + tx_length + max_rx_length;
+    // head is written only by the producer
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (ring->size - (head - tail) < len) {
+        __atomic_store_n(&ring->n_dropped, ring->n_dropped + 1, __ATOMIC_RELAXED);
+        ring->reserved = 0;
+        return false;
+    }
+    // the consumer only frees more space until the record is published
+    ring->reserved = len;
+    copy_in(ring, head + sizeof(DynamixelIOCaptureRecord), tx_data, tx_length);
+    return true;
+}
+
+void dynamixel_capture_ring_end(DynamixelIOCaptureRing *ring,
+        const DynamixelIOCaptureRecord *record, const uint8_t *rx_data)
+{
+    uint32_t len = sizeof(*record) + record->tx_length + record->rx_length;
+    if (ring->reserved == 0 || len > ring->reserved)
+        return;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    copy_in(ring, head + sizeof(*record) + record->tx_length, rx_data, record->rx_length);
+    copy_in(ring, head, record, sizeof(*record));
+    ring->reserved = 0;
+    // the consumer sees the record only after it is complete
+    __atomic_store_n(&ring->head, head + len, __ATOMIC_RELEASE);
+}
+
+bool dynamixel_capture_ring_write(DynamixelIOCaptureRing *ring,
+        const DynamixelIOCaptureRecord *record, const uint8_t *tx_data, const uint8_t *rx_data)
+{
+    if (!dynamixel_capture_ring_begin(ring, tx_data, record->tx_length, record->rx_length))
+        return false;
+    dynamixel_capture_ring_end(ring, record, rx_data);
+    return true;
+}
+
+size_t dynamixel_capture_ring_read(DynamixelIOCaptureRing *ring, uint8_t *out, size_t max)
+{
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t len = head - tail;
+    if (len > max)
+        len = (uint32_t) max;
+    copy_out(ring, tail, out, len);
+    // the space may be reused only after the data is copied
+    __atomic_store_n(&ring->tail, tail + len, __ATOMIC_RELEASE);
+    return len;
+}
+
+void dynamixel_capture_header_init(DynamixelIOCaptureHeader *header, uint8_t protocol)
+{
+    memcpy(header->magic, DYNAMIXEL_CAPTURE_MAGIC, sizeof(header->magic));
+    header->version = DYNAMIXEL_CAPTURE_VERSION;
+    header->protocol = protocol;
+    header->reserved[0] = header->reserved[1] = 0;
+}
+
+size_t dynamixel_capture_header_check(const uint8_t *log, size_t log_size, uint8_t *protocol)
+{
+    DynamixelIOCaptureHeader header;
+    if (log_size < sizeof(header))
+        return 0;
+    memcpy(&header, log, sizeof(header));
+    if (memcmp(header.magic, DYNAMIXEL_CAPTURE_MAGIC, sizeof(header.magic)) != 0
+            || header.version != DYNAMIXEL_CAPTURE_VERSION)
+        return 0;
+    if (protocol != NULL)
+        *protocol = header.protocol;
+    return sizeof(header);
+}
+
+bool dynamixel_capture_next(const uint8_t *log, size_t log_size, size_t *offset,
+        DynamixelIOCaptureRecord *record, const uint8_t **tx_data, const uint8_t **rx_data)
+{
+    if (*offset + sizeof(*record) > log_size)
+        return false;
+    memcpy(record, &log[*offset], sizeof(*record));
+    size_t len = sizeof(*record) + record->tx_length + record->rx_length;
+    if (*offset + len > log_size)
+        return false;
+    *tx_data = &log[*offset + sizeof(*record)];
+    *rx_data = *tx_data + record->tx_length;
+    *offset += len;
+    return true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary capture of the bus traffic of the IO task (see dynamixel_io_task_set_capture()
+ * in io_task.h), to be analysed after a failure in the field or replayed
+ * (posix/replay_uart.h) through the IO task.
+ *
+ * Each transaction is captured as one record: a header (DynamixelIOCaptureRecord) with
+ * the status of the transaction, followed by tx_length bytes of the sent packet and
+ * rx_length bytes received before the transaction has ended (also of a failed one, e.g.
+ * a part of the response before a timeout), so a response cannot be separated from its packet.
+ *
+ * The IO task appends records to a lock-free ring (one producer, one consumer), which
+ * never blocks it: a transaction that does not fit is dropped whole (and counted), space
+ * for it is reserved when it starts (dynamixel_capture_ring_begin()) and it is published
+ * when it ends. The consumer (e.g. posix/capture_file.h, or a low priority task) copies
+ * the bytes out to a file; the ring itself may also be placed in a memory-mapped region
+ * (or RAM kept over reset). A log is a DynamixelIOCaptureHeader followed by the records,
+ * in the byte order of the MCU.
+ *
+ * This header does not depend on FreeRTOS, so that logs can be processed on a host
+ * (tools/dynamixel-capture prints them as text).
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DYNAMIXEL_CAPTURE_MAGIC     "DXCP"
+#define DYNAMIXEL_CAPTURE_VERSION   2
+
+// 16 bytes without padding
+typedef struct {
+    uint32_t time_us;         // start of the transaction, wraps around
+    uint32_t duration_us;     // until its end
+    uint16_t tx_length;       // bytes of the sent packet following the header
+    uint16_t rx_length;       // received bytes following the sent ones
+    uint16_t response_size;   // expected size of all status packets
+    uint8_t n_responses;      // number of status packets expected
+    uint8_t status;           // DynamixelIOStatus of the transaction
+} DynamixelIOCaptureRecord;
+
+// 8 bytes at the start of a log
+typedef struct {
+    char magic[4];            // DYNAMIXEL_CAPTURE_MAGIC
+    uint8_t version;          // DYNAMIXEL_CAPTURE_VERSION
+    uint8_t protocol;         // DynamixelIOProtocol of the task
+    uint8_t reserved[2];
+} DynamixelIOCaptureHeader;
+
+typedef struct {
+    uint8_t *buffer;
+    uint32_t size;            // power of 2
+    uint32_t head;            // bytes written (by the producer), wraps around
+    uint32_t tail;            // bytes read (by the consumer), wraps around
+    uint32_t n_dropped;       // records that have not fit
+    uint32_t reserved;        // bytes reserved by dynamixel_capture_ring_begin(), 0 if none
+} DynamixelIOCaptureRing;
+
+// size must be a power of 2
+bool dynamixel_capture_ring_init(DynamixelIOCaptureRing *ring, uint8_t *buffer, uint32_t size);
+// reserves space for a record with tx_length + max_rx_length bytes of data and copies
+// the sent bytes into it (not seen by the consumer yet), false if it does not fit
+bool dynamixel_capture_ring_begin(DynamixelIOCaptureRing *ring,
+        const uint8_t *tx_data, uint16_t tx_length, uint16_t max_rx_length);
+// completes the record of the last successful dynamixel_capture_ring_begin() (with
+// the same tx_length and at most max_rx_length of rx_data) and publishes it whole
+void dynamixel_capture_ring_end(DynamixelIOCaptureRing *ring,
+        const DynamixelIOCaptureRecord *record, const uint8_t *rx_data);
+// appends the whole record (with its sent and received bytes) or nothing if it does not fit
+bool dynamixel_capture_ring_write(DynamixelIOCaptureRing *ring,
+        const DynamixelIOCaptureRecord *record, const uint8_t *tx_data, const uint8_t *rx_data);
+// copies out at most max bytes written so far (records are published whole),
+// returns the number of bytes
+size_t dynamixel_capture_ring_read(DynamixelIOCaptureRing *ring, uint8_t *out, size_t max);
+
+void dynamixel_capture_header_init(DynamixelIOCaptureHeader *header, uint8_t protocol);
+// size of the header if the log starts with a valid one, otherwise 0
+size_t dynamixel_capture_header_check(const uint8_t *log, size_t log_size, uint8_t *protocol);
+// the record at *offset (moved after it) with pointers to its sent and received bytes
+// in the log, false at the end of the log (or if the last record is truncated)
+bool dynamixel_capture_next(const uint8_t *log, size_t log_size, size_t *offset,
+        DynamixelIOCaptureRecord *record, const uint8_t **tx_data, const uint8_t **rx_data);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,146 @@
+#pragma once
+
+/*
+ * C++20 coroutines waiting for transactions of IO tasks (io_task.h), so that one thread
+ * (e.g. a control loop on a host) can drive many buses at once, each with its own coroutine,
+ * without a thread per bus or blocking on dynamixel_io_wait_response():
+ *
+ *   IOCoroutine read_positions(IOScheduler &scheduler, DynamixelIOTaskHandle *bus) {
+ *       ...
+ *       DynamixelIOResponse response = co_await scheduler.transfer(bus, &packet, response_size);
+ *       ...
+ *   }
+ *
+ *   read_positions(scheduler, &bus_1);   // run up to the first co_await
+ *   read_positions(scheduler, &bus_2);
+ *   scheduler.run();                     // resumes them until all have finished
+ *
+ * The response is passed by a completion callback of the IO task to the scheduler,
+ * the coroutine is resumed in the thread calling run(). Like a response from a queue,
+ * the awaited one owns its buffer of the rx pool (if the IO task has one), the coroutine
+ * gives it back with dynamixel_io_release_response(). The awaited request must stay
+ * valid until the coroutine is resumed, its packet receives the response unless it is
+ * received into the pool (see dynamixel_io_task_set_rx_pool()). Coroutines must
+ * not wait for anything else than transactions of the scheduler (it ends when none is waiting).
+ */
+
+#if !defined(__cpp_impl_coroutine)
+#   error "io_coroutine.h requires C++20 coroutines"
+#endif
+
+#include <coroutine>
+#include <exception>
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "io_task.h"
+
+namespace Dynamixel {
+
+// coroutine started right away and running until it ends (its frame is destroyed then),
+// suspended only while waiting for transactions
+struct IOCoroutine {
+    struct promise_type {
+        IOCoroutine get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+class IOScheduler {
+public:
+    // awaitable transaction, co_await gives its DynamixelIOResponse
+    // (with status dio_UNDEFINED if the request cannot be sent)
+    class Transaction {
+    public:
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            coroutine = handle;
+            dynamixel_io_completion_create_callback(&completion, &IOScheduler::complete, this);
+            request.completion = &completion;
+            request.ignore_response = false;
+            // the IO task must not block on the queue of ready ones
+            configASSERT(scheduler->n_waiting < scheduler->max_waiting);
+            if (!dynamixel_io_submit(task_handle, &request))
+                return false;  // resumed right away
+            scheduler->n_waiting++;
+            return true;
+        }
+        DynamixelIOResponse await_resume() const noexcept { return response; }
+
+    private:
+        friend class IOScheduler;
+        Transaction(IOScheduler *scheduler, DynamixelIOTaskHandle *task_handle,
+                const DynamixelIORequest &request):
+            scheduler(scheduler), task_handle(task_handle), request(request), response() {
+            response.status = dio_UNDEFINED;
+        }
+
+        IOScheduler *scheduler;
+        DynamixelIOTaskHandle *task_handle;
+        DynamixelIORequest request;
+        DynamixelIOCompletion completion;
+        DynamixelIOResponse response;
+        std::coroutine_handle<> coroutine;
+    };
+
+    // max_waiting is the number of transactions awaited at once (more is an error)
+    explicit IOScheduler(UBaseType_t max_waiting): max_waiting(max_waiting), n_waiting(0) {
+        ready = xQueueCreate(max_waiting, sizeof(Transaction *));
+        configASSERT(ready != nullptr);
+    }
+    ~IOScheduler() {
+        configASSERT(n_waiting == 0);
+        vQueueDelete(ready);
+    }
+    IOScheduler(const IOScheduler &) = delete;
+    IOScheduler &operator=(const IOScheduler &) = delete;
+
+    // like dynamixel_io_send_request()
+    Transaction transfer(DynamixelIOTaskHandle *task_handle, DynamixelPacket *packet,
+            int response_size, DynamixelIOPriority priority = dio_PRIORITY_NORMAL) {
+        DynamixelIORequest request = {};
+        request.packet = packet;
+        request.response_size = response_size;
+        request.n_responses = 1;
+        request.priority = priority;
+        return Transaction(this, task_handle, request);
+    }
+    // like dynamixel_io_submit() (the completion is set by the scheduler)
+    Transaction submit(DynamixelIOTaskHandle *task_handle, const DynamixelIORequest &request) {
+        return Transaction(this, task_handle, request);
+    }
+
+    // resumes coroutines as their transactions complete, until none is waiting
+    void run() {
+        while (n_waiting > 0) {
+            Transaction *transaction;
+            BaseType_t result = xQueueReceive(ready, &transaction, portMAX_DELAY);
+            configASSERT(result == pdTRUE);
+            n_waiting--;
+            transaction->coroutine.resume();
+        }
+    }
+
+    int waiting() const {
+        return n_waiting;
+    }
+
+private:
+    // called by the IO task, the buffer of the response is passed on to the coroutine
+    static void complete(DynamixelIOResponse *response, void *context) {
+        Transaction *transaction = static_cast<Transaction *>(context);
+        transaction->response = *response;
+        // there is space for each waiting one, the callback must not block
+        BaseType_t result = xQueueSendToBack(transaction->scheduler->ready, &transaction, 0);
+        configASSERT(result == pdTRUE);
+    }
+
+    QueueHandle_t ready;      // transactions with responses, to be resumed
+    const int max_waiting;    // length of the queue of ready ones
+    int n_waiting;            // suspended coroutines (touched only by the thread of run())
+};
+
+} // namespace Dynamixel
@@ -3,11 +3,79 @@
 #include <string.h>
 
 
+static uint32_t max_wait_us(DynamixelIOTaskHandle *task,
+        uint32_t n_bytes, uint32_t n_read_delays);
 static uint32_t max_wait_ticks(DynamixelIOTaskHandle *task,
-        uint32_t n_bytes, bool is_reading);
+        uint32_t n_bytes, uint32_t n_read_delays);
+static void start_timer(DynamixelIOTaskHandle *handle, uint32_t timeout_us);
+static bool stop_timer(DynamixelIOTaskHandle *handle);
+static bool stop_timer_woken(DynamixelIOTaskHandle *handle);
+static DynamixelIOLatencyEstimate *latency_estimate(DynamixelIOTaskHandle *handle,
+        DynamixelIORequest *request);
+static uint32_t reception_timeout_us(DynamixelIOTaskHandle *handle,
+        DynamixelIORequest *request, DynamixelIOLatencyEstimate *estimate);
+static void update_latency(DynamixelIOTaskHandle *handle,
+        DynamixelIOLatencyEstimate *estimate, DynamixelIOStatus status);
+static int uart_write(void *context, uint8_t *data, size_t data_len);
+static int uart_read(void *context, uint8_t *data, size_t data_len);
+static int uart_reset(void *context);
+static DynamixelIOStatus transfer(DynamixelIOTaskHandle *task_handle,
+        DynamixelIORequest *request, DynamixelIOResponse *response, TickType_t buffer_wait);
+static DynamixelIOStatus exchange(DynamixelIOTaskHandle *task_handle,
+        DynamixelIORequest *request, DynamixelIOResponse *response);
+static DynamixelIOStatus transfer_batch(DynamixelIOTaskHandle *task_handle,
+        DynamixelIORequest *request);
 static void maybe_send_response(DynamixelIOStatus status,
         DynamixelIORequest *request, DynamixelIOResponse *response,
         DynamixelIOTaskHandle *handle);
+static void receive_request(DynamixelIOTaskHandle *handle, DynamixelIORequest *request);
+static bool has_expired(DynamixelIOTaskHandle *handle, DynamixelIORequest *request);
+static void take_coalesced(DynamixelIOTaskHandle *handle, DynamixelIORequest *request);
+static bool submit_coalesced(DynamixelIOTaskHandle *handle,
+        const DynamixelIOCoalescedWrite *write, DynamixelIOPriority priority);
+static bool merge_sync_write(DynamixelIOCoalescedWrite *pending,
+        const DynamixelIOCoalescedWrite *write);
+static uint32_t now_us(DynamixelIOTaskHandle *handle);
+static uint32_t now_us_from_isr(DynamixelIOTaskHandle *handle);
+static void metrics_begin(DynamixelIOTaskHandle *handle);
+static void metrics_end(DynamixelIOTaskHandle *handle);
+static void metrics_add(uint32_t *counter, uint32_t value);
+static uint8_t *take_rx_buffer(DynamixelIOTaskHandle *handle, DynamixelIORequest *request,
+        TickType_t wait);
+static void give_rx_buffer(DynamixelIORxPool *pool, uint8_t *buffer);
+static void trace(DynamixelIOTaskHandle *handle, DynamixelIOTraceEventType type, uint8_t detail);
+static void trace_from_isr(DynamixelIOTaskHandle *handle,
+        DynamixelIOTraceEventType type, uint8_t detail);
+static void trace_enqueued(DynamixelIOTaskHandle *handle, DynamixelIORequest *request);
+static void trace_dequeued(DynamixelIOTaskHandle *handle, DynamixelIORequest *request);
+static void trace_record(DynamixelIOTaskHandle *handle, uint32_t time_us,
+        DynamixelIOTraceEventType type, uint32_t request, uint8_t detail);
+static void capture_transaction(DynamixelIOTaskHandle *handle, DynamixelIOCaptureRing *ring,
+        DynamixelIORequest *request, int tx_size, DynamixelIOStatus status,
+        uint32_t start_us, uint32_t duration_us);
+// functions that depend on protocol used by the task
+static uint8_t *request_data(DynamixelIOTaskHandle *handle, DynamixelIORequest *request);
+static uint8_t *response_data(DynamixelIOTaskHandle *handle, DynamixelIORequest *request);
+static int request_size(DynamixelIOTaskHandle *handle, DynamixelIORequest *request);
+static uint8_t packet_id(DynamixelIOTaskHandle *handle, DynamixelPacket *packet);
+static DynamixelIOTransactionKind request_kind(DynamixelIOTaskHandle *handle,
+        DynamixelPacket *packet);
+static void start_response_parser(DynamixelIOTaskHandle *handle, DynamixelIORequest *request);
+static void stop_response_parser(DynamixelIOTaskHandle *handle);
+static bool chain_reception(DynamixelIOTaskHandle *handle);
+static DynamixelIOStatus reception_status(DynamixelIOTaskHandle *handle,
+        DynamixelIORequest *request, DynamixelIOResponse *response,
+        uint32_t notification_value, bool timer_expired);
+static void init_response_parser(DynamixelIOTaskHandle *handle);
+static DynamixelParserResult feed_response_parser(DynamixelIOTaskHandle *handle,
+        const uint8_t *data, int data_len, int *n_consumed);
+static int parsed_packet_size(DynamixelIOTaskHandle *handle);
+static int received_size(DynamixelIOTaskHandle *handle, DynamixelIORequest *request,
+        DynamixelIOStatus status);
+static DynamixelIOStatus check_status_packet(DynamixelIOTaskHandle *handle,
+        uint8_t *data, int data_len, bool is_parsed, int *size);
+static DynamixelIOStatus check_response(DynamixelIOTaskHandle *handle,
+        DynamixelIORequest *request, DynamixelIOResponse *response);
 
 void dynamixel_io_task(void *arguments)
 {
@@ -15,121 +83,264 @@ void dynamixel_io_task(void *arguments)
         (DynamixelIOTaskHandle *) arguments;
     DynamixelIORequest request;
     DynamixelIOResponse response;
-    uint32_t notification_value;
-    int uart_result;
 
     while (1)
     {
-        task_handle->transmission_state = dio_NOT_COMPLETED;
         // reinitialize response
         response.data = NULL;
         response.data_len = 0;
         response.status = dio_UNDEFINED;
+        response.packet = NULL;
+        response.items = NULL;
+        response.n_items = 0;
+        response.status_packet = NULL;
+        response.buffer = NULL;
 
         // wait forever for command to be transmitted
-        BaseType_t queue_result = xQueueReceive(task_handle->request_queue,
-                &request, portMAX_DELAY);
-        configASSERT(queue_result == pdTRUE);
-        configASSERT(request.packet != NULL);
-        configASSERT(request.response_size >= 0);
-
-        // start transmission
-        uart_result = task_handle->uart_write_handle(
-                dynamixel_packet_data(request.packet),
-                dynamixel_packet_size(request.packet));
-
-        if (uart_result != 0) {
-            // recover from uart error
-            task_handle->uart_reset_handle();
-            maybe_send_response(dio_UART_WRITE_ERROR, &request, &response, task_handle);
+        receive_request(task_handle, &request);
+        if (request.coalesced != NULL)
+            take_coalesced(task_handle, &request);
+        trace_dequeued(task_handle, &request);
+
+        if (has_expired(task_handle, &request)) {
+            // not sent at all, so that it does not delay the others
+            trace(task_handle, dio_TRACE_DONE, dio_DEADLINE_EXPIRED);
+            for (int i = 0; request.items != NULL && i < request.n_items; i++) {
+                request.items[i].response.status = dio_DEADLINE_EXPIRED;
+                request.items[i].response.buffer = NULL;
+            }
+            maybe_send_response(dio_DEADLINE_EXPIRED, &request, &response, task_handle);
+            continue;
+        }
+        if (request.items != NULL) {
+            // the whole batch back to back, with one response
+            maybe_send_response(transfer_batch(task_handle, &request),
+                    &request, &response, task_handle);
             continue; // back to waiting
         }
+        DynamixelIOStatus status = transfer(task_handle, &request, &response, portMAX_DELAY);
+        maybe_send_response(status, &request, &response, task_handle);
+    }
 
-        // wait for transmission end
-        // do not care for how many notifications were received (should be one)
-        notification_value = ulTaskNotifyTake(pdTRUE,
-                max_wait_ticks(task_handle, dynamixel_packet_size(request.packet), false));
+    // the task should probably never end anyway
+#if ( INCLUDE_vTaskDelete == 1 )
+    vTaskDelete(NULL);
+#else
+    configASSERT(0);
+#endif
+}
 
-        if (notification_value == 0) {
-            // recover from timeout
-            task_handle->uart_reset_handle();
-            maybe_send_response(dio_UART_WRITE_TIMEOUT, &request, &response, task_handle);
-            continue; // back to waiting
-        }
+// one transaction, counted in the metrics of the task
+static DynamixelIOStatus transfer(DynamixelIOTaskHandle *task_handle,
+        DynamixelIORequest *request, DynamixelIOResponse *response, TickType_t buffer_wait)
+{
+    // the packet may be overwritten by the response
+    DynamixelIOTransactionKind kind = request_kind(task_handle, request->packet);
+    int tx_size = request_size(task_handle, request);
+    // with the rx pool the response goes to a buffer, the packet is left intact
+    uint8_t *rx_buffer = take_rx_buffer(task_handle, request, buffer_wait);
+    task_handle->rx_buffer = rx_buffer;
+    // the packet is copied to the capture ring before it may be overwritten,
+    // the record of the transaction is published when it ends
+    DynamixelIOCaptureRing *capture = __atomic_load_n(&task_handle->capture, __ATOMIC_ACQUIRE);
+    if (capture != NULL && !dynamixel_capture_ring_begin(capture, request_data(task_handle, request),
+                (uint16_t) tx_size, (uint16_t) request->response_size))
+        capture = NULL;
+    uint32_t start_us = now_us(task_handle);
+    DynamixelIOStatus status = exchange(task_handle, request, response);
+    uint32_t wire_us = now_us(task_handle) - start_us;
+    if (capture != NULL)
+        capture_transaction(task_handle, capture, request, tx_size, status, start_us, wire_us);
+    task_handle->rx_buffer = NULL;
+    if (rx_buffer != NULL) {
+        // owned by the caller only with valid data (also of a partial response)
+        if ((status == dio_OK || response->data_len > 0) && !request->ignore_response)
+            response->buffer = rx_buffer;
+        else
+            give_rx_buffer(task_handle->rx_pool, rx_buffer);
+    }
 
-        if (task_handle->transmission_state != dio_WRITE_COMPLETED) {
-            // recover from timeout
-            task_handle->uart_reset_handle();
-            maybe_send_response(dio_WRONG_NOTIFICATION, &request, &response, task_handle);
-            continue; // back to waiting
-        }
+    DynamixelIOMetrics *metrics = &task_handle->metrics;
+    metrics_begin(task_handle);
+    metrics_add(&metrics->n_transactions, 1);
+    metrics_add(&metrics->tx_bytes, status != dio_UART_WRITE_ERROR ? tx_size : 0);
+    metrics_add(&metrics->rx_bytes, status == dio_OK ? request->response_size : 0);
+    metrics_add(&metrics->n_status[status], 1);
+    metrics_add(&metrics->busy_us, wire_us);
+    metrics_add(&metrics->wire_time[kind].counts[dynamixel_io_histogram_bucket(wire_us)], 1);
+    metrics_end(task_handle);
+    trace(task_handle, dio_TRACE_DONE, status);
+    return status;
+}
 
-        if (request.response_size == 0) {
-            // nothing to be received
-            maybe_send_response(dio_OK, &request, &response, task_handle);
-            continue; // back to waiting
-        }
+// sends the request and receives the response (if any),
+// response is filled only for dio_OK, UART is reset on error
+static DynamixelIOStatus exchange(DynamixelIOTaskHandle *task_handle,
+        DynamixelIORequest *request, DynamixelIOResponse *response)
+{
+    uint32_t notification_value;
+    int uart_result;
 
-        // clear packet contents (just in case)
-        // dynamixel_packet_init(request.packet, 0, 0);
-        // set known values to easier check if anything was read
-        uint8_t markers[] = {0xba, 0xad, 0xf0, 0x0d, 0xba, 0xad, 0xf0, 0x0d}; // baad food
-        size_t markers_len = sizeof(markers) / sizeof(*markers);
-        memcpy(request.packet, markers,
-                sizeof(DynamixelPacket) < markers_len ? sizeof(DynamixelPacket) : markers_len );
-
-        // receive response
-        uart_result = task_handle->uart_read_handle(
-                dynamixel_packet_data(request.packet),
-                request.response_size);
-
-        if (uart_result != 0) {
-            // recover from uart error
-            task_handle->uart_reset_handle();
-            maybe_send_response(dio_UART_READ_ERROR, &request, &response, task_handle);
-            continue; // back to waiting
-        }
+    task_handle->transmission_state = dio_NOT_COMPLETED;
+    task_handle->rx_data_seen = false;
+    configASSERT(request->packet != NULL);
+    configASSERT(request->response_size >= 0);
+    configASSERT(request->n_responses >= 1);
+    configASSERT(request->tx_size >= 0);
+    // the packet may be overwritten by the response while it is being sent
+    int tx_size = request_size(task_handle, request);
+    DynamixelIOLatencyEstimate *estimate = latency_estimate(task_handle, request);
+    task_handle->rx_timeout_us = reception_timeout_us(task_handle, request, estimate);
+    // without the timer the task waits (in ticks) for the whole response
+    task_handle->rx_armed_timeout_us = task_handle->timer.start != NULL ? task_handle->rx_timeout_us
+        : max_wait_us(task_handle, request->response_size, request->n_responses);
 
-        // wait for transmission to end
-        notification_value = ulTaskNotifyTake(pdTRUE,
-                max_wait_ticks(task_handle, request.response_size, true));
+    // reception may be started right from the write completion (see chain_reception())
+    bool chained = task_handle->chain_reception && request->response_size > 0;
+    if (chained) {
+        // the packet is still being sent, so it cannot be marked (see below)
+        start_timer(task_handle, max_wait_us(task_handle,
+                    tx_size + request->response_size, request->n_responses));
+        start_response_parser(task_handle, request);
+        task_handle->rx_chain_started = false;
+        task_handle->rx_chain_pending = true;
+    } else {
+        start_timer(task_handle, max_wait_us(task_handle, tx_size, 0));
+    }
 
-        if (notification_value == 0) {
-            // recover from timeout
-            task_handle->uart_reset_handle();
-            maybe_send_response(dio_UART_READ_TIMEOUT, &request, &response, task_handle);
-            continue; // back to waiting
-        }
+    // start transmission
+    trace(task_handle, dio_TRACE_TX_STARTED, packet_id(task_handle, request->packet));
+    uart_result = task_handle->uart.write(task_handle->uart.context,
+            request_data(task_handle, request), tx_size);
 
-        if (task_handle->transmission_state != dio_READ_COMPLETED) {
-            // recover from timeout
-            task_handle->uart_reset_handle();
-            maybe_send_response(dio_WRONG_NOTIFICATION, &request, &response, task_handle);
-            continue; // back to waiting
-        }
+    if (uart_result != 0) {
+        // recover from uart error
+        task_handle->rx_chain_pending = false;
+        stop_timer(task_handle);
+        task_handle->uart.reset(task_handle->uart.context);
+        return dio_UART_WRITE_ERROR;
+    }
 
-        if (!dynamixel_packet_checksum_isok(request.packet)) {
-            // recover from wrong checksum
-            maybe_send_response(dio_WRONG_CHECKSUM, &request, &response, task_handle);
-            continue; // back to waiting
+    if (chained) {
+        // woken only once, with the response (or error) of the whole transaction
+        notification_value = ulTaskNotifyTake(pdTRUE, max_wait_ticks(task_handle,
+                    tx_size + request->response_size, request->n_responses));
+        task_handle->rx_chain_pending = false;
+        stop_response_parser(task_handle);
+        bool timer_expired = stop_timer_woken(task_handle);
+
+        DynamixelIOStatus status;
+        if (task_handle->rx_chain_started) {
+            status = reception_status(task_handle, request, response,
+                    notification_value, timer_expired);
+            update_latency(task_handle, estimate, status);
+        } else {
+            if (notification_value == 0 || timer_expired)
+                status = dio_UART_WRITE_TIMEOUT;
+            else if (task_handle->transmission_state == dio_WRITE_COMPLETED)
+                status = dio_UART_READ_ERROR; // reception could not be started
+            else
+                status = dio_WRONG_NOTIFICATION;
+            task_handle->uart.reset(task_handle->uart.context);
         }
+        return status;
+    }
 
-        // communication successful
-        response.data = request.packet->parameters_with_checksum;
-        response.data_len = dynamixel_packet_n_parameters(request.packet);
-        // this should be always true (from definition)
-        configASSERT(request.response_size ==
-                response.data_len + DYNAMIXEL_PACKET_BASE_SIZE + 1);
-        maybe_send_response(dio_OK, &request, &response, task_handle);
+    // wait for transmission end
+    // do not care for how many notifications were received (should be one)
+    notification_value = ulTaskNotifyTake(pdTRUE,
+            max_wait_ticks(task_handle, tx_size, 0));
+    bool timer_expired = stop_timer_woken(task_handle);
 
+    if (notification_value == 0 || (timer_expired
+                && task_handle->transmission_state != dio_WRITE_COMPLETED)) {
+        // recover from timeout
+        task_handle->uart.reset(task_handle->uart.context);
+        return dio_UART_WRITE_TIMEOUT;
     }
 
-    // the task should probably never end anyway
-#if ( INCLUDE_vTaskDelete == 1 )
-    vTaskDelete(NULL);
-#else
-    configASSERT(0);
-#endif
+    if (task_handle->transmission_state != dio_WRITE_COMPLETED) {
+        // recover from timeout
+        task_handle->uart.reset(task_handle->uart.context);
+        return dio_WRONG_NOTIFICATION;
+    }
+
+    if (request->response_size == 0) {
+        // nothing to be received
+        return dio_OK;
+    }
+
+    // clear packet contents (just in case)
+    // dynamixel_packet_init(request->packet, 0, 0);
+    // set known values to easier check if anything was read
+    uint8_t markers[] = {0xba, 0xad, 0xf0, 0x0d, 0xba, 0xad, 0xf0, 0x0d}; // baad food
+    size_t markers_len = sizeof(markers) / sizeof(*markers);
+    memcpy(response_data(task_handle, request), markers,
+            (size_t) request->response_size < markers_len ? (size_t) request->response_size : markers_len );
+
+    // prepare parser in case the driver passes data in chunks
+    start_timer(task_handle, task_handle->rx_timeout_us);
+    start_response_parser(task_handle, request);
+    task_handle->rx_parser_armed = true;
+
+    // receive response
+    trace(task_handle, dio_TRACE_RX_STARTED, 0);
+    uart_result = task_handle->uart.read(task_handle->uart.context,
+            response_data(task_handle, request),
+            request->response_size);
+
+    if (uart_result != 0) {
+        // recover from uart error
+        stop_response_parser(task_handle);
+        stop_timer(task_handle);
+        task_handle->uart.reset(task_handle->uart.context);
+        return dio_UART_READ_ERROR;
+    }
+
+    // wait for transmission to end (each servo waits its return delay time)
+    notification_value = ulTaskNotifyTake(pdTRUE,
+            max_wait_ticks(task_handle, request->response_size, request->n_responses));
+    stop_response_parser(task_handle);
+    timer_expired = stop_timer_woken(task_handle);
+
+    DynamixelIOStatus status = reception_status(task_handle, request, response,
+            notification_value, timer_expired);
+    update_latency(task_handle, estimate, status);
+    return status;
+}
+
+// runs each item of a batch request as a separate transaction (also after errors),
+// returns status of the first failed one
+static DynamixelIOStatus transfer_batch(DynamixelIOTaskHandle *task_handle,
+        DynamixelIORequest *request)
+{
+    configASSERT(request->n_items > 0);
+    DynamixelIOStatus batch_status = dio_OK;
+    for (int i = 0; i < request->n_items; i++) {
+        DynamixelIOBatchItem *item = &request->items[i];
+        DynamixelIORequest item_request = {
+            .packet = item->packet,
+            .tx_size = 0,
+            .response_size = item->response_size,
+            .n_responses = 1,
+            .ignore_response = false,
+            .completion = NULL
+        };
+        DynamixelIOResponse *result = &item->response;
+        result->data = NULL;
+        result->data_len = 0;
+        result->packet = item->packet;
+        result->items = NULL;
+        result->n_items = 0;
+        result->status_packet = NULL;
+        result->buffer = NULL;
+        // buffers are given back only after the whole batch, so its items do not wait for
+        // them (the task would wait forever with fewer free buffers than items)
+        result->status = transfer(task_handle, &item_request, result, 0);
+        if (result->status != dio_OK && batch_status == dio_OK)
+            batch_status = result->status;
+    }
+    return batch_status;
 }
 
 /*********************************************************************************/
@@ -144,24 +355,82 @@ void dynamixel_io_task_create(DynamixelIOTaskHandle *handle,
         uint32_t max_wait_per_byte_us,
         uint32_t max_wait_read_delay_us)
 {
-    // TODO: this may be possible to implement a way to use longer queues,
-    //       but now longer queue may cause a task to recive a response
-    //       for requests made by other task
-    configASSERT(queues_length == 1);
-    // check if parameter values are ok
-    configASSERT(handle != NULL);
-    configASSERT(task_name != NULL);
     configASSERT(uart_write_handle != NULL);
     configASSERT(uart_read_handle != NULL);
     configASSERT(uart_reset_handle != NULL);
-    // initialise user configuration fields
     handle->uart_write_handle = uart_write_handle;
     handle->uart_read_handle = uart_read_handle;
     handle->uart_reset_handle = uart_reset_handle;
+    DynamixelIOUARTDriver uart_driver = {
+        .write = uart_write,
+        .read = uart_read,
+        .reset = uart_reset,
+        .context = handle,
+    };
+    dynamixel_io_task_create_with_driver(handle, task_name, task_priority, queues_length,
+            uart_driver, max_wait_per_byte_us, max_wait_read_delay_us);
+}
+
+void dynamixel_io_task_create_with_driver(DynamixelIOTaskHandle *handle,
+        const char * const task_name,
+        UBaseType_t task_priority,
+        UBaseType_t queues_length,
+        DynamixelIOUARTDriver uart_driver,
+        uint32_t max_wait_per_byte_us,
+        uint32_t max_wait_read_delay_us)
+{
+    // check if parameter values are ok
+    configASSERT(queues_length >= 1);
+    configASSERT(handle != NULL);
+    configASSERT(task_name != NULL);
+    configASSERT(uart_driver.write != NULL);
+    configASSERT(uart_driver.read != NULL);
+    configASSERT(uart_driver.reset != NULL);
+    // initialise user configuration fields
+    handle->uart = uart_driver;
     handle->max_wait_per_byte_us = max_wait_per_byte_us;
     handle->max_wait_read_delay_us = max_wait_read_delay_us;
     handle->transmission_state = dio_NOT_COMPLETED;
-    // allocate rtos structures
+    handle->protocol = dio_PROTOCOL_1;
+    handle->rx_parser_result = dpr_IN_PROGRESS;
+    handle->rx_parser_armed = false;
+    handle->rx_n_pending = 0;
+    handle->timer.start = NULL;
+    handle->timer.stop = NULL;
+    handle->first_byte_timeout_us = 0;
+    handle->inter_byte_timeout_us = 0;
+    handle->timer.now = NULL;
+    handle->timeout_expired = false;
+    handle->timeout_expired_us = 0;
+    handle->rx_timeout_us = 0;
+    handle->latency = NULL;
+    handle->n_latency_ids = 0;
+    handle->rx_data_seen = false;
+    handle->chain_reception = false;
+    handle->rx_chain_pending = false;
+    handle->rx_chain_started = false;
+    memset(handle->queue_stats, 0, sizeof(handle->queue_stats));
+    memset(&handle->metrics, 0, sizeof(handle->metrics));
+    handle->metrics_sequence = 0;
+    handle->rx_pool = NULL;
+    handle->rx_buffer = NULL;
+    handle->trace = NULL;
+    handle->capture = NULL;
+    handle->trace_size = 0;
+    handle->trace_n_recorded = 0;
+    handle->trace_next_request = 0;
+    handle->trace_request = 0;
+    handle->coalesced = NULL;
+    handle->n_coalesced_slots = 0;
+    // allocate rtos structures, queues first as the task may start running immediately
+    for (int i = 0; i < dio_N_PRIORITIES; i++) {
+        handle->request_queues[i] = xQueueCreate(queues_length, sizeof(DynamixelIORequest));
+        configASSERT(handle->request_queues[i] != NULL);
+    }
+    handle->n_requests = xSemaphoreCreateCounting(dio_N_PRIORITIES * queues_length, 0);
+    handle->response_queue = xQueueCreate(queues_length, sizeof(DynamixelIOResponse));
+    configASSERT(handle->n_requests != NULL);
+    configASSERT(handle->response_queue != NULL);
     BaseType_t result = xTaskCreate(dynamixel_io_task,
             task_name,
             configMINIMAL_STACK_SIZE, // TODO: how much?
@@ -169,10 +438,6 @@ void dynamixel_io_task_create(DynamixelIOTaskHandle *handle,
             task_priority,
             &handle->task_handle);
     configASSERT(result == pdPASS);
-    handle->request_queue = xQueueCreate(queues_length, sizeof(DynamixelIORequest));
-    handle->response_queue = xQueueCreate(queues_length, sizeof(DynamixelIOResponse));
-    configASSERT(handle->request_queue != NULL);
-    configASSERT(handle->response_queue != NULL);
 }
 
 
@@ -182,7 +447,17 @@ void dynamixel_io_task_notify_transmission_complete(DynamixelIOTaskHandle *dio_t
     TaskHandle_t task_handle = dio_task_handle->task_handle;
     BaseType_t higher_priority_task_woken = pdFALSE;
     configASSERT(task_handle != NULL);
+    trace_from_isr(dio_task_handle, state == dio_WRITE_COMPLETED ?
+            dio_TRACE_TX_COMPLETED : dio_TRACE_RX_COMPLETED, state);
     dio_task_handle->transmission_state = state;
+    if (state == dio_WRITE_COMPLETED && dio_task_handle->timer.now != NULL)
+        dio_task_handle->tx_end_us = dio_task_handle->timer.now(dio_task_handle->timer.context);
+    if (state == dio_WRITE_COMPLETED && dio_task_handle->rx_chain_pending) {
+        // start reception right away, the task is woken only with the response
+        dio_task_handle->rx_chain_pending = false;
+        if (chain_reception(dio_task_handle))
+            return;
+    }
     /* Notify the task that the transmission is complete. */
     vTaskNotifyGiveFromISR(task_handle, &higher_priority_task_woken);
     /* If xHigherPriorityTaskWoken is now set to pdTRUE then a context switch
@@ -192,21 +467,220 @@ void dynamixel_io_task_notify_transmission_complete(DynamixelIOTaskHandle *dio_t
     portYIELD_FROM_ISR(higher_priority_task_woken);
 }
 
+void dynamixel_io_task_notify_bytes_received(DynamixelIOTaskHandle *dio_task_handle,
+        const uint8_t *data, size_t data_len)
+{
+    // ignore anything that is not a response (e.g. echo of transmitted data)
+    if (!dio_task_handle->rx_parser_armed)
+        return;
+    DynamixelIOTimer *timer = &dio_task_handle->timer;
+    if (!dio_task_handle->rx_data_seen) {
+        trace_from_isr(dio_task_handle, dio_TRACE_RX_FIRST_DATA, 0);
+        if (timer->now != NULL)
+            dio_task_handle->rx_first_data_us = timer->now(timer->context);
+        dio_task_handle->rx_data_seen = true;
+    }
+
+    DynamixelParserResult result = dpr_IN_PROGRESS;
+    bool packet_started = false;
+    while (data_len > 0) {
+        int n_consumed;
+        result = feed_response_parser(dio_task_handle, data, data_len, &n_consumed);
+        data += n_consumed;
+        data_len -= n_consumed;
+        packet_started = true;
+        if (result != dpr_PACKET_READY || --dio_task_handle->rx_n_pending == 0)
+            break;
+        // next status packet will be stored right after this one
+        dio_task_handle->rx_offset += parsed_packet_size(dio_task_handle);
+        init_response_parser(dio_task_handle);
+        result = dpr_IN_PROGRESS;
+        packet_started = false;
+    }
+    if (result == dpr_IN_PROGRESS) {
+        // the next servo starts responding after its return delay
+        if (timer->start != NULL && dio_task_handle->inter_byte_timeout_us > 0) {
+            dio_task_handle->rx_armed_timeout_us = packet_started ?
+                dio_task_handle->inter_byte_timeout_us : dio_task_handle->first_byte_timeout_us;
+            timer->start(timer->context, dio_task_handle->rx_armed_timeout_us);
+        }
+        return;
+    }
+    if (timer->start != NULL)
+        timer->stop(timer->context);
+
+    // last packet or error ends the reception, the rest of data is ignored
+    dio_task_handle->rx_parser_armed = false;
+    dio_task_handle->rx_parser_result = result;
+    dynamixel_io_task_notify_transmission_complete(dio_task_handle,
+            result == dpr_PACKET_READY ? dio_READ_COMPLETED : dio_READ_REJECTED);
+}
+
+void dynamixel_io_task_set_timer(DynamixelIOTaskHandle *handle, DynamixelIOTimer timer,
+        uint32_t first_byte_timeout_us, uint32_t inter_byte_timeout_us)
+{
+    configASSERT(timer.start == NULL || timer.stop != NULL);
+    configASSERT((first_byte_timeout_us == 0) == (inter_byte_timeout_us == 0));
+    handle->timer = timer;
+    handle->first_byte_timeout_us = timer.start != NULL ? first_byte_timeout_us : 0;
+    handle->inter_byte_timeout_us = timer.start != NULL ? inter_byte_timeout_us : 0;
+}
+
+uint32_t dynamixel_io_task_get_rx_timeout_us(DynamixelIOTaskHandle *handle, bool *rearmed)
+{
+    if (rearmed != NULL)
+        *rearmed = handle->timer.start != NULL && handle->inter_byte_timeout_us > 0;
+    return handle->rx_armed_timeout_us;
+}
+
+void dynamixel_io_task_set_adaptive_timeouts(DynamixelIOTaskHandle *handle,
+        DynamixelIOLatencyEstimate *estimates, int n_ids, uint32_t floor_us, uint32_t ceiling_us)
+{
+    configASSERT(estimates == NULL || handle->timer.now != NULL);
+    configASSERT(n_ids >= 0 && n_ids <= DYNAMIXEL_BROADCASTING_ID);
+    configASSERT(floor_us <= ceiling_us);
+    if (estimates != NULL)
+        memset(estimates, 0, n_ids * sizeof(*estimates));
+    taskENTER_CRITICAL();
+    handle->latency = estimates;
+    handle->n_latency_ids = estimates != NULL ? n_ids : 0;
+    handle->adaptive_floor_us = floor_us;
+    handle->adaptive_ceiling_us = ceiling_us;
+    taskEXIT_CRITICAL();
+}
+
+bool dynamixel_io_task_get_latency_estimate(DynamixelIOTaskHandle *handle, uint8_t id,
+        DynamixelIOLatencyEstimate *estimate)
+{
+    bool learned = false;
+    taskENTER_CRITICAL();
+    if (id < handle->n_latency_ids) {
+        *estimate = handle->latency[id];
+        learned = estimate->n_samples >= DYNAMIXEL_IO_ADAPTIVE_MIN_SAMPLES;
+    }
+    taskEXIT_CRITICAL();
+    return learned;
+}
+
+void dynamixel_io_task_notify_timeout(DynamixelIOTaskHandle *dio_task_handle)
+{
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    configASSERT(dio_task_handle->task_handle != NULL);
+    // transmission state is left as it is, completion may come at the same time;
+    // no critical section (it is traced by the task): the POSIX timer thread calls this
+    // with its lock, which start() and stop() take in critical sections of the reception
+    if (__atomic_load_n(&dio_task_handle->trace, __ATOMIC_RELAXED) != NULL)
+        dio_task_handle->timeout_expired_us = now_us_from_isr(dio_task_handle);
+    dio_task_handle->timeout_expired = true;
+    vTaskNotifyGiveFromISR(dio_task_handle->task_handle, &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+void dynamixel_io_task_set_chained_reception(DynamixelIOTaskHandle *handle, bool chained)
+{
+    handle->chain_reception = chained;
+}
+
+void dynamixel_io_task_set_protocol(DynamixelIOTaskHandle *handle,
+        DynamixelIOProtocol protocol)
+{
+    configASSERT(protocol == dio_PROTOCOL_1 || protocol == dio_PROTOCOL_2);
+    handle->protocol = protocol;
+}
+
 bool dynamixel_io_send_request(DynamixelIOTaskHandle *task_handle,
         DynamixelPacket *packet, int response_size, bool ignore_response)
 {
+    return dynamixel_io_send_multi_request(task_handle, packet, response_size, 1, ignore_response);
+}
+
+bool dynamixel_io_send_multi_request(DynamixelIOTaskHandle *task_handle,
+        DynamixelPacket *packet, int response_size, int n_responses, bool ignore_response)
+{
+    DynamixelIORequest request = {
+        .packet = packet,
+        .tx_size = 0,
+        .response_size = response_size,
+        .n_responses = n_responses,
+        .ignore_response = ignore_response,
+        .completion = NULL
+    };
+    return dynamixel_io_submit(task_handle, &request);
+}
+
+bool dynamixel_io_send_batch(DynamixelIOTaskHandle *task_handle,
+        DynamixelPacketBatch *batch, bool ignore_response)
+{
+    configASSERT(batch->n_packets > 0);
+    DynamixelIORequest request = {
+        .packet = dynamixel_packet_batch_packet(batch),
+        .tx_size = batch->size,
+        .response_size = batch->response_size,
+        .n_responses = 1,
+        .ignore_response = ignore_response,
+        .completion = NULL
+    };
+    return dynamixel_io_submit(task_handle, &request);
+}
+
+bool dynamixel_io_send_request_to(DynamixelIOTaskHandle *task_handle,
+        DynamixelPacket *packet, int response_size, DynamixelIOCompletion *completion)
+{
+    configASSERT(completion != NULL);
     DynamixelIORequest request = {
         .packet = packet,
+        .tx_size = 0,
         .response_size = response_size,
-        .ignore_response = ignore_response
+        .n_responses = 1,
+        .ignore_response = false,
+        .completion = completion
+    };
+    return dynamixel_io_submit(task_handle, &request);
+}
+
+bool dynamixel_io_send_request_batch(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOBatchItem *items, int n_items, DynamixelIOCompletion *completion)
+{
+    configASSERT(n_items > 0);
+    DynamixelIORequest request = {
+        .packet = NULL,
+        .tx_size = 0,
+        .response_size = 0,
+        .n_responses = 1,
+        .ignore_response = false,
+        .completion = completion,
+        .items = items,
+        .n_items = n_items
     };
-    BaseType_t result = xQueueSendToBack(task_handle->request_queue,
-            &request,
+    return dynamixel_io_submit(task_handle, &request);
+}
+
+bool dynamixel_io_submit(DynamixelIOTaskHandle *task_handle, const DynamixelIORequest *request)
+{
+    configASSERT(request->priority >= 0 && request->priority < dio_N_PRIORITIES);
+    DynamixelIORequest queued = *request;
+    queued.queued_at = xTaskGetTickCount();
+    trace_enqueued(task_handle, &queued);
+    BaseType_t result = xQueueSendToBack(task_handle->request_queues[request->priority],
+            &queued,
             portMAX_DELAY);
             // 2 * portTICK_PERIOD_MS(task_handle->max_wait_time_ms));
     // TODO: ^ should it wait portMAX_DELAY?
     //         it must be more than used in ulTaskNotifyTake !!!
-    return result == pdPASS;
+    if (result != pdPASS)
+        return false;
+    // the task takes the semaphore once for each request in any of the queues
+    xSemaphoreGive(task_handle->n_requests);
+    return true;
+}
+
+bool dynamixel2_io_send_request(DynamixelIOTaskHandle *task_handle,
+        Dynamixel2Packet *packet, int response_size, bool ignore_response)
+{
+    configASSERT(task_handle->protocol == dio_PROTOCOL_2);
+    // the task treats packets according to the protocol
+    return dynamixel_io_send_request(task_handle, (DynamixelPacket *) packet,
+            response_size, ignore_response);
 }
 
 bool dynamixel_io_wait_response(DynamixelIOTaskHandle *task_handle,
@@ -221,15 +695,382 @@ bool dynamixel_io_wait_response(DynamixelIOTaskHandle *task_handle,
     return result == pdTRUE;
 }
 
+bool dynamixel_io_completion_create(DynamixelIOCompletion *completion, UBaseType_t max_outstanding)
+{
+    configASSERT(max_outstanding >= 1);
+    completion->queue = xQueueCreate(max_outstanding, sizeof(DynamixelIOResponse));
+    completion->callback = NULL;
+    completion->callback_context = NULL;
+    return completion->queue != NULL;
+}
+
+void dynamixel_io_completion_create_callback(DynamixelIOCompletion *completion,
+        DynamixelIOCallback callback, void *context)
+{
+    configASSERT(callback != NULL);
+    completion->queue = NULL;
+    completion->callback = callback;
+    completion->callback_context = context;
+}
+
+void dynamixel_io_completion_delete(DynamixelIOCompletion *completion)
+{
+    if (completion->queue != NULL)
+        vQueueDelete(completion->queue);
+    completion->queue = NULL;
+    completion->callback = NULL;
+}
+
+void dynamixel_io_task_set_coalescing(DynamixelIOTaskHandle *handle,
+        DynamixelIOCoalescedWrite *slots, int n_slots)
+{
+    configASSERT(slots != NULL || n_slots == 0);
+    for (int i = 0; i < n_slots; i++)
+        slots[i].pending = false;
+    taskENTER_CRITICAL();
+    handle->coalesced = slots;
+    handle->n_coalesced_slots = n_slots;
+    taskEXIT_CRITICAL();
+}
+
+bool dynamixel_io_write_coalesced(DynamixelIOTaskHandle *task_handle, uint8_t id,
+        uint8_t address, const uint8_t *data, int data_len, DynamixelIOPriority priority)
+{
+    if (data_len <= 0 || data_len > DYNAMIXEL_IO_COALESCED_MAX_DATA)
+        return false;
+    DynamixelIOCoalescedWrite write = {
+        .sync = false,
+        .id = id,
+        .address = address,
+        .data_len = data_len,
+        .n_servos = 1
+    };
+    memcpy(write.data, data, data_len);
+    return submit_coalesced(task_handle, &write, priority);
+}
+
+bool dynamixel_io_sync_write_coalesced(DynamixelIOTaskHandle *task_handle, uint8_t address,
+        const uint8_t *data, int n_servos, int data_len_for_each, DynamixelIOPriority priority)
+{
+    int size = n_servos * (data_len_for_each + 1);
+    if (n_servos <= 0 || data_len_for_each <= 0 || size > DYNAMIXEL_IO_COALESCED_MAX_DATA)
+        return false;
+    DynamixelIOCoalescedWrite write = {
+        .sync = true,
+        .id = DYNAMIXEL_BROADCASTING_ID,
+        .address = address,
+        .data_len = data_len_for_each,
+        .n_servos = n_servos
+    };
+    memcpy(write.data, data, size);
+    return submit_coalesced(task_handle, &write, priority);
+}
+
+void dynamixel_io_task_get_queue_stats(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOPriority priority, DynamixelIOQueueStats *stats)
+{
+    configASSERT(priority >= 0 && priority < dio_N_PRIORITIES);
+    taskENTER_CRITICAL();
+    *stats = task_handle->queue_stats[priority];
+    taskEXIT_CRITICAL();
+}
+
+void dynamixel_io_task_reset_queue_stats(DynamixelIOTaskHandle *task_handle)
+{
+    taskENTER_CRITICAL();
+    memset(task_handle->queue_stats, 0, sizeof(task_handle->queue_stats));
+    taskEXIT_CRITICAL();
+}
+
+void dynamixel_io_task_get_metrics(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOMetrics *metrics)
+{
+    _Static_assert(sizeof(DynamixelIOMetrics) % sizeof(uint32_t) == 0,
+            "metrics are copied as 32-bit words");
+    const uint32_t *source = (const uint32_t *) &task_handle->metrics;
+    uint32_t *copy = (uint32_t *) metrics;
+    while (1) {
+        uint32_t sequence = __atomic_load_n(&task_handle->metrics_sequence, __ATOMIC_ACQUIRE);
+        if ((sequence & 1) == 0) {
+            // acquire, so that the sequence is read again after them
+            for (size_t i = 0; i < sizeof(DynamixelIOMetrics) / sizeof(uint32_t); i++)
+                copy[i] = __atomic_load_n(&source[i], __ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&task_handle->metrics_sequence, __ATOMIC_RELAXED) == sequence)
+                break;
+        } else {
+            // the task may have been preempted by this one in the middle of an update
+            vTaskDelay(1);
+        }
+    }
+    metrics->time_us = now_us(task_handle);
+}
+
+void dynamixel_io_task_set_trace(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOTraceEvent *events, int n_events)
+{
+    configASSERT(events == NULL || n_events > 0);
+    taskENTER_CRITICAL();
+    task_handle->trace_size = events != NULL ? n_events : 0;
+    task_handle->trace_n_recorded = 0;
+    // events check it before entering a critical section
+    __atomic_store_n(&task_handle->trace, events, __ATOMIC_RELAXED);
+    taskEXIT_CRITICAL();
+}
+
+void dynamixel_io_task_set_capture(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOCaptureRing *ring)
+{
+    // taken by the task at the start of each transaction
+    __atomic_store_n(&task_handle->capture, ring, __ATOMIC_RELEASE);
+}
+
+int dynamixel_io_task_read_trace(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOTraceEvent *events, int max_events)
+{
+    taskENTER_CRITICAL();
+    uint32_t n_events = task_handle->trace_n_recorded;
+    if (n_events > task_handle->trace_size)
+        n_events = task_handle->trace_size;
+    if (n_events > (uint32_t) max_events)
+        n_events = max_events;
+    uint32_t first = task_handle->trace_n_recorded - n_events;
+    for (uint32_t i = 0; i < n_events; i++)
+        events[i] = task_handle->trace[(first + i) % task_handle->trace_size];
+    taskEXIT_CRITICAL();
+    return (int) n_events;
+}
+
+int dynamixel_io_histogram_bucket(uint32_t value_us)
+{
+    int bucket = 0;
+    for (value_us >>= 4; value_us != 0 && bucket < DYNAMIXEL_IO_HISTOGRAM_N_BUCKETS - 1; value_us >>= 1)
+        bucket++;
+    return bucket;
+}
+
+bool dynamixel_io_rx_pool_create(DynamixelIORxPool *pool, uint8_t *storage,
+        int buffer_size, int n_buffers)
+{
+    configASSERT(storage != NULL && buffer_size > 0 && n_buffers > 0);
+    pool->storage = storage;
+    pool->buffer_size = buffer_size;
+    pool->n_buffers = n_buffers;
+    pool->free_buffers = xQueueCreate(n_buffers, sizeof(uint8_t *));
+    if (pool->free_buffers == NULL)
+        return false;
+    for (int i = 0; i < n_buffers; i++)
+        give_rx_buffer(pool, &storage[i * buffer_size]);
+    return true;
+}
+
+void dynamixel_io_rx_pool_delete(DynamixelIORxPool *pool)
+{
+    vQueueDelete(pool->free_buffers);
+    pool->free_buffers = NULL;
+}
+
+void dynamixel_io_task_set_rx_pool(DynamixelIOTaskHandle *handle, DynamixelIORxPool *pool)
+{
+    handle->rx_pool = pool;
+}
+
+void dynamixel_io_release_response(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOResponse *response)
+{
+    if (response->buffer != NULL) {
+        configASSERT(task_handle->rx_pool != NULL);
+        give_rx_buffer(task_handle->rx_pool, response->buffer);
+        response->buffer = NULL;
+    }
+    // items of a batch have their own buffers
+    for (int i = 0; response->items != NULL && i < response->n_items; i++)
+        dynamixel_io_release_response(task_handle, &response->items[i].response);
+}
+
+bool dynamixel_io_wait_completion(DynamixelIOCompletion *completion,
+        DynamixelIOResponse *response)
+{
+    BaseType_t result = xQueueReceive(completion->queue, response, portMAX_DELAY);
+    return result == pdTRUE;
+}
+
+bool dynamixel_io_future_create(DynamixelIOFuture *future)
+{
+    future->pending = false;
+    return dynamixel_io_completion_create(&future->completion, 1);
+}
+
+void dynamixel_io_future_delete(DynamixelIOFuture *future)
+{
+    configASSERT(!future->pending);
+    dynamixel_io_completion_delete(&future->completion);
+}
+
+bool dynamixel_io_submit_future(DynamixelIOTaskHandle *task_handle,
+        DynamixelIORequest *request, DynamixelIOFuture *future)
+{
+    // with more requests the IO task could block on the queue of the future
+    if (future->pending || request->ignore_response)
+        return false;
+    request->completion = &future->completion;
+    future->pending = dynamixel_io_submit(task_handle, request);
+    return future->pending;
+}
+
+bool dynamixel_io_send_request_future(DynamixelIOTaskHandle *task_handle,
+        DynamixelPacket *packet, int response_size, DynamixelIOFuture *future)
+{
+    DynamixelIORequest request = {
+        .packet = packet,
+        .response_size = response_size,
+        .n_responses = 1,
+        .ignore_response = false
+    };
+    return dynamixel_io_submit_future(task_handle, &request, future);
+}
+
+bool dynamixel_io_future_poll(DynamixelIOFuture *future)
+{
+    return dynamixel_io_future_wait(future, 0);
+}
+
+bool dynamixel_io_future_wait(DynamixelIOFuture *future, TickType_t timeout)
+{
+    if (!future->pending)
+        return true;
+    if (xQueueReceive(future->completion.queue, &future->response, timeout) != pdTRUE)
+        return false;
+    future->pending = false;
+    return true;
+}
+
+static uint32_t max_wait_us(DynamixelIOTaskHandle *task,
+        uint32_t n_bytes, uint32_t n_read_delays)
+{
+    return n_bytes * task->max_wait_per_byte_us + n_read_delays * task->max_wait_read_delay_us;
+}
+
 static uint32_t max_wait_ticks(DynamixelIOTaskHandle *task,
-        uint32_t n_bytes, bool is_reading)
+        uint32_t n_bytes, uint32_t n_read_delays)
 {
-    uint32_t max_wait_us = n_bytes * task->max_wait_per_byte_us;
-    if (is_reading)
-        max_wait_us += task->max_wait_read_delay_us;
-    uint32_t divider = portTICK_PERIOD_MS * 1000; // divde by 1000 to convert microsec to milisec
-    uint32_t max_wait_ticks = ((max_wait_us - 1) / divider) + 1; // ceiling division (rounds up)
-    return max_wait_ticks;
+    uint32_t wait_us = max_wait_us(task, n_bytes, n_read_delays);
+    // ceiling division (rounds up), a tick may be shorter than millisecond (e.g. POSIX port)
+    uint64_t wait_ticks = ((uint64_t) wait_us * configTICK_RATE_HZ + 999999) / 1000000;
+    // with the timer ticks are only a fallback, they must not expire first
+    if (task->timer.start != NULL)
+        wait_ticks += 2;
+    return (uint32_t) wait_ticks;
+}
+
+static void start_timer(DynamixelIOTaskHandle *handle, uint32_t timeout_us)
+{
+    if (handle->timer.start == NULL)
+        return;
+    // expiry of the previous timeout (after the notification that ended it) is stale
+    handle->timer.stop(handle->timer.context);
+    ulTaskNotifyTake(pdTRUE, 0);
+    handle->timeout_expired = false;
+    handle->timer.start(handle->timer.context, timeout_us);
+}
+
+// returns true if the timer has expired
+static bool stop_timer(DynamixelIOTaskHandle *handle)
+{
+    if (handle->timer.start == NULL)
+        return false;
+    handle->timer.stop(handle->timer.context);
+    return handle->timeout_expired;
+}
+
+// stop_timer() after the task has been woken, traces the expiry before the wakeup
+static bool stop_timer_woken(DynamixelIOTaskHandle *handle)
+{
+    bool expired = stop_timer(handle);
+    if (expired && __atomic_load_n(&handle->trace, __ATOMIC_RELAXED) != NULL) {
+        taskENTER_CRITICAL();
+        trace_record(handle, handle->timeout_expired_us, dio_TRACE_TIMEOUT, handle->trace_request, 0);
+        taskEXIT_CRITICAL();
+    }
+    trace(handle, dio_TRACE_WOKEN, 0);
+    return expired;
+}
+
+// estimate of the servo the request is for, NULL if it is not learned from this request
+// (must be called before sending, without an rx pool the response overwrites the packet)
+static DynamixelIOLatencyEstimate *latency_estimate(DynamixelIOTaskHandle *handle,
+        DynamixelIORequest *request)
+{
+    // batches of packets are answered by the last one
+    if (handle->latency == NULL || handle->timer.now == NULL || request->response_size == 0
+            || request->n_responses != 1 || request->tx_size != 0)
+        return NULL;
+    uint8_t id = packet_id(handle, request->packet);
+    return id < handle->n_latency_ids ? &handle->latency[id] : NULL;
+}
+
+// timeout from the start of reception (until the first data with inter-byte timeouts)
+static uint32_t reception_timeout_us(DynamixelIOTaskHandle *handle,
+        DynamixelIORequest *request, DynamixelIOLatencyEstimate *estimate)
+{
+    if (estimate != NULL && estimate->n_samples >= DYNAMIXEL_IO_ADAPTIVE_MIN_SAMPLES) {
+        uint64_t timeout_us = (uint64_t) estimate->latency_us + 4 * (uint64_t) estimate->deviation_us;
+        if (timeout_us < handle->adaptive_floor_us)
+            timeout_us = handle->adaptive_floor_us;
+        // exponential backoff while the servo does not respond
+        timeout_us <<= estimate->n_timeouts < 16 ? estimate->n_timeouts : 16;
+        if (timeout_us > handle->adaptive_ceiling_us)
+            timeout_us = handle->adaptive_ceiling_us;
+        if (handle->first_byte_timeout_us > 0)
+            return (uint32_t) timeout_us;
+        return (uint32_t) timeout_us + max_wait_us(handle, request->response_size, 0);
+    }
+    if (handle->first_byte_timeout_us > 0)
+        return handle->first_byte_timeout_us;
+    return max_wait_us(handle, request->response_size, request->n_responses);
+}
+
+// smoothed like round-trip time in RFC 6298 (gains 1/8 and 1/4)
+static void update_latency(DynamixelIOTaskHandle *handle,
+        DynamixelIOLatencyEstimate *estimate, DynamixelIOStatus status)
+{
+    if (estimate == NULL)
+        return;
+    uint32_t sample_us = handle->rx_first_data_us - handle->tx_end_us;
+    taskENTER_CRITICAL();
+    if (status == dio_OK && handle->rx_data_seen) {
+        if (estimate->n_samples == 0) {
+            estimate->latency_us = sample_us;
+            estimate->deviation_us = sample_us / 2;
+        } else {
+            uint32_t error_us = sample_us > estimate->latency_us ?
+                sample_us - estimate->latency_us : estimate->latency_us - sample_us;
+            estimate->deviation_us = (uint32_t) ((3 * (uint64_t) estimate->deviation_us + error_us) / 4);
+            estimate->latency_us = (uint32_t) ((7 * (uint64_t) estimate->latency_us + sample_us) / 8);
+        }
+        if (estimate->n_samples < UINT16_MAX)
+            estimate->n_samples++;
+        estimate->n_timeouts = 0;
+    } else if (status == dio_UART_READ_TIMEOUT && !handle->rx_data_seen) {
+        if (estimate->n_timeouts < UINT8_MAX)
+            estimate->n_timeouts++;
+    }
+    taskEXIT_CRITICAL();
+}
+
+// adapters for context-free UART functions, context is the task handle
+static int uart_write(void *context, uint8_t *data, size_t data_len)
+{
+    return ((DynamixelIOTaskHandle *) context)->uart_write_handle(data, data_len);
+}
+
+static int uart_read(void *context, uint8_t *data, size_t data_len)
+{
+    return ((DynamixelIOTaskHandle *) context)->uart_read_handle(data, data_len);
+}
+
+static int uart_reset(void *context)
+{
+    return ((DynamixelIOTaskHandle *) context)->uart_reset_handle();
 }
 
 static void maybe_send_response(DynamixelIOStatus status,
@@ -238,10 +1079,532 @@ static void maybe_send_response(DynamixelIOStatus status,
 {
     if (!request->ignore_response) {
         response->status = status;
-        BaseType_t queue_result = xQueueSendToBack(handle->response_queue,
-                response, portMAX_DELAY);
+        response->packet = request->packet;
+        response->items = request->items;
+        response->n_items = request->n_items;
+        DynamixelIOCompletion *completion = request->completion;
+        if (completion != NULL && completion->callback != NULL) {
+            completion->callback(response, completion->callback_context);
+            return;
+        }
+        QueueHandle_t queue = completion != NULL ? completion->queue : handle->response_queue;
+        BaseType_t queue_result = xQueueSendToBack(queue, response, portMAX_DELAY);
         configASSERT(queue_result == pdTRUE);
     }
 }
 
+// the next request: the oldest one of the most urgent class
+static void receive_request(DynamixelIOTaskHandle *handle, DynamixelIORequest *request)
+{
+    static const DynamixelIOPriority order[dio_N_PRIORITIES] = {
+        dio_PRIORITY_CONTROL, dio_PRIORITY_NORMAL, dio_PRIORITY_BACKGROUND
+    };
+    BaseType_t result = xSemaphoreTake(handle->n_requests, portMAX_DELAY);
+    configASSERT(result == pdTRUE);
+    // the semaphore is given after the request is queued, so one of the queues has it
+    for (int i = 0; i < dio_N_PRIORITIES; i++)
+        if (xQueueReceive(handle->request_queues[order[i]], request, 0) == pdTRUE)
+            return;
+    configASSERT(0);
+}
+
+// updates queue statistics, true if the request has waited longer than its deadline
+static bool has_expired(DynamixelIOTaskHandle *handle, DynamixelIORequest *request)
+{
+    // unsigned difference is right also after the tick count overflows
+    TickType_t waited = xTaskGetTickCount() - request->queued_at;
+    bool expired = request->max_queue_wait != 0 && waited > request->max_queue_wait;
+    DynamixelIOQueueStats *stats = &handle->queue_stats[request->priority];
+    taskENTER_CRITICAL();
+    stats->n_requests++;
+    stats->n_expired += expired;
+    stats->total_wait += waited;
+    if (waited > stats->max_wait)
+        stats->max_wait = waited;
+    taskEXIT_CRITICAL();
+
+    uint32_t waited_us = (uint32_t) ((uint64_t) waited * 1000000 / configTICK_RATE_HZ);
+    DynamixelIOTransactionKind kind = request_kind(handle,
+            request->items != NULL ? request->items[0].packet : request->packet);
+    DynamixelIOMetrics *metrics = &handle->metrics;
+    metrics_begin(handle);
+    metrics_add(&metrics->queue_wait[kind].counts[dynamixel_io_histogram_bucket(waited_us)], 1);
+    if (expired)
+        metrics_add(&metrics->n_status[dio_DEADLINE_EXPIRED], 1);
+    metrics_end(handle);
+    return expired;
+}
+
+// builds the packet of a coalesced write, its slot can be reused from now on
+static void take_coalesced(DynamixelIOTaskHandle *handle, DynamixelIORequest *request)
+{
+    DynamixelIOCoalescedWrite write;
+    taskENTER_CRITICAL();
+    write = *request->coalesced;
+    request->coalesced->pending = false;
+    taskEXIT_CRITICAL();
+
+    int max_n_parameters = DYNAMIXEL_IO_COALESCED_MAX_DATA + 2;
+    DynamixelPacket *packet = &handle->coalesced_packet;
+    if (write.sync)
+        request->response_size = dynamixel_prepare_sync_write_sized(packet, max_n_parameters,
+                write.address, write.data, write.n_servos, write.data_len);
+    else
+        request->response_size = dynamixel_prepare_write_sized(packet, max_n_parameters,
+                write.id, write.address, write.data, write.data_len);
+    configASSERT(request->response_size >= 0);
+    request->packet = packet;
+}
+
+static bool submit_coalesced(DynamixelIOTaskHandle *handle,
+        const DynamixelIOCoalescedWrite *write, DynamixelIOPriority priority)
+{
+    configASSERT(handle->protocol == dio_PROTOCOL_1);
+    configASSERT(priority >= 0 && priority < dio_N_PRIORITIES);
+    DynamixelIOCoalescedWrite *slot = NULL;
+    taskENTER_CRITICAL();
+    for (int i = 0; i < handle->n_coalesced_slots; i++) {
+        DynamixelIOCoalescedWrite *pending = &handle->coalesced[i];
+        if (!pending->pending) {
+            if (slot == NULL)
+                slot = pending;
+            continue;
+        }
+        if (pending->sync != write->sync || pending->id != write->id
+                || pending->address != write->address || pending->data_len != write->data_len)
+            continue;
+        // last writer wins
+        if (!write->sync)
+            memcpy(pending->data, write->data, write->data_len);
+        else if (!merge_sync_write(pending, write))
+            continue;
+        handle->queue_stats[priority].n_coalesced++;
+        taskEXIT_CRITICAL();
+        return true;
+    }
+    if (slot != NULL) {
+        *slot = *write;
+        slot->pending = true;
+    }
+    taskEXIT_CRITICAL();
+    if (slot == NULL)
+        return false;
+
+    DynamixelIORequest request = {
+        .packet = NULL,
+        .response_size = 0,
+        .n_responses = 1,
+        .ignore_response = true,
+        .priority = priority,
+        .coalesced = slot
+    };
+    if (dynamixel_io_submit(handle, &request))
+        return true;
+    taskENTER_CRITICAL();
+    slot->pending = false;
+    taskEXIT_CRITICAL();
+    return false;
+}
+
+// replaces data of the servos that are already in the pending sync write and adds
+// the others, false (and nothing changed) if they do not fit
+static bool merge_sync_write(DynamixelIOCoalescedWrite *pending,
+        const DynamixelIOCoalescedWrite *write)
+{
+    int entry_size = write->data_len + 1;
+    int index[DYNAMIXEL_IO_COALESCED_MAX_DATA / 2];  // at least 2 bytes per servo
+    int n_servos = pending->n_servos;
+    for (int i = 0; i < write->n_servos; i++) {
+        uint8_t id = write->data[i * entry_size];
+        index[i] = -1;
+        for (int j = 0; j < pending->n_servos; j++)
+            if (pending->data[j * entry_size] == id)
+                index[i] = j;
+        if (index[i] < 0)
+            index[i] = n_servos++;
+    }
+    if (n_servos * entry_size > DYNAMIXEL_IO_COALESCED_MAX_DATA)
+        return false;
+    for (int i = 0; i < write->n_servos; i++)
+        memcpy(&pending->data[index[i] * entry_size], &write->data[i * entry_size], entry_size);
+    pending->n_servos = n_servos;
+    return true;
+}
+
+// a free buffer of the rx pool for the response (waits at most wait ticks for one),
+// NULL if it should be received into the packet
+static uint8_t *take_rx_buffer(DynamixelIOTaskHandle *handle, DynamixelIORequest *request,
+        TickType_t wait)
+{
+    DynamixelIORxPool *pool = handle->rx_pool;
+    if (pool == NULL || request->response_size == 0 || request->response_size > pool->buffer_size)
+        return NULL;
+    uint8_t *buffer;
+    if (xQueueReceive(pool->free_buffers, &buffer, wait) != pdTRUE) {
+        configASSERT(wait != portMAX_DELAY);
+        return NULL;
+    }
+    return buffer;
+}
+
+static void give_rx_buffer(DynamixelIORxPool *pool, uint8_t *buffer)
+{
+    // there is always space for all the buffers
+    BaseType_t result = xQueueSendToBack(pool->free_buffers, &buffer, 0);
+    configASSERT(result == pdTRUE);
+}
+
+// time in microseconds, of the timer if it can tell it, otherwise of ticks
+static uint32_t now_us(DynamixelIOTaskHandle *handle)
+{
+    if (handle->timer.now != NULL)
+        return handle->timer.now(handle->timer.context);
+    return (uint32_t) ((uint64_t) xTaskGetTickCount() * 1000000 / configTICK_RATE_HZ);
+}
+
+static uint32_t now_us_from_isr(DynamixelIOTaskHandle *handle)
+{
+    if (handle->timer.now != NULL)
+        return handle->timer.now(handle->timer.context);
+    return (uint32_t) ((uint64_t) xTaskGetTickCountFromISR() * 1000000 / configTICK_RATE_HZ);
+}
+
+// metrics are written only by the task, between metrics_begin() and metrics_end()
+// the sequence is odd, so that dynamixel_io_task_get_metrics() can retry
+static void metrics_begin(DynamixelIOTaskHandle *handle)
+{
+    __atomic_store_n(&handle->metrics_sequence, handle->metrics_sequence + 1, __ATOMIC_RELAXED);
+}
+
+static void metrics_end(DynamixelIOTaskHandle *handle)
+{
+    __atomic_store_n(&handle->metrics_sequence, handle->metrics_sequence + 1, __ATOMIC_RELEASE);
+}
+
+// there is only one writer, so no read-modify-write is needed; release, so that
+// a reader that sees the new value also sees the odd sequence
+static void metrics_add(uint32_t *counter, uint32_t value)
+{
+    __atomic_store_n(counter, *counter + value, __ATOMIC_RELEASE);
+}
+
+// events of the request handled by the task, without the ring only the pointer is tested
+static void trace(DynamixelIOTaskHandle *handle, DynamixelIOTraceEventType type, uint8_t detail)
+{
+    if (__atomic_load_n(&handle->trace, __ATOMIC_RELAXED) == NULL)
+        return;
+    taskENTER_CRITICAL();
+    trace_record(handle, now_us(handle), type, handle->trace_request, detail);
+    taskEXIT_CRITICAL();
+}
+
+static void trace_from_isr(DynamixelIOTaskHandle *handle,
+        DynamixelIOTraceEventType type, uint8_t detail)
+{
+    if (__atomic_load_n(&handle->trace, __ATOMIC_RELAXED) == NULL)
+        return;
+    UBaseType_t saved_interrupt_status = taskENTER_CRITICAL_FROM_ISR();
+    trace_record(handle, now_us_from_isr(handle), type, handle->trace_request, detail);
+    taskEXIT_CRITICAL_FROM_ISR(saved_interrupt_status);
+}
+
+static void capture_transaction(DynamixelIOTaskHandle *handle, DynamixelIOCaptureRing *ring,
+        DynamixelIORequest *request, int tx_size, DynamixelIOStatus status,
+        uint32_t start_us, uint32_t duration_us)
+{
+    DynamixelIOCaptureRecord record = {
+        .time_us = start_us,
+        .duration_us = duration_us,
+        .tx_length = (uint16_t) tx_size,
+        .rx_length = (uint16_t) received_size(handle, request, status),
+        .response_size = (uint16_t) request->response_size,
+        .n_responses = (uint8_t) (request->n_responses < UINT8_MAX ? request->n_responses : UINT8_MAX),
+        .status = (uint8_t) status
+    };
+    dynamixel_capture_ring_end(ring, &record, response_data(handle, request));
+}
+
+// numbers the request (from the caller)
+static void trace_enqueued(DynamixelIOTaskHandle *handle, DynamixelIORequest *request)
+{
+    if (__atomic_load_n(&handle->trace, __ATOMIC_RELAXED) == NULL)
+        return;
+    taskENTER_CRITICAL();
+    request->trace_request = handle->trace_next_request++;
+    trace_record(handle, now_us(handle), dio_TRACE_ENQUEUED, request->trace_request, request->priority);
+    taskEXIT_CRITICAL();
+}
+
+// the following events (also from interrupts) belong to the request
+static void trace_dequeued(DynamixelIOTaskHandle *handle, DynamixelIORequest *request)
+{
+    if (__atomic_load_n(&handle->trace, __ATOMIC_RELAXED) == NULL)
+        return;
+    taskENTER_CRITICAL();
+    handle->trace_request = request->trace_request;
+    trace_record(handle, now_us(handle), dio_TRACE_DEQUEUED, request->trace_request, request->priority);
+    taskEXIT_CRITICAL();
+}
+
+// in a critical section, the ring may have been removed in the meantime
+static void trace_record(DynamixelIOTaskHandle *handle, uint32_t time_us,
+        DynamixelIOTraceEventType type, uint32_t request, uint8_t detail)
+{
+    if (handle->trace == NULL)
+        return;
+    DynamixelIOTraceEvent *event =
+        &handle->trace[handle->trace_n_recorded++ % handle->trace_size];
+    event->time_us = time_us;
+    event->request = request;
+    event->type = type;
+    event->detail = detail;
+    event->reserved[0] = event->reserved[1] = 0;
+}
+
+static uint8_t *request_data(DynamixelIOTaskHandle *handle, DynamixelIORequest *request)
+{
+    if (handle->protocol == dio_PROTOCOL_2)
+        return dynamixel2_packet_data((Dynamixel2Packet *) request->packet);
+    return dynamixel_packet_data(request->packet);
+}
+
+// where the response of the current transaction is received
+static uint8_t *response_data(DynamixelIOTaskHandle *handle, DynamixelIORequest *request)
+{
+    if (handle->rx_buffer != NULL)
+        return handle->rx_buffer;
+    return request_data(handle, request);
+}
+
+static int request_size(DynamixelIOTaskHandle *handle, DynamixelIORequest *request)
+{
+    if (request->tx_size > 0)
+        return request->tx_size;
+    if (handle->protocol == dio_PROTOCOL_2)
+        return dynamixel2_packet_size((Dynamixel2Packet *) request->packet);
+    return dynamixel_packet_size(request->packet);
+}
 
+static uint8_t packet_id(DynamixelIOTaskHandle *handle, DynamixelPacket *packet)
+{
+    return handle->protocol == dio_PROTOCOL_2 ? ((Dynamixel2Packet *) packet)->id : packet->id;
+}
+
+static DynamixelIOTransactionKind request_kind(DynamixelIOTaskHandle *handle,
+        DynamixelPacket *packet)
+{
+    uint8_t instruction = handle->protocol == dio_PROTOCOL_2 ?
+        ((Dynamixel2Packet *) packet)->instruction : packet->instruction;
+    switch (instruction) {
+        case DYNAMIXEL_INST_PING:
+            return dio_KIND_PING;
+        case DYNAMIXEL_INST_READ:
+        case DYNAMIXEL_INST_SYSTEM_READ:
+        case DYNAMIXEL_INST_BULK_READ:
+        case DYNAMIXEL2_INST_SYNC_READ:
+        case DYNAMIXEL2_INST_FAST_SYNC_READ:
+            return dio_KIND_READ;
+        case DYNAMIXEL_INST_WRITE:
+        case DYNAMIXEL_INST_REG_WRITE:
+        case DYNAMIXEL_INST_ACTION:
+        case DYNAMIXEL_INST_SYSTEM_WRITE:
+        case DYNAMIXEL_INST_SYNC_WRITE:
+        case DYNAMIXEL_INST_SYNC_REG_WRITE:
+        case DYNAMIXEL2_INST_BULK_WRITE:
+            return dio_KIND_WRITE;
+        default:
+            return dio_KIND_OTHER;
+    }
+}
+
+static void start_response_parser(DynamixelIOTaskHandle *handle, DynamixelIORequest *request)
+{
+    handle->rx_data = response_data(handle, request);
+    handle->rx_size = request->response_size;
+    handle->rx_offset = 0;
+    handle->rx_n_pending = request->n_responses;
+    init_response_parser(handle);
+    handle->rx_parser_result = dpr_IN_PROGRESS;
+    handle->rx_data_seen = false;
+}
+
+// data received after that (e.g. after timeout) is ignored, the interrupt
+// that passes it cannot run in the middle of the critical section
+static void stop_response_parser(DynamixelIOTaskHandle *handle)
+{
+    taskENTER_CRITICAL();
+    handle->rx_parser_armed = false;
+    taskEXIT_CRITICAL();
+}
+
+// called from the write completion interrupt, returns false if reception could not be started
+static bool chain_reception(DynamixelIOTaskHandle *handle)
+{
+    // set before the timer is started, its expiry may wake the task right away;
+    // the driver may complete reception before returning
+    trace_from_isr(handle, dio_TRACE_RX_STARTED, 0);
+    handle->rx_chain_started = true;
+    handle->rx_parser_armed = true;
+    if (handle->timer.start != NULL)
+        handle->timer.start(handle->timer.context, handle->rx_timeout_us);
+    if (handle->uart.read(handle->uart.context, handle->rx_data, handle->rx_size) == 0)
+        return true;
+    handle->rx_parser_armed = false;
+    handle->rx_chain_started = false;
+    return false;
+}
+
+// status of reception that has ended with notification (or timeout), UART is reset on error
+static DynamixelIOStatus reception_status(DynamixelIOTaskHandle *handle,
+        DynamixelIORequest *request, DynamixelIOResponse *response,
+        uint32_t notification_value, bool timer_expired)
+{
+    DynamixelIOTransmissionState state = handle->transmission_state;
+    DynamixelIOStatus status;
+    if (notification_value == 0 || (timer_expired
+                && state != dio_READ_COMPLETED && state != dio_READ_REJECTED))
+        status = dio_UART_READ_TIMEOUT;
+    else if (state == dio_READ_REJECTED)
+        // parser has found a broken packet, stop reception of the rest
+        status = handle->rx_parser_result == dpr_WRONG_CHECKSUM ?
+            dio_WRONG_CHECKSUM : dio_WRONG_FRAMING;
+    else if (state != dio_READ_COMPLETED)
+        status = dio_WRONG_NOTIFICATION;
+    else
+        // verify the response and find received data
+        return check_response(handle, request, response);
+    // status packets of a multi-response request completed before the failure
+    // (known only with streaming reception) are passed to the caller
+    if (request->n_responses > 1 && handle->rx_offset > 0) {
+        response->status_packet = (DynamixelPacket *) handle->rx_data;
+        response->data = handle->rx_data;
+        response->data_len = handle->rx_offset;
+    }
+    handle->uart.reset(handle->uart.context);
+    return status;
+}
+
+static void init_response_parser(DynamixelIOTaskHandle *handle)
+{
+    // packet may have any capacity, but it must fit the rest of expected response
+    uint8_t *start = handle->rx_data + handle->rx_offset;
+    int remaining = handle->rx_size - handle->rx_offset;
+    if (handle->protocol == dio_PROTOCOL_2)
+        dynamixel2_packet_parser_init(&handle->rx_parser2, (Dynamixel2Packet *) start,
+                remaining - DYNAMIXEL2_PACKET_BASE_SIZE - 2);
+    else
+        dynamixel_packet_parser_init_sized(&handle->rx_parser, (DynamixelPacket *) start,
+                remaining - DYNAMIXEL_PACKET_BASE_SIZE - 1);
+}
+
+static DynamixelParserResult feed_response_parser(DynamixelIOTaskHandle *handle,
+        const uint8_t *data, int data_len, int *n_consumed)
+{
+    if (handle->protocol == dio_PROTOCOL_2)
+        return dynamixel2_packet_parser_feed(&handle->rx_parser2, data, data_len, n_consumed);
+    return dynamixel_packet_parser_feed(&handle->rx_parser, data, data_len, n_consumed);
+}
+
+static int parsed_packet_size(DynamixelIOTaskHandle *handle)
+{
+    if (handle->protocol == dio_PROTOCOL_2)
+        return dynamixel2_packet_size(handle->rx_parser2.packet);
+    return dynamixel_packet_size(handle->rx_parser.packet);
+}
+
+// number of bytes of the response stored as received (after the reception has ended):
+// with streaming reception the status packets before the last one and the part of the last
+// one stored by the parser (Protocol 2.0: only whole ones, the parser stores them unstuffed),
+// otherwise (exact reads) the whole response if it has arrived
+static int received_size(DynamixelIOTaskHandle *handle, DynamixelIORequest *request,
+        DynamixelIOStatus status)
+{
+    if (!handle->rx_data_seen) {
+        bool received = status == dio_OK || status == dio_WRONG_CHECKSUM || status == dio_WRONG_FRAMING;
+        return received && request->response_size > 0 ? request->response_size : 0;
+    }
+    int size = handle->rx_offset;
+    DynamixelParserResult result = handle->rx_parser_result;
+    if (result == dpr_PACKET_READY || result == dpr_WRONG_CHECKSUM) {
+        size += parsed_packet_size(handle);
+    } else if (handle->protocol == dio_PROTOCOL_1) {
+        DynamixelPacketParser *parser = &handle->rx_parser;
+        if (result == dpr_WRONG_LENGTH)
+            // start bytes, id and the rejected length
+            size += DYNAMIXEL_PACKET_BASE_SIZE - 1;
+        else if (parser->state == dps_LENGTH)
+            size += DYNAMIXEL_PACKET_BASE_SIZE - 2;
+        else if (parser->state == dps_BODY)
+            size += DYNAMIXEL_PACKET_BASE_SIZE - 1 + parser->n_body_received;
+    }
+    return size < request->response_size ? size : request->response_size;
+}
+
+static DynamixelIOStatus check_status_packet(DynamixelIOTaskHandle *handle,
+        uint8_t *data, int data_len, bool is_parsed, int *size)
+{
+    if (handle->protocol == dio_PROTOCOL_2) {
+        Dynamixel2Packet *packet = (Dynamixel2Packet *) data;
+        if (data_len < DYNAMIXEL2_PACKET_BASE_SIZE + 2)
+            return dio_WRONG_FRAMING;
+        *size = dynamixel2_packet_size(packet);
+        if (!is_parsed) {
+            if (*size > data_len)
+                return dio_WRONG_FRAMING;
+            if (!dynamixel2_packet_decode(packet, *size))
+                return dio_WRONG_CHECKSUM;
+            // parser may have received stuffed packet, but without it we can only
+            // read the expected number of bytes, so unstuffed packet is incomplete
+            if (dynamixel2_packet_size(packet) != *size)
+                return dio_WRONG_FRAMING;
+        }
+        return dio_OK;
+    }
+
+    DynamixelPacket *packet = (DynamixelPacket *) data;
+    if (data_len < DYNAMIXEL_PACKET_BASE_SIZE + 1)
+        return dio_WRONG_FRAMING;
+    *size = dynamixel_packet_size(packet);
+    if (*size > data_len)
+        return dio_WRONG_FRAMING;
+    if (!is_parsed && !dynamixel_packet_checksum_isok(packet))
+        return dio_WRONG_CHECKSUM;
+    return dio_OK;
+}
+
+static DynamixelIOStatus check_response(DynamixelIOTaskHandle *handle,
+        DynamixelIORequest *request, DynamixelIOResponse *response)
+{
+    // parser has already verified the packets if it has been used
+    bool is_parsed = handle->rx_parser_result == dpr_PACKET_READY;
+
+    // status packets are stored one after another
+    uint8_t *data = response_data(handle, request);
+    int offset = 0;
+    for (int i = 0; i < request->n_responses; i++) {
+        int size;
+        DynamixelIOStatus status = check_status_packet(handle, &data[offset],
+                request->response_size - offset, is_parsed, &size);
+        if (status != dio_OK)
+            return status;
+        offset += size;
+    }
+    // servos may respond with different amount of data than expected
+    if (offset != request->response_size)
+        return dio_WRONG_FRAMING;
+
+    response->status_packet = (DynamixelPacket *) data;
+    if (request->n_responses > 1) {
+        response->data = data;
+        response->data_len = offset;
+    } else if (handle->protocol == dio_PROTOCOL_2) {
+        Dynamixel2Packet *packet = (Dynamixel2Packet *) data;
+        response->data = dynamixel2_packet_status_data(packet);
+        response->data_len = dynamixel2_packet_status_data_len(packet);
+    } else {
+        DynamixelPacket *packet = (DynamixelPacket *) data;
+        response->data = packet->parameters_with_checksum;
+        response->data_len = dynamixel_packet_n_parameters(packet);
+    }
+    return dio_OK;
+}
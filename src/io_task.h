@@ -6,6 +6,8 @@ extern "C" {
 
 /*
  * Implementation of IO communication with Dynamixel servos using FreeRTOS.
+ * On a host it can be used with POSIX threads instead (see posix/FreeRTOS.h)
+ * and a termios serial port driver (posix/serial_port.h).
  *
  * Communication is generic, and a peripheral driver functions must be provided.
  * Dynamixel servos use half-duplex UART and many servos can be connected to
@@ -21,18 +23,129 @@ extern "C" {
  *    in transfer completion interrupt.
  * 1. Initialize DynamixelIOTaskHandle structure using dynamixel_io_task_create(),
  *    this also creates FreeRTOS task and queues.
- * 2. Create and fill DynamixelPacket, then send request to request_queue:
+ * 2. Create and fill DynamixelPacket, then send request to the request queues:
  *       dynamixel_io_send_request(...)
  * 3. (!) If request.ignore_response == false, create DynamixelIOResponse and wait:
  *       dynamixel_io_wait_response(...)
  *    or else the task will fill up response queue and hang until it is cleared!
+ *
+ * The shared response_queue can be used only by one caller at a time (otherwise
+ * a caller could receive a response to a request of another one). If many tasks use
+ * the same IO task, each should have its own DynamixelIOCompletion and send requests
+ * with dynamixel_io_send_request_to() (or dynamixel_io_submit()), responses are then
+ * put into the queue of the completion. With the request queue longer than 1,
+ * requests of all the callers wait in it, so the IO task starts the next transfer
+ * right after the previous one; a caller may also have many outstanding requests,
+ * their responses come in the same order.
+ *
+ * Waiting for the completion is not the only way to get the response. A completion
+ * created with dynamixel_io_completion_create_callback() has no queue, its callback
+ * is called by the IO task with each response (it must be short and must not block,
+ * like an interrupt handler, it delays the next transaction; it owns the buffer of the
+ * response, see DynamixelIOCallback). A DynamixelIOFuture
+ * holds the response to one request, it can be polled without blocking
+ * (dynamixel_io_future_poll()) or waited for, so the caller can prepare the next
+ * cycle while the bus is busy. C++20 coroutines can co_await transactions on many
+ * IO tasks from one thread (io_coroutine.h).
+ *
+ * Some instructions (bulk read, Protocol 2.0 sync read) make many servos respond,
+ * each with its own status packet. Such requests are sent with
+ * dynamixel_io_send_multi_request() and all the status packets are received
+ * one after another into the request packet (or a buffer of the rx pool), so its
+ * storage must fit all of them.
+ * When one of them is missing or broken, the response has the status of the failure and
+ * (with streaming reception) the status packets received before it.
+ *
+ * Many independent transactions (e.g. reads of each servo of a group) can be sent
+ * as one batch request with dynamixel_io_send_request_batch(): the task runs them
+ * back to back and the caller gets one response with the result of each of them,
+ * instead of two queue operations (and task switches) per transaction.
+ *
+ * Requests have priority classes (DynamixelIORequest.priority, e.g. set for
+ * dynamixel_io_submit()), each class has its own queue: waiting control requests
+ * (e.g. sync write of goal positions, torque off) are always sent before normal ones
+ * and those before background ones (e.g. reads of temperatures), requests of the same
+ * class are sent in order. A request may also have a deadline (max_queue_wait),
+ * if it waits in the queue longer, it is not sent at all and its response has status
+ * dio_DEADLINE_EXPIRED (a late goal position is worse than none). How long requests
+ * of each class wait is measured, see dynamixel_io_task_get_queue_stats().
+ *
+ * The task also counts transactions, bytes, statuses and time the bus is busy, and keeps
+ * histograms of queue wait and wire time (from the start of transmission to the end
+ * of reception) of reads, writes and pings. All of them are read at once, without
+ * stopping the task, with dynamixel_io_task_get_metrics() (the task only writes them,
+ * readers retry if an update was in progress, like a seqlock).
+ *
+ * To see where the time of each transaction goes (queue wait, transmission, return
+ * delay of the servo, reception, wakeup of the task), its events can be recorded
+ * with timestamps into a ring buffer given to dynamixel_io_task_set_trace() (see
+ * io_trace.h). Without the buffer each event costs only a test of a pointer.
+ *
+ * Setpoints (e.g. goal positions) that wait in the queue are outdated by the next ones.
+ * In coalescing mode (dynamixel_io_task_set_coalescing()) writes sent with
+ * dynamixel_io_write_coalesced() replace the data of a pending write to the same
+ * (id, address, length) and sync writes sent with dynamixel_io_sync_write_coalesced()
+ * are merged into a pending sync write of the same register block, keeping its place
+ * in the queue, so a bus that has fallen behind sends only the newest values.
+ * Such writes are sent without waiting for their responses.
+ *
+ * Responses are received into the request packet by default, so it has to be prepared
+ * again before it is resent. With a pool of receive buffers (dynamixel_io_task_set_rx_pool())
+ * each response that fits is received into a free buffer instead, the request packet
+ * is not modified at all (it can be prepared once and sent in every cycle). The buffer
+ * belongs to the caller with the response (DynamixelIOResponse.buffer) until it is given
+ * back with dynamixel_io_release_response(); when there is no free buffer the task waits
+ * for one (like for space in the response queue), except for items of a batch request,
+ * which are then received into their packets.
+ *
+ * Receiving can be done in one of two ways:
+ *  - uart_read_handle receives exactly data_len bytes into data and then
+ *    dynamixel_io_task_notify_transmission_complete() is called,
+ *  - uart_read_handle only starts reception, and every received chunk of data
+ *    is passed to dynamixel_io_task_notify_bytes_received() (e.g. from DMA
+ *    half/full-transfer or idle line interrupts); the response is parsed
+ *    on the fly and the task is notified as soon as the whole packet has
+ *    been received or a framing error has been detected, so a broken
+ *    response does not have to wait for the timeout.
+ *
+ * Timeouts are measured in RTOS ticks, so with 1ms tick a missing servo is detected
+ * after 1-2ms even if its response would take 100us. Optionally a timer with
+ * microsecond resolution (e.g. a hardware timer, posix/io_timer.h on a host) can be set
+ * with dynamixel_io_task_set_timer(), then the timeouts are measured by it (ticks are
+ * still used as a fallback). With streaming reception, separate first byte and
+ * inter-byte timeouts can be used instead of the timeout for the whole response.
+ *
+ * The timeouts have to allow for the slowest servo (longest Return Delay Time).
+ * If the timer can also tell the time, the task can learn how long each servo takes
+ * to respond (dynamixel_io_task_set_adaptive_timeouts()): time from the end
+ * of transmission to the first received data is smoothed like round-trip time in TCP
+ * (RFC 6298) and the first byte timeout of a servo is its smoothed latency plus four
+ * times its mean deviation, within given bounds, so a servo that stops responding
+ * is detected after a fraction of the static timeout. Each timeout without any data
+ * doubles the timeout of the servo until it responds again.
+ *
+ * Normally the task is woken when transmission ends, starts reception and is woken
+ * again with the response. With dynamixel_io_task_set_chained_reception() reception
+ * is started by dynamixel_io_task_notify_transmission_complete() itself (so uart read
+ * function must be safe to call from the transmission complete interrupt) and the task
+ * is woken only once, which shortens the turnaround and saves a context switch.
+ *
+ * All the traffic (sent packets, received bytes and status of each transaction) can be
+ * captured into a lock-free ring with dynamixel_io_task_set_capture() (io_capture.h),
+ * it is never blocked by the consumer of the ring (records are dropped instead).
  */
 
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
+#include "semphr.h"
 
 #include "dynamixel.h"
+#include "packet_parser.h"
+#include "protocol2.h"
+#include "packet_batch.h"
+#include "io_trace.h"
+#include "io_capture.h"
 
 /*
  * UART communication function signatures that have to be implemented by user.
@@ -49,10 +162,161 @@ typedef int (*HalfDuplexUARTNonBlockingWrite)(uint8_t *data, size_t data_len);
 typedef int (*HalfDuplexUARTNonBlockingRead)(uint8_t *data, size_t data_len);
 typedef int (*HalfDuplexUARTReset)(void);
 
+/*
+ * The same functions, but with a context pointer (e.g. a driver handling many UARTs,
+ * like the termios one in posix/serial_port.h), used with dynamixel_io_task_create_with_driver().
+ */
+typedef struct {
+    int (*write)(void *context, uint8_t *data, size_t data_len);
+    int (*read)(void *context, uint8_t *data, size_t data_len);
+    int (*reset)(void *context);
+    void *context;
+} DynamixelIOUARTDriver;
+
+
+/*
+ * One-shot timer with microsecond resolution. start() (re)arms it, it is also called
+ * from dynamixel_io_task_notify_bytes_received() (so it must be safe to call from
+ * interrupt), stop() disarms it so that it does not expire after returning.
+ * On expiry dynamixel_io_task_notify_timeout() must be called.
+ */
+typedef struct {
+    void (*start)(void *context, uint32_t timeout_us);
+    void (*stop)(void *context);
+    void *context;
+    // optional, free running time in microseconds (may wrap), also called from
+    // dynamixel_io_task_notify_bytes_received(); needed for adaptive timeouts
+    uint32_t (*now)(void *context);
+} DynamixelIOTimer;
+
+// response latency of one servo (see dynamixel_io_task_set_adaptive_timeouts())
+typedef struct {
+    uint32_t latency_us;      // smoothed time to the first data of response
+    uint32_t deviation_us;    // smoothed mean deviation of the latency
+    uint16_t n_samples;
+    uint8_t n_timeouts;       // timeouts since the last response
+} DynamixelIOLatencyEstimate;
+
+// learned timeouts are used for servos with at least this many samples
+#ifndef DYNAMIXEL_IO_ADAPTIVE_MIN_SAMPLES
+#   define DYNAMIXEL_IO_ADAPTIVE_MIN_SAMPLES   4
+#endif
+
+/*
+ * Receive buffers (see dynamixel_io_task_set_rx_pool()), storage of n_buffers * buffer_size
+ * bytes is given by the user (e.g. statically allocated).
+ */
+typedef struct {
+    uint8_t *storage;
+    int buffer_size;          // bytes of each buffer (of all status packets of a response)
+    int n_buffers;
+    QueueHandle_t free_buffers; // pointers to buffers not owned by any response
+} DynamixelIORxPool;
+
+struct DynamixelIOResponse;
+
+// called by the IO task with a response (valid only during the call), the callback owns
+// its buffer of the rx pool (if any): gives it back with dynamixel_io_release_response()
+// or keeps it with a copy of the response to give it back later
+typedef void (*DynamixelIOCallback)(struct DynamixelIOResponse *response, void *context);
+
+/*
+ * Per-caller destination of responses (see the usage above).
+ */
+typedef struct {
+    QueueHandle_t queue;      // NULL for a callback
+    DynamixelIOCallback callback;
+    void *callback_context;
+} DynamixelIOCompletion;
+
+typedef enum {
+    dio_PROTOCOL_1 = 1,       // DynamixelPacket (packet.h), default
+    dio_PROTOCOL_2 = 2,       // Dynamixel2Packet (protocol2.h)
+} DynamixelIOProtocol;
+
+// maximum data of a coalesced write (of all servos for a sync write)
+#ifndef DYNAMIXEL_IO_COALESCED_MAX_DATA
+#   define DYNAMIXEL_IO_COALESCED_MAX_DATA   64
+#endif
+
+// write waiting in the queue in coalescing mode (see dynamixel_io_task_set_coalescing())
+typedef struct {
+    bool pending;             // queued, not yet taken by the task
+    bool sync;                // sync write, otherwise write to one servo
+    uint8_t id;               // servo of a write
+    uint8_t address;
+    uint8_t data_len;         // for each servo of a sync write
+    uint8_t n_servos;         // of a sync write
+    uint8_t data[DYNAMIXEL_IO_COALESCED_MAX_DATA]; // for a sync write like in dynamixel_prepare_sync_write()
+} DynamixelIOCoalescedWrite;
+
+typedef enum {
+    dio_PRIORITY_NORMAL = 0,  // default (of zero initialised requests)
+    dio_PRIORITY_CONTROL,     // sent before any other waiting request
+    dio_PRIORITY_BACKGROUND,  // sent only when no other request waits
+    dio_N_PRIORITIES
+} DynamixelIOPriority;
+
+// how long requests of one priority class have waited in the queue (in ticks)
+typedef struct {
+    uint32_t n_requests;      // number of requests taken by the task (including expired)
+    uint32_t n_expired;       // requests dropped because of their deadline
+    uint32_t n_coalesced;     // writes merged into pending ones (not sent separately)
+    TickType_t max_wait;
+    uint64_t total_wait;      // average is total_wait / n_requests
+} DynamixelIOQueueStats;
+
+typedef enum {
+    dio_OK = 0,
+    dio_UART_WRITE_ERROR,     // error returned by uart_write_handle
+    dio_UART_READ_ERROR,      // error returned by uart_read_handle
+    dio_UART_WRITE_TIMEOUT,   // task not notified for more than maximum wait time
+    dio_UART_READ_TIMEOUT,    // task not notified for more than maximum wait time
+    dio_WRONG_NOTIFICATION,   // received notification from wrong transmission type
+    dio_WRONG_CHECKSUM,       // received response, but checksum is wrong
+    dio_WRONG_FRAMING,        // received response has wrong length
+    dio_DEADLINE_EXPIRED,     // request has waited longer than its max_queue_wait, not sent
+    dio_UNDEFINED,            // should never happen
+} DynamixelIOStatus;
+
+// histogram bucket i counts values below (16 << i) microseconds (the last one all the rest)
+#ifndef DYNAMIXEL_IO_HISTOGRAM_N_BUCKETS
+#   define DYNAMIXEL_IO_HISTOGRAM_N_BUCKETS   16
+#endif
+
+typedef struct {
+    uint32_t counts[DYNAMIXEL_IO_HISTOGRAM_N_BUCKETS];
+} DynamixelIOHistogram;
+
+// transactions are classified by instruction of the request packet
+typedef enum {
+    dio_KIND_PING = 0,
+    dio_KIND_READ,            // also bulk read and sync read
+    dio_KIND_WRITE,           // also reg write, action, sync and bulk write
+    dio_KIND_OTHER,           // e.g. reset, reboot
+    dio_N_KINDS
+} DynamixelIOTransactionKind;
+
+/*
+ * Counters of the task (see dynamixel_io_task_get_metrics()), all of them wrap around
+ * (times in microseconds after ~71 minutes), so rates should be computed from differences
+ * of two snapshots, e.g. bus load = d(busy_us) / d(time_us).
+ */
+typedef struct {
+    uint32_t n_transactions;  // sent (each item of a batch request is one)
+    uint32_t tx_bytes;        // sent to the bus
+    uint32_t rx_bytes;        // of received responses (with dio_OK)
+    uint32_t n_status[dio_UNDEFINED + 1]; // of transactions and expired requests
+    uint32_t busy_us;         // sum of wire times
+    uint32_t time_us;         // when the snapshot was taken (the same clock)
+    DynamixelIOHistogram queue_wait[dio_N_KINDS];  // of requests (by their first packet)
+    DynamixelIOHistogram wire_time[dio_N_KINDS];   // of transactions
+} DynamixelIOMetrics;
 
 typedef enum {
     dio_WRITE_COMPLETED,
     dio_READ_COMPLETED,
+    dio_READ_REJECTED,        // received data has been rejected by the response parser
     dio_NOT_COMPLETED
 } DynamixelIOTransmissionState;
 
@@ -66,47 +330,135 @@ typedef enum {
 typedef struct {
     // Handles
     TaskHandle_t task_handle;
-    QueueHandle_t request_queue;
+    QueueHandle_t request_queues[dio_N_PRIORITIES]; // one for each priority class
+    SemaphoreHandle_t n_requests;    // counts requests in all the queues
     QueueHandle_t response_queue;
     // Task cofiguration
     HalfDuplexUARTNonBlockingWrite uart_write_handle;
     HalfDuplexUARTNonBlockingRead uart_read_handle;
     HalfDuplexUARTReset uart_reset_handle;
+    DynamixelIOUARTDriver uart;      // used by the task (wraps the handles above if they are used)
     // timing constraints: per byte and read delay (servo waits before sending response)
     // FIXME: reading seems to require much more time (needed overall 3ms for 8 bytes at BR=57600b/s)
     uint32_t max_wait_per_byte_us;   // usually =~ ( 1 / (baud_rate / (8+1)) ) * 10^6
     uint32_t max_wait_read_delay_us; // depends on dynamixel Return Delay Time (default 500us)
+    // protocol of all the packets sent through this task (see dynamixel_io_task_set_protocol())
+    DynamixelIOProtocol protocol;
+    // optional timeouts with microsecond resolution (see dynamixel_io_task_set_timer())
+    DynamixelIOTimer timer;          // start == NULL if not used
+    uint32_t first_byte_timeout_us;  // from the start of reception (or the end of a status packet)
+    uint32_t inter_byte_timeout_us;  // from the last received chunk of data
+    bool timeout_expired;
+    uint32_t timeout_expired_us;     // time of the expiry (traced by the task)
+    uint32_t rx_timeout_us;          // timeout of the current reception (until the first data)
+    uint32_t rx_armed_timeout_us;    // the last one armed (see dynamixel_io_task_get_rx_timeout_us())
+    // adaptive timeouts (see dynamixel_io_task_set_adaptive_timeouts())
+    DynamixelIOLatencyEstimate *latency; // indexed by servo id, NULL if not used
+    int n_latency_ids;
+    uint32_t adaptive_floor_us;
+    uint32_t adaptive_ceiling_us;
+    uint32_t tx_end_us;              // time when transmission has ended
+    uint32_t rx_first_data_us;       // time of the first received data
+    bool rx_data_seen;
+    // reception started from write completion (see dynamixel_io_task_set_chained_reception())
+    bool chain_reception;
+    bool rx_chain_pending;    // write completion should start reception
+    bool rx_chain_started;    // reception has been started by write completion
+    // queue wait of each priority class (see dynamixel_io_task_get_queue_stats())
+    DynamixelIOQueueStats queue_stats[dio_N_PRIORITIES];
+    // written only by the task, odd metrics_sequence while they are being updated
+    // (see dynamixel_io_task_get_metrics())
+    DynamixelIOMetrics metrics;
+    uint32_t metrics_sequence;
+    // receive buffers (see dynamixel_io_task_set_rx_pool()), NULL to receive into packets
+    DynamixelIORxPool *rx_pool;
+    uint8_t *rx_buffer;              // buffer of the current transaction, NULL for the packet
+    // ring of trace events (see dynamixel_io_task_set_trace()), NULL if not used
+    DynamixelIOTraceEvent *trace;
+    uint32_t trace_size;
+    uint32_t trace_n_recorded;       // since the ring was set, the latest ones are kept
+    uint32_t trace_next_request;     // number of the next submitted request
+    uint32_t trace_request;          // number of the request handled by the task
+    // ring for captured traffic (see dynamixel_io_task_set_capture()), NULL if not used
+    DynamixelIOCaptureRing *capture;
+    // pending writes in coalescing mode (see dynamixel_io_task_set_coalescing())
+    DynamixelIOCoalescedWrite *coalesced;
+    int n_coalesced_slots;
+    // coalesced write taken by the task is sent from here
+    union {
+        DynamixelPacket coalesced_packet;
+        uint8_t coalesced_storage[DYNAMIXEL_PACKET_STORAGE_SIZE(DYNAMIXEL_IO_COALESCED_MAX_DATA + 2)];
+    };
     // internal variable for verifying proper task notification
     DynamixelIOTransmissionState transmission_state;
+    // internal variables for parsing data from dynamixel_io_task_notify_bytes_received()
+    union {
+        DynamixelPacketParser rx_parser;
+        Dynamixel2PacketParser rx_parser2;
+    };
+    DynamixelParserResult rx_parser_result;
+    bool rx_parser_armed;
+    uint8_t *rx_data;         // start of the buffer for (all) status packets
+    int rx_size;              // expected size of all status packets
+    int rx_offset;            // where the packet being parsed starts
+    int rx_n_pending;         // number of status packets not yet received
 } DynamixelIOTaskHandle;
 
-typedef enum {
-    dio_OK = 0,
-    dio_UART_WRITE_ERROR,     // error returned by uart_write_handle
-    dio_UART_READ_ERROR,      // error returned by uart_read_handle
-    dio_UART_WRITE_TIMEOUT,   // task not notified for more than maximum wait time
-    dio_UART_READ_TIMEOUT,    // task not notified for more than maximum wait time
-    dio_WRONG_NOTIFICATION,   // received notification from wrong transmission type
-    dio_WRONG_CHECKSUM,       // received response, but checksum is wrong
-    dio_UNDEFINED,            // should never happen
-} DynamixelIOStatus;
-
 typedef struct {
-    DynamixelPacket *packet;  // pointer to already created packet
+    DynamixelPacket *packet;  // pointer to already created packet (of any capacity,
+                              // without an rx pool the response is written into it,
+                              // so it must fit)
+    int tx_size;              // number of bytes to send (e.g. for batches), 0 for packet size
     int response_size;        // expected size of response (0 for no response)
+    int n_responses;          // number of status packets that make the response (usually 1)
     bool ignore_response;     // if true, than no DynamixelIOResponse will be sent,
                               // useful when task does not want to wait for response_queue
+    DynamixelIOCompletion *completion; // where the response is sent, NULL for response_queue
+    struct DynamixelIOBatchItem *items; // transactions of a batch request (then packet is NULL)
+    int n_items;
+    DynamixelIOPriority priority; // dio_PRIORITY_NORMAL by default
+    TickType_t max_queue_wait;    // deadline (since submitting), 0 for none
+    TickType_t queued_at;         // set when the request is submitted
+    DynamixelIOCoalescedWrite *coalesced; // data of the packet (then packet is NULL)
+    uint32_t trace_request;       // set when the request is submitted (while tracing)
 } DynamixelIORequest;
 
-typedef struct {
-    DynamixelIOStatus status; // status of communication, data is valid only for dio_OK
-    uint8_t *data;            // points to received data
-                              // (start of request.packet.parameters_with_checksum)
-    int data_len;             // length of data
+typedef struct DynamixelIOResponse {
+    DynamixelIOStatus status; // status of communication, data is valid only for dio_OK (or
+                              // status packets received before a failure of a multi-response
+                              // request, with streaming reception, data_len > 0)
+    uint8_t *data;            // points to received data (start of request.packet.parameters_with_checksum,
+                              // for Protocol 2.0 the first byte after error), for multiple status
+                              // packets points to the first of them (see dynamixel_status_packets_next())
+    int data_len;             // length of data (of all status packets)
+    DynamixelPacket *packet;  // packet of the request (tells which one, if many are outstanding)
+    struct DynamixelIOBatchItem *items; // items of a batch request (with their results)
+    int n_items;
+    DynamixelPacket *status_packet; // the (first) received status packet, for dio_OK or data_len > 0
+                              // (Dynamixel2Packet for Protocol 2.0), in buffer or in packet
+    uint8_t *buffer;          // buffer of the rx pool with the data, owned by the caller until
+                              // dynamixel_io_release_response(), NULL if received into packet
 } DynamixelIOResponse;
 
+// one transaction of a batch request, like a request sent with dynamixel_io_send_request()
+typedef struct DynamixelIOBatchItem {
+    DynamixelPacket *packet;  // the response is received into it (if there is no free buffer
+                              // of the rx pool), so it must fit
+    int response_size;        // expected size of response (0 for no response)
+    DynamixelIOResponse response; // result, filled by the task
+} DynamixelIOBatchItem;
+
+// response to one request, to be polled or waited for (see the usage above)
+typedef struct {
+    DynamixelIOCompletion completion;
+    DynamixelIOResponse response; // valid when the future is ready
+    bool pending;             // sent, the response has not been taken yet
+} DynamixelIOFuture;
+
 
 void dynamixel_io_task(void *arguments);
+// queues_length is the number of requests that can wait for the task
+// (and of responses in the shared response_queue)
 void dynamixel_io_task_create(DynamixelIOTaskHandle *handle,
         const char * const task_name,
         UBaseType_t task_priority,
@@ -116,14 +468,153 @@ void dynamixel_io_task_create(DynamixelIOTaskHandle *handle,
         HalfDuplexUARTReset uart_reset_handle,
         uint32_t max_wait_per_byte_us,
         uint32_t max_wait_read_delay_us);
+// the same, but with UART driver functions that take context
+void dynamixel_io_task_create_with_driver(DynamixelIOTaskHandle *handle,
+        const char * const task_name,
+        UBaseType_t task_priority,
+        UBaseType_t queues_length,
+        DynamixelIOUARTDriver uart_driver,
+        uint32_t max_wait_per_byte_us,
+        uint32_t max_wait_read_delay_us);
 void dynamixel_io_task_notify_transmission_complete(DynamixelIOTaskHandle *dio_task_handle,
         DynamixelIOTransmissionState state);
+// to be called from interrupt with each chunk of received data (streaming reception),
+// data received when the task does not wait for a response is ignored
+void dynamixel_io_task_notify_bytes_received(DynamixelIOTaskHandle *dio_task_handle,
+        const uint8_t *data, size_t data_len);
+// sets the timer used for timeouts (timer.start == NULL to use only ticks), first byte and
+// inter-byte timeouts (both must be given, only for streaming reception) or 0 to wait
+// for the whole response as long as with ticks; should be called before sending requests
+void dynamixel_io_task_set_timer(DynamixelIOTaskHandle *handle, DynamixelIOTimer timer,
+        uint32_t first_byte_timeout_us, uint32_t inter_byte_timeout_us);
+// learns response latency of servos with ids below n_ids (estimates must have n_ids
+// elements), their timeouts until the first data are derived from it and bounded by
+// floor_us and ceiling_us; requires the timer with now() and streaming reception
+// (notify_bytes_received), applies to requests with one status packet; estimates == NULL
+// disables it; should be called before sending requests
+void dynamixel_io_task_set_adaptive_timeouts(DynamixelIOTaskHandle *handle,
+        DynamixelIOLatencyEstimate *estimates, int n_ids, uint32_t floor_us, uint32_t ceiling_us);
+// copy of the estimate of the servo, false if it is not learned
+bool dynamixel_io_task_get_latency_estimate(DynamixelIOTaskHandle *handle, uint8_t id,
+        DynamixelIOLatencyEstimate *estimate);
+// timeout of the reception in progress as armed by the task: for the whole response
+// (in ticks or by the timer), until the first data or the learned one; with inter-byte
+// timeouts (rearmed, may be NULL) it is armed again by each data received, so it counts
+// from the last data, otherwise from the start of reception; for drivers that model
+// time of the bus (posix/virtual_bus.h)
+uint32_t dynamixel_io_task_get_rx_timeout_us(DynamixelIOTaskHandle *handle, bool *rearmed);
+// to be called from the timer interrupt when it expires
+void dynamixel_io_task_notify_timeout(DynamixelIOTaskHandle *dio_task_handle);
+// if true, reception is started from dynamixel_io_task_notify_transmission_complete(),
+// should be called before sending requests
+void dynamixel_io_task_set_chained_reception(DynamixelIOTaskHandle *handle, bool chained);
+// changes protocol of the packets handled by the task (Protocol 1.0 by default),
+// should be called after dynamixel_io_task_create() before sending any requests
+void dynamixel_io_task_set_protocol(DynamixelIOTaskHandle *handle,
+        DynamixelIOProtocol protocol);
 // wrappers around xQueueSendToBack/xQueueReceive; return false on queue timeout
 bool dynamixel_io_send_request(DynamixelIOTaskHandle *task_handle,
         DynamixelPacket *packet, int response_size, bool ignore_response);
+// the same for Protocol 2.0 packets (the task must be configured for dio_PROTOCOL_2),
+// response data is unstuffed, error can be read with dynamixel2_packet_error(packet)
+bool dynamixel2_io_send_request(DynamixelIOTaskHandle *task_handle,
+        Dynamixel2Packet *packet, int response_size, bool ignore_response);
+// for requests that result in n_responses status packets (of total size response_size),
+// packet can be either DynamixelPacket or Dynamixel2Packet (casted), depending on protocol
+bool dynamixel_io_send_multi_request(DynamixelIOTaskHandle *task_handle,
+        DynamixelPacket *packet, int response_size, int n_responses, bool ignore_response);
+// sends all packets from the batch with one UART transfer,
+// the response (to the last packet) is received into the batch buffer
+bool dynamixel_io_send_batch(DynamixelIOTaskHandle *task_handle,
+        DynamixelPacketBatch *batch, bool ignore_response);
 bool dynamixel_io_wait_response(DynamixelIOTaskHandle *task_handle,
         DynamixelIOResponse *response);
 
+// max_outstanding is the number of requests sent with the completion that may wait
+// for their responses at once (the IO task blocks if more responses are not received)
+bool dynamixel_io_completion_create(DynamixelIOCompletion *completion, UBaseType_t max_outstanding);
+// the callback is called by the IO task instead of queueing responses (with any number
+// of outstanding requests)
+void dynamixel_io_completion_create_callback(DynamixelIOCompletion *completion,
+        DynamixelIOCallback callback, void *context);
+void dynamixel_io_completion_delete(DynamixelIOCompletion *completion);
+// like dynamixel_io_send_request(), but the response is sent to the completion
+bool dynamixel_io_send_request_to(DynamixelIOTaskHandle *task_handle,
+        DynamixelPacket *packet, int response_size, DynamixelIOCompletion *completion);
+// sends all transactions with one request, the task runs them back to back (each one
+// also after errors of the previous ones) and fills their responses; then it sends one
+// response (to the completion or response_queue if NULL) with status dio_OK if all
+// of them are ok, otherwise with status of the first failed one
+bool dynamixel_io_send_request_batch(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOBatchItem *items, int n_items, DynamixelIOCompletion *completion);
+// sends a request filled by the caller (any of the above, e.g. multi request with completion)
+bool dynamixel_io_submit(DynamixelIOTaskHandle *task_handle, const DynamixelIORequest *request);
+// slots for pending writes of the coalescing mode (one for each write that can wait
+// in the queues at once) or NULL to disable it; should be called when no coalesced
+// writes are pending, only for Protocol 1.0
+void dynamixel_io_task_set_coalescing(DynamixelIOTaskHandle *handle,
+        DynamixelIOCoalescedWrite *slots, int n_slots);
+// writes data to the servo, or replaces data of the same write if it is still pending
+// (then the write keeps its place and priority); without response, returns false
+// if data is too long or there is no free slot
+bool dynamixel_io_write_coalesced(DynamixelIOTaskHandle *task_handle, uint8_t id,
+        uint8_t address, const uint8_t *data, int data_len, DynamixelIOPriority priority);
+// the same for a sync write (data like in dynamixel_prepare_sync_write()), merged
+// into a pending sync write of the same address and data length if all servos fit
+bool dynamixel_io_sync_write_coalesced(DynamixelIOTaskHandle *task_handle, uint8_t address,
+        const uint8_t *data, int n_servos, int data_len_for_each, DynamixelIOPriority priority);
+// statistics of the queue of the given priority class (copy, consistent)
+void dynamixel_io_task_get_queue_stats(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOPriority priority, DynamixelIOQueueStats *stats);
+void dynamixel_io_task_reset_queue_stats(DynamixelIOTaskHandle *task_handle);
+// consistent snapshot of all the counters of the task (see DynamixelIOMetrics),
+// waits (a tick at a time) only if the task is just updating them
+void dynamixel_io_task_get_metrics(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOMetrics *metrics);
+// index of the histogram bucket of the value
+int dynamixel_io_histogram_bucket(uint32_t value_us);
+// starts recording trace events into the ring of n_events (the oldest ones are overwritten),
+// events == NULL stops it; may be called at any time
+void dynamixel_io_task_set_trace(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOTraceEvent *events, int n_events);
+// copies up to max_events of the latest recorded events, the oldest first, returns their
+// number; the recording is paused while copying (in a critical section)
+int dynamixel_io_task_read_trace(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOTraceEvent *events, int max_events);
+// captures each transaction into the ring (io_capture.h, read by its consumer),
+// NULL to stop capturing; the ring must not be reinitialised while it is used
+void dynamixel_io_task_set_capture(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOCaptureRing *ring);
+// storage must have n_buffers * buffer_size bytes, returns false if the queue of free
+// buffers cannot be created
+bool dynamixel_io_rx_pool_create(DynamixelIORxPool *pool, uint8_t *storage,
+        int buffer_size, int n_buffers);
+void dynamixel_io_rx_pool_delete(DynamixelIORxPool *pool);
+// responses (that fit) are received into buffers of the pool, NULL to receive them into
+// request packets; should be called when no requests are pending
+void dynamixel_io_task_set_rx_pool(DynamixelIOTaskHandle *handle, DynamixelIORxPool *pool);
+// gives back the buffer of the response (and of the items of a batch response),
+// nothing if it has none; the data must not be used after that
+void dynamixel_io_release_response(DynamixelIOTaskHandle *task_handle,
+        DynamixelIOResponse *response);
+// waits for the next response to requests sent with the completion
+bool dynamixel_io_wait_completion(DynamixelIOCompletion *completion,
+        DynamixelIOResponse *response);
+bool dynamixel_io_future_create(DynamixelIOFuture *future);
+void dynamixel_io_future_delete(DynamixelIOFuture *future);
+// sends the request (its completion is set) with the response to the future,
+// false if the future is still pending (one request at a time) or it cannot be sent
+bool dynamixel_io_submit_future(DynamixelIOTaskHandle *task_handle,
+        DynamixelIORequest *request, DynamixelIOFuture *future);
+// like dynamixel_io_send_request(), but the response is sent to the future
+bool dynamixel_io_send_request_future(DynamixelIOTaskHandle *task_handle,
+        DynamixelPacket *packet, int response_size, DynamixelIOFuture *future);
+// true if the response has come (then it is in future->response) or nothing has been
+// sent, does not block
+bool dynamixel_io_future_poll(DynamixelIOFuture *future);
+// like dynamixel_io_future_poll(), but waits at most timeout ticks for the response
+bool dynamixel_io_future_wait(DynamixelIOFuture *future, TickType_t timeout);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Events of the trace of transactions recorded by the IO task
+ * (see dynamixel_io_task_set_trace() in io_task.h).
+ *
+ * Each transaction goes through phases: the request waits in the queue
+ * (ENQUEUED -> DEQUEUED), the packet is sent (TX_STARTED -> TX_COMPLETED),
+ * the servo waits its return delay (-> RX_FIRST_DATA), sends the response
+ * (-> RX_COMPLETED) and the task is woken (-> WOKEN) to finish it (DONE).
+ * Completions and received data are recorded in the interrupts that notify
+ * the task, timestamps come from the timer of the task if it can tell the time
+ * (otherwise from ticks), so they are as close to the hardware as possible.
+ *
+ * This header does not depend on FreeRTOS, so that dumped events can be
+ * processed on a host (tools/dynamixel-trace converts them to Chrome trace JSON).
+ * A dump is an array of DynamixelIOTraceEvent in the byte order of the MCU
+ * (e.g. written from dynamixel_io_task_read_trace()).
+ */
+
+#include <stdint.h>
+
+typedef enum {
+    dio_TRACE_ENQUEUED = 0,   // request submitted (detail: priority class)
+    dio_TRACE_DEQUEUED,       // request taken by the task (detail: priority class)
+    dio_TRACE_TX_STARTED,     // write started (detail: servo id of the packet)
+    dio_TRACE_TX_COMPLETED,   // write completion notified (interrupt)
+    dio_TRACE_RX_STARTED,     // read started, by the task or chained from write completion
+    dio_TRACE_RX_FIRST_DATA,  // the first data of the response received (interrupt)
+    dio_TRACE_RX_COMPLETED,   // reception ended (interrupt, detail: DynamixelIOTransmissionState)
+    dio_TRACE_TIMEOUT,        // the timer expired (time of the interrupt, recorded by the task)
+    dio_TRACE_WOKEN,          // the task woken after waiting for a notification
+    dio_TRACE_DONE,           // transaction finished (detail: DynamixelIOStatus)
+    dio_N_TRACE_EVENT_TYPES
+} DynamixelIOTraceEventType;
+
+// 12 bytes without padding
+typedef struct {
+    uint32_t time_us;         // wraps around
+    uint32_t request;         // number of the request (in order of submission) the event belongs to
+    uint8_t type;             // DynamixelIOTraceEventType
+    uint8_t detail;
+    uint8_t reserved[2];
+} DynamixelIOTraceEvent;
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,43 +4,72 @@
 
 
 void dynamixel_packet_init(DynamixelPacket *packet, uint8_t id, uint8_t instruction) {
+    dynamixel_packet_init_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS, id, instruction);
+}
+
+bool dynamixel_packet_add_parameter(DynamixelPacket *packet, uint8_t parameter) {
+    return dynamixel_packet_add_parameter_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS, parameter);
+}
+
+bool dynamixel_packet_add_parameters(DynamixelPacket *packet, const uint8_t *parameters, int n_parameters) {
+    return dynamixel_packet_add_parameters_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS,
+            parameters, n_parameters);
+}
+
+bool dynamixel_packet_add_parameter_u16(DynamixelPacket *packet, uint16_t parameter) {
+    return dynamixel_packet_add_parameter_u16_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS, parameter);
+}
+
+bool dynamixel_packet_add_checksum(DynamixelPacket *packet) {
+    return dynamixel_packet_add_checksum_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS);
+}
+
+/*  */
+
+void dynamixel_packet_init_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, uint8_t instruction)
+{
     // dynamixel start bytes are always 0xff 0xff
     packet->_start_bytes[0] = 0xff;
     packet->_start_bytes[1] = 0xff;
     packet->id = id;
     packet->length = 2; // instruction/error and checksum
     packet->instruction = instruction;
-    memset(packet->parameters_with_checksum, 0,
-            sizeof(packet->parameters_with_checksum) / sizeof(packet->parameters_with_checksum[0]));
+    memset(packet->parameters_with_checksum, 0, max_n_parameters + 1);
 }
 
-bool dynamixel_packet_add_parameter(DynamixelPacket *packet, uint8_t parameter) {
+bool dynamixel_packet_add_parameter_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t parameter)
+{
     int next_index = dynamixel_packet_n_parameters(packet);
-    int array_max_size = sizeof(packet->parameters_with_checksum) / sizeof(packet->parameters_with_checksum[0]);
-    if (next_index >= array_max_size)
-        return false; // cannot add more elements
+    if (next_index >= max_n_parameters)
+        return false; // cannot add more elements (last one is for checksum)
     packet->parameters_with_checksum[next_index] = parameter;
     packet->length++;
     return true;
 }
 
-bool dynamixel_packet_add_parameters(DynamixelPacket *packet, const uint8_t *parameters, int n_parameters) {
+bool dynamixel_packet_add_parameters_sized(DynamixelPacket *packet, int max_n_parameters,
+        const uint8_t *parameters, int n_parameters)
+{
     int next_index = dynamixel_packet_n_parameters(packet);
-    int space_remaining = dynamixel_packet_space_remaining(packet);
-    if (n_parameters > space_remaining)
-        return false; // cannot add all of the elements, so do not add anything
+    int space_remaining = dynamixel_packet_space_remaining_sized(packet, max_n_parameters);
+    if (n_parameters > space_remaining - 1)
+        return false; // cannot add all of the elements (with checksum), so do not add anything
     memcpy(&packet->parameters_with_checksum[next_index], parameters, n_parameters);
     packet->length += n_parameters;
     return true;
 }
 
-bool dynamixel_packet_add_parameter_u16(DynamixelPacket *packet, uint16_t parameter) {
+bool dynamixel_packet_add_parameter_u16_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint16_t parameter)
+{
     // FIXME: endianess-dependent
-    return dynamixel_packet_add_parameters(packet, (uint8_t *) &parameter, 2);
+    return dynamixel_packet_add_parameters_sized(packet, max_n_parameters, (uint8_t *) &parameter, 2);
 }
 
-bool dynamixel_packet_add_checksum(DynamixelPacket *packet) {
-    int space_remaining = dynamixel_packet_space_remaining(packet);
+bool dynamixel_packet_add_checksum_sized(DynamixelPacket *packet, int max_n_parameters) {
+    int space_remaining = dynamixel_packet_space_remaining_sized(packet, max_n_parameters);
     if (space_remaining < 1)
         return false;
     int checksum_index = dynamixel_packet_get_checksum_index(packet);
@@ -49,6 +78,13 @@ bool dynamixel_packet_add_checksum(DynamixelPacket *packet) {
     return true;
 }
 
+int dynamixel_packet_space_remaining_sized(DynamixelPacket *packet, int max_n_parameters) {
+    int next_index = dynamixel_packet_n_parameters(packet);
+    int array_max_size = max_n_parameters + 1;
+    int space_remaining = array_max_size - next_index;
+    return space_remaining;
+}
+
 /*  */
 
 uint8_t* dynamixel_packet_data(DynamixelPacket *packet) {
@@ -62,10 +98,7 @@ int dynamixel_packet_size(DynamixelPacket *packet) {
 }
 
 int dynamixel_packet_space_remaining(DynamixelPacket *packet) {
-    int next_index = dynamixel_packet_n_parameters(packet);
-    int array_max_size = sizeof(packet->parameters_with_checksum) / sizeof(packet->parameters_with_checksum[0]);
-    int space_remaining = array_max_size - next_index;
-    return space_remaining;
+    return dynamixel_packet_space_remaining_sized(packet, DYNAMIXEL_MAX_N_PARAMETERS);
 }
 
 int dynamixel_packet_n_parameters(DynamixelPacket *packet) {
@@ -25,7 +25,14 @@ extern "C" {
 // As we don't want dynamic allocation we have to define a limit of parameters.
 // This value is needed to statically allocate communication buffers.
 // The size of the structure is in fact this+6 (but ofc use sizeof(DynamixelPacket))
-#define DYNAMIXEL_MAX_N_PARAMETERS   24
+// Packets with different capacity can be used with *_sized functions (see below).
+#ifndef DYNAMIXEL_MAX_N_PARAMETERS
+#   define DYNAMIXEL_MAX_N_PARAMETERS   24
+#endif
+
+// Maximum size of a packet that can be received by servos (AX-12 receive buffer)
+#define DYNAMIXEL_PROTOCOL_MAX_PACKET_SIZE   143
+#define DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS  (DYNAMIXEL_PROTOCOL_MAX_PACKET_SIZE - DYNAMIXEL_PACKET_BASE_SIZE - 1)
 
 
 /*
@@ -54,6 +61,14 @@ typedef struct __attribute__ ((__packed__)) {
 // useful for calculating size of reveice packets (as we don't have them yet created)
 #define DYNAMIXEL_PACKET_BASE_SIZE   (2 + 3)
 
+// size of storage for a packet that can hold max_n_parameters, such storage
+// can be used as a DynamixelPacket with *_sized functions:
+//   uint8_t storage[DYNAMIXEL_PACKET_STORAGE_SIZE(100)];
+//   DynamixelPacket *packet = (DynamixelPacket *) storage;
+//   dynamixel_packet_init_sized(packet, 100, id, instruction);
+// (in C++ BasicPacket<N> from basic_packet.h is more convenient)
+#define DYNAMIXEL_PACKET_STORAGE_SIZE(max_n_parameters)  (DYNAMIXEL_PACKET_BASE_SIZE + (max_n_parameters) + 1)
+
 
 // initializes the structure with default values (other functions assume that this was called)
 // needs to be called each time before adding parameters to a packet
@@ -72,6 +87,19 @@ bool dynamixel_packet_add_parameter_u16(DynamixelPacket *packet, uint16_t parame
 // returns false if there is not enough space and does NOT add ANYTHING
 bool dynamixel_packet_add_checksum(DynamixelPacket *packet);
 
+// variants of the above functions for packets with capacity different than DYNAMIXEL_MAX_N_PARAMETERS,
+// max_n_parameters is the number of parameters that the packet storage can hold (excluding checksum)
+void dynamixel_packet_init_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t id, uint8_t instruction);
+bool dynamixel_packet_add_parameter_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint8_t parameter);
+bool dynamixel_packet_add_parameters_sized(DynamixelPacket *packet, int max_n_parameters,
+        const uint8_t *parameters, int n_parameters);
+bool dynamixel_packet_add_parameter_u16_sized(DynamixelPacket *packet, int max_n_parameters,
+        uint16_t parameter);
+bool dynamixel_packet_add_checksum_sized(DynamixelPacket *packet, int max_n_parameters);
+int dynamixel_packet_space_remaining_sized(DynamixelPacket *packet, int max_n_parameters);
+
 // returns pointer to packet data
 uint8_t* dynamixel_packet_data(DynamixelPacket *packet);
 // gives size (in bytes) of data packet to be transimitted through UART
@@ -0,0 +1,42 @@
+#include <string.h> // memcpy
+
+#include "packet_batch.h"
+
+
+void dynamixel_packet_batch_init(DynamixelPacketBatch *batch, uint8_t *buffer, int capacity) {
+    batch->buffer = buffer;
+    batch->capacity = capacity;
+    dynamixel_packet_batch_clear(batch);
+}
+
+void dynamixel_packet_batch_clear(DynamixelPacketBatch *batch) {
+    batch->size = 0;
+    batch->n_packets = 0;
+    batch->response_size = 0;
+}
+
+bool dynamixel_packet_batch_add(DynamixelPacketBatch *batch, DynamixelPacket *packet, int response_size) {
+    return dynamixel_packet_batch_add_data(batch, dynamixel_packet_data(packet),
+            dynamixel_packet_size(packet), response_size);
+}
+
+bool dynamixel_packet_batch_add_data(DynamixelPacketBatch *batch, const uint8_t *data, int size,
+        int response_size)
+{
+    if (response_size < 0 || batch->response_size != 0)
+        return false;
+    // response will be received into the buffer
+    int space_needed = batch->size + size;
+    if (space_needed > batch->capacity || response_size > batch->capacity)
+        return false;
+    memcpy(&batch->buffer[batch->size], data, size);
+    batch->size += size;
+    batch->n_packets++;
+    batch->response_size = response_size;
+    return true;
+}
+
+DynamixelPacket *dynamixel_packet_batch_packet(DynamixelPacketBatch *batch) {
+    return (DynamixelPacket *) batch->buffer;
+}
+
@@ -0,0 +1,64 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Batches of instruction packets sent with a single UART transfer.
+ *
+ * Each request sent to the IO task costs one uart_write_handle() call,
+ * one transfer-complete interrupt and one task notification. Packets that
+ * are sent back-to-back (broadcast writes, REG_WRITE to many servos followed
+ * by ACTION, sync-writes to different control table blocks) can be copied
+ * into one contiguous buffer and sent as a single transfer. Servos do not
+ * need any gap between packets, they just parse the stream.
+ *
+ * Only the last packet in the batch may expect a response, as the servo
+ * responds before the next packets would be parsed by other servos and the
+ * line is half-duplex. The response is received into the batch buffer.
+ *
+ * Usage:
+ *   uint8_t buffer[64];
+ *   DynamixelPacketBatch batch;
+ *   dynamixel_packet_batch_init(&batch, buffer, sizeof(buffer));
+ *   for each servo:
+ *       response_size = dynamixel_prepare_reg_write(&packet, id, address, data, len);
+ *       dynamixel_packet_batch_add(&batch, &packet, response_size);
+ *   dynamixel_packet_batch_add(&batch, &action, dynamixel_prepare_action(&action, BROADCASTING_ID));
+ *   dynamixel_io_send_batch(io_task, &batch, false);
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "packet.h"
+
+typedef struct {
+    uint8_t *buffer;          // buffer provided by user
+    int capacity;             // size of the buffer
+    int size;                 // number of bytes used by packets
+    int n_packets;            // number of packets in the batch
+    int response_size;        // expected response to the last packet
+} DynamixelPacketBatch;
+
+
+void dynamixel_packet_batch_init(DynamixelPacketBatch *batch, uint8_t *buffer, int capacity);
+// removes all packets
+void dynamixel_packet_batch_clear(DynamixelPacketBatch *batch);
+// copies complete packet to the end of the batch, response_size is the value returned
+// by the dynamixel_prepare_* function used to create the packet;
+// returns false and does NOT add ANYTHING if there is no space left, response_size
+// indicates an error or the previous packet expects a response
+bool dynamixel_packet_batch_add(DynamixelPacketBatch *batch, DynamixelPacket *packet, int response_size);
+// the same for raw packet data (e.g. Protocol 2.0 packet)
+bool dynamixel_packet_batch_add_data(DynamixelPacketBatch *batch, const uint8_t *data, int size,
+        int response_size);
+// packet that can be passed to dynamixel_io_send_* (data that is sent starts at the beginning)
+DynamixelPacket *dynamixel_packet_batch_packet(DynamixelPacketBatch *batch);
+
+
+#ifdef __cplusplus
+}
+#endif
+
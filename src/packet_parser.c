@@ -0,0 +1,94 @@
+#include <stddef.h>
+
+#include "packet_parser.h"
+
+
+void dynamixel_packet_parser_init(DynamixelPacketParser *parser, DynamixelPacket *packet) {
+    dynamixel_packet_parser_init_sized(parser, packet, DYNAMIXEL_MAX_N_PARAMETERS);
+}
+
+void dynamixel_packet_parser_init_sized(DynamixelPacketParser *parser, DynamixelPacket *packet,
+        int max_n_parameters)
+{
+    parser->packet = packet;
+    parser->max_n_parameters = max_n_parameters;
+    dynamixel_packet_parser_reset(parser);
+}
+
+void dynamixel_packet_parser_reset(DynamixelPacketParser *parser) {
+    parser->state = dps_START_1;
+    parser->checksum = 0;
+    parser->n_body_received = 0;
+}
+
+DynamixelParserResult dynamixel_packet_parser_feed_byte(DynamixelPacketParser *parser, uint8_t byte) {
+    DynamixelPacket *packet = parser->packet;
+    uint8_t *data = dynamixel_packet_data(packet);
+
+    switch (parser->state) {
+        case dps_START_1:
+            if (byte == 0xff)
+                parser->state = dps_START_2;
+            break;
+
+        case dps_START_2:
+            parser->state = byte == 0xff ? dps_ID : dps_START_1;
+            break;
+
+        case dps_ID:
+            // 0xff is not a valid ID, so it must be yet another start byte
+            // (e.g. the previous one was some noise)
+            if (byte == 0xff)
+                break;
+            packet->_start_bytes[0] = 0xff;
+            packet->_start_bytes[1] = 0xff;
+            packet->id = byte;
+            parser->checksum = byte;
+            parser->state = dps_LENGTH;
+            break;
+
+        case dps_LENGTH:
+            // stored also if rejected, so that the packet has all the received bytes
+            packet->length = byte;
+            // length = n_parameters + 2, packet must fit into parameters_with_checksum[]
+            if (byte < 2 || byte - 2 > parser->max_n_parameters) {
+                dynamixel_packet_parser_reset(parser);
+                // this may be the beginning of the next packet
+                if (byte == 0xff)
+                    parser->state = dps_START_2;
+                return dpr_WRONG_LENGTH;
+            }
+            parser->checksum += byte;
+            parser->n_body_received = 0;
+            parser->state = dps_BODY;
+            break;
+
+        case dps_BODY:
+            // body starts right after length field
+            data[DYNAMIXEL_PACKET_BASE_SIZE - 1 + parser->n_body_received] = byte;
+            parser->n_body_received++;
+            // last byte of the body is the checksum
+            if (parser->n_body_received < packet->length) {
+                parser->checksum += byte;
+                break;
+            }
+            uint8_t checksum = (uint8_t) (~parser->checksum);
+            bool is_ok = checksum == byte;
+            dynamixel_packet_parser_reset(parser);
+            return is_ok ? dpr_PACKET_READY : dpr_WRONG_CHECKSUM;
+    }
+
+    return dpr_IN_PROGRESS;
+}
+
+DynamixelParserResult dynamixel_packet_parser_feed(DynamixelPacketParser *parser,
+        const uint8_t *data, int data_len, int *n_consumed)
+{
+    DynamixelParserResult result = dpr_IN_PROGRESS;
+    int i = 0;
+    while (i < data_len && result == dpr_IN_PROGRESS)
+        result = dynamixel_packet_parser_feed_byte(parser, data[i++]);
+    if (n_consumed != NULL)
+        *n_consumed = i;
+    return result;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Incremental parser of status packets.
+ *
+ * Instead of waiting until exactly N bytes have been received, bytes can be
+ * passed to the parser as soon as they arrive (one by one or in chunks, e.g.
+ * from a DMA ring buffer). The parser looks for 0xff 0xff start bytes, checks
+ * the length field and computes the checksum on the fly, so a complete packet
+ * (or a framing error) is reported right after its last byte.
+ *
+ * Parsed packet is written directly into the given DynamixelPacket.
+ *
+ * Usage:
+ *   DynamixelPacketParser parser;
+ *   dynamixel_packet_parser_init(&parser, &packet);
+ *   // for each received chunk:
+ *   while (data_len > 0) {
+ *       int n_consumed;
+ *       DynamixelParserResult result = dynamixel_packet_parser_feed(&parser,
+ *               data, data_len, &n_consumed);
+ *       data += n_consumed;
+ *       data_len -= n_consumed;
+ *       if (result == dpr_PACKET_READY) { ...use packet... }
+ *   }
+ */
+
+#include "packet.h"
+
+typedef enum {
+    dpr_IN_PROGRESS = 0,  // more bytes are needed
+    dpr_PACKET_READY,     // whole packet with correct checksum has been received
+    dpr_WRONG_LENGTH,     // length field does not fit into the packet
+    dpr_WRONG_CHECKSUM,   // whole packet has been received, but checksum is wrong
+} DynamixelParserResult;
+
+typedef enum {
+    dps_START_1,          // waiting for first 0xff
+    dps_START_2,          // waiting for second 0xff
+    dps_ID,
+    dps_LENGTH,
+    dps_BODY,             // instruction/error, parameters and checksum
+} DynamixelParserState;
+
+typedef struct {
+    DynamixelPacket *packet;    // packet being filled
+    int max_n_parameters;       // capacity of the packet, longer packets are rejected
+    DynamixelParserState state;
+    uint8_t checksum;           // running sum of id, length, error and parameters
+    int n_body_received;        // number of bytes received in dps_BODY state
+} DynamixelPacketParser;
+
+
+// initializes parser that will write into the given packet
+void dynamixel_packet_parser_init(DynamixelPacketParser *parser, DynamixelPacket *packet);
+// the same for packets with capacity different than DYNAMIXEL_MAX_N_PARAMETERS
+// (can be also used to reject packets longer than expected)
+void dynamixel_packet_parser_init_sized(DynamixelPacketParser *parser, DynamixelPacket *packet,
+        int max_n_parameters);
+// drops any partially received packet and starts searching for start bytes
+void dynamixel_packet_parser_reset(DynamixelPacketParser *parser);
+// processes a single byte
+// after any result other than dpr_IN_PROGRESS the parser starts looking for next packet,
+// so data in the packet is valid only until next byte is passed to the parser
+DynamixelParserResult dynamixel_packet_parser_feed_byte(DynamixelPacketParser *parser, uint8_t byte);
+// processes bytes until a packet is ready, an error occurs or all data is consumed
+// stores the number of bytes processed in n_consumed (may be NULL)
+DynamixelParserResult dynamixel_packet_parser_feed(DynamixelPacketParser *parser,
+        const uint8_t *data, int data_len, int *n_consumed);
+
+
+#ifdef __cplusplus
+}
+#endif
+
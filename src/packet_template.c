@@ -0,0 +1,75 @@
+#include <string.h> // memcpy
+
+#include "packet_template.h"
+
+
+// checksum = ~sum, so when a byte changes from old to new value:
+// new_checksum = ~(sum - old + new) = checksum + old - new
+static void update_checksum(DynamixelPacket *packet, uint8_t old_value, uint8_t new_value);
+
+
+bool dynamixel_packet_template_init(DynamixelPacketTemplate *tpl, int response_size) {
+    if (response_size < 0)
+        return false;
+    if (!dynamixel_packet_checksum_isok(&tpl->packet))
+        return false;
+    tpl->response_size = response_size;
+    return true;
+}
+
+void dynamixel_packet_template_set_id(DynamixelPacketTemplate *tpl, uint8_t id) {
+    update_checksum(&tpl->packet, tpl->packet.id, id);
+    tpl->packet.id = id;
+}
+
+bool dynamixel_packet_template_set_parameter(DynamixelPacketTemplate *tpl, int index, uint8_t value) {
+    return dynamixel_packet_template_set_parameters(tpl, index, &value, 1);
+}
+
+bool dynamixel_packet_template_set_parameter_u16(DynamixelPacketTemplate *tpl, int index, uint16_t value) {
+    // little-endian, as all the registers
+    const uint8_t bytes[2] = {value & 0xff, value >> 8};
+    return dynamixel_packet_template_set_parameters(tpl, index, bytes, 2);
+}
+
+bool dynamixel_packet_template_set_parameters(DynamixelPacketTemplate *tpl, int index,
+        const uint8_t *values, int n_values)
+{
+    DynamixelPacket *packet = &tpl->packet;
+    if (index < 0 || index + n_values > dynamixel_packet_n_parameters(packet))
+        return false;
+    // accumulate differences to update checksum only once
+    uint8_t old_sum = 0, new_sum = 0;
+    uint8_t *parameters = &packet->parameters_with_checksum[index];
+    for (int i = 0; i < n_values; i++) {
+        old_sum += parameters[i];
+        new_sum += values[i];
+        parameters[i] = values[i];
+    }
+    update_checksum(packet, old_sum, new_sum);
+    return true;
+}
+
+bool dynamixel_packet_template_set_sync_write_data(DynamixelPacketTemplate *tpl,
+        int actuator_index, const uint8_t *data)
+{
+    // parameters are: address, L, id1, data1[L], id2, data2[L], ...
+    int data_len_for_each = tpl->packet.parameters_with_checksum[1];
+    int index = 2 + actuator_index * (data_len_for_each + 1) + 1;
+    if (actuator_index < 0)
+        return false;
+    return dynamixel_packet_template_set_parameters(tpl, index, data, data_len_for_each);
+}
+
+void dynamixel_packet_template_copy(const DynamixelPacketTemplate *tpl, DynamixelPacket *packet) {
+    DynamixelPacket *source = (DynamixelPacket *) &tpl->packet;
+    memcpy(dynamixel_packet_data(packet), dynamixel_packet_data(source),
+            dynamixel_packet_size(source));
+}
+
+/*** Private functions *********************************************************/
+
+static void update_checksum(DynamixelPacket *packet, uint8_t old_value, uint8_t new_value) {
+    int checksum_index = dynamixel_packet_get_checksum_index(packet);
+    packet->parameters_with_checksum[checksum_index] += old_value - new_value;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Packet templates - packets that are assembled once and then only modified.
+ *
+ * Control loops usually send packets of the same shape every cycle
+ * (e.g. sync-write of goal positions, reads of present position), only
+ * some parameter values change. Instead of assembling such a packet
+ * from scratch each time (init, adding parameters, computing checksum),
+ * a template is built once using dynamixel_prepare_* functions and then
+ * parameters are modified in place, with the checksum being updated
+ * in O(1) from the difference between old and new values.
+ *
+ * Usage:
+ *   DynamixelPacketTemplate tpl;
+ *   int response_size = dynamixel_prepare_sync_write(&tpl.packet, address, data, n, len);
+ *   dynamixel_packet_template_init(&tpl, response_size);
+ *   // each cycle:
+ *   dynamixel_packet_template_set_sync_write_data(&tpl, 0, new_data0);
+ *   ...
+ *   dynamixel_io_send_request(io_task, &tpl.packet, tpl.response_size, false);
+ *
+ * WARNING: without a pool of receive buffers (dynamixel_io_task_set_rx_pool()),
+ *   the IO task writes responses over the request packet, so templates of packets
+ *   that have a response (response_size > 0) have to be copied with
+ *   dynamixel_packet_template_copy() before sending. Responses received into
+ *   buffers of the pool leave the template intact.
+ */
+
+#include "packet.h"
+
+typedef struct {
+    DynamixelPacket packet;   // complete packet, checksum is always valid
+    int response_size;        // expected size of response, as returned by dynamixel_prepare_*
+} DynamixelPacketTemplate;
+
+
+// finishes building of template->packet assembled with dynamixel_prepare_*,
+// response_size should be the value returned by that function
+// returns false if response_size indicates an error or the packet checksum is wrong
+bool dynamixel_packet_template_init(DynamixelPacketTemplate *tpl, int response_size);
+// changes servo id (response_size is not modified, so do not change from/to broadcasting)
+void dynamixel_packet_template_set_id(DynamixelPacketTemplate *tpl, uint8_t id);
+// change parameter(s) at given index (the same as index in parameters_with_checksum)
+// return false if the parameter index is outside of the packet and does NOT change ANYTHING
+bool dynamixel_packet_template_set_parameter(DynamixelPacketTemplate *tpl, int index, uint8_t value);
+bool dynamixel_packet_template_set_parameter_u16(DynamixelPacketTemplate *tpl, int index, uint16_t value);
+bool dynamixel_packet_template_set_parameters(DynamixelPacketTemplate *tpl, int index,
+        const uint8_t *values, int n_values);
+// for sync-write packets: changes data for actuator given by its position in the packet
+// (data has length as given when assembling the packet)
+bool dynamixel_packet_template_set_sync_write_data(DynamixelPacketTemplate *tpl,
+        int actuator_index, const uint8_t *data);
+// copies only the bytes used by the packet
+void dynamixel_packet_template_copy(const DynamixelPacketTemplate *tpl, DynamixelPacket *packet);
+
+
+#ifdef __cplusplus
+}
+#endif
+
@@ -0,0 +1,44 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Minimal subset of FreeRTOS API implemented with POSIX threads (freertos_posix.c),
+ * enough to run io_task.c, servo_group.cpp and discovery_utils.c on a host.
+ *
+ * One tick is one microsecond, so all the timeouts computed by the IO task
+ * have microsecond resolution (and TickType_t wraps after ~71 minutes).
+ * Task priorities and stack sizes are ignored.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE                     ((BaseType_t) 0)
+#define pdTRUE                      ((BaseType_t) 1)
+#define pdFAIL                      pdFALSE
+#define pdPASS                      pdTRUE
+#define portMAX_DELAY               ((TickType_t) 0xffffffffUL)
+
+#define configTICK_RATE_HZ          ((TickType_t) 1000000)
+#define configMINIMAL_STACK_SIZE    ((uint16_t) 0)
+#define INCLUDE_vTaskDelete         1
+#define pdMS_TO_TICKS(ms)           ((TickType_t) (((uint64_t) (ms) * configTICK_RATE_HZ) / 1000))
+#define pdUS_TO_TICKS(us)           ((TickType_t) (us))
+
+// there are no interrupts, "ISR" functions can be called from any thread
+#define portYIELD_FROM_ISR(x)       ((void) (x))
+
+// unlike assert() it evaluates the expression also with NDEBUG
+void vAssertCalled(const char *file, int line);
+#define configASSERT(x)             do { if (!(x)) vAssertCalled(__FILE__, __LINE__); } while (0)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,90 @@
+#include "capture_file.h"
+
+#include <string.h>
+#include <time.h>
+
+
+static void drain(DynamixelCaptureFileWriter *writer);
+static void *writer_thread(void *arguments);
+
+
+bool dynamixel_capture_file_start(DynamixelCaptureFileWriter *writer,
+        DynamixelIOCaptureRing *ring, FILE *file, uint8_t protocol, uint32_t period_us)
+{
+    if (file == NULL)
+        return false;
+    memset(writer, 0, sizeof(*writer));
+    writer->ring = ring;
+    writer->file = file;
+    writer->period_us = period_us;
+
+    DynamixelIOCaptureHeader header;
+    dynamixel_capture_header_init(&header, protocol);
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+        return false;
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&writer->changed, &attr);
+    pthread_condattr_destroy(&attr);
+
+    writer->running = true;
+    if (pthread_create(&writer->thread, NULL, writer_thread, writer) != 0) {
+        writer->running = false;
+        pthread_cond_destroy(&writer->changed);
+        pthread_mutex_destroy(&writer->lock);
+        return false;
+    }
+    return true;
+}
+
+bool dynamixel_capture_file_stop(DynamixelCaptureFileWriter *writer)
+{
+    pthread_mutex_lock(&writer->lock);
+    writer->running = false;
+    pthread_cond_signal(&writer->changed);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+    pthread_cond_destroy(&writer->changed);
+    pthread_mutex_destroy(&writer->lock);
+
+    // what has been captured until now
+    drain(writer);
+    if (fflush(writer->file) != 0)
+        writer->write_error = true;
+    return !writer->write_error;
+}
+
+// copies everything from the ring into the file
+static void drain(DynamixelCaptureFileWriter *writer)
+{
+    uint8_t chunk[4096];
+    size_t len;
+    while ((len = dynamixel_capture_ring_read(writer->ring, chunk, sizeof(chunk))) > 0) {
+        if (fwrite(chunk, 1, len, writer->file) != len)
+            writer->write_error = true;
+    }
+}
+
+static void *writer_thread(void *arguments)
+{
+    DynamixelCaptureFileWriter *writer = (DynamixelCaptureFileWriter *) arguments;
+    pthread_mutex_lock(&writer->lock);
+    while (writer->running) {
+        pthread_mutex_unlock(&writer->lock);
+        drain(writer);
+        pthread_mutex_lock(&writer->lock);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        uint64_t ns = (uint64_t) deadline.tv_nsec + (uint64_t) writer->period_us * 1000;
+        deadline.tv_sec += ns / 1000000000;
+        deadline.tv_nsec = ns % 1000000000;
+        if (writer->running)
+            pthread_cond_timedwait(&writer->changed, &writer->lock, &deadline);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Consumer of the capture ring of the IO task (io_capture.h) on POSIX systems:
+ * a thread that copies captured records into a file every period_us, so that
+ * the IO task only copies bytes into memory.
+ *
+ * Usage:
+ *   static uint8_t buffer[1 << 16];
+ *   DynamixelIOCaptureRing ring;
+ *   dynamixel_capture_ring_init(&ring, buffer, sizeof(buffer));
+ *   DynamixelCaptureFileWriter writer;
+ *   dynamixel_capture_file_start(&writer, &ring, fopen("bus.dxcp", "wb"), dio_PROTOCOL_1, 10000);
+ *   dynamixel_io_task_set_capture(&io_task, &ring);
+ *   ...
+ *   dynamixel_io_task_set_capture(&io_task, NULL);
+ *   dynamixel_capture_file_stop(&writer);    // writes the rest, the file is left open
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "io_capture.h"
+
+typedef struct {
+    DynamixelIOCaptureRing *ring;
+    FILE *file;
+    uint32_t period_us;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    bool running;
+    bool write_error;
+} DynamixelCaptureFileWriter;
+
+// writes the header of the log and starts the thread, returns false if it fails
+bool dynamixel_capture_file_start(DynamixelCaptureFileWriter *writer,
+        DynamixelIOCaptureRing *ring, FILE *file, uint8_t protocol, uint32_t period_us);
+// stops the thread after writing everything captured so far (and flushes the file),
+// returns false if any write has failed
+bool dynamixel_capture_file_stop(DynamixelCaptureFileWriter *writer);
+
+#ifdef __cplusplus
+}
+#endif
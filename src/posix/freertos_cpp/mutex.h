@@ -0,0 +1,31 @@
+#pragma once
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+/*
+ * Mutex with the interface of freertos_cpp/mutex.h used by ServoGroup.
+ * It is a binary semaphore, so it may be given by other thread than the one
+ * that has taken it (ServoGroup takes it in constructor).
+ */
+class Mutex {
+public:
+    Mutex(): handle(xSemaphoreCreateMutex()) {
+        configASSERT(handle != NULL);
+    }
+    ~Mutex() {
+        vSemaphoreDelete(handle);
+    }
+    Mutex(const Mutex &) = delete;
+    Mutex &operator=(const Mutex &) = delete;
+
+    bool take(TickType_t ticks_to_wait = portMAX_DELAY) {
+        return xSemaphoreTake(handle, ticks_to_wait) == pdTRUE;
+    }
+    bool give() {
+        return xSemaphoreGive(handle) == pdTRUE;
+    }
+
+private:
+    SemaphoreHandle_t handle;
+};
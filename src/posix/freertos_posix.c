@@ -0,0 +1,340 @@
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+struct PosixTask {
+    pthread_t thread;
+    TaskFunction_t function;
+    void *parameters;
+    // notification value
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notification;
+};
+
+struct PosixQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t n_items;
+    UBaseType_t head;         // index of the oldest item
+    uint8_t *items;
+};
+
+static __thread struct PosixTask *current_task = NULL;
+static pthread_mutex_t critical_lock;
+static pthread_once_t critical_lock_once = PTHREAD_ONCE_INIT;
+
+static void init_cond(pthread_cond_t *cond);
+static bool wait_until(pthread_cond_t *cond, pthread_mutex_t *lock,
+        TickType_t ticks_to_wait, const struct timespec *deadline);
+static void deadline_after(TickType_t ticks, struct timespec *deadline);
+static struct PosixTask *new_task(void);
+static void init_critical_lock(void);
+static void *task_entry(void *arguments);
+
+
+void vAssertCalled(const char *file, int line)
+{
+    fprintf(stderr, "%s:%d: configASSERT failed\n", file, line);
+    abort();
+}
+
+/*** Tasks ********************************************************************/
+
+BaseType_t xTaskCreate(TaskFunction_t task_function, const char * const name,
+        uint16_t stack_depth, void *parameters, UBaseType_t priority,
+        TaskHandle_t *created_task)
+{
+    (void) name;
+    (void) stack_depth;
+    (void) priority;
+    struct PosixTask *task = new_task();
+    if (task == NULL)
+        return pdFAIL;
+    task->function = task_function;
+    task->parameters = parameters;
+    // handle must be valid before the task starts running
+    if (created_task != NULL)
+        *created_task = task;
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0)
+        return pdFAIL;
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    configASSERT(task == NULL || task == current_task);
+    // like in FreeRTOS, the handle must not be used after deletion
+    struct PosixTask *deleted = current_task;
+    current_task = NULL;
+    if (deleted != NULL) {
+        pthread_cond_destroy(&deleted->notified);
+        pthread_mutex_destroy(&deleted->lock);
+        free(deleted);
+    }
+    pthread_exit(NULL);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (current_task == NULL) {
+        current_task = new_task();
+        configASSERT(current_task != NULL);
+        current_task->thread = pthread_self();
+    }
+    return current_task;
+}
+
+void vTaskDelay(TickType_t ticks_to_delay)
+{
+    struct timespec delay = {
+        .tv_sec = ticks_to_delay / configTICK_RATE_HZ,
+        .tv_nsec = (long) (ticks_to_delay % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ),
+    };
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR)
+        continue;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t us = (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000;
+    return (TickType_t) us;
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return xTaskGetTickCount();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait)
+{
+    struct PosixTask *task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline;
+    deadline_after(ticks_to_wait, &deadline);
+
+    pthread_mutex_lock(&task->lock);
+    while (task->notification == 0) {
+        if (!wait_until(&task->notified, &task->lock, ticks_to_wait, &deadline))
+            break;
+    }
+    uint32_t value = task->notification;
+    if (value != 0)
+        task->notification = clear_count_on_exit ? 0 : value - 1;
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notification++;
+    pthread_cond_signal(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken)
+{
+    xTaskNotifyGive(task);
+    if (higher_priority_task_woken != NULL)
+        *higher_priority_task_woken = pdFALSE;
+}
+
+void vTaskEnterCritical(void)
+{
+    pthread_once(&critical_lock_once, init_critical_lock);
+    pthread_mutex_lock(&critical_lock);
+}
+
+void vTaskExitCritical(void)
+{
+    pthread_mutex_unlock(&critical_lock);
+}
+
+/*** Queues *******************************************************************/
+
+QueueHandle_t xQueueCreate(UBaseType_t queue_length, UBaseType_t item_size)
+{
+    struct PosixQueue *queue = calloc(1, sizeof(struct PosixQueue));
+    if (queue == NULL)
+        return NULL;
+    queue->items = item_size > 0 ? calloc(queue_length, item_size) : NULL;
+    if (item_size > 0 && queue->items == NULL) {
+        free(queue);
+        return NULL;
+    }
+    queue->length = queue_length;
+    queue->item_size = item_size;
+    pthread_mutex_init(&queue->lock, NULL);
+    init_cond(&queue->not_empty);
+    init_cond(&queue->not_full);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->items);
+    free(queue);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    deadline_after(ticks_to_wait, &deadline);
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->n_items == queue->length) {
+        if (!wait_until(&queue->not_full, &queue->lock, ticks_to_wait, &deadline)) {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFAIL;
+        }
+    }
+    UBaseType_t tail = (queue->head + queue->n_items) % queue->length;
+    // semaphores have no items (and pass NULL)
+    if (queue->item_size > 0 && item != NULL)
+        memcpy(&queue->items[tail * queue->item_size], item, queue->item_size);
+    queue->n_items++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t queue, const void *item,
+        BaseType_t *higher_priority_task_woken)
+{
+    if (higher_priority_task_woken != NULL)
+        *higher_priority_task_woken = pdFALSE;
+    return xQueueSendToBack(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    deadline_after(ticks_to_wait, &deadline);
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->n_items == 0) {
+        if (!wait_until(&queue->not_empty, &queue->lock, ticks_to_wait, &deadline)) {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFALSE;
+        }
+    }
+    if (queue->item_size > 0 && buffer != NULL)
+        memcpy(buffer, &queue->items[queue->head * queue->item_size], queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->n_items--;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t n_items = queue->n_items;
+    pthread_mutex_unlock(&queue->lock);
+    return n_items;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    configASSERT(initial_count <= max_count);
+    SemaphoreHandle_t semaphore = xQueueCreate(max_count, 0);
+    if (semaphore != NULL)
+        for (UBaseType_t i = 0; i < initial_count; i++)
+            xSemaphoreGive(semaphore);
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    if (mutex != NULL)
+        xSemaphoreGive(mutex);
+    return mutex;
+}
+
+/******************************************************************************/
+
+static void init_cond(pthread_cond_t *cond)
+{
+    // deadlines are not affected by changes of system time
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// returns false on timeout, the condition has to be checked by the caller anyway
+static bool wait_until(pthread_cond_t *cond, pthread_mutex_t *lock,
+        TickType_t ticks_to_wait, const struct timespec *deadline)
+{
+    if (ticks_to_wait == 0)
+        return false;
+    if (ticks_to_wait == portMAX_DELAY)
+        return pthread_cond_wait(cond, lock) == 0;
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+static void deadline_after(TickType_t ticks, struct timespec *deadline)
+{
+    if (ticks == 0 || ticks == portMAX_DELAY)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    uint64_t ns = (uint64_t) deadline->tv_nsec + (uint64_t) ticks * (1000000000 / configTICK_RATE_HZ);
+    deadline->tv_sec += ns / 1000000000;
+    deadline->tv_nsec = ns % 1000000000;
+}
+
+static struct PosixTask *new_task(void)
+{
+    struct PosixTask *task = calloc(1, sizeof(struct PosixTask));
+    if (task == NULL)
+        return NULL;
+    pthread_mutex_init(&task->lock, NULL);
+    init_cond(&task->notified);
+    return task;
+}
+
+static void *task_entry(void *arguments)
+{
+    current_task = (struct PosixTask *) arguments;
+    current_task->function(current_task->parameters);
+    // FreeRTOS tasks must not return
+    configASSERT(0);
+    return NULL;
+}
+
+static void init_critical_lock(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&critical_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
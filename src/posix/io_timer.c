@@ -0,0 +1,112 @@
+#include "io_timer.h"
+
+#include <string.h>
+#include <time.h>
+
+
+static uint64_t monotonic_ns(void);
+static void timer_start(void *context, uint32_t timeout_us);
+static void timer_stop(void *context);
+static uint32_t timer_now(void *context);
+static void *timer_thread(void *arguments);
+
+
+bool dynamixel_io_timer_init(DynamixelIOTimerThread *timer, DynamixelIOTaskHandle *io_task)
+{
+    memset(timer, 0, sizeof(*timer));
+    timer->io_task = io_task;
+    pthread_mutex_init(&timer->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&timer->changed, &attr);
+    pthread_condattr_destroy(&attr);
+
+    timer->running = true;
+    if (pthread_create(&timer->thread, NULL, timer_thread, timer) != 0) {
+        timer->running = false;
+        pthread_cond_destroy(&timer->changed);
+        pthread_mutex_destroy(&timer->lock);
+        return false;
+    }
+    return true;
+}
+
+void dynamixel_io_timer_deinit(DynamixelIOTimerThread *timer)
+{
+    pthread_mutex_lock(&timer->lock);
+    timer->running = false;
+    pthread_cond_signal(&timer->changed);
+    pthread_mutex_unlock(&timer->lock);
+    pthread_join(timer->thread, NULL);
+    pthread_cond_destroy(&timer->changed);
+    pthread_mutex_destroy(&timer->lock);
+}
+
+DynamixelIOTimer dynamixel_io_timer_driver(DynamixelIOTimerThread *timer)
+{
+    DynamixelIOTimer driver = {
+        .start = timer_start,
+        .stop = timer_stop,
+        .context = timer,
+        .now = timer_now,
+    };
+    return driver;
+}
+
+static void timer_start(void *context, uint32_t timeout_us)
+{
+    DynamixelIOTimerThread *timer = (DynamixelIOTimerThread *) context;
+    pthread_mutex_lock(&timer->lock);
+    timer->deadline_ns = monotonic_ns() + (uint64_t) timeout_us * 1000;
+    timer->armed = true;
+    pthread_cond_signal(&timer->changed);
+    pthread_mutex_unlock(&timer->lock);
+}
+
+static void timer_stop(void *context)
+{
+    DynamixelIOTimerThread *timer = (DynamixelIOTimerThread *) context;
+    pthread_mutex_lock(&timer->lock);
+    timer->armed = false;
+    pthread_mutex_unlock(&timer->lock);
+}
+
+static uint32_t timer_now(void *context)
+{
+    (void) context;
+    return (uint32_t) (monotonic_ns() / 1000);
+}
+
+static void *timer_thread(void *arguments)
+{
+    DynamixelIOTimerThread *timer = (DynamixelIOTimerThread *) arguments;
+    pthread_mutex_lock(&timer->lock);
+    while (timer->running) {
+        if (!timer->armed) {
+            pthread_cond_wait(&timer->changed, &timer->lock);
+            continue;
+        }
+        if (monotonic_ns() >= timer->deadline_ns) {
+            // notified with the lock taken, so that stop() is synchronous
+            timer->armed = false;
+            timer->n_expired++;
+            dynamixel_io_task_notify_timeout(timer->io_task);
+            continue;
+        }
+        struct timespec deadline = {
+            .tv_sec = (time_t) (timer->deadline_ns / 1000000000),
+            .tv_nsec = (long) (timer->deadline_ns % 1000000000),
+        };
+        pthread_cond_timedwait(&timer->changed, &timer->lock, &deadline);
+    }
+    pthread_mutex_unlock(&timer->lock);
+    return NULL;
+}
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Timer for microsecond timeouts of the IO task on POSIX systems
+ * (see dynamixel_io_task_set_timer()).
+ *
+ * A dedicated thread sleeps until the deadline (pthread_cond_timedwait() on
+ * CLOCK_MONOTONIC) and calls dynamixel_io_task_notify_timeout(). Stopping the timer
+ * is synchronous: after stop() returns the timeout is not notified.
+ * now() is CLOCK_MONOTONIC in microseconds (for adaptive timeouts).
+ *
+ * Usage:
+ *   DynamixelIOTimerThread timer;
+ *   dynamixel_io_timer_init(&timer, &io_task);
+ *   dynamixel_io_task_set_timer(&io_task, dynamixel_io_timer_driver(&timer),
+ *       600, 100);
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "io_task.h"
+
+typedef struct {
+    DynamixelIOTaskHandle *io_task;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    bool running;
+    bool armed;
+    uint64_t deadline_ns;         // CLOCK_MONOTONIC
+    uint32_t n_expired;           // number of notified timeouts
+} DynamixelIOTimerThread;
+
+// io_task is the handle the timer will be set for, returns false if the thread cannot be started
+bool dynamixel_io_timer_init(DynamixelIOTimerThread *timer, DynamixelIOTaskHandle *io_task);
+// stops the thread (the timer must not be used by the IO task after that)
+void dynamixel_io_timer_deinit(DynamixelIOTimerThread *timer);
+DynamixelIOTimer dynamixel_io_timer_driver(DynamixelIOTimerThread *timer);
+
+#ifdef __cplusplus
+}
+#endif
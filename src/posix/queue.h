@@ -0,0 +1,23 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "FreeRTOS.h"
+
+typedef struct PosixQueue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t queue_length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait);
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t queue, const void *item,
+        BaseType_t *higher_priority_task_woken);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+#define xQueueSend      xQueueSendToBack
+
+#ifdef __cplusplus
+}
+#endif
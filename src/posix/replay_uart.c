@@ -0,0 +1,160 @@
+#include "replay_uart.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+static void deliver(DynamixelReplayUART *replay);
+static int replay_write(void *context, uint8_t *data, size_t data_len);
+static int replay_read(void *context, uint8_t *data, size_t data_len);
+static int replay_reset(void *context);
+
+
+bool dynamixel_replay_uart_init(DynamixelReplayUART *replay, DynamixelIOTaskHandle *io_task,
+        const uint8_t *log, size_t log_size)
+{
+    memset(replay, 0, sizeof(*replay));
+    replay->io_task = io_task;
+    replay->log = log;
+    replay->log_size = log_size;
+    replay->offset = dynamixel_capture_header_check(log, log_size, &replay->protocol);
+    replay->status = dio_UNDEFINED;
+    return replay->offset > 0;
+}
+
+DynamixelIOUARTDriver dynamixel_replay_uart_driver(DynamixelReplayUART *replay)
+{
+    DynamixelIOUARTDriver driver = {
+        .write = replay_write,
+        .read = replay_read,
+        .reset = replay_reset,
+        .context = replay,
+    };
+    return driver;
+}
+
+int dynamixel_replay_run(DynamixelReplayUART *replay, int *n_different)
+{
+    *n_different = 0;
+    size_t offset = dynamixel_capture_header_check(replay->log, replay->log_size, NULL);
+    if (offset == 0 || replay->io_task->protocol != replay->protocol)
+        return -1;
+    // both the packet and its response are written into it
+    uint8_t *buffer = malloc(UINT16_MAX);
+    if (buffer == NULL)
+        return -1;
+
+    int n_transactions = 0;
+    DynamixelIOCaptureRecord record;
+    const uint8_t *tx_data, *rx_data;
+    // a dropped transaction is missing from the log whole, the others are not affected
+    while (dynamixel_capture_next(replay->log, replay->log_size, &offset, &record, &tx_data, &rx_data)) {
+        memcpy(buffer, tx_data, record.tx_length);
+        DynamixelIORequest request = {
+            .packet = (DynamixelPacket *) buffer,
+            .tx_size = record.tx_length,
+            .response_size = record.response_size,
+            .n_responses = record.n_responses > 0 ? record.n_responses : 1,
+            .ignore_response = false,
+            .completion = NULL
+        };
+        DynamixelIOResponse response;
+        if (!dynamixel_io_submit(replay->io_task, &request)
+                || !dynamixel_io_wait_response(replay->io_task, &response)) {
+            n_transactions = -1;
+            break;
+        }
+        n_transactions++;
+        if (record.status != response.status)
+            (*n_different)++;
+        dynamixel_io_release_response(replay->io_task, &response);
+    }
+    free(buffer);
+    return n_transactions;
+}
+
+/*** UART driver **************************************************************/
+
+static int replay_write(void *context, uint8_t *data, size_t data_len)
+{
+    DynamixelReplayUART *replay = (DynamixelReplayUART *) context;
+    // responses to the previous transfer are lost
+    replay->receiving = false;
+    replay->response_size = 0;
+    replay->n_delivered = 0;
+
+    DynamixelIOCaptureRecord record;
+    const uint8_t *tx_data, *rx_data;
+    if (!dynamixel_capture_next(replay->log, replay->log_size, &replay->offset, &record,
+                &tx_data, &rx_data)) {
+        replay->n_overruns++;
+        return -1;
+    }
+    replay->n_transfers++;
+    if (record.tx_length != data_len || memcmp(tx_data, data, data_len) != 0)
+        replay->n_mismatches++;
+
+    replay->status = (DynamixelIOStatus) record.status;
+    replay->response = rx_data;
+    replay->response_size = record.rx_length;
+    switch (replay->status) {
+    case dio_UART_WRITE_ERROR:
+        return -1;
+    case dio_UART_WRITE_TIMEOUT:
+        // the IO task is never notified
+        return 0;
+    case dio_WRONG_NOTIFICATION:
+        dynamixel_io_task_notify_transmission_complete(replay->io_task, dio_READ_COMPLETED);
+        return 0;
+    default:
+        // the IO task may start reception right away (chained reception)
+        dynamixel_io_task_notify_transmission_complete(replay->io_task, dio_WRITE_COMPLETED);
+        return 0;
+    }
+}
+
+static int replay_read(void *context, uint8_t *data, size_t data_len)
+{
+    DynamixelReplayUART *replay = (DynamixelReplayUART *) context;
+    if (replay->status == dio_UART_READ_ERROR)
+        return -1;
+    replay->receiving = true;
+    replay->read_data = data;
+    replay->read_len = (int) data_len;
+    deliver(replay);
+    return 0;
+}
+
+static int replay_reset(void *context)
+{
+    DynamixelReplayUART *replay = (DynamixelReplayUART *) context;
+    replay->receiving = false;
+    replay->response_size = 0;
+    replay->n_delivered = 0;
+    return 0;
+}
+
+// passes the recorded response (if it is all there, the IO task times out otherwise)
+static void deliver(DynamixelReplayUART *replay)
+{
+    if (replay->exact_reads) {
+        if (replay->n_delivered + replay->read_len > replay->response_size)
+            return;
+        memcpy(replay->read_data, &replay->response[replay->n_delivered], replay->read_len);
+        replay->n_delivered += replay->read_len;
+        replay->receiving = false;
+        dynamixel_io_task_notify_transmission_complete(replay->io_task, dio_READ_COMPLETED);
+        return;
+    }
+
+    // byte by byte, to stop when the IO task has got the whole response
+    while (replay->n_delivered < replay->response_size && replay->io_task->rx_parser_armed) {
+        taskENTER_CRITICAL();
+        dynamixel_io_task_notify_bytes_received(replay->io_task,
+                &replay->response[replay->n_delivered], 1);
+        taskEXIT_CRITICAL();
+        replay->n_delivered++;
+    }
+    if (!replay->io_task->rx_parser_armed)
+        replay->receiving = false;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * UART driver for the IO task (like virtual_bus.h) that replays a log captured
+ * with dynamixel_io_task_set_capture() (io_capture.h), e.g. from a robot in the field:
+ * each written packet takes the next transaction of the log and gets its recorded
+ * response (or failure), so the same application code can be run against it
+ * deterministically, without hardware. A transaction dropped by the capture ring
+ * is missing from the log whole (with its response).
+ *
+ * Written bytes are compared with the recorded packets (a difference is counted
+ * in n_mismatches, the recorded response is given anyway). Failures are reproduced
+ * by their status: write error, missing write notification, wrong notification,
+ * read error and missing (or truncated) response - the task waits for its timeout then.
+ * Exactly the recorded bytes are received (with exact_reads only a whole response).
+ * Everything happens immediately in the driver functions (like virtual time
+ * of the virtual bus), the recorded timing is not reproduced.
+ *
+ * dynamixel_replay_run() sends all the recorded packets itself, to check that the IO task
+ * ends each transaction with the same status as in the log.
+ *
+ * Usage:
+ *   DynamixelReplayUART replay;
+ *   dynamixel_replay_uart_init(&replay, &io_task, log, log_size);
+ *   dynamixel_io_task_create_with_driver(&io_task, "dxl", 1, 1,
+ *       dynamixel_replay_uart_driver(&replay), 10 + 1, 1000);
+ *   int n_different;
+ *   int n_transactions = dynamixel_replay_run(&replay, &n_different);
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "io_task.h"
+#include "io_capture.h"
+
+typedef struct {
+    DynamixelIOTaskHandle *io_task;
+    const uint8_t *log;
+    size_t log_size;
+    size_t offset;            // of the next record used by the driver
+    uint8_t protocol;         // of the log
+    bool exact_reads;         // copy response into buffer of read function
+
+    // recorded end of the current transaction
+    DynamixelIOStatus status;
+    const uint8_t *response;
+    int response_size;
+    int n_delivered;          // number of bytes passed to the IO task
+    bool receiving;           // the IO task has started reception
+    uint8_t *read_data;       // buffer and length given to the read function
+    int read_len;
+
+    uint32_t n_transfers;     // packets written by the IO task
+    uint32_t n_mismatches;    // written packets that differ from the recorded ones
+    uint32_t n_overruns;      // packets written after the end of the log (write error)
+} DynamixelReplayUART;
+
+// log must stay valid while it is replayed, returns false if its header is not valid
+bool dynamixel_replay_uart_init(DynamixelReplayUART *replay, DynamixelIOTaskHandle *io_task,
+        const uint8_t *log, size_t log_size);
+DynamixelIOUARTDriver dynamixel_replay_uart_driver(DynamixelReplayUART *replay);
+// sends every recorded packet to the IO task (created with the driver of the replay,
+// with the same protocol as the log) and waits for its response, counts transactions
+// that end with a different status than recorded into *n_different;
+// returns the number of transactions or -1 if it cannot be run
+int dynamixel_replay_run(DynamixelReplayUART *replay, int *n_different);
+
+#ifdef __cplusplus
+}
+#endif
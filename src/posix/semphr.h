@@ -0,0 +1,24 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "queue.h"
+
+// semaphores are queues of zero-sized items, just like in FreeRTOS
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+// not recursive and without priority inheritance
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+
+#define vSemaphoreDelete(sem)                   vQueueDelete(sem)
+#define xSemaphoreTake(sem, ticks_to_wait)      xQueueReceive((sem), NULL, (ticks_to_wait))
+#define xSemaphoreGive(sem)                     xQueueSendToBack((sem), NULL, 0)
+#define xSemaphoreGiveFromISR(sem, woken)       xQueueSendToBackFromISR((sem), NULL, (woken))
+
+#ifdef __cplusplus
+}
+#endif
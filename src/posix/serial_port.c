@@ -0,0 +1,275 @@
+#include "serial_port.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#   include <linux/serial.h>
+#endif
+
+
+static bool baud_rate_to_speed(int baud_rate, speed_t *speed);
+static void set_low_latency(int fd);
+static void *rx_thread(void *arguments);
+static int serial_write(void *context, uint8_t *data, size_t data_len);
+static int serial_read(void *context, uint8_t *data, size_t data_len);
+static int serial_reset(void *context);
+
+
+bool dynamixel_serial_port_open(DynamixelSerialPort *port, DynamixelIOTaskHandle *io_task,
+        const char *device, int baud_rate)
+{
+    speed_t speed;
+    int result;
+    if (!baud_rate_to_speed(baud_rate, &speed)) {
+        errno = EINVAL;
+        return false;
+    }
+
+    port->io_task = io_task;
+    port->receiving = false;
+    port->n_pending = 0;
+
+    port->fd = open(device, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (port->fd < 0)
+        return false;
+
+    // raw 8N1, read() returns whatever is available (after poll())
+    struct termios tty;
+    if (tcgetattr(port->fd, &tty) != 0)
+        goto error_close_fd;
+    cfmakeraw(&tty);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cflag &= ~(CSTOPB | PARENB);
+#ifdef CRTSCTS
+    tty.c_cflag &= ~CRTSCTS;
+#endif
+    tty.c_cc[VMIN] = 1;
+    tty.c_cc[VTIME] = 0;
+    if (cfsetispeed(&tty, speed) != 0 || cfsetospeed(&tty, speed) != 0)
+        goto error_close_fd;
+    if (tcsetattr(port->fd, TCSANOW, &tty) != 0)
+        goto error_close_fd;
+    set_low_latency(port->fd);
+    tcflush(port->fd, TCIOFLUSH);
+
+    if (pipe(port->wakeup_pipe) != 0)
+        goto error_close_fd;
+    if (pthread_mutex_init(&port->lock, NULL) != 0)
+        goto error_close_pipe;
+    result = pthread_create(&port->rx_thread, NULL, rx_thread, port);
+    if (result != 0) {
+        pthread_mutex_destroy(&port->lock);
+        errno = result;
+        goto error_close_pipe;
+    }
+    return true;
+
+error_close_pipe:
+    close(port->wakeup_pipe[0]);
+    close(port->wakeup_pipe[1]);
+error_close_fd:
+    result = errno;
+    close(port->fd);
+    errno = result;
+    return false;
+}
+
+void dynamixel_serial_port_close(DynamixelSerialPort *port)
+{
+    uint8_t stop = 0;
+    while (write(port->wakeup_pipe[1], &stop, 1) < 0 && errno == EINTR)
+        continue;
+    pthread_join(port->rx_thread, NULL);
+    pthread_mutex_destroy(&port->lock);
+    close(port->wakeup_pipe[0]);
+    close(port->wakeup_pipe[1]);
+    close(port->fd);
+}
+
+DynamixelIOUARTDriver dynamixel_serial_port_driver(DynamixelSerialPort *port)
+{
+    DynamixelIOUARTDriver driver = {
+        .write = serial_write,
+        .read = serial_read,
+        .reset = serial_reset,
+        .context = port,
+    };
+    return driver;
+}
+
+uint32_t dynamixel_serial_port_byte_time_us(int baud_rate)
+{
+    // start bit + 8 data bits + stop bit
+    return (10 * 1000000 + (uint32_t) baud_rate - 1) / (uint32_t) baud_rate;
+}
+
+/******************************************************************************/
+
+static int serial_write(void *context, uint8_t *data, size_t data_len)
+{
+    DynamixelSerialPort *port = (DynamixelSerialPort *) context;
+
+    // anything received up to now is not a response to this request
+    pthread_mutex_lock(&port->lock);
+    port->receiving = false;
+    port->n_pending = 0;
+    pthread_mutex_unlock(&port->lock);
+    tcflush(port->fd, TCIFLUSH);
+
+    while (data_len > 0) {
+        ssize_t n_written = write(port->fd, data, data_len);
+        if (n_written < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n_written;
+        data_len -= (size_t) n_written;
+    }
+    // wait until all the data has been transmitted, so the timeout of reception
+    // does not include time spent in output buffers
+    if (tcdrain(port->fd) != 0)
+        return -1;
+
+    dynamixel_io_task_notify_transmission_complete(port->io_task, dio_WRITE_COMPLETED);
+    return 0;
+}
+
+static int serial_read(void *context, uint8_t *data, size_t data_len)
+{
+    // data is received in the rx_thread and passed to the parser
+    (void) data;
+    (void) data_len;
+    DynamixelSerialPort *port = (DynamixelSerialPort *) context;
+
+    pthread_mutex_lock(&port->lock);
+    port->receiving = true;
+    if (port->n_pending > 0) {
+        taskENTER_CRITICAL();
+        dynamixel_io_task_notify_bytes_received(port->io_task, port->pending,
+                (size_t) port->n_pending);
+        taskEXIT_CRITICAL();
+        port->n_pending = 0;
+    }
+    pthread_mutex_unlock(&port->lock);
+    return 0;
+}
+
+static int serial_reset(void *context)
+{
+    DynamixelSerialPort *port = (DynamixelSerialPort *) context;
+    pthread_mutex_lock(&port->lock);
+    port->receiving = false;
+    port->n_pending = 0;
+    pthread_mutex_unlock(&port->lock);
+    return tcflush(port->fd, TCIOFLUSH) == 0 ? 0 : -1;
+}
+
+static void *rx_thread(void *arguments)
+{
+    DynamixelSerialPort *port = (DynamixelSerialPort *) arguments;
+    uint8_t buffer[DYNAMIXEL_SERIAL_PORT_BUFFER_SIZE];
+    struct pollfd fds[2] = {
+        { .fd = port->fd, .events = POLLIN },
+        { .fd = port->wakeup_pipe[0], .events = POLLIN },
+    };
+
+    while (1) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents != 0)
+            break;
+        // device has been disconnected (or the other side of pty closed)
+        if ((fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0
+                && (fds[0].revents & POLLIN) == 0)
+            break;
+
+        ssize_t n_read = read(port->fd, buffer, sizeof(buffer));
+        if (n_read < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if (n_read <= 0)
+            break;
+
+        pthread_mutex_lock(&port->lock);
+        if (port->receiving) {
+            // like an interrupt, it must not run in a critical section of the IO task
+            taskENTER_CRITICAL();
+            dynamixel_io_task_notify_bytes_received(port->io_task, buffer, (size_t) n_read);
+            taskEXIT_CRITICAL();
+        } else {
+            // keep the newest bytes, the response is at the end
+            // (buffer is not larger than pending, so at most all of them are replaced)
+            int n = (int) n_read;
+            int n_dropped = port->n_pending + n - (int) sizeof(port->pending);
+            if (n_dropped > 0) {
+                memmove(port->pending, &port->pending[n_dropped], port->n_pending - n_dropped);
+                port->n_pending -= n_dropped;
+            }
+            memcpy(&port->pending[port->n_pending], buffer, n);
+            port->n_pending += n;
+        }
+        pthread_mutex_unlock(&port->lock);
+    }
+    return NULL;
+}
+
+static bool baud_rate_to_speed(int baud_rate, speed_t *speed)
+{
+    static const struct {
+        int baud_rate;
+        speed_t speed;
+    } speeds[] = {
+        {9600, B9600}, {19200, B19200}, {57600, B57600}, {115200, B115200},
+#ifdef B230400
+        {230400, B230400},
+#endif
+#ifdef B460800
+        {460800, B460800},
+#endif
+#ifdef B500000
+        {500000, B500000},
+#endif
+#ifdef B1000000
+        {1000000, B1000000},
+#endif
+#ifdef B2000000
+        {2000000, B2000000},
+#endif
+#ifdef B3000000
+        {3000000, B3000000},
+#endif
+#ifdef B4000000
+        {4000000, B4000000},
+#endif
+    };
+    for (size_t i = 0; i < sizeof(speeds) / sizeof(*speeds); i++) {
+        if (speeds[i].baud_rate == baud_rate) {
+            *speed = speeds[i].speed;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void set_low_latency(int fd)
+{
+#if defined(__linux__) && defined(ASYNC_LOW_LATENCY)
+    // makes the driver push received data immediately (not supported by all of them)
+    struct serial_struct serial;
+    if (ioctl(fd, TIOCGSERIAL, &serial) == 0) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        ioctl(fd, TIOCSSERIAL, &serial);
+    }
+#else
+    (void) fd;
+#endif
+}
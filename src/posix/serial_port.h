@@ -0,0 +1,64 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * UART driver for the IO task on POSIX systems (termios serial device,
+ * e.g. /dev/ttyUSB0 with USB2Dynamixel/U2D2, or a pseudo-terminal in tests).
+ *
+ * Device is configured in raw mode (8N1, no flow control), with low latency
+ * mode requested on Linux (ASYNC_LOW_LATENCY, ignored if not supported).
+ * A dedicated thread waits for data with poll() and passes each chunk to
+ * dynamixel_io_task_notify_bytes_received(), so the response is parsed
+ * as soon as it arrives.
+ *
+ * Usage:
+ *   DynamixelIOTaskHandle io_task;
+ *   DynamixelSerialPort serial;
+ *   dynamixel_serial_port_open(&serial, &io_task, "/dev/ttyUSB0", 1000000);
+ *   dynamixel_io_task_create_with_driver(&io_task, "dxl", 1, 1,
+ *       dynamixel_serial_port_driver(&serial), 10 + 1, 1000);
+ *
+ * Bytes received after transmission has ended, but before the task has started
+ * reception, are buffered, so fast responses are not lost. Lines that echo
+ * transmitted bytes are not supported (adapters with direction control do not echo).
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "io_task.h"
+
+#ifndef DYNAMIXEL_SERIAL_PORT_BUFFER_SIZE
+#   define DYNAMIXEL_SERIAL_PORT_BUFFER_SIZE   256
+#endif
+
+typedef struct {
+    int fd;
+    int wakeup_pipe[2];           // used to stop the reception thread
+    pthread_t rx_thread;
+    DynamixelIOTaskHandle *io_task;
+    // state shared with the reception thread
+    pthread_mutex_t lock;
+    bool receiving;               // the task waits for response
+    int n_pending;                // number of bytes received before reception started
+    uint8_t pending[DYNAMIXEL_SERIAL_PORT_BUFFER_SIZE];
+} DynamixelSerialPort;
+
+// opens and configures the device and starts reception thread,
+// io_task is the handle that will be created with this driver,
+// returns false on error (errno is set)
+bool dynamixel_serial_port_open(DynamixelSerialPort *port, DynamixelIOTaskHandle *io_task,
+        const char *device, int baud_rate);
+// stops reception thread and closes the device (the IO task must not be used after that)
+void dynamixel_serial_port_close(DynamixelSerialPort *port);
+DynamixelIOUARTDriver dynamixel_serial_port_driver(DynamixelSerialPort *port);
+// time needed to transmit one byte (with start and stop bits) in microseconds, rounded up
+uint32_t dynamixel_serial_port_byte_time_us(int baud_rate);
+
+#ifdef __cplusplus
+}
+#endif
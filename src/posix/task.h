@@ -0,0 +1,41 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "FreeRTOS.h"
+
+typedef struct PosixTask *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreate(TaskFunction_t task_function, const char * const name,
+        uint16_t stack_depth, void *parameters, UBaseType_t priority,
+        TaskHandle_t *created_task);
+// only the calling task can be deleted (task = NULL)
+void vTaskDelete(TaskHandle_t task);
+// also for threads not created with xTaskCreate() (e.g. main thread)
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+void vTaskDelay(TickType_t ticks_to_delay);
+TickType_t xTaskGetTickCount(void);
+TickType_t xTaskGetTickCountFromISR(void);
+
+// critical sections exclude each other globally (like disabled interrupts on one core),
+// they may be nested; drivers call notifications of the IO task that are meant
+// for interrupts in a critical section, so that they do not run in the middle of one
+void vTaskEnterCritical(void);
+void vTaskExitCritical(void);
+#define taskENTER_CRITICAL()        vTaskEnterCritical()
+#define taskEXIT_CRITICAL()         vTaskExitCritical()
+// the same lock (interrupts are not nested by priority here)
+#define taskENTER_CRITICAL_FROM_ISR()           (vTaskEnterCritical(), (UBaseType_t) 0)
+#define taskEXIT_CRITICAL_FROM_ISR(saved)       ((void) (saved), vTaskExitCritical())
+
+// task notifications used as counting semaphore
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken);
+
+#ifdef __cplusplus
+}
+#endif
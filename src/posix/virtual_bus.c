@@ -0,0 +1,646 @@
+#include "virtual_bus.h"
+
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "dynamixel.h"
+
+
+// registers that can be written with WRITE instruction
+static const bool writable[DYNAMIXEL_VIRTUAL_SERVO_TABLE_SIZE] = {
+    [DYNAMIXEL_ID] = true,
+    [DYNAMIXEL_BAUD_RATE] = true,
+    [DYNAMIXEL_RETURN_DELAY_TIME] = true,
+    [DYNAMIXEL_CW_ANGLE_LIMIT_L ... DYNAMIXEL_CCW_ANGLE_LIMIT_H] = true,
+    [DYNAMIXEL_LIMIT_TEMPERATURE ... DYNAMIXEL_ALARM_SHUTDOWN] = true,
+    [DYNAMIXEL_TORQUE_ENABLE ... DYNAMIXEL_TORQUE_LIMIT_H] = true,
+    [DYNAMIXEL_LOCK ... DYNAMIXEL_PUNCH_H] = true,
+};
+
+static uint64_t real_time_ns(void);
+static uint64_t current_time_ns(DynamixelVirtualBus *bus);
+static bool baud_rate_matches(DynamixelVirtualBus *bus, DynamixelVirtualServo *servo);
+static uint8_t write_table(DynamixelVirtualServo *servo, uint8_t address,
+        const uint8_t *data, int data_len);
+static void process_instruction(DynamixelVirtualBus *bus, bool checksum_ok, uint64_t end_ns);
+static bool is_mx_model(uint16_t model_number);
+static void process_bulk_read(DynamixelVirtualBus *bus, uint64_t end_ns);
+static void add_response(DynamixelVirtualBus *bus, uint8_t id, uint8_t error,
+        const uint8_t *data, int data_len, uint64_t start_ns);
+static void deliver(DynamixelVirtualBus *bus, uint64_t until_ns);
+static uint32_t random_next(DynamixelVirtualBus *bus);
+static uint32_t choose_faults(DynamixelVirtualBus *bus);
+static void apply_response_faults(DynamixelVirtualBus *bus, uint32_t faults);
+static void *real_time_thread(void *arguments);
+static int bus_write(void *context, uint8_t *data, size_t data_len);
+static int bus_read(void *context, uint8_t *data, size_t data_len);
+static int bus_reset(void *context);
+
+
+void dynamixel_virtual_servo_init(DynamixelVirtualServo *servo, uint8_t id)
+{
+    dynamixel_virtual_servo_init_model(servo, id, DYNAMIXEL_AX12_MODEL_NUMBER);
+}
+
+void dynamixel_virtual_servo_init_model(DynamixelVirtualServo *servo, uint8_t id,
+        uint16_t model_number)
+{
+    memset(servo, 0, sizeof(*servo));
+    uint8_t *t = servo->table;
+    t[DYNAMIXEL_MODEL_NUMBER_L] = model_number & 0xff;
+    t[DYNAMIXEL_MODOEL_NUMBER_H] = model_number >> 8;
+    t[DYNAMIXEL_VERSION] = 0x18;
+    t[DYNAMIXEL_ID] = id;
+    t[DYNAMIXEL_BAUD_RATE] = DYNAMIXEL_BAUD_RATE_1000000;
+    t[DYNAMIXEL_RETURN_DELAY_TIME] = 250;
+    t[DYNAMIXEL_CCW_ANGLE_LIMIT_L] = 0xff;
+    t[DYNAMIXEL_CCW_ANGLE_LIMIT_H] = 0x03;
+    t[DYNAMIXEL_LIMIT_TEMPERATURE] = 70;
+    t[DYNAMIXEL_DOWN_LIMIT_VOLTAGE] = 60;
+    t[DYNAMIXEL_UP_LIMIT_VOLTAGE] = 140;
+    t[DYNAMIXEL_MAX_TORQUE_L] = 0xff;
+    t[DYNAMIXEL_MAX_TORQUE_H] = 0x03;
+    t[DYNAMIXEL_RETURN_LEVEL] = DYNAMIXEL_STATUS_RESPONSE_ALWAYS;
+    t[DYNAMIXEL_ALARM_LED] = DYNAMIXEL_ERROR_OVERLOAD_MASK | DYNAMIXEL_ERROR_OVERHEATING_MASK;
+    t[DYNAMIXEL_ALARM_SHUTDOWN] = DYNAMIXEL_ERROR_OVERLOAD_MASK | DYNAMIXEL_ERROR_OVERHEATING_MASK;
+    t[DYNAMIXEL_CW_COMPLIANCE_MARGIN] = 1;
+    t[DYNAMIXEL_CCW_COMPLIANCE_MARGIN] = 1;
+    t[DYNAMIXEL_CW_COMPLIANCE_SLOPE] = 32;
+    t[DYNAMIXEL_CCW_COMPLIANCE_SLOPE] = 32;
+    t[DYNAMIXEL_TORQUE_LIMIT_L] = 0xff;
+    t[DYNAMIXEL_TORQUE_LIMIT_H] = 0x03;
+    // in the middle of the range, not moving
+    t[DYNAMIXEL_GOAL_POSITION_H] = 0x02;
+    t[DYNAMIXEL_PRESENT_POSITION_H] = 0x02;
+    t[DYNAMIXEL_PRESENT_VOLTAGE] = 120;
+    t[DYNAMIXEL_PRESENT_TEMPERATURE] = 30;
+    t[DYNAMIXEL_PUNCH_L] = 0x20;
+    servo->connected = true;
+}
+
+uint8_t dynamixel_virtual_servo_read_u8(DynamixelVirtualServo *servo, uint8_t address)
+{
+    return servo->table[address];
+}
+
+uint16_t dynamixel_virtual_servo_read_u16(DynamixelVirtualServo *servo, uint8_t address)
+{
+    return servo->table[address] | (servo->table[address + 1] << 8);
+}
+
+void dynamixel_virtual_servo_write_u8(DynamixelVirtualServo *servo, uint8_t address, uint8_t value)
+{
+    servo->table[address] = value;
+}
+
+void dynamixel_virtual_servo_write_u16(DynamixelVirtualServo *servo, uint8_t address, uint16_t value)
+{
+    servo->table[address] = value & 0xff;
+    servo->table[address + 1] = value >> 8;
+}
+
+bool dynamixel_virtual_bus_init(DynamixelVirtualBus *bus, DynamixelIOTaskHandle *io_task,
+        DynamixelVirtualServo *servos, int n_servos, int baud_rate, bool virtual_time)
+{
+    memset(bus, 0, sizeof(*bus));
+    bus->servos = servos;
+    bus->n_servos = n_servos;
+    bus->baud_rate = baud_rate;
+    // start bit + 8 data bits + stop bit
+    bus->byte_time_ns = (uint32_t) ((10ULL * 1000000000 + baud_rate - 1) / baud_rate);
+    bus->virtual_time = virtual_time;
+    bus->io_task = io_task;
+    bus->start_ns = real_time_ns();
+    bus->random_state = 1;
+    dynamixel_packet_parser_init_sized(&bus->parser, &bus->instruction,
+            DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS);
+
+    pthread_mutex_init(&bus->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&bus->changed, &attr);
+    pthread_condattr_destroy(&attr);
+    if (virtual_time)
+        return true;
+
+    bus->running = true;
+    if (pthread_create(&bus->thread, NULL, real_time_thread, bus) != 0) {
+        bus->running = false;
+        return false;
+    }
+    return true;
+}
+
+void dynamixel_virtual_bus_deinit(DynamixelVirtualBus *bus)
+{
+    if (bus->running) {
+        pthread_mutex_lock(&bus->lock);
+        bus->running = false;
+        pthread_cond_signal(&bus->changed);
+        pthread_mutex_unlock(&bus->lock);
+        pthread_join(bus->thread, NULL);
+    }
+    pthread_cond_destroy(&bus->changed);
+    pthread_mutex_destroy(&bus->lock);
+}
+
+DynamixelIOUARTDriver dynamixel_virtual_bus_driver(DynamixelVirtualBus *bus)
+{
+    DynamixelIOUARTDriver driver = {
+        .write = bus_write,
+        .read = bus_read,
+        .reset = bus_reset,
+        .context = bus,
+    };
+    return driver;
+}
+
+uint64_t dynamixel_virtual_bus_time_us(DynamixelVirtualBus *bus)
+{
+    pthread_mutex_lock(&bus->lock);
+    uint64_t now_ns = current_time_ns(bus);
+    pthread_mutex_unlock(&bus->lock);
+    return now_ns / 1000;
+}
+
+void dynamixel_virtual_bus_set_fault_rate(DynamixelVirtualBus *bus,
+        DynamixelVirtualBusFault fault, float rate)
+{
+    pthread_mutex_lock(&bus->lock);
+    bus->fault_rates[fault] = rate;
+    pthread_mutex_unlock(&bus->lock);
+}
+
+void dynamixel_virtual_bus_seed(DynamixelVirtualBus *bus, uint32_t seed)
+{
+    pthread_mutex_lock(&bus->lock);
+    // xorshift cannot leave zero state
+    bus->random_state = seed != 0 ? seed : 1;
+    pthread_mutex_unlock(&bus->lock);
+}
+
+void dynamixel_virtual_bus_inject(DynamixelVirtualBus *bus, DynamixelVirtualBusFault fault)
+{
+    pthread_mutex_lock(&bus->lock);
+    bus->forced_faults |= 1u << fault;
+    pthread_mutex_unlock(&bus->lock);
+}
+
+/*** UART driver **************************************************************/
+
+static int bus_write(void *context, uint8_t *data, size_t data_len)
+{
+    DynamixelVirtualBus *bus = (DynamixelVirtualBus *) context;
+    pthread_mutex_lock(&bus->lock);
+
+    // responses to the previous transfer are lost
+    bus->receiving = false;
+    bus->response_size = 0;
+    bus->n_delivered = 0;
+
+    uint32_t faults = choose_faults(bus);
+    if (faults & (1u << dvb_FAULT_WRITE_ERROR)) {
+        bus->fault_counts[dvb_FAULT_WRITE_ERROR]++;
+        pthread_mutex_unlock(&bus->lock);
+        return -1;
+    }
+    bool missing = faults & (1u << dvb_FAULT_MISSING_SERVO);
+    if (missing)
+        bus->fault_counts[dvb_FAULT_MISSING_SERVO]++;
+
+    // servos receive the packets byte by byte
+    uint64_t time_ns = current_time_ns(bus);
+    dynamixel_packet_parser_reset(&bus->parser);
+    for (size_t i = 0; i < data_len; i++) {
+        time_ns += bus->byte_time_ns;
+        DynamixelParserResult result = dynamixel_packet_parser_feed_byte(&bus->parser, data[i]);
+        if (result == dpr_IN_PROGRESS)
+            continue;
+        if (!missing && (result == dpr_PACKET_READY || result == dpr_WRONG_CHECKSUM))
+            process_instruction(bus, result == dpr_PACKET_READY, time_ns);
+        dynamixel_packet_parser_reset(&bus->parser);
+    }
+    apply_response_faults(bus, faults);
+
+    bool spurious = faults & (1u << dvb_FAULT_SPURIOUS_NOTIFICATION);
+    if (spurious)
+        bus->fault_counts[dvb_FAULT_SPURIOUS_NOTIFICATION]++;
+    if (!bus->virtual_time) {
+        bus->write_end_ns = time_ns;
+        bus->write_pending = true;
+        bus->write_spurious = spurious;
+        pthread_cond_signal(&bus->changed);
+        pthread_mutex_unlock(&bus->lock);
+        return 0;
+    }
+    bus->now_ns = time_ns;
+    pthread_mutex_unlock(&bus->lock);
+    // not locked, the IO task may start reception right away (chained reception)
+    dynamixel_io_task_notify_transmission_complete(bus->io_task,
+            spurious ? dio_READ_COMPLETED : dio_WRITE_COMPLETED);
+    return 0;
+}
+
+static int bus_read(void *context, uint8_t *data, size_t data_len)
+{
+    DynamixelVirtualBus *bus = (DynamixelVirtualBus *) context;
+    pthread_mutex_lock(&bus->lock);
+    bus->receiving = true;
+    bus->read_data = data;
+    bus->read_len = (int) data_len;
+
+    if (bus->virtual_time) {
+        // deliver what would arrive before the timeout armed by the IO task expires,
+        // inter-byte timeouts are armed again by each byte
+        bool rearmed;
+        uint64_t deadline_ns = bus->now_ns
+            + (uint64_t) dynamixel_io_task_get_rx_timeout_us(bus->io_task, &rearmed) * 1000;
+        while (rearmed && !bus->exact_reads && bus->receiving && bus->n_delivered < bus->response_size
+                && bus->arrival_ns[bus->n_delivered] <= deadline_ns) {
+            uint64_t arrival_ns = bus->arrival_ns[bus->n_delivered];
+            deliver(bus, arrival_ns);
+            deadline_ns = arrival_ns
+                + (uint64_t) dynamixel_io_task_get_rx_timeout_us(bus->io_task, NULL) * 1000;
+        }
+        deliver(bus, deadline_ns);
+        // the task waits until the end of the response or for the whole timeout
+        if (bus->receiving)
+            bus->now_ns = deadline_ns;
+        else if (bus->n_delivered > 0 && bus->arrival_ns[bus->n_delivered - 1] > bus->now_ns)
+            bus->now_ns = bus->arrival_ns[bus->n_delivered - 1];
+    } else {
+        pthread_cond_signal(&bus->changed);
+    }
+    pthread_mutex_unlock(&bus->lock);
+    return 0;
+}
+
+static int bus_reset(void *context)
+{
+    DynamixelVirtualBus *bus = (DynamixelVirtualBus *) context;
+    pthread_mutex_lock(&bus->lock);
+    bus->receiving = false;
+    bus->write_pending = false;
+    bus->response_size = 0;
+    bus->n_delivered = 0;
+    pthread_mutex_unlock(&bus->lock);
+    return 0;
+}
+
+// passes bytes that arrived until the given time, must be called with the lock taken
+static void deliver(DynamixelVirtualBus *bus, uint64_t until_ns)
+{
+    if (bus->exact_reads) {
+        int last = bus->n_delivered + bus->read_len - 1;
+        if (last >= bus->response_size || bus->arrival_ns[last] > until_ns)
+            return;
+        memcpy(bus->read_data, &bus->response[bus->n_delivered], bus->read_len);
+        bus->n_delivered += bus->read_len;
+        bus->receiving = false;
+        dynamixel_io_task_notify_transmission_complete(bus->io_task, dio_READ_COMPLETED);
+        return;
+    }
+
+    int start = bus->n_delivered;
+    int end = start;
+    while (end < bus->response_size && bus->arrival_ns[end] <= until_ns)
+        end++;
+    if (end == start)
+        return;
+    if (bus->virtual_time) {
+        // byte by byte, to know when the IO task has got the whole response
+        while (bus->n_delivered < end && bus->io_task->rx_parser_armed) {
+            taskENTER_CRITICAL();
+            dynamixel_io_task_notify_bytes_received(bus->io_task,
+                    &bus->response[bus->n_delivered], 1);
+            taskEXIT_CRITICAL();
+            bus->n_delivered++;
+        }
+        if (!bus->io_task->rx_parser_armed)
+            bus->receiving = false;
+    } else {
+        // the parser ignores anything after the response; like an interrupt,
+        // it must not run in a critical section of the IO task
+        taskENTER_CRITICAL();
+        dynamixel_io_task_notify_bytes_received(bus->io_task, &bus->response[start],
+                (size_t) (end - start));
+        taskEXIT_CRITICAL();
+        bus->n_delivered = end;
+    }
+}
+
+static void *real_time_thread(void *arguments)
+{
+    DynamixelVirtualBus *bus = (DynamixelVirtualBus *) arguments;
+#ifdef __linux__
+    // byte times are microseconds, default slack of timed waits is 50us
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+#endif
+    pthread_mutex_lock(&bus->lock);
+    while (bus->running) {
+        uint64_t now_ns = current_time_ns(bus);
+        if (bus->write_pending && bus->write_end_ns <= now_ns) {
+            bus->write_pending = false;
+            // not locked, the IO task may start reception right away (chained reception)
+            DynamixelIOTransmissionState state =
+                bus->write_spurious ? dio_READ_COMPLETED : dio_WRITE_COMPLETED;
+            pthread_mutex_unlock(&bus->lock);
+            dynamixel_io_task_notify_transmission_complete(bus->io_task, state);
+            pthread_mutex_lock(&bus->lock);
+            continue;
+        }
+        if (bus->receiving)
+            deliver(bus, now_ns);
+
+        // sleep until the next event
+        uint64_t next_ns = UINT64_MAX;
+        if (bus->write_pending)
+            next_ns = bus->write_end_ns;
+        if (bus->receiving && bus->n_delivered < bus->response_size) {
+            // bytes sent back to back are delivered together (like with idle line interrupt)
+            int last = bus->n_delivered;
+            while (last + 1 < bus->response_size
+                    && bus->arrival_ns[last + 1] - bus->arrival_ns[last] <= bus->byte_time_ns)
+                last++;
+            if (bus->arrival_ns[last] < next_ns)
+                next_ns = bus->arrival_ns[last];
+        }
+        if (next_ns == UINT64_MAX) {
+            pthread_cond_wait(&bus->changed, &bus->lock);
+        } else {
+            next_ns += bus->start_ns;
+            struct timespec deadline = {
+                .tv_sec = (time_t) (next_ns / 1000000000),
+                .tv_nsec = (long) (next_ns % 1000000000),
+            };
+            pthread_cond_timedwait(&bus->changed, &bus->lock, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&bus->lock);
+    return NULL;
+}
+
+/*** Faults *******************************************************************/
+
+static uint32_t random_next(DynamixelVirtualBus *bus)
+{
+    // xorshift32
+    uint32_t x = bus->random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    bus->random_state = x;
+    return x;
+}
+
+// faults of the current transfer, must be called with the lock taken
+static uint32_t choose_faults(DynamixelVirtualBus *bus)
+{
+    uint32_t faults = bus->forced_faults;
+    bus->forced_faults = 0;
+    for (int i = 0; i < dvb_N_FAULTS; i++) {
+        float rate = bus->fault_rates[i];
+        if (rate > 0 && random_next(bus) < (double) rate * UINT32_MAX)
+            faults |= 1u << i;
+    }
+    return faults;
+}
+
+static void apply_response_faults(DynamixelVirtualBus *bus, uint32_t faults)
+{
+    if (bus->response_size == 0)
+        return;
+    if (faults & (1u << dvb_FAULT_DROPPED_BYTE)) {
+        // the following bytes arrive when they would have anyway
+        int i = (int) (random_next(bus) % (uint32_t) bus->response_size);
+        int n_moved = bus->response_size - i - 1;
+        memmove(&bus->response[i], &bus->response[i + 1], n_moved);
+        memmove(&bus->arrival_ns[i], &bus->arrival_ns[i + 1], n_moved * sizeof(bus->arrival_ns[0]));
+        bus->response_size--;
+        bus->fault_counts[dvb_FAULT_DROPPED_BYTE]++;
+    }
+    if (faults & (1u << dvb_FAULT_CORRUPTED_CHECKSUM)) {
+        bus->response[bus->response_size - 1] ^= 0xff;
+        bus->fault_counts[dvb_FAULT_CORRUPTED_CHECKSUM]++;
+    }
+    if (faults & (1u << dvb_FAULT_LATE_RESPONSE)) {
+        // twice the timeout armed by the IO task (until the first byte with inter-byte
+        // timeouts), also with real time scheduling
+        uint64_t late_ns = 2 * (uint64_t) dynamixel_io_task_get_rx_timeout_us(bus->io_task, NULL) * 1000;
+        for (int i = 0; i < bus->response_size; i++)
+            bus->arrival_ns[i] += late_ns;
+        bus->fault_counts[dvb_FAULT_LATE_RESPONSE]++;
+    }
+}
+
+/*** Servos *******************************************************************/
+
+static void process_instruction(DynamixelVirtualBus *bus, bool checksum_ok, uint64_t end_ns)
+{
+    DynamixelPacket *packet = &bus->instruction;
+    bool is_broadcast = packet->id == DYNAMIXEL_BROADCASTING_ID;
+    uint8_t *params = packet->parameters_with_checksum;
+    int n_params = dynamixel_packet_n_parameters(packet);
+
+    // the only broadcast with responses, addressed servo by servo
+    if (checksum_ok && is_broadcast && packet->instruction == DYNAMIXEL_INST_BULK_READ) {
+        process_bulk_read(bus, end_ns);
+        return;
+    }
+
+    for (int i = 0; i < bus->n_servos; i++) {
+        DynamixelVirtualServo *servo = &bus->servos[i];
+        uint8_t *table = servo->table;
+        if (!servo->connected || !baud_rate_matches(bus, servo))
+            continue;
+        if (packet->id != table[DYNAMIXEL_ID] && !is_broadcast)
+            continue;
+        servo->n_instructions++;
+
+        // evaluated before execution (e.g. RESET changes it)
+        uint8_t id = table[DYNAMIXEL_ID];
+        uint8_t return_level = table[DYNAMIXEL_RETURN_LEVEL];
+        uint32_t return_delay_us = DYNAMIXEL_RETURN_DELAY_TIME_TO_US(table[DYNAMIXEL_RETURN_DELAY_TIME]);
+        uint8_t error = 0;
+        const uint8_t *data = NULL;
+        int data_len = 0;
+
+        if (!checksum_ok) {
+            error = DYNAMIXEL_ERROR_CHECKSUM_MASK;
+        } else switch (packet->instruction) {
+            case DYNAMIXEL_INST_PING:
+                break;
+            case DYNAMIXEL_INST_READ:
+                if (n_params != 2 || params[0] + params[1] > DYNAMIXEL_VIRTUAL_SERVO_TABLE_SIZE) {
+                    error = DYNAMIXEL_ERROR_RANGE_MASK;
+                    break;
+                }
+                data = &table[params[0]];
+                data_len = params[1];
+                break;
+            case DYNAMIXEL_INST_WRITE:
+                if (n_params < 2)
+                    error = DYNAMIXEL_ERROR_INSTRUCTION_MASK;
+                else
+                    error = write_table(servo, params[0], &params[1], n_params - 1);
+                break;
+            case DYNAMIXEL_INST_REG_WRITE:
+                if (n_params < 2 || params[0] + n_params - 1 > DYNAMIXEL_VIRTUAL_SERVO_TABLE_SIZE) {
+                    error = DYNAMIXEL_ERROR_RANGE_MASK;
+                    break;
+                }
+                servo->registered_address = params[0];
+                servo->registered_len = n_params - 1;
+                memcpy(servo->registered_data, &params[1], n_params - 1);
+                table[DYNAMIXEL_REGISTERED_INSTRUCTION] = 1;
+                break;
+            case DYNAMIXEL_INST_ACTION:
+                if (table[DYNAMIXEL_REGISTERED_INSTRUCTION] == 0) {
+                    error = DYNAMIXEL_ERROR_INSTRUCTION_MASK;
+                    break;
+                }
+                table[DYNAMIXEL_REGISTERED_INSTRUCTION] = 0;
+                error = write_table(servo, servo->registered_address,
+                        servo->registered_data, servo->registered_len);
+                break;
+            case DYNAMIXEL_INST_RESET: {
+                // factory defaults of the same model
+                uint16_t model_number = dynamixel_virtual_servo_read_u16(servo, DYNAMIXEL_MODEL_NUMBER_L);
+                dynamixel_virtual_servo_init_model(servo, 1, model_number);
+                break;
+            }
+            case DYNAMIXEL_INST_SYNC_WRITE:
+                // address, length of data for each servo, then id and data of each
+                if (n_params >= 2 && params[1] > 0) {
+                    int entry_len = 1 + params[1];
+                    for (int offset = 2; offset + entry_len <= n_params; offset += entry_len) {
+                        if (params[offset] == id)
+                            write_table(servo, params[0], &params[offset + 1], params[1]);
+                    }
+                }
+                break;
+            default:
+                error = DYNAMIXEL_ERROR_INSTRUCTION_MASK;
+                break;
+        }
+
+        bool respond = return_level >= DYNAMIXEL_STATUS_RESPONSE_ALWAYS
+            || packet->instruction == DYNAMIXEL_INST_PING
+            || (return_level >= DYNAMIXEL_STATUS_RESPONSE_READ_DATA
+                    && packet->instruction == DYNAMIXEL_INST_READ);
+        if (!is_broadcast && respond)
+            add_response(bus, id, error, data, data_len, end_ns + return_delay_us * 1000);
+    }
+}
+
+static bool is_mx_model(uint16_t model_number)
+{
+    return model_number == DYNAMIXEL_MX12W_MODEL_NUMBER || model_number == DYNAMIXEL_MX28_MODEL_NUMBER
+        || model_number == DYNAMIXEL_MX64_MODEL_NUMBER || model_number == DYNAMIXEL_MX106_MODEL_NUMBER;
+}
+
+static void process_bulk_read(DynamixelVirtualBus *bus, uint64_t end_ns)
+{
+    DynamixelPacket *packet = &bus->instruction;
+    uint8_t *params = packet->parameters_with_checksum;
+    int n_params = dynamixel_packet_n_parameters(packet);
+    if (n_params < 1 || params[0] != 0x00)
+        return;
+
+    // length, id and address of each servo, responses in this order
+    for (int offset = 1; offset + 3 <= n_params; offset += 3) {
+        uint8_t data_len = params[offset];
+        uint8_t id = params[offset + 1];
+        uint8_t address = params[offset + 2];
+        for (int i = 0; i < bus->n_servos; i++) {
+            DynamixelVirtualServo *servo = &bus->servos[i];
+            uint8_t *table = servo->table;
+            if (!servo->connected || !baud_rate_matches(bus, servo) || table[DYNAMIXEL_ID] != id)
+                continue;
+            // AX servos do not know the instruction (and do not respond to broadcasts)
+            if (!is_mx_model(dynamixel_virtual_servo_read_u16(servo, DYNAMIXEL_MODEL_NUMBER_L)))
+                continue;
+            servo->n_instructions++;
+
+            uint32_t return_delay_us = DYNAMIXEL_RETURN_DELAY_TIME_TO_US(table[DYNAMIXEL_RETURN_DELAY_TIME]);
+            uint8_t error = 0;
+            const uint8_t *data = &table[address];
+            if (address + data_len > DYNAMIXEL_VIRTUAL_SERVO_TABLE_SIZE) {
+                error = DYNAMIXEL_ERROR_RANGE_MASK;
+                data = NULL;
+                data_len = 0;
+            }
+            if (table[DYNAMIXEL_RETURN_LEVEL] >= DYNAMIXEL_STATUS_RESPONSE_READ_DATA)
+                add_response(bus, id, error, data, data_len, end_ns + return_delay_us * 1000);
+        }
+    }
+}
+
+static uint8_t write_table(DynamixelVirtualServo *servo, uint8_t address,
+        const uint8_t *data, int data_len)
+{
+    if (address + data_len > DYNAMIXEL_VIRTUAL_SERVO_TABLE_SIZE)
+        return DYNAMIXEL_ERROR_RANGE_MASK;
+    for (int i = 0; i < data_len; i++) {
+        if (!writable[address + i])
+            return DYNAMIXEL_ERROR_RANGE_MASK;
+    }
+    memcpy(&servo->table[address], data, data_len);
+
+    // goal position is reached immediately
+    uint8_t *table = servo->table;
+    table[DYNAMIXEL_PRESENT_POSITION_L] = table[DYNAMIXEL_GOAL_POSITION_L];
+    table[DYNAMIXEL_PRESENT_POSITION_H] = table[DYNAMIXEL_GOAL_POSITION_H];
+    return 0;
+}
+
+static void add_response(DynamixelVirtualBus *bus, uint8_t id, uint8_t error,
+        const uint8_t *data, int data_len, uint64_t start_ns)
+{
+    uint8_t storage[DYNAMIXEL_PACKET_STORAGE_SIZE(DYNAMIXEL_VIRTUAL_SERVO_TABLE_SIZE)];
+    DynamixelPacket *status = (DynamixelPacket *) storage;
+    dynamixel_packet_init_sized(status, DYNAMIXEL_VIRTUAL_SERVO_TABLE_SIZE, id, error);
+    dynamixel_packet_add_parameters_sized(status, DYNAMIXEL_VIRTUAL_SERVO_TABLE_SIZE, data, data_len);
+    dynamixel_packet_add_checksum_sized(status, DYNAMIXEL_VIRTUAL_SERVO_TABLE_SIZE);
+
+    int size = dynamixel_packet_size(status);
+    if (bus->response_size + size > DYNAMIXEL_VIRTUAL_BUS_BUFFER_SIZE)
+        return;
+    // servo cannot start before the line is free
+    uint64_t line_free_ns = bus->response_size > 0 ? bus->arrival_ns[bus->response_size - 1] : 0;
+    uint64_t time_ns = start_ns > line_free_ns ? start_ns : line_free_ns;
+    for (int i = 0; i < size; i++) {
+        time_ns += bus->byte_time_ns;
+        bus->response[bus->response_size] = storage[i];
+        bus->arrival_ns[bus->response_size] = time_ns;
+        bus->response_size++;
+    }
+}
+
+static bool baud_rate_matches(DynamixelVirtualBus *bus, DynamixelVirtualServo *servo)
+{
+    // Baud Rate register: 2000000 / (value + 1), UART tolerates ~3% difference
+    int servo_baud_rate = 2000000 / (servo->table[DYNAMIXEL_BAUD_RATE] + 1);
+    int difference = servo_baud_rate - bus->baud_rate;
+    if (difference < 0)
+        difference = -difference;
+    return difference * 100 <= bus->baud_rate * 3;
+}
+
+static uint64_t real_time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+static uint64_t current_time_ns(DynamixelVirtualBus *bus)
+{
+    if (bus->virtual_time)
+        return bus->now_ns;
+    return real_time_ns() - bus->start_ns;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Simulated bus of AX-12 servos, a UART driver for the IO task (like serial_port.h),
+ * so that the IO task, ServoGroup and discovery utils can be tested and benchmarked
+ * without hardware.
+ *
+ * Each virtual servo has the whole control table (defines.h) with factory defaults
+ * and handles PING, READ, WRITE, REG_WRITE, ACTION, RESET and SYNC_WRITE, servos
+ * with an MX model number (dynamixel_virtual_servo_init_model()) also BULK_READ.
+ * It responds only if its Baud Rate register matches the bus, according to
+ * Status Return Level, after Return Delay Time. Goal position is reached immediately.
+ * Servos of a BULK_READ respond in the order of the request, each after its Return
+ * Delay Time or when the previous status packet ends (if it is later).
+ *
+ * Timing is modelled with byte time of the bus baud rate, in one of two modes:
+ *  - real time: a thread notifies the IO task when transmission would have ended
+ *    and passes response bytes when they would have been received, bytes sent back
+ *    to back in one chunk (like a driver with idle line interrupt),
+ *  - virtual time: everything happens immediately in the driver functions, the bus
+ *    has its own clock advanced by the modelled time; response that would not fit
+ *    in the timeout armed by the IO task (dynamixel_io_task_get_rx_timeout_us(),
+ *    also first byte, inter-byte and adaptive ones, the timer itself does not have
+ *    to expire) is not delivered (fully), so results do not depend on the load
+ *    of the host.
+ *
+ * Response is passed to dynamixel_io_task_notify_bytes_received() or, with exact_reads,
+ * copied into the buffer given to the read function (the other reception method).
+ *
+ * Faults can be injected into transfers, either randomly with a given probability
+ * (dynamixel_virtual_bus_set_fault_rate(), reproducible for the same seed)
+ * or into the next transfer (dynamixel_virtual_bus_inject()).
+ *
+ * Usage:
+ *   DynamixelVirtualServo servos[2];
+ *   dynamixel_virtual_servo_init(&servos[0], 1);
+ *   dynamixel_virtual_servo_init(&servos[1], 2);
+ *   DynamixelVirtualBus bus;
+ *   dynamixel_virtual_bus_init(&bus, &io_task, servos, 2, 1000000, true);
+ *   dynamixel_io_task_create_with_driver(&io_task, "dxl", 1, 1,
+ *       dynamixel_virtual_bus_driver(&bus), 10 + 1, 1000);
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "io_task.h"
+#include "packet_parser.h"
+
+#define DYNAMIXEL_VIRTUAL_SERVO_TABLE_SIZE   (DYNAMIXEL_PUNCH_H + 1)
+
+// maximum size of responses to a single transfer
+#ifndef DYNAMIXEL_VIRTUAL_BUS_BUFFER_SIZE
+#   define DYNAMIXEL_VIRTUAL_BUS_BUFFER_SIZE   512
+#endif
+
+typedef enum {
+    dvb_FAULT_WRITE_ERROR = 0,        // write function returns error (nothing is sent)
+    dvb_FAULT_DROPPED_BYTE,           // one byte of response is lost
+    dvb_FAULT_CORRUPTED_CHECKSUM,     // checksum of (the last) status packet is wrong
+    dvb_FAULT_LATE_RESPONSE,          // response comes after the IO task timeout
+    dvb_FAULT_MISSING_SERVO,          // servos ignore the transfer
+    dvb_FAULT_SPURIOUS_NOTIFICATION,  // IO task notified with wrong state instead of write completion
+    dvb_N_FAULTS
+} DynamixelVirtualBusFault;
+
+typedef struct {
+    uint8_t table[DYNAMIXEL_VIRTUAL_SERVO_TABLE_SIZE];
+    // data of REG_WRITE, applied on ACTION
+    uint8_t registered_address;
+    uint8_t registered_len;
+    uint8_t registered_data[DYNAMIXEL_VIRTUAL_SERVO_TABLE_SIZE];
+    // disconnected servo ignores everything
+    bool connected;
+    uint32_t n_instructions;  // number of packets processed by this servo
+} DynamixelVirtualServo;
+
+typedef struct {
+    DynamixelVirtualServo *servos;
+    int n_servos;
+    int baud_rate;
+    uint32_t byte_time_ns;
+    bool virtual_time;
+    bool exact_reads;         // copy response into buffer of read function
+    DynamixelIOTaskHandle *io_task;
+
+    // instruction packets received by servos (of any size allowed by the protocol)
+    union {
+        DynamixelPacket instruction;
+        uint8_t instruction_storage[DYNAMIXEL_PACKET_STORAGE_SIZE(DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS)];
+    };
+    DynamixelPacketParser parser;
+
+    // responses of servos to the last transfer, with time of arrival of each byte
+    uint8_t response[DYNAMIXEL_VIRTUAL_BUS_BUFFER_SIZE];
+    uint64_t arrival_ns[DYNAMIXEL_VIRTUAL_BUS_BUFFER_SIZE];
+    int response_size;
+    int n_delivered;          // number of bytes passed to the IO task
+    bool receiving;           // the IO task has started reception
+    uint8_t *read_data;       // buffer and length given to the read function
+    int read_len;
+    uint64_t write_end_ns;    // when transmission ends (real time mode)
+    bool write_pending;       // write completion not notified yet (real time mode)
+    bool write_spurious;      // notify wrong state instead of write completion (real time mode)
+
+    // fault injection
+    float fault_rates[dvb_N_FAULTS];          // probability of each fault in a transfer
+    uint32_t forced_faults;                   // bit mask of faults in the next transfer
+    uint32_t fault_counts[dvb_N_FAULTS];      // number of faults injected (that had effect)
+    uint32_t random_state;
+
+    uint64_t now_ns;          // virtual time
+    uint64_t start_ns;        // start of real time
+
+    // real time mode
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    bool running;
+} DynamixelVirtualBus;
+
+// factory defaults of AX-12 with the given id (and 1Mbps baud rate)
+void dynamixel_virtual_servo_init(DynamixelVirtualServo *servo, uint8_t id);
+// the same with another model number (kept by RESET), MX ones respond to BULK_READ
+void dynamixel_virtual_servo_init_model(DynamixelVirtualServo *servo, uint8_t id,
+        uint16_t model_number);
+uint8_t dynamixel_virtual_servo_read_u8(DynamixelVirtualServo *servo, uint8_t address);
+uint16_t dynamixel_virtual_servo_read_u16(DynamixelVirtualServo *servo, uint8_t address);
+// changes the table directly (e.g. to simulate present position), without any checks
+void dynamixel_virtual_servo_write_u8(DynamixelVirtualServo *servo, uint8_t address, uint8_t value);
+void dynamixel_virtual_servo_write_u16(DynamixelVirtualServo *servo, uint8_t address, uint16_t value);
+
+// io_task is the handle that will be created with this driver,
+// returns false if the real time thread cannot be started
+bool dynamixel_virtual_bus_init(DynamixelVirtualBus *bus, DynamixelIOTaskHandle *io_task,
+        DynamixelVirtualServo *servos, int n_servos, int baud_rate, bool virtual_time);
+void dynamixel_virtual_bus_deinit(DynamixelVirtualBus *bus);
+DynamixelIOUARTDriver dynamixel_virtual_bus_driver(DynamixelVirtualBus *bus);
+// virtual time (or real time since init) in microseconds
+uint64_t dynamixel_virtual_bus_time_us(DynamixelVirtualBus *bus);
+
+// rate is probability of the fault in each transfer (0 - never, 1 - always)
+void dynamixel_virtual_bus_set_fault_rate(DynamixelVirtualBus *bus,
+        DynamixelVirtualBusFault fault, float rate);
+// random faults (and the byte to drop) depend only on the seed
+void dynamixel_virtual_bus_seed(DynamixelVirtualBus *bus, uint32_t seed);
+// injects the fault into the next transfer (in addition to random ones)
+void dynamixel_virtual_bus_inject(DynamixelVirtualBus *bus, DynamixelVirtualBusFault fault);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,442 @@
+#include <string.h> // memcpy
+
+#include "protocol2.h"
+
+
+static const uint16_t crc_table[256] = {
+    0x0000, 0x8005, 0x800f, 0x000a, 0x801b, 0x001e, 0x0014, 0x8011,
+    0x8033, 0x0036, 0x003c, 0x8039, 0x0028, 0x802d, 0x8027, 0x0022,
+    0x8063, 0x0066, 0x006c, 0x8069, 0x0078, 0x807d, 0x8077, 0x0072,
+    0x0050, 0x8055, 0x805f, 0x005a, 0x804b, 0x004e, 0x0044, 0x8041,
+    0x80c3, 0x00c6, 0x00cc, 0x80c9, 0x00d8, 0x80dd, 0x80d7, 0x00d2,
+    0x00f0, 0x80f5, 0x80ff, 0x00fa, 0x80eb, 0x00ee, 0x00e4, 0x80e1,
+    0x00a0, 0x80a5, 0x80af, 0x00aa, 0x80bb, 0x00be, 0x00b4, 0x80b1,
+    0x8093, 0x0096, 0x009c, 0x8099, 0x0088, 0x808d, 0x8087, 0x0082,
+    0x8183, 0x0186, 0x018c, 0x8189, 0x0198, 0x819d, 0x8197, 0x0192,
+    0x01b0, 0x81b5, 0x81bf, 0x01ba, 0x81ab, 0x01ae, 0x01a4, 0x81a1,
+    0x01e0, 0x81e5, 0x81ef, 0x01ea, 0x81fb, 0x01fe, 0x01f4, 0x81f1,
+    0x81d3, 0x01d6, 0x01dc, 0x81d9, 0x01c8, 0x81cd, 0x81c7, 0x01c2,
+    0x0140, 0x8145, 0x814f, 0x014a, 0x815b, 0x015e, 0x0154, 0x8151,
+    0x8173, 0x0176, 0x017c, 0x8179, 0x0168, 0x816d, 0x8167, 0x0162,
+    0x8123, 0x0126, 0x012c, 0x8129, 0x0138, 0x813d, 0x8137, 0x0132,
+    0x0110, 0x8115, 0x811f, 0x011a, 0x810b, 0x010e, 0x0104, 0x8101,
+    0x8303, 0x0306, 0x030c, 0x8309, 0x0318, 0x831d, 0x8317, 0x0312,
+    0x0330, 0x8335, 0x833f, 0x033a, 0x832b, 0x032e, 0x0324, 0x8321,
+    0x0360, 0x8365, 0x836f, 0x036a, 0x837b, 0x037e, 0x0374, 0x8371,
+    0x8353, 0x0356, 0x035c, 0x8359, 0x0348, 0x834d, 0x8347, 0x0342,
+    0x03c0, 0x83c5, 0x83cf, 0x03ca, 0x83db, 0x03de, 0x03d4, 0x83d1,
+    0x83f3, 0x03f6, 0x03fc, 0x83f9, 0x03e8, 0x83ed, 0x83e7, 0x03e2,
+    0x83a3, 0x03a6, 0x03ac, 0x83a9, 0x03b8, 0x83bd, 0x83b7, 0x03b2,
+    0x0390, 0x8395, 0x839f, 0x039a, 0x838b, 0x038e, 0x0384, 0x8381,
+    0x0280, 0x8285, 0x828f, 0x028a, 0x829b, 0x029e, 0x0294, 0x8291,
+    0x82b3, 0x02b6, 0x02bc, 0x82b9, 0x02a8, 0x82ad, 0x82a7, 0x02a2,
+    0x82e3, 0x02e6, 0x02ec, 0x82e9, 0x02f8, 0x82fd, 0x82f7, 0x02f2,
+    0x02d0, 0x82d5, 0x82df, 0x02da, 0x82cb, 0x02ce, 0x02c4, 0x82c1,
+    0x8243, 0x0246, 0x024c, 0x8249, 0x0258, 0x825d, 0x8257, 0x0252,
+    0x0270, 0x8275, 0x827f, 0x027a, 0x826b, 0x026e, 0x0264, 0x8261,
+    0x0220, 0x8225, 0x822f, 0x022a, 0x823b, 0x023e, 0x0234, 0x8231,
+    0x8213, 0x0216, 0x021c, 0x8219, 0x0208, 0x820d, 0x8207, 0x0202,
+};
+
+static const uint8_t header[] = {0xff, 0xff, 0xfd, 0x00};
+
+static uint16_t crc16_update(uint16_t crc, uint8_t byte);
+// returns false if the byte is the one added by stuffing (should be dropped)
+static bool unstuff_byte(int *n_matched, uint8_t byte);
+// byte of instruction (index 0) and parameters (index 1..n)
+static uint8_t *body_byte(Dynamixel2Packet *packet, int index);
+static int status_size(int data_len, uint8_t id);
+
+
+uint16_t dynamixel2_crc16(uint16_t crc, const uint8_t *data, int data_len) {
+    for (int i = 0; i < data_len; i++)
+        crc = crc16_update(crc, data[i]);
+    return crc;
+}
+
+/*** Packet *******************************************************************/
+
+void dynamixel2_packet_init(Dynamixel2Packet *packet, uint8_t id, uint8_t instruction) {
+    memcpy(packet->_header, header, sizeof(header));
+    packet->id = id;
+    packet->length = 3; // instruction and CRC
+    packet->instruction = instruction;
+}
+
+bool dynamixel2_packet_add_parameter(Dynamixel2Packet *packet, uint8_t parameter) {
+    int n = dynamixel2_packet_n_parameters(packet);
+    // 0xff 0xff 0xfd in instruction+parameters requires additional 0xfd
+    bool needs_stuffing = parameter == 0xfd && n >= 1
+        && *body_byte(packet, n) == 0xff && *body_byte(packet, n - 1) == 0xff;
+    int n_needed = needs_stuffing ? 2 : 1;
+    if (n + n_needed > DYNAMIXEL2_MAX_N_PARAMETERS)
+        return false; // cannot add more elements
+    packet->parameters_with_crc[n++] = parameter;
+    if (needs_stuffing)
+        packet->parameters_with_crc[n++] = 0xfd;
+    packet->length = n + 3;
+    return true;
+}
+
+bool dynamixel2_packet_add_parameters(Dynamixel2Packet *packet, const uint8_t *parameters, int n_parameters) {
+    uint16_t length = packet->length;
+    for (int i = 0; i < n_parameters; i++) {
+        if (!dynamixel2_packet_add_parameter(packet, parameters[i])) {
+            packet->length = length; // do not add anything
+            return false;
+        }
+    }
+    return true;
+}
+
+bool dynamixel2_packet_add_parameter_u16(Dynamixel2Packet *packet, uint16_t parameter) {
+    // all fields of Protocol 2.0 are little-endian
+    const uint8_t bytes[2] = {parameter & 0xff, parameter >> 8};
+    return dynamixel2_packet_add_parameters(packet, bytes, 2);
+}
+
+bool dynamixel2_packet_add_parameter_u32(Dynamixel2Packet *packet, uint32_t parameter) {
+    const uint8_t bytes[4] = {parameter & 0xff, (parameter >> 8) & 0xff,
+        (parameter >> 16) & 0xff, parameter >> 24};
+    return dynamixel2_packet_add_parameters(packet, bytes, 4);
+}
+
+bool dynamixel2_packet_add_crc(Dynamixel2Packet *packet) {
+    // there is always space for CRC after parameters
+    uint16_t crc = dynamixel2_packet_compute_crc(packet);
+    int n = dynamixel2_packet_n_parameters(packet);
+    packet->parameters_with_crc[n] = crc & 0xff;
+    packet->parameters_with_crc[n + 1] = crc >> 8;
+    return true;
+}
+
+uint8_t* dynamixel2_packet_data(Dynamixel2Packet *packet) {
+    return (uint8_t *) packet;
+}
+
+int dynamixel2_packet_size(Dynamixel2Packet *packet) {
+    return DYNAMIXEL2_PACKET_BASE_SIZE + dynamixel2_packet_n_parameters(packet) + 2;
+}
+
+int dynamixel2_packet_n_parameters(Dynamixel2Packet *packet) {
+    return packet->length - 3;
+}
+
+uint16_t dynamixel2_packet_get_crc(Dynamixel2Packet *packet) {
+    int n = dynamixel2_packet_n_parameters(packet);
+    return packet->parameters_with_crc[n] | (packet->parameters_with_crc[n + 1] << 8);
+}
+
+uint16_t dynamixel2_packet_compute_crc(Dynamixel2Packet *packet) {
+    // CRC of everything from header to the last parameter
+    return dynamixel2_crc16(0, dynamixel2_packet_data(packet), dynamixel2_packet_size(packet) - 2);
+}
+
+bool dynamixel2_packet_crc_isok(Dynamixel2Packet *packet) {
+    return dynamixel2_packet_compute_crc(packet) == dynamixel2_packet_get_crc(packet);
+}
+
+bool dynamixel2_packet_decode(Dynamixel2Packet *packet, int size) {
+    if (size < DYNAMIXEL2_PACKET_BASE_SIZE + 2)
+        return false;
+    if (memcmp(packet->_header, header, sizeof(header)) != 0)
+        return false;
+    if (packet->length < 3 || dynamixel2_packet_size(packet) != size)
+        return false;
+    if (!dynamixel2_packet_crc_isok(packet))
+        return false;
+
+    // remove stuffing in place (instruction cannot be stuffing, so start from parameters)
+    int n_raw = dynamixel2_packet_n_parameters(packet);
+    int n_matched = 0;
+    int n = 0;
+    unstuff_byte(&n_matched, packet->instruction);
+    for (int i = 0; i < n_raw; i++) {
+        uint8_t byte = packet->parameters_with_crc[i];
+        if (unstuff_byte(&n_matched, byte))
+            packet->parameters_with_crc[n++] = byte;
+    }
+    if (n != n_raw) {
+        // move CRC right after the last parameter
+        packet->parameters_with_crc[n] = packet->parameters_with_crc[n_raw];
+        packet->parameters_with_crc[n + 1] = packet->parameters_with_crc[n_raw + 1];
+        packet->length = n + 3;
+    }
+    return true;
+}
+
+Dynamixel2Packet *dynamixel2_status_packets_next(uint8_t *data, int data_len, int *offset) {
+    int remaining = data_len - *offset;
+    if (remaining < DYNAMIXEL2_PACKET_BASE_SIZE + 2)
+        return NULL;
+    Dynamixel2Packet *packet = (Dynamixel2Packet *) &data[*offset];
+    int size = dynamixel2_packet_size(packet);
+    if (packet->length < 3 || size > remaining)
+        return NULL;
+    *offset += size;
+    return packet;
+}
+
+uint8_t dynamixel2_packet_error(Dynamixel2Packet *packet) {
+    return packet->parameters_with_crc[0];
+}
+
+uint8_t *dynamixel2_packet_status_data(Dynamixel2Packet *packet) {
+    return &packet->parameters_with_crc[1];
+}
+
+int dynamixel2_packet_status_data_len(Dynamixel2Packet *packet) {
+    return dynamixel2_packet_n_parameters(packet) - 1;
+}
+
+/*** Parser *******************************************************************/
+
+enum {
+    d2ps_HEADER,
+    d2ps_ID,
+    d2ps_LENGTH_L,
+    d2ps_LENGTH_H,
+    d2ps_BODY,
+};
+
+void dynamixel2_packet_parser_init(Dynamixel2PacketParser *parser, Dynamixel2Packet *packet,
+        int max_n_parameters)
+{
+    parser->packet = packet;
+    parser->max_n_parameters = max_n_parameters;
+    dynamixel2_packet_parser_reset(parser);
+}
+
+void dynamixel2_packet_parser_reset(Dynamixel2PacketParser *parser) {
+    parser->state = d2ps_HEADER;
+    parser->crc = 0;
+    parser->n_body_raw = 0;
+    parser->n_body = 0;
+    parser->raw_length = 0;
+    parser->n_stuffing_matched = 0; // also used for matching header
+}
+
+DynamixelParserResult dynamixel2_packet_parser_feed_byte(Dynamixel2PacketParser *parser, uint8_t byte) {
+    Dynamixel2Packet *packet = parser->packet;
+
+    switch (parser->state) {
+        case d2ps_HEADER:
+            if (byte == header[parser->n_stuffing_matched]) {
+                parser->n_stuffing_matched++;
+            } else if (byte == 0xff) {
+                // 0xff 0xff 0xff - the first one was noise
+                parser->n_stuffing_matched = parser->n_stuffing_matched == 2 ? 2 : 1;
+            } else {
+                parser->n_stuffing_matched = 0;
+            }
+            if (parser->n_stuffing_matched == sizeof(header)) {
+                memcpy(packet->_header, header, sizeof(header));
+                parser->crc = dynamixel2_crc16(0, header, sizeof(header));
+                parser->n_stuffing_matched = 0;
+                parser->state = d2ps_ID;
+            }
+            return dpr_IN_PROGRESS;
+
+        case d2ps_ID:
+            packet->id = byte;
+            parser->state = d2ps_LENGTH_L;
+            break;
+
+        case d2ps_LENGTH_L:
+            parser->raw_length = byte;
+            parser->state = d2ps_LENGTH_H;
+            break;
+
+        case d2ps_LENGTH_H:
+            parser->raw_length |= byte << 8;
+            // instruction and CRC at least, stuffing adds at most 1 byte per 3
+            if (parser->raw_length < 3 || parser->raw_length - 3 >
+                    parser->max_n_parameters + parser->max_n_parameters / 3 + 1) {
+                dynamixel2_packet_parser_reset(parser);
+                return dpr_WRONG_LENGTH;
+            }
+            parser->state = d2ps_BODY;
+            break;
+
+        case d2ps_BODY: {
+            int n_content = parser->raw_length - 2; // without CRC
+            if (parser->n_body_raw < n_content) {
+                parser->n_body_raw++;
+                parser->crc = crc16_update(parser->crc, byte);
+                if (!unstuff_byte(&parser->n_stuffing_matched, byte))
+                    return dpr_IN_PROGRESS;
+                if (parser->n_body - 1 >= parser->max_n_parameters) {
+                    dynamixel2_packet_parser_reset(parser);
+                    return dpr_WRONG_LENGTH;
+                }
+                *body_byte(packet, parser->n_body++) = byte;
+                return dpr_IN_PROGRESS;
+            }
+            // CRC bytes go right after unstuffed parameters
+            packet->length = parser->n_body + 2;
+            int n = dynamixel2_packet_n_parameters(packet);
+            packet->parameters_with_crc[n + parser->n_body_raw - n_content] = byte;
+            parser->n_body_raw++;
+            if (parser->n_body_raw < parser->raw_length)
+                return dpr_IN_PROGRESS;
+            bool is_ok = dynamixel2_packet_get_crc(packet) == parser->crc;
+            dynamixel2_packet_parser_reset(parser);
+            return is_ok ? dpr_PACKET_READY : dpr_WRONG_CHECKSUM;
+        }
+    }
+
+    parser->crc = crc16_update(parser->crc, byte);
+    return dpr_IN_PROGRESS;
+}
+
+DynamixelParserResult dynamixel2_packet_parser_feed(Dynamixel2PacketParser *parser,
+        const uint8_t *data, int data_len, int *n_consumed)
+{
+    DynamixelParserResult result = dpr_IN_PROGRESS;
+    int i = 0;
+    while (i < data_len && result == dpr_IN_PROGRESS)
+        result = dynamixel2_packet_parser_feed_byte(parser, data[i++]);
+    if (n_consumed != NULL)
+        *n_consumed = i;
+    return result;
+}
+
+/*** Builders *****************************************************************/
+
+int dynamixel2_prepare_simple_instruction(Dynamixel2Packet *packet, uint8_t id, uint8_t instruction) {
+    dynamixel2_packet_init(packet, id, instruction);
+    dynamixel2_packet_add_crc(packet);
+    // ping returns model number (2 bytes) and firmware version
+    return status_size(instruction == DYNAMIXEL2_INST_PING ? 3 : 0, id);
+}
+
+int dynamixel2_prepare_ping(Dynamixel2Packet *packet, uint8_t id) {
+    return dynamixel2_prepare_simple_instruction(packet, id, DYNAMIXEL2_INST_PING);
+}
+
+int dynamixel2_prepare_action(Dynamixel2Packet *packet, uint8_t id) {
+    return dynamixel2_prepare_simple_instruction(packet, id, DYNAMIXEL2_INST_ACTION);
+}
+
+int dynamixel2_prepare_reboot(Dynamixel2Packet *packet, uint8_t id) {
+    return dynamixel2_prepare_simple_instruction(packet, id, DYNAMIXEL2_INST_REBOOT);
+}
+
+int dynamixel2_prepare_read(Dynamixel2Packet *packet, uint8_t id, uint16_t address, int data_len) {
+    dynamixel2_packet_init(packet, id, DYNAMIXEL2_INST_READ);
+    bool is_ok = dynamixel2_packet_add_parameter_u16(packet, address);
+    is_ok = is_ok && dynamixel2_packet_add_parameter_u16(packet, data_len);
+    is_ok = is_ok && dynamixel2_packet_add_crc(packet);
+    if (!is_ok)
+        return -1;
+    return status_size(data_len, id);
+}
+
+int dynamixel2_prepare_write(Dynamixel2Packet *packet, uint8_t id, uint16_t address,
+        const uint8_t *data, int data_len)
+{
+    dynamixel2_packet_init(packet, id, DYNAMIXEL2_INST_WRITE);
+    bool is_ok = dynamixel2_packet_add_parameter_u16(packet, address);
+    is_ok = is_ok && dynamixel2_packet_add_parameters(packet, data, data_len);
+    is_ok = is_ok && dynamixel2_packet_add_crc(packet);
+    if (!is_ok)
+        return -1;
+    return status_size(0, id);
+}
+
+int dynamixel2_prepare_reg_write(Dynamixel2Packet *packet, uint8_t id, uint16_t address,
+        const uint8_t *data, int data_len)
+{
+    dynamixel2_packet_init(packet, id, DYNAMIXEL2_INST_REG_WRITE);
+    bool is_ok = dynamixel2_packet_add_parameter_u16(packet, address);
+    is_ok = is_ok && dynamixel2_packet_add_parameters(packet, data, data_len);
+    is_ok = is_ok && dynamixel2_packet_add_crc(packet);
+    if (!is_ok)
+        return -1;
+    return status_size(0, id);
+}
+
+int dynamixel2_prepare_sync_write(Dynamixel2Packet *packet, uint16_t address, const uint8_t *data,
+        int n_actuators, int data_len_for_each)
+{
+    dynamixel2_packet_init(packet, DYNAMIXEL_BROADCASTING_ID, DYNAMIXEL2_INST_SYNC_WRITE);
+    bool is_ok = dynamixel2_packet_add_parameter_u16(packet, address);
+    is_ok = is_ok && dynamixel2_packet_add_parameter_u16(packet, data_len_for_each);
+    is_ok = is_ok && dynamixel2_packet_add_parameters(packet, data, (data_len_for_each + 1) * n_actuators);
+    is_ok = is_ok && dynamixel2_packet_add_crc(packet);
+    if (!is_ok)
+        return -1;
+    return 0; // always broadcasting
+}
+
+int dynamixel2_prepare_sync_read(Dynamixel2Packet *packet, uint16_t address, int data_len,
+        const uint8_t *ids, int n_actuators)
+{
+    dynamixel2_packet_init(packet, DYNAMIXEL_BROADCASTING_ID, DYNAMIXEL2_INST_SYNC_READ);
+    bool is_ok = dynamixel2_packet_add_parameter_u16(packet, address);
+    is_ok = is_ok && dynamixel2_packet_add_parameter_u16(packet, data_len);
+    is_ok = is_ok && dynamixel2_packet_add_parameters(packet, ids, n_actuators);
+    is_ok = is_ok && dynamixel2_packet_add_crc(packet);
+    if (!is_ok)
+        return -1;
+    return n_actuators * DYNAMIXEL2_STATUS_PACKET_SIZE(data_len);
+}
+
+int dynamixel2_prepare_fast_sync_read(Dynamixel2Packet *packet, uint16_t address, int data_len,
+        const uint8_t *ids, int n_actuators)
+{
+    dynamixel2_packet_init(packet, DYNAMIXEL_BROADCASTING_ID, DYNAMIXEL2_INST_FAST_SYNC_READ);
+    bool is_ok = dynamixel2_packet_add_parameter_u16(packet, address);
+    is_ok = is_ok && dynamixel2_packet_add_parameter_u16(packet, data_len);
+    is_ok = is_ok && dynamixel2_packet_add_parameters(packet, ids, n_actuators);
+    is_ok = is_ok && dynamixel2_packet_add_crc(packet);
+    if (!is_ok || n_actuators < 1)
+        return -1;
+    // for each servo: error, id, data, CRC (the last CRC is CRC of the whole packet)
+    return DYNAMIXEL2_PACKET_BASE_SIZE + n_actuators * (1 + 1 + data_len + 2);
+}
+
+uint8_t *dynamixel2_fast_sync_read_data(Dynamixel2Packet *packet, int index, int data_len,
+        uint8_t *error, uint8_t *id)
+{
+    int offset = index * (1 + 1 + data_len + 2);
+    if (index < 0 || offset + 2 + data_len > dynamixel2_packet_n_parameters(packet))
+        return NULL;
+    uint8_t *block = &packet->parameters_with_crc[offset];
+    if (error != NULL)
+        *error = block[0];
+    if (id != NULL)
+        *id = block[1];
+    return &block[2];
+}
+
+/*** Private functions *********************************************************/
+
+static uint16_t crc16_update(uint16_t crc, uint8_t byte) {
+    return (crc << 8) ^ crc_table[((crc >> 8) ^ byte) & 0xff];
+}
+
+static bool unstuff_byte(int *n_matched, uint8_t byte) {
+    if (*n_matched == 3) {
+        *n_matched = 0;
+        if (byte == 0xfd)
+            return false;
+    }
+    if (byte == 0xff)
+        *n_matched = *n_matched < 2 ? *n_matched + 1 : 2;
+    else if (byte == 0xfd && *n_matched == 2)
+        *n_matched = 3;
+    else
+        *n_matched = 0;
+    return true;
+}
+
+static uint8_t *body_byte(Dynamixel2Packet *packet, int index) {
+    return index == 0 ? &packet->instruction : &packet->parameters_with_crc[index - 1];
+}
+
+static int status_size(int data_len, uint8_t id) {
+    if (id == DYNAMIXEL_BROADCASTING_ID)
+        return 0;
+    return DYNAMIXEL2_STATUS_PACKET_SIZE(data_len);
+}
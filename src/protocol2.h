@@ -0,0 +1,167 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Dynamixel Protocol 2.0 (used e.g. by X-series servos).
+ *
+ * Differences from Protocol 1.0 (packet.h):
+ *  - 4-byte header (0xff 0xff 0xfd 0x00) and 16-bit length
+ *  - CRC-16 (IBM/ANSI, polynomial 0x8005) instead of additive checksum
+ *  - byte stuffing: if 0xff 0xff 0xfd appears in instruction/parameters,
+ *    additional 0xfd is inserted after it (0xff 0xff 0xfd 0xfd)
+ *  - status packets have instruction 0x55 and error as the first parameter
+ *
+ * Packets are assembled the same way as Protocol 1.0 packets (parameters
+ * are stuffed on the fly, CRC is added at the end), then they can be sent
+ * by the IO task configured with dynamixel_io_task_set_protocol().
+ *
+ * Received packets are stored unstuffed: dynamixel2_packet_decode() checks
+ * CRC of the received bytes and removes stuffing in place (Dynamixel2PacketParser
+ * does both on the fly), so after decoding parameters can be accessed directly.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "defines.h"
+#include "packet_parser.h"
+
+// limit of (stuffed) parameters, see DYNAMIXEL_MAX_N_PARAMETERS
+#ifndef DYNAMIXEL2_MAX_N_PARAMETERS
+#   define DYNAMIXEL2_MAX_N_PARAMETERS   64
+#endif
+
+/* --- Instructions --- */
+#define DYNAMIXEL2_INST_PING                  0x01
+#define DYNAMIXEL2_INST_READ                  0x02
+#define DYNAMIXEL2_INST_WRITE                 0x03
+#define DYNAMIXEL2_INST_REG_WRITE             0x04
+#define DYNAMIXEL2_INST_ACTION                0x05
+#define DYNAMIXEL2_INST_FACTORY_RESET         0x06
+#define DYNAMIXEL2_INST_REBOOT                0x08
+#define DYNAMIXEL2_INST_CLEAR                 0x10
+#define DYNAMIXEL2_INST_STATUS                0x55
+#define DYNAMIXEL2_INST_SYNC_READ             0x82
+#define DYNAMIXEL2_INST_SYNC_WRITE            0x83
+#define DYNAMIXEL2_INST_FAST_SYNC_READ        0x8a
+#define DYNAMIXEL2_INST_BULK_READ             0x92
+#define DYNAMIXEL2_INST_BULK_WRITE            0x93
+
+// error field of status packet (lower 7 bits is error number)
+#define DYNAMIXEL2_ERROR_ALERT_MASK           (1 << 7)
+#define DYNAMIXEL2_ERROR_NUMBER(error)        ((error) & 0x7f)
+
+
+/*
+ * Structure that represents Protocol 2.0 packet.
+ *
+ * WARNING: Number of parameters may change, but there are always two
+ *   bytes of CRC after the last parameter!
+ */
+typedef struct __attribute__ ((__packed__)) {
+    uint8_t _header[4];       // 0xff 0xff 0xfd 0x00
+    uint8_t id;               // id of dynamixel servo or BROADCASTING_ID
+    uint16_t length;          // length of packet (= n_parameters + 3)
+    uint8_t instruction;      // instruction code or 0x55 for status packets
+    // parameters (for status packets the first one is error) with CRC at the end
+    uint8_t parameters_with_crc[DYNAMIXEL2_MAX_N_PARAMETERS + 2];
+} Dynamixel2Packet;
+
+// header + id + length + instruction
+#define DYNAMIXEL2_PACKET_BASE_SIZE   (4 + 1 + 2 + 1)
+// size of status packet without any data (only error and CRC)
+#define DYNAMIXEL2_STATUS_PACKET_SIZE(data_len)   (DYNAMIXEL2_PACKET_BASE_SIZE + 1 + (data_len) + 2)
+
+
+// CRC-16 (IBM/ANSI) as used by Protocol 2.0, computed with a lookup table,
+// pass 0 as crc for the first chunk of data and previous result for the next ones
+uint16_t dynamixel2_crc16(uint16_t crc, const uint8_t *data, int data_len);
+
+// the same set of methods as for DynamixelPacket
+void dynamixel2_packet_init(Dynamixel2Packet *packet, uint8_t id, uint8_t instruction);
+// parameters are stuffed when added, so they may take more space
+// return false if parameters limit has been reached and do NOT add ANYTHING
+bool dynamixel2_packet_add_parameter(Dynamixel2Packet *packet, uint8_t parameter);
+bool dynamixel2_packet_add_parameters(Dynamixel2Packet *packet, const uint8_t *parameters, int n_parameters);
+bool dynamixel2_packet_add_parameter_u16(Dynamixel2Packet *packet, uint16_t parameter);
+bool dynamixel2_packet_add_parameter_u32(Dynamixel2Packet *packet, uint32_t parameter);
+bool dynamixel2_packet_add_crc(Dynamixel2Packet *packet);
+
+uint8_t* dynamixel2_packet_data(Dynamixel2Packet *packet);
+int dynamixel2_packet_size(Dynamixel2Packet *packet);
+int dynamixel2_packet_n_parameters(Dynamixel2Packet *packet);
+uint16_t dynamixel2_packet_get_crc(Dynamixel2Packet *packet);
+uint16_t dynamixel2_packet_compute_crc(Dynamixel2Packet *packet);
+bool dynamixel2_packet_crc_isok(Dynamixel2Packet *packet);
+
+// checks CRC of received packet (raw bytes, size as received) and removes byte stuffing
+// returns false if packet is malformed or CRC is wrong
+bool dynamixel2_packet_decode(Dynamixel2Packet *packet, int size);
+// for decoded status packets
+uint8_t dynamixel2_packet_error(Dynamixel2Packet *packet);
+uint8_t *dynamixel2_packet_status_data(Dynamixel2Packet *packet);
+int dynamixel2_packet_status_data_len(Dynamixel2Packet *packet);
+// iterates over decoded status packets stored one after another (response to sync read),
+// the same as dynamixel_status_packets_next()
+Dynamixel2Packet *dynamixel2_status_packets_next(uint8_t *data, int data_len, int *offset);
+
+
+/*
+ * Incremental parser of Protocol 2.0 status packets, the same as DynamixelPacketParser,
+ * but it also computes CRC and removes byte stuffing on the fly.
+ */
+typedef struct {
+    Dynamixel2Packet *packet;   // packet being filled (unstuffed)
+    int max_n_parameters;       // capacity of the packet (unstuffed parameters)
+    int state;                  // internal state
+    uint16_t crc;               // running CRC of the raw bytes
+    int n_body_raw;             // number of raw bytes received in body (from instruction)
+    int n_body;                 // number of unstuffed bytes stored (from instruction)
+    uint16_t raw_length;        // length field as received
+    int n_stuffing_matched;     // number of bytes of 0xff 0xff 0xfd pattern matched
+} Dynamixel2PacketParser;
+
+void dynamixel2_packet_parser_init(Dynamixel2PacketParser *parser, Dynamixel2Packet *packet,
+        int max_n_parameters);
+void dynamixel2_packet_parser_reset(Dynamixel2PacketParser *parser);
+DynamixelParserResult dynamixel2_packet_parser_feed_byte(Dynamixel2PacketParser *parser, uint8_t byte);
+DynamixelParserResult dynamixel2_packet_parser_feed(Dynamixel2PacketParser *parser,
+        const uint8_t *data, int data_len, int *n_consumed);
+
+
+/*
+ * Packet builders, each returns expected size of response (unstuffed)
+ * or -1 on error (packet too long), just like dynamixel_prepare_* functions.
+ */
+int dynamixel2_prepare_simple_instruction(Dynamixel2Packet *packet, uint8_t id, uint8_t instruction);
+int dynamixel2_prepare_ping(Dynamixel2Packet *packet, uint8_t id);
+int dynamixel2_prepare_action(Dynamixel2Packet *packet, uint8_t id);
+int dynamixel2_prepare_reboot(Dynamixel2Packet *packet, uint8_t id);
+int dynamixel2_prepare_read(Dynamixel2Packet *packet, uint8_t id, uint16_t address, int data_len);
+int dynamixel2_prepare_write(Dynamixel2Packet *packet, uint8_t id, uint16_t address,
+        const uint8_t *data, int data_len);
+int dynamixel2_prepare_reg_write(Dynamixel2Packet *packet, uint8_t id, uint16_t address,
+        const uint8_t *data, int data_len);
+// data in format {id1, data1[data_len_for_each], id2, ...}, as in dynamixel_prepare_sync_write()
+int dynamixel2_prepare_sync_write(Dynamixel2Packet *packet, uint16_t address, const uint8_t *data,
+        int n_actuators, int data_len_for_each);
+// each servo responds with separate status packet (in order of ids),
+// returns the size of all of them
+int dynamixel2_prepare_sync_read(Dynamixel2Packet *packet, uint16_t address, int data_len,
+        const uint8_t *ids, int n_actuators);
+// all servos respond with a single status packet, returns its size
+int dynamixel2_prepare_fast_sync_read(Dynamixel2Packet *packet, uint16_t address, int data_len,
+        const uint8_t *ids, int n_actuators);
+// gives access to data of n-th servo in decoded fast sync read response
+// (stores error and id of the servo, returns NULL if index is out of packet)
+uint8_t *dynamixel2_fast_sync_read_data(Dynamixel2Packet *packet, int index, int data_len,
+        uint8_t *error, uint8_t *id);
+
+
+#ifdef __cplusplus
+}
+#endif
+
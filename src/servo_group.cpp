@@ -5,7 +5,10 @@ namespace Dynamixel {
 
 
 /*** Servo ********************************************************************/
-Servo::Servo(uint8_t id): servo_id(id) {
+Servo::Servo(uint8_t id):
+    servo_id(id), failures(0), backoff_shift(0), status(dio_UNDEFINED),
+    quarantined(false)
+{
     configASSERT(id != DYNAMIXEL_BROADCASTING_ID);
 }
 
@@ -58,12 +61,36 @@ bool Servo::is_selected() {
     return selected;
 }
 
+DynamixelIOStatus Servo::last_status() {
+    return static_cast<DynamixelIOStatus>(status);
+}
+
+int Servo::n_failures() {
+    return failures;
+}
+
+bool Servo::is_quarantined() {
+    return quarantined;
+}
+
 
 /*** ServoGroup ***************************************************************/
 
+const uint16_t ServoGroup::ax_models[2] = {
+    DYNAMIXEL_AX12_MODEL_NUMBER, DYNAMIXEL_AX18_MODEL_NUMBER
+};
+const uint16_t ServoGroup::mx_models[4] = {
+    DYNAMIXEL_MX12W_MODEL_NUMBER, DYNAMIXEL_MX28_MODEL_NUMBER,
+    DYNAMIXEL_MX64_MODEL_NUMBER, DYNAMIXEL_MX106_MODEL_NUMBER
+};
+
 ServoGroup::ServoGroup(DynamixelIOTaskHandle *task_handle,
         Servo *servos, int n_servos):
-    task_handle(task_handle), servos(servos), n_servos(n_servos)
+    task_handle(task_handle), batch(nullptr), servo_of_item(nullptr), servo_done(nullptr),
+    next_probe(nullptr), rx_storage(nullptr), max_batch_size(0), rx_storage_size(0),
+    servos(servos), n_servos(n_servos), initialised(false),
+    models(ax_models), n_models(2), coalescing(false),
+    max_failures(0), min_backoff(0), max_backoff(0)
 {
     configASSERT(this->n_servos > 0);
     configASSERT(this->servos != nullptr);
@@ -72,7 +99,11 @@ ServoGroup::ServoGroup(DynamixelIOTaskHandle *task_handle,
     // FIXME: requires packets large enough to perform 16-bit sync-write
     // for the whole group, bytes: 2_always + N * (1_id + 2_16bitdata)
     // (this simplifies the design, and support may be implemented later)
-    configASSERT(DYNAMIXEL_MAX_N_PARAMETERS >= 2 + n_servos * (1 + 2));
+    configASSERT(packet.max_n_parameters >= 2 + n_servos * (1 + 2));
+
+    // responses come only to this group, so the IO task may be shared with other callers
+    bool created = dynamixel_io_completion_create(&completion, 1);
+    configASSERT(created);
 
     // take the mutex, we will give it away only after initialise() :D
     // can be run without scheduler if xTicksToWait == 0
@@ -88,38 +119,32 @@ bool ServoGroup::initialise() {
     if (initialised)
         return true;
 
-    // ping each servo to check if we can communicate
-    for (int i = 0; i < n_servos; i++) {
-        bool is_alive = false;
-        // check more than once, not to be over-sensitive
-        for (int j = 0; j < 3; j++) {
-            is_alive = is_alive || ping_servo(i);
-            if (is_alive) break;
-        }
-        if (!is_alive) {
-            return false;
-        }
-    }
+    // ping each servo to check if we can communicate,
+    // check more than once, not to be over-sensitive
+    // (but not more than the circuit breaker allows)
+    if (!ping_all(max_failures > 0 ? std::min(max_failures, 3) : 3))
+        return false;
 
     // check model numbers!
-    prepare_all_u16(DYNAMIXEL_MODEL_NUMBER_L);
+    prepare_all_read<AX::MODEL_NUMBER>();
     if (!read_selected())
         return false;
-    // these are the only ones verified
+    // only the ones verified (see set_models())
     for (int i = 0; i < n_servos; i++) {
-        configASSERT(servos[i].data_u16() == DYNAMIXEL_AX12_MODEL_NUMBER
-                || servos[i].data_u16() == DYNAMIXEL_AX18_MODEL_NUMBER);
+        if (servos[i].quarantined)
+            continue;
+        configASSERT(std::find(models, models + n_models, servos[i].data_u16()) != models + n_models);
     }
 
     // set defaults:
 
     // make sure torque is disabled
-    prepare_all_u8(DYNAMIXEL_TORQUE_ENABLE, 0);
+    prepare_all<AX::TORQUE_ENABLE>(0);
     if (!sync_selected())
         return false;
 
     // set sensible alarm LED and alarm shutdown (default overheating error only)
-    prepare_all_u8(DYNAMIXEL_ALARM_LED, // all for now
+    prepare_all<AX::ALARM_LED>( // all for now
             DYNAMIXEL_ERROR_INSTRUCTION_MASK |
             DYNAMIXEL_ERROR_OVERLOAD_MASK    |
             DYNAMIXEL_ERROR_CHECKSUM_MASK    |
@@ -129,7 +154,7 @@ bool ServoGroup::initialise() {
             DYNAMIXEL_ERROR_INPUT_VOLTAGE_MASK);
     if (!sync_selected())
         return false;
-    prepare_all_u8(DYNAMIXEL_ALARM_SHUTDOWN,
+    prepare_all<AX::ALARM_SHUTDOWN>(
             DYNAMIXEL_ERROR_OVERHEATING_MASK | DYNAMIXEL_ERROR_INPUT_VOLTAGE_MASK);
     if (!sync_selected())
         return false;
@@ -160,6 +185,13 @@ bool ServoGroup::initialise() {
     return true;
 }
 
+void ServoGroup::set_models(const uint16_t *models, int n_models) {
+    configASSERT(models != nullptr && n_models > 0);
+    configASSERT(!initialised);
+    this->models = models;
+    this->n_models = n_models;
+}
+
 bool ServoGroup::sync_selected(bool unselect) {
     // TODO: implement situtations (using reg-write + action?):
     //  - some servos have different lengths of data to be sent
@@ -177,15 +209,23 @@ bool ServoGroup::sync_selected(bool unselect) {
     //         return false;
     // configASSERT(data_len == 1 || data_len == 2);
 
+    probe_quarantined();
+
+    configASSERT(std::any_of(servos, servos + n_servos, [](Servo &s){ return s.is_selected(); }));
+    // quarantined servos are not written
     auto first_selected = std::find_if(servos, servos + n_servos,
-            [](Servo &s){ return s.is_selected(); });
-    configASSERT(first_selected != servos + n_servos);
+            [](Servo &s){ return s.is_selected() && !s.quarantined; });
+    if (first_selected == servos + n_servos) {
+        if (unselect)
+            select_all(false);
+        return true;
+    }
 
     int data_len = first_selected->data_length();
     uint8_t address = first_selected->address();
 
     bool are_all = std::all_of(servos, servos + n_servos, [data_len, address](Servo &s) {
-            if (!s.is_selected())
+            if (!s.is_selected() || s.quarantined)
                 return true;
             return s.data_length() == data_len && s.address() == address;
         });
@@ -221,7 +261,7 @@ bool ServoGroup::sync_selected(bool unselect) {
 
 
     // assemble the packet
-    int init_status = dynamixel_prepare_sync_write_init(&packet, address, data_len);
+    int init_status = packet.prepare_sync_write_init(address, data_len);
     // it would be sad if there was not enough space even for init, but whatever...
     if (init_status != 0)
         return false;
@@ -230,34 +270,41 @@ bool ServoGroup::sync_selected(bool unselect) {
     // calculate if it is possible to send data to all in one sync-write
     //                 N * (id + data) + checksum
     int space_needed = n_servos * (1 + data_len) + 1;
-    int space_remaining = dynamixel_packet_space_remaining(&packet);
+    int space_remaining = packet.space_remaining();
     configASSERT(space_remaining >= space_needed);
 
     // add data from servos
     for (int i = 0; i < n_servos; i++) {
         Servo &servo = servos[i];
-        if (servo.is_selected()) {
-            int result = dynamixel_prepare_sync_write_add_next(&packet,
-                    servo.id(), servo.data());
+        if (servo.is_selected() && !servo.quarantined) {
+            int result = packet.prepare_sync_write_add_next(servo.id(), servo.data());
             if (result != 0)
                 return false;
         }
     }
 
     // start transfer
-    int response_size = dynamixel_prepare_sync_write_end(&packet);
+    int response_size = packet.prepare_sync_write_end();
     // assert that we eariler calculated required space correctly
     if (response_size != 0)
         return false;
 
-    bool is_ok = dynamixel_io_send_request(task_handle,
-            &packet, response_size, false);
-    if (!is_ok)
-        return false;
+    // the newest values replace the ones still waiting in the queue, if there is a free
+    // slot (otherwise sent normally); the packet is sent by the IO task from its slot
+    if (coalescing) {
+        uint8_t *parameters = packet.get()->parameters_with_checksum;
+        int n_selected = (dynamixel_packet_n_parameters(packet.get()) - 2) / (1 + data_len);
+        if (dynamixel_io_sync_write_coalesced(task_handle, address, parameters + 2,
+                    n_selected, data_len, dio_PRIORITY_CONTROL)) {
+            if (unselect)
+                select_all(false);
+            return true;
+        }
+    }
 
+    // goal positions go before any waiting reads (e.g. of other groups on the bus)
     DynamixelIOResponse response;
-    is_ok = dynamixel_io_wait_response(task_handle, &response);
-    if (!is_ok || response.status != dio_OK)
+    if (!transfer(packet.get(), response_size, 1, response, dio_PRIORITY_CONTROL))
         return false;
 
     if (unselect)
@@ -266,72 +313,298 @@ bool ServoGroup::sync_selected(bool unselect) {
     return true;
 }
 
+void ServoGroup::set_coalescing(bool enabled) {
+    coalescing = enabled;
+}
+
 bool ServoGroup::read_selected(bool unselect) {
-    // read each servo separately
+    probe_quarantined();
+
+    // read each servo separately, but send all the reads with one batch request
+    int n_items = 0;
     for (int i = 0; i < n_servos; i++) {
+        Servo &servo = servos[i];
+        if (servo.quarantined)
+            continue;
         // TODO: allows only reading and writing 1 or 2 bytes
-        int len = servos[i].data_length();
+        int len = servo.data_length();
         configASSERT(len == 1 || len == 2);
-        // prepare packet
-        int response_size;
-        if (len == 1)
-            response_size = dynamixel_prepare_read_register_u8(&packet,
-                    servos[i].id(), servos[i].address());
-        else
-            response_size = dynamixel_prepare_read_register_u16(&packet,
-                    servos[i].id(), servos[i].address());
-
-        // send and wait for response
-        bool is_ok = dynamixel_io_send_request(task_handle,
-                &packet, response_size, false);
-        if (!is_ok) return false;
-        DynamixelIOResponse response;
-        is_ok = dynamixel_io_wait_response(task_handle, &response);
-        if (!is_ok || response.status != dio_OK)
+        batch[n_items].packet = batch_packet(n_items);
+        batch[n_items].response_size = dynamixel_prepare_read_sized(batch[n_items].packet, 2,
+                servo.id(), servo.address(), len);
+        servo_of_item[n_items++] = i;
+    }
+
+    bool all_ok = true;
+    if (n_items > 0) {
+        // send and wait for responses
+        all_ok = transfer_batch(n_items);
+
+        // move the data to Servos, of each successful read
+        for (int i = 0; i < n_items; i++) {
+            DynamixelIOResponse &response = batch[i].response;
+            Servo &servo = servos[servo_of_item[i]];
+            record(servo, response.status);
+            if (response.status != dio_OK)
+                continue;
+            servo.data_buffer[0] = response.data[0];
+            if (servo.data_length() == 2)
+                servo.data_buffer[1] = response.data[1];
+            // save last error values
+            servo.last_error = response.status_packet->error;
+        }
+        release_batch(n_items);
+    }
+    if (all_ok && unselect)
+        select_all(false);
+    return all_ok;
+}
+
+bool ServoGroup::bulk_read_selected(bool unselect) {
+    probe_quarantined();
+
+    // the request is assembled where the status packets will be received
+    DynamixelPacket *request = reinterpret_cast<DynamixelPacket *>(rx_storage);
+    const int max_n_parameters = std::min(rx_storage_size - DYNAMIXEL_PACKET_BASE_SIZE - 1,
+            DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS);
+    if (dynamixel_prepare_bulk_read_init_sized(request, max_n_parameters) != 0)
+        return false;
+    // servos that have answered
+    bool *answered = servo_done;
+    int n_responses = 0;
+    for (int i = 0; i < n_servos; i++) {
+        Servo &servo = servos[i];
+        // not read, nothing to record
+        answered[i] = !servo.is_selected() || servo.quarantined;
+        if (answered[i])
+            continue;
+        int len = servo.data_length();
+        configASSERT(len == 1 || len == 2);
+        if (dynamixel_prepare_bulk_read_add_next_sized(request, max_n_parameters,
+                    servo.id(), servo.address(), len) != 0)
             return false;
+        n_responses++;
+    }
+    bool all_ok = true;
+    if (n_responses > 0) {
+        int response_size = dynamixel_prepare_bulk_read_end_sized(request, max_n_parameters);
+        configASSERT(response_size > 0 && response_size <= rx_storage_size);
 
-        // if response was ok, then move the data to Servo
-        servos[i].data_buffer[0] = response.data[0];
-        if (len == 2)
-            servos[i].data_buffer[1] = response.data[1];
-        // save last error values
-        servos[i].last_error = packet.error;
+        DynamixelIOResponse response;
+        all_ok = transfer(request, response_size, n_responses, response);
+        // route each status packet to its servo by id, also the ones received
+        // before a failure (e.g. of a servo that has not responded)
+        int received_size = all_ok ? response_size : response.data_len;
+        if (received_size > 0 && !route_status_packets(response.status_packet, received_size, answered))
+            all_ok = false;
+        dynamixel_io_release_response(task_handle, &response);
+
+        // the rest have failed (or have not been read if the request has not been sent)
+        DynamixelIOStatus failure = response.status != dio_OK ? response.status : dio_WRONG_FRAMING;
+        for (int i = 0; i < n_servos; i++) {
+            if (!answered[i])
+                record(servos[i], failure);
+        }
     }
-    if (unselect)
+    if (all_ok && unselect)
         select_all(false);
+    return all_ok;
+}
+
+bool ServoGroup::route_status_packets(DynamixelPacket *packets, int size, bool *answered) {
+    int offset = 0;
+    DynamixelPacket *status;
+    while ((status = dynamixel_status_packets_next(reinterpret_cast<uint8_t *>(packets), size, &offset))) {
+        auto servo = std::find_if(servos, servos + n_servos, [status](Servo &s) {
+                return s.is_selected() && !s.quarantined && s.id() == status->id;
+            });
+        if (servo == servos + n_servos)
+            return false;
+        int len = servo->data_length();
+        if (dynamixel_packet_n_parameters(status) != len)
+            return false;
+        memcpy(servo->data_buffer, status->parameters_with_checksum, len);
+        servo->last_error = status->error;
+        record(*servo, dio_OK);
+        answered[servo - servos] = true;
+    }
     return true;
 }
 
 bool ServoGroup::read_one(int num, uint8_t *into, uint8_t start_address, int n_bytes) {
-    int response_size = dynamixel_prepare_read(&packet,
-            servos[num].id(), start_address, n_bytes);
+    int response_size = packet.prepare_read(servos[num].id(), start_address, n_bytes);
 
-    bool is_ok = dynamixel_io_send_request(task_handle,
-            &packet, response_size, false);
-    if (!is_ok) return false;
     DynamixelIOResponse response;
-    is_ok = dynamixel_io_wait_response(task_handle, &response);
-    if (!is_ok || response.status != dio_OK)
+    bool ok = transfer(packet.get(), response_size, 1, response);
+    record(servos[num], response.status);
+    if (!ok)
         return false;
 
     // copy data to destination
     memcpy(into, response.data, response.data_len);
+    dynamixel_io_release_response(task_handle, &response);
     return true;
 }
 
 bool ServoGroup::ping_servo(int num) {
     configASSERT(num >= 0 && num < n_servos);
 
-    int response_size = dynamixel_prepare_ping(&packet, servos[num].id());
+    int response_size = packet.prepare_ping(servos[num].id());
     configASSERT(response_size >= 0); // ping has to have response
 
-    bool is_ok = dynamixel_io_send_request(task_handle,
-            &packet, response_size, false);
-    if (!is_ok) return false;
+    DynamixelIOResponse response;
+    bool ok = transfer(packet.get(), response_size, 1, response);
+    record(servos[num], response.status);
+    dynamixel_io_release_response(task_handle, &response);
+    return ok;
+}
+
+void ServoGroup::set_circuit_breaker(int max_failures, TickType_t min_backoff,
+        TickType_t max_backoff) {
+    configASSERT(max_failures >= 0 && max_failures <= UINT8_MAX);
+    configASSERT(max_failures == 0 || (min_backoff > 0 && min_backoff <= max_backoff));
+    this->max_failures = max_failures;
+    this->min_backoff = min_backoff;
+    this->max_backoff = max_backoff;
+    // without the breaker all servos are used again
+    if (max_failures == 0) {
+        for (int i = 0; i < n_servos; i++)
+            servos[i].quarantined = false;
+    }
+}
+
+int ServoGroup::probe_quarantined() {
+    if (max_failures == 0)
+        return 0;
+    TickType_t now = xTaskGetTickCount();
+    int n_items = 0;
+    for (int i = 0; i < n_servos; i++) {
+        Servo &servo = servos[i];
+        // the difference is right also after the tick count wraps
+        if (!servo.quarantined || static_cast<TickType_t>(now - next_probe[i]) > portMAX_DELAY / 2)
+            continue;
+        batch[n_items].packet = batch_packet(n_items);
+        batch[n_items].response_size = dynamixel_prepare_simple_instruction_sized(
+                batch[n_items].packet, 2, servo.id(), DYNAMIXEL_INST_PING);
+        servo_of_item[n_items++] = i;
+    }
+    if (n_items == 0)
+        return 0;
+    transfer_batch(n_items);
+    int n_restored = 0;
+    for (int i = 0; i < n_items; i++) {
+        record(servos[servo_of_item[i]], batch[i].response.status);
+        if (batch[i].response.status == dio_OK)
+            n_restored++;
+    }
+    release_batch(n_items);
+    return n_restored;
+}
 
+void ServoGroup::record(Servo &servo, DynamixelIOStatus status) {
+    servo.status = static_cast<uint8_t>(status);
+    // not sent at all, nothing is known about the servo
+    if (status == dio_UNDEFINED || status == dio_DEADLINE_EXPIRED)
+        return;
+    if (status == dio_OK) {
+        servo.failures = 0;
+        servo.quarantined = false;
+        return;
+    }
+    if (servo.failures < UINT8_MAX)
+        servo.failures++;
+    if (max_failures > 0 && servo.failures >= max_failures)
+        quarantine(servo);
+}
+
+void ServoGroup::quarantine(Servo &servo) {
+    if (!servo.quarantined) {
+        servo.quarantined = true;
+        servo.backoff_shift = 0;
+    } else if ((min_backoff << servo.backoff_shift) <= max_backoff / 2) {
+        servo.backoff_shift++;
+    }
+    next_probe[&servo - servos] = xTaskGetTickCount() + (min_backoff << servo.backoff_shift);
+}
+
+bool ServoGroup::transfer(DynamixelPacket *request_packet, int response_size, int n_responses,
+        DynamixelIOResponse &response, DynamixelIOPriority priority) {
+    // nothing to release if it is not sent
+    response = DynamixelIOResponse();
+    response.status = dio_UNDEFINED;
+    DynamixelIORequest request = {};
+    request.priority = priority;
+    request.packet = request_packet;
+    request.response_size = response_size;
+    request.n_responses = n_responses;
+    request.completion = &completion;
+    if (!dynamixel_io_submit(task_handle, &request))
+        return false;
+    if (!dynamixel_io_wait_completion(&completion, &response))
+        return false;
+    return response.status == dio_OK;
+}
+
+DynamixelPacket *ServoGroup::batch_packet(int i) {
+    configASSERT(i >= 0 && i < max_batch_size);
+    return reinterpret_cast<DynamixelPacket *>(rx_storage + i * batch_slot_size);
+}
+
+bool ServoGroup::transfer_batch(int n_items) {
+    configASSERT(n_items > 0 && n_items <= max_batch_size);
+    // in case the request cannot be sent
+    for (int i = 0; i < n_items; i++) {
+        batch[i].response.status = dio_UNDEFINED;
+        batch[i].response.buffer = nullptr;
+    }
+    if (!dynamixel_io_send_request_batch(task_handle, batch, n_items, &completion))
+        return false;
     DynamixelIOResponse response;
-    is_ok = dynamixel_io_wait_response(task_handle, &response);
-    return is_ok && response.status == dio_OK;
+    if (!dynamixel_io_wait_completion(&completion, &response))
+        return false;
+    return response.status == dio_OK;
+}
+
+void ServoGroup::release_batch(int n_items) {
+    for (int i = 0; i < n_items; i++)
+        dynamixel_io_release_response(task_handle, &batch[i].response);
+}
+
+bool ServoGroup::ping_all(int n_attempts) {
+    bool *alive = servo_done;
+    std::fill(alive, alive + n_servos, false);
+    int n_alive = 0;
+    for (int attempt = 0; attempt < n_attempts && n_alive < n_servos; attempt++) {
+        // ping again only the servos that have not responded yet
+        int n_items = 0;
+        for (int i = 0; i < n_servos; i++) {
+            if (alive[i])
+                continue;
+            batch[n_items].packet = batch_packet(n_items);
+            batch[n_items].response_size = dynamixel_prepare_simple_instruction_sized(
+                    batch[n_items].packet, 2, servos[i].id(), DYNAMIXEL_INST_PING);
+            servo_of_item[n_items++] = i;
+        }
+        transfer_batch(n_items);
+        for (int k = 0; k < n_items; k++) {
+            record(servos[servo_of_item[k]], batch[k].response.status);
+            if (batch[k].response.status == dio_OK) {
+                alive[servo_of_item[k]] = true;
+                n_alive++;
+            }
+        }
+        release_batch(n_items);
+    }
+    if (n_alive == n_servos)
+        return true;
+    if (max_failures == 0)
+        return false;
+    // the rest of the group can be used without them
+    for (int i = 0; i < n_servos; i++) {
+        if (!alive[i] && !servos[i].quarantined)
+            quarantine(servos[i]);
+    }
+    return n_alive > 0;
 }
 
 
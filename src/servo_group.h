@@ -4,6 +4,13 @@
 
 #include "freertos_cpp/mutex.h"
 #include "io_task.h"
+#include "basic_packet.h"
+
+// Capacity of the packet used by ServoGroup, it limits the number of servos
+// in a group to (N - 2) / 3 (for 16-bit sync-write), may be decreased to save memory
+#ifndef DYNAMIXEL_SERVO_GROUP_MAX_N_PARAMETERS
+#   define DYNAMIXEL_SERVO_GROUP_MAX_N_PARAMETERS   DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS
+#endif
 
 
 namespace Dynamixel {
@@ -28,6 +35,12 @@ public:
      */
     void prepare_u8(uint8_t address, uint8_t value = 0);
     void prepare_u16(uint8_t address, uint16_t value = 0);
+    // typed variants (see control_table.h), writing read-only registers does not compile,
+    // returns false (and does not select the servo) if value is out of register range
+    template<const Register &R>
+    bool prepare(uint16_t value);
+    template<const Register &R>
+    void prepare_read();
     void select(bool value=true);
 
     // accessors
@@ -38,6 +51,10 @@ public:
     const uint8_t *data();
     int data_length();
     bool is_selected();
+    // health (see ServoGroup::set_circuit_breaker())
+    DynamixelIOStatus last_status();  // of the last transaction with the servo
+    int n_failures();                 // consecutive failed transactions
+    bool is_quarantined();
 
     // TODO: to be added:
     // - id changing - requires some special checks or we may loose servo's id
@@ -49,10 +66,14 @@ private:
     uint8_t last_error;  // value of packet.error from last reading operation
     uint8_t reg_address;
     uint8_t data_buffer[2];
+    uint8_t failures;         // consecutive failed transactions (saturated)
+    uint8_t backoff_shift;    // probe interval is min_backoff << backoff_shift
+    uint8_t status;           // DynamixelIOStatus of the last transaction
     // avoid taking too much space (Servos are to be stored in an array): subsequent
     // bit-fields of the same type are connected (8 times bool: 1 takes one byte)
     bool is_2_bytes: 1;
     bool selected: 1;
+    bool quarantined: 1;
 };
 
 /*
@@ -74,28 +95,80 @@ private:
  * by deriving from Mutex, which allows to take()/give() access to the class.
  * Also Lock allows to automatic scoped give() (gives in Lock's destructor).
  *
+ * Status of the last transaction with each servo is kept in the Servo. Reads of
+ * a group go on after a failed servo, the others get their data (partial results).
+ * With the circuit breaker a servo that keeps failing (e.g. unplugged) is quarantined:
+ * it is skipped by reads and sync writes, so that it does not cost a timeout in every
+ * cycle, and only pinged from time to time, less and less often, until it responds.
  */
 class ServoGroup: public Mutex {
 public:
+    // size of a slot of Storage for a read (or ping) of up to 2 bytes of one servo
+    static constexpr int batch_slot_size = DYNAMIXEL_PACKET_STORAGE_SIZE(2);
+
+    /* Memory of a group of up to N servos for its reads and the circuit breaker,
+     * provided by the caller (like the array of servos): slots for reads of each servo
+     * of a batch request, or a bulk read request of the whole group and then its status
+     * packets. */
+    template<int N>
+    struct Storage {
+        static_assert(N > 0 && 1 + 3 * N <= DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS,
+                "Bulk read of the whole group does not fit into a packet");
+        DynamixelIOBatchItem batch[N];  // transactions of a batch request
+        uint8_t servo_of_item[N];       // index of the servo of each transaction
+        bool servo_done[N];             // of each servo (answered, alive), used by one operation
+        TickType_t next_probe[N];       // of each servo, when quarantined
+        alignas(DynamixelPacket) uint8_t rx[std::max(N * batch_slot_size,
+                DYNAMIXEL_PACKET_STORAGE_SIZE(1 + 3 * N))];
+    };
+
     /* Initialise the structure (no initial communcation,
      * may be created before FreeRTOS scheduler is started)
      * To use this class initialise() must be called when scheduler is running,
      * this is counter-C++, but it is problematic when the class cannot
-     * be instantiated before starting of the sceduler. */
+     * be instantiated before starting of the sceduler.
+     * Storage must be for at least n_servos and outlive the group. */
+    template<int N>
     ServoGroup(DynamixelIOTaskHandle *task_handle,
-            Servo *servos, int n_servos);
+            Servo *servos, int n_servos, Storage<N> &storage);
 
     /* Perform initial communication, write default values
      * (requires FreeRTOS scheduler running) */
     bool initialise();
+    // model numbers accepted by initialise() (set before it, the array must outlive
+    // the group), AX-12 and AX-18 (ax_models) by default, bulk_read_selected() requires
+    // MX ones (mx_models)
+    void set_models(const uint16_t *models, int n_models);
+    static const uint16_t ax_models[2];
+    static const uint16_t mx_models[4];
     bool is_initialised();
 
     // writing to servos through uart task,
     // by default unselects all servos after operation
     bool sync_selected(bool unselect=true);
+    // sync writes are sent as coalesced writes (the IO task must have coalescing slots,
+    // see dynamixel_io_task_set_coalescing()), sync_selected() does not wait for them
+    // and values still waiting in the queue are replaced by newer ones
+    void set_coalescing(bool enabled);
+    // reads each servo with separate transaction (all of them in one batch request);
+    // data of the servos read successfully
+    // is stored also if others fail (see Servo::last_status()), quarantined servos are
+    // skipped (not a failure)
     bool read_selected(bool unselect=true);
+    // reads all servos with a single bulk read (MX series only, see set_models()), each servo may have
+    // different address and data length (1 or 2 bytes); status packets of all of them
+    // are received into the storage of the group, not into the packet; like read_selected(),
+    // the servos that have responded get their data also if the others fail
+    bool bulk_read_selected(bool unselect=true);
     // bool write_servo(int num, uint8_t address, );
     bool ping_servo(int num);
+    // after max_failures consecutive failed transactions a servo is quarantined (also when
+    // it does not respond to initialise()), until a ping probe succeeds; the first probe is
+    // sent by read_selected() or sync_selected() after min_backoff ticks, the interval
+    // is doubled after each failed one up to max_backoff; max_failures 0 disables (default)
+    void set_circuit_breaker(int max_failures, TickType_t min_backoff, TickType_t max_backoff);
+    // pings quarantined servos whose probe is due, returns the number of restored ones
+    int probe_quarantined();
 
     // TODO: add reading (or writing) more data from one servo
     bool read_one(int num, uint8_t *into, uint8_t start_address, int n_bytes);
@@ -108,20 +181,117 @@ public:
     void prepare_all_u16(uint8_t address, uint16_t value = 0);
     void prepare_selected_u8(uint8_t address, uint8_t value = 0);
     void prepare_selected_u16(uint8_t address, uint16_t value = 0);
+    template<const Register &R>
+    bool prepare_all(uint16_t value);
+    template<const Register &R>
+    void prepare_all_read();
 
     // getters for servo array
     Servo& operator[] (int num);
     int len();
 
 private:
+    // everything but the storage
+    ServoGroup(DynamixelIOTaskHandle *task_handle, Servo *servos, int n_servos);
+
+    // sends the request packet and waits for response, true if it is ok
+    bool transfer(DynamixelPacket *request, int response_size, int n_responses,
+            DynamixelIOResponse &response, DynamixelIOPriority priority = dio_PRIORITY_NORMAL);
+    // packet in the i-th slot of the storage of the group (with 2 parameters)
+    DynamixelPacket *batch_packet(int i);
+    // sends the first n_items of batch with one request and waits for it,
+    // true if all are ok (otherwise results of each item are in their responses)
+    bool transfer_batch(int n_items);
+    // gives the rx buffers of the first n_items of batch back to the pool of the IO task
+    void release_batch(int n_items);
+    // copies data of status packets of a bulk read (size bytes) to the selected servos
+    // and marks them answered, false if a packet is not of a selected servo
+    bool route_status_packets(DynamixelPacket *packets, int size, bool *answered);
+    // pings all servos (each at most n_attempts times), true if all have responded
+    // (or the others have been quarantined)
+    bool ping_all(int n_attempts);
+    // updates health of the servo after a transaction with it
+    void record(Servo &servo, DynamixelIOStatus status);
+    // (again, after a failed probe with longer backoff)
+    void quarantine(Servo &servo);
+
     DynamixelIOTaskHandle *task_handle; // task to handle comunication over UART
-    DynamixelPacket packet;             // structure for storing UART packets
+    DynamixelIOCompletion completion;   // responses to requests of this group
+    BasicPacket<DYNAMIXEL_SERVO_GROUP_MAX_N_PARAMETERS> packet; // structure for storing UART packets
+    // of the Storage given by the caller
+    DynamixelIOBatchItem *batch;        // transactions of a batch request
+    uint8_t *servo_of_item;
+    bool *servo_done;
+    TickType_t *next_probe;
+    uint8_t *rx_storage;                // batch requests and bulk reads
+    int max_batch_size;                 // number of servos the storage is for
+    int rx_storage_size;
     Servo *servos;                      // pointer to prealocated array of DynamixelServo
     const int n_servos;                       // number of servos in the group
     bool initialised;                   // specifies wheather initialise() has been called
+    const uint16_t *models;             // accepted by initialise()
+    int n_models;
+    bool coalescing;                    // sync writes are coalesced
+    int max_failures;                   // of the circuit breaker, 0 if disabled
+    TickType_t min_backoff;
+    TickType_t max_backoff;
 };
 
 
 
 
+template<int N>
+ServoGroup::ServoGroup(DynamixelIOTaskHandle *task_handle,
+        Servo *servos, int n_servos, Storage<N> &storage):
+    ServoGroup(task_handle, servos, n_servos)
+{
+    configASSERT(n_servos <= N);
+    batch = storage.batch;
+    servo_of_item = storage.servo_of_item;
+    servo_done = storage.servo_done;
+    next_probe = storage.next_probe;
+    rx_storage = storage.rx;
+    max_batch_size = N;
+    rx_storage_size = sizeof(storage.rx);
+}
+
+template<const Register &R>
+bool Servo::prepare(uint16_t value) {
+    static_assert(R.is_writable(), "Register is read-only");
+    static_assert(R.size == 1 || R.size == 2, "Servo stores only 1 or 2 bytes");
+    if (!R.contains(value))
+        return false;
+    if (R.size == 1)
+        prepare_u8(R.address, value);
+    else
+        prepare_u16(R.address, value);
+    return true;
+}
+
+template<const Register &R>
+void Servo::prepare_read() {
+    static_assert(R.size == 1 || R.size == 2, "Servo stores only 1 or 2 bytes");
+    if (R.size == 1)
+        prepare_u8(R.address);
+    else
+        prepare_u16(R.address);
+}
+
+template<const Register &R>
+bool ServoGroup::prepare_all(uint16_t value) {
+    // check range first so that no servo is left prepared
+    if (!R.contains(value))
+        return false;
+    for (int i = 0; i < n_servos; i++)
+        servos[i].prepare<R>(value);
+    return true;
+}
+
+template<const Register &R>
+void ServoGroup::prepare_all_read() {
+    for (int i = 0; i < n_servos; i++)
+        servos[i].prepare_read<R>();
+}
+
+
 } // namespace Dynamixel
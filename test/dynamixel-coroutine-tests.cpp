@@ -0,0 +1,6 @@
+#include "dynamixel_io_coroutine_tests.h"
+
+
+int main(void) {
+    return run_dynamixel_io_coroutine_tests();
+}
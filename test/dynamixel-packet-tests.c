@@ -5,9 +5,33 @@
 
 #include "dynamixel_packet_tests.h"
 #include "dynamixel_tests.h"
+#include "dynamixel_packet_parser_tests.h"
+#include "dynamixel_packet_template_tests.h"
+#include "dynamixel_protocol2_tests.h"
+#include "dynamixel_packet_batch_tests.h"
+#include "dynamixel_conversions_tests.h"
+#include "dynamixel_trace_chrome_tests.h"
+#include "dynamixel_io_capture_tests.h"
+#ifdef DYNAMIXEL_WITH_POSIX
+#   include "dynamixel_posix_io_tests.h"
+#   include "dynamixel_virtual_bus_tests.h"
+#   include "dynamixel_io_task_tests.h"
+#   include "dynamixel_replay_tests.h"
+#   include "dynamixel_discovery_tests.h"
+#endif
 
 
 int main(void) {
-    return run_dynamixel_tests() + run_dynamixel_packet_tests();
+    return run_dynamixel_tests() + run_dynamixel_packet_tests()
+        + run_dynamixel_packet_parser_tests() + run_dynamixel_packet_template_tests()
+        + run_dynamixel_protocol2_tests() + run_dynamixel_packet_batch_tests()
+        + run_dynamixel_conversions_tests() + run_dynamixel_trace_chrome_tests()
+        + run_dynamixel_io_capture_tests()
+#ifdef DYNAMIXEL_WITH_POSIX
+        + run_dynamixel_posix_io_tests() + run_dynamixel_virtual_bus_tests()
+        + run_dynamixel_io_task_tests() + run_dynamixel_replay_tests()
+        + run_dynamixel_discovery_tests()
+#endif
+        ;
 }
 
@@ -0,0 +1,7 @@
+#include "dynamixel_control_table_tests.h"
+#include "dynamixel_servo_group_tests.h"
+
+
+int main(void) {
+    return run_dynamixel_control_table_tests() + run_dynamixel_servo_group_tests();
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <type_traits>
+#include <utility>
+
+#include "dynamixel.h"
+#include "basic_packet.h"
+#include "control_table.h"
+
+/*
+ * Typed helpers of control_table.h compared with packets prepared by dynamixel_prepare_*.
+ */
+
+using namespace Dynamixel;
+
+// whether prepare_write<R>() compiles for the register
+template<const Register &R, typename = void>
+struct ControlTableTestWritable: std::false_type {};
+template<const Register &R>
+struct ControlTableTestWritable<R, decltype((void) prepare_write<R>(
+            std::declval<MaxPacket &>(), uint8_t(1), uint16_t(0)))>: std::true_type {};
+
+static_assert(ControlTableTestWritable<AX::GOAL_POSITION>::value, "Writable register rejected");
+static_assert(!ControlTableTestWritable<AX::PRESENT_POSITION>::value, "Read-only register written");
+static_assert(!ControlTableTestWritable<AX::MODEL_NUMBER>::value, "Read-only register written");
+// a block is read-only if any of its registers is
+static_assert(!ControlTableTestWritable<AX::PRESENT_POSITION_AND_SPEED>::value, "Read-only block written");
+
+static_assert(AX::PRESENT_POSITION_AND_SPEED.address == DYNAMIXEL_PRESENT_POSITION_L
+        && AX::PRESENT_POSITION_AND_SPEED.size == 4 && AX::PRESENT_POSITION_AND_SPEED.is_volatile,
+        "Wrong coalescing");
+
+static void control_table_test_assert_packet(DynamixelPacket *packet, DynamixelPacket *correct) {
+    assert_int_equal(dynamixel_packet_size(packet), dynamixel_packet_size(correct));
+    assert_memory_equal(dynamixel_packet_data(packet), dynamixel_packet_data(correct),
+            dynamixel_packet_size(correct));
+}
+
+static void test_control_table_prepare_write(void **state) {
+    MaxPacket packet;
+    DynamixelPacket correct;
+    uint8_t goal[] = {0x00, 0x02};
+    int correct_size = dynamixel_prepare_write(&correct, 3, DYNAMIXEL_GOAL_POSITION_L, goal, 2);
+
+    assert_int_equal(prepare_write<AX::GOAL_POSITION>(packet, 3, 0x200), correct_size);
+    control_table_test_assert_packet(packet.get(), &correct);
+    assert_int_equal((prepare_write<AX::GOAL_POSITION, 0x200>(packet, 3)), correct_size);
+    control_table_test_assert_packet(packet.get(), &correct);
+    assert_int_equal(prepare_write<AX::GOAL_POSITION>(packet, 3, goal), correct_size);
+    control_table_test_assert_packet(packet.get(), &correct);
+    assert_int_equal(packet.prepare_write<AX::GOAL_POSITION>(3, 0x200), correct_size);
+    control_table_test_assert_packet(packet.get(), &correct);
+
+    // of the default capacity
+    DynamixelPacket plain;
+    assert_int_equal(prepare_write<AX::GOAL_POSITION>(&plain, 3, 0x200), correct_size);
+    control_table_test_assert_packet(&plain, &correct);
+    assert_int_equal((prepare_write<AX::GOAL_POSITION, 0x200>(&plain, 3)), correct_size);
+    control_table_test_assert_packet(&plain, &correct);
+
+    // 1 byte register
+    correct_size = dynamixel_prepare_set_register_u8(&correct, 3, DYNAMIXEL_LED, 1);
+    assert_int_equal(prepare_write<AX::LED>(packet, 3, 1), correct_size);
+    control_table_test_assert_packet(packet.get(), &correct);
+}
+
+static void test_control_table_out_of_range(void **state) {
+    MaxPacket packet;
+    DynamixelPacket plain;
+    assert_int_equal(prepare_write<AX::GOAL_POSITION>(packet, 1, 1024), -1);
+    assert_int_equal(prepare_write<AX::GOAL_POSITION>(&plain, 1, 1024), -1);
+    // minimum above zero
+    assert_int_equal(prepare_write<AX::PUNCH>(packet, 1, 31), -1);
+    assert_true(prepare_write<AX::PUNCH>(packet, 1, 32) > 0);
+    assert_int_equal(prepare_write<AX::LED>(packet, 1, 2), -1);
+    assert_int_equal(packet.prepare_write<AX::TORQUE_ENABLE>(1, 0x100), -1);
+}
+
+static void test_control_table_prepare_read(void **state) {
+    MaxPacket packet;
+    DynamixelPacket correct;
+    int correct_size = dynamixel_prepare_read(&correct, 2, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    assert_int_equal(correct_size, 8);
+
+    assert_int_equal(prepare_read<AX::PRESENT_POSITION>(packet, 2), correct_size);
+    control_table_test_assert_packet(packet.get(), &correct);
+    assert_int_equal(packet.prepare_read<AX::PRESENT_POSITION>(2), correct_size);
+    control_table_test_assert_packet(packet.get(), &correct);
+    DynamixelPacket plain;
+    assert_int_equal(prepare_read<AX::PRESENT_POSITION>(&plain, 2), correct_size);
+    control_table_test_assert_packet(&plain, &correct);
+}
+
+static void test_control_table_coalesced(void **state) {
+    MaxPacket packet;
+    DynamixelPacket correct;
+    // goal position 0x123 and moving speed 0x45
+    uint8_t data[] = {0x23, 0x01, 0x45, 0x00};
+    int correct_size = dynamixel_prepare_write(&correct, 1, DYNAMIXEL_GOAL_POSITION_L, data, 4);
+    assert_int_equal(prepare_write<AX::GOAL_POSITION_AND_SPEED>(packet, 1, data), correct_size);
+    control_table_test_assert_packet(packet.get(), &correct);
+
+    correct_size = dynamixel_prepare_read(&correct, 1, DYNAMIXEL_PRESENT_POSITION_L, 4);
+    assert_int_equal(prepare_read<AX::PRESENT_POSITION_AND_SPEED>(packet, 1), correct_size);
+    control_table_test_assert_packet(packet.get(), &correct);
+
+    // the capacity of the packet is respected (address and 4 bytes of data)
+    BasicPacket<4> small;
+    assert_true(prepare_write<AX::GOAL_POSITION_AND_SPEED>(small, 1, data) < 0);
+    assert_int_equal(prepare_read<AX::PRESENT_POSITION_AND_SPEED>(small, 1), correct_size);
+}
+
+static void test_control_table_sync_write_bulk_read(void **state) {
+    MaxPacket packet;
+    DynamixelPacket correct;
+    uint8_t data[] = {1, 0x10, 0x00, 2, 0x20, 0x00};
+    dynamixel_prepare_sync_write(&correct, DYNAMIXEL_GOAL_POSITION_L, data, 2, 2);
+    assert_int_equal(prepare_sync_write_init<AX::GOAL_POSITION>(packet), 0);
+    assert_int_equal(packet.prepare_sync_write_add_next(1, &data[1]), 0);
+    assert_int_equal(packet.prepare_sync_write_add_next(2, &data[4]), 0);
+    assert_int_equal(packet.prepare_sync_write_end(), 0);
+    control_table_test_assert_packet(packet.get(), &correct);
+
+    uint8_t bulk[] = {2, 1, DYNAMIXEL_PRESENT_POSITION_L, 1, 2, DYNAMIXEL_ID};
+    int correct_size = dynamixel_prepare_bulk_read(&correct, bulk, 2);
+    assert_int_equal(packet.prepare_bulk_read_init(), 0);
+    assert_int_equal(prepare_bulk_read_add_next<AX::PRESENT_POSITION>(packet, 1), 0);
+    assert_int_equal(packet.prepare_bulk_read_add_next<AX::ID>(2), 0);
+    assert_int_equal(packet.prepare_bulk_read_end(), correct_size);
+    control_table_test_assert_packet(packet.get(), &correct);
+}
+
+int run_dynamixel_control_table_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_control_table_prepare_write),
+        cmocka_unit_test(test_control_table_out_of_range),
+        cmocka_unit_test(test_control_table_prepare_read),
+        cmocka_unit_test(test_control_table_coalesced),
+        cmocka_unit_test(test_control_table_sync_write_bulk_read),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+
+#include "conversions.h"
+
+// exact values for reference
+#define TEST_MAX_ANGLE_RAD    (300 * 3.14159265358979323846 / 180)
+#define TEST_MAX_SPEED_RADPS  (114 * 2 * 3.14159265358979323846 / 60)
+
+
+static void test_conversions_angle_q16(void **state) {
+    for (uint16_t angle = 0; angle <= DYNAMIXEL_MAX_ANGLE_INT; angle++) {
+        double rad = angle * TEST_MAX_ANGLE_RAD / DYNAMIXEL_MAX_ANGLE_INT;
+        int32_t rad_q16 = dynamixel_angle2rad_q16(angle);
+        assert_true(fabs(rad_q16 - rad * 65536) <= 1);
+        assert_int_equal(dynamixel_rad2angle_q16(rad_q16), angle);
+        // rounding to nearest
+        assert_int_equal(dynamixel_rad2angle_q16(rad_q16 + 80), angle);
+        assert_int_equal(dynamixel_rad2angle_q16(rad_q16 - 80), angle);
+    }
+    // saturation
+    assert_int_equal(dynamixel_rad2angle_q16(-65536), 0);
+    assert_int_equal(dynamixel_rad2angle_q16(10 * 65536), DYNAMIXEL_MAX_ANGLE_INT);
+    assert_int_equal(dynamixel_rad2angle_q16(INT32_MAX), DYNAMIXEL_MAX_ANGLE_INT);
+}
+
+static void test_conversions_angle_q15(void **state) {
+    for (uint16_t angle = 0; angle <= DYNAMIXEL_MAX_ANGLE_INT; angle++) {
+        // fraction of pi relative to 150 deg
+        double deg = angle * 300.0 / DYNAMIXEL_MAX_ANGLE_INT - 150;
+        int16_t pi_q15 = dynamixel_angle2pi_q15(angle);
+        assert_true(fabs(pi_q15 - deg / 180 * 32768) <= 1);
+        assert_int_equal(dynamixel_pi2angle_q15(pi_q15), angle);
+    }
+    assert_int_equal(dynamixel_angle2pi_q15(0), -dynamixel_angle2pi_q15(DYNAMIXEL_MAX_ANGLE_INT));
+    assert_int_equal(dynamixel_pi2angle_q15(INT16_MIN), 0);
+    assert_int_equal(dynamixel_pi2angle_q15(INT16_MAX), DYNAMIXEL_MAX_ANGLE_INT);
+}
+
+static void test_conversions_speed(void **state) {
+    for (uint16_t speed = 0; speed <= DYNAMIXEL_SPEED_MAX_VALUE; speed++) {
+        double radps = speed * TEST_MAX_SPEED_RADPS / DYNAMIXEL_SPEED_MAX_VALUE;
+        int32_t radps_q16 = dynamixel_speed2radps_q16(speed);
+        assert_true(fabs(radps_q16 - radps * 65536) <= 1);
+        assert_int_equal(dynamixel_radps2speed_q16(radps_q16), speed);
+        assert_true(fabs(dynamixel_speed2radps(speed) - radps) < 1e-5);
+        assert_int_equal(dynamixel_radps2speed(dynamixel_speed2radps(speed)), speed);
+        // clockwise
+        uint16_t speed_cw = speed | DYNAMIXEL_GOAL_SPEED_DIRECTION_MASK;
+        assert_int_equal(dynamixel_speed2radps_q16(speed_cw), -radps_q16);
+        if (speed > 0) {
+            assert_int_equal(dynamixel_radps2speed_q16(-radps_q16), speed_cw);
+            assert_int_equal(dynamixel_radps2speed(dynamixel_speed2radps(speed_cw)), speed_cw);
+        }
+    }
+    assert_int_equal(dynamixel_radps2speed_q16(100 * 65536), DYNAMIXEL_SPEED_MAX_VALUE);
+    assert_int_equal(dynamixel_radps2speed(100), DYNAMIXEL_SPEED_MAX_VALUE);
+    assert_int_equal(dynamixel_radps2speed(-100),
+            DYNAMIXEL_SPEED_MAX_VALUE | DYNAMIXEL_GOAL_SPEED_DIRECTION_MASK);
+}
+
+static void test_conversions_batch(void **state) {
+    enum { N = 37 };  // not a multiple of vector size
+    uint16_t angles[N], result[N];
+    float rad[N];
+    int32_t rad_q16[N];
+    int16_t pi_q15[N];
+    for (int i = 0; i < N; i++)
+        angles[i] = i * 27;
+
+    dynamixel_angles2rad(angles, rad, N);
+    for (int i = 0; i < N; i++)
+        assert_true(fabsf(rad[i] - dynamixel_angle2rad(angles[i])) < 1e-5f);
+    dynamixel_rad2angles(rad, result, N);
+    assert_memory_equal(result, angles, sizeof(angles));
+
+    dynamixel_angles2rad_q16(angles, rad_q16, N);
+    for (int i = 0; i < N; i++)
+        assert_int_equal(rad_q16[i], dynamixel_angle2rad_q16(angles[i]));
+    dynamixel_rad2angles_q16(rad_q16, result, N);
+    assert_memory_equal(result, angles, sizeof(angles));
+
+    dynamixel_angles2pi_q15(angles, pi_q15, N);
+    for (int i = 0; i < N; i++)
+        assert_int_equal(pi_q15[i], dynamixel_angle2pi_q15(angles[i]));
+    dynamixel_pi2angles_q15(pi_q15, result, N);
+    assert_memory_equal(result, angles, sizeof(angles));
+
+    // speeds with both directions
+    for (int i = 0; i < N; i++)
+        angles[i] = i % 2 ? i * 27 : (i * 27) | DYNAMIXEL_GOAL_SPEED_DIRECTION_MASK;
+    angles[0] = 0;
+    dynamixel_speeds2radps(angles, rad, N);
+    dynamixel_radps2speeds(rad, result, N);
+    assert_memory_equal(result, angles, sizeof(angles));
+    dynamixel_speeds2radps_q16(angles, rad_q16, N);
+    dynamixel_radps2speeds_q16(rad_q16, result, N);
+    assert_memory_equal(result, angles, sizeof(angles));
+}
+
+
+int run_dynamixel_conversions_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_conversions_angle_q16),
+        cmocka_unit_test(test_conversions_angle_q15),
+        cmocka_unit_test(test_conversions_speed),
+        cmocka_unit_test(test_conversions_batch),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
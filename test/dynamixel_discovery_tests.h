@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include "dynamixel.h"
+#include "discovery_utils.h"
+#include "io_task.h"
+#include "virtual_bus.h"
+#include "dynamixel_virtual_bus_fixture.h"
+
+/*
+ * Discovery of virtual AX-12 servos (ids 1, 7 and 200, and id 3 at another baud rate)
+ * in virtual time, the printed information is collected into a buffer.
+ */
+
+#define DISCOVERY_TEST_N_SERVOS   4
+
+typedef VirtualBusFixture DiscoveryTestState;
+
+static DiscoveryTestState discovery_test;
+static char discovery_test_output[2048];
+static int discovery_test_output_len;
+
+static int discovery_group_setup(void **state)
+{
+    DiscoveryTestState *test = &discovery_test;
+    *state = test;
+    dynamixel_virtual_servo_init(&test->servos[0], 1);
+    dynamixel_virtual_servo_init(&test->servos[1], 7);
+    dynamixel_virtual_servo_init(&test->servos[2], 200);
+    dynamixel_virtual_servo_init(&test->servos[3], 3);
+    dynamixel_virtual_servo_write_u8(&test->servos[3], DYNAMIXEL_BAUD_RATE, DYNAMIXEL_BAUD_RATE_57600);
+    // the (short) return delay is reported
+    dynamixel_virtual_servo_write_u8(&test->servos[1], DYNAMIXEL_RETURN_DELAY_TIME, 0x10);
+    return virtual_bus_fixture_init(test, DISCOVERY_TEST_N_SERVOS, 1) ? 0 : -1;
+}
+
+static int discovery_test_write(char *ptr, int len) {
+    int space = (int) sizeof(discovery_test_output) - 1 - discovery_test_output_len;
+    len = len < space ? len : space;
+    memcpy(&discovery_test_output[discovery_test_output_len], ptr, len);
+    discovery_test_output_len += len;
+    discovery_test_output[discovery_test_output_len] = '\0';
+    return len;
+}
+
+static int discovery_test_count(const char *text) {
+    int n = 0;
+    for (const char *found = strstr(discovery_test_output, text); found != NULL;
+            found = strstr(found + 1, text))
+        n++;
+    return n;
+}
+
+static void test_discovery_finds_servos(void **state) {
+    DiscoveryTestState *test = (DiscoveryTestState *) *state;
+    discovery_test_output_len = 0;
+    dynamixel_servos_discovery(&test->io_task, discovery_test_write);
+
+    assert_int_equal(discovery_test_count("Found servo"), 3);
+    assert_non_null(strstr(discovery_test_output, "Found servo with ID 1\n"));
+    assert_non_null(strstr(discovery_test_output, "Found servo with ID 7\n"
+                "-> model number = 0x0c \n"
+                "-> firmware ver = 0x18 \n"
+                "-> baud rate    = 0x01 \n"
+                "-> return delay = 0x10 \n"));
+    assert_non_null(strstr(discovery_test_output, "Found servo with ID 200\n"));
+    assert_null(strstr(discovery_test_output, "ID 3\n"));
+    assert_int_equal(discovery_test_count("ERROR"), 0);
+    // found servo is pinged once, then its registers are read one by one
+    assert_int_equal(test->servos[0].n_instructions, 1 + 4);
+}
+
+static void test_discovery_without_output(void **state) {
+    DiscoveryTestState *test = (DiscoveryTestState *) *state;
+    uint32_t n_instructions = test->servos[0].n_instructions;
+    dynamixel_servos_discovery(&test->io_task, NULL);
+    assert_int_equal(test->servos[0].n_instructions, n_instructions);
+}
+
+int run_dynamixel_discovery_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_discovery_finds_servos),
+        cmocka_unit_test(test_discovery_without_output),
+    };
+    return cmocka_run_group_tests(tests, discovery_group_setup, NULL);
+}
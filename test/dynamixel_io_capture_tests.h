@@ -0,0 +1,131 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include "io_capture.h"
+
+static void test_capture_ring_wrap(void **state) {
+    uint8_t buffer[64];
+    DynamixelIOCaptureRing ring;
+    assert_false(dynamixel_capture_ring_init(&ring, buffer, 48));
+    assert_true(dynamixel_capture_ring_init(&ring, buffer, sizeof(buffer)));
+
+    // 16 + 20 bytes each, the second one wraps around the end of the buffer
+    const uint8_t data[20] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20};
+    uint8_t out[64];
+    for (int i = 0; i < 3; i++) {
+        DynamixelIOCaptureRecord record = {.time_us = (uint32_t) i, .tx_length = 12, .rx_length = 8,
+            .n_responses = 1};
+        assert_true(dynamixel_capture_ring_write(&ring, &record, data, &data[12]));
+        assert_int_equal(dynamixel_capture_ring_read(&ring, out, sizeof(out)), sizeof(record) + sizeof(data));
+        DynamixelIOCaptureRecord copy;
+        memcpy(&copy, out, sizeof(copy));
+        assert_int_equal(copy.time_us, i);
+        assert_int_equal(copy.tx_length, 12);
+        assert_int_equal(copy.rx_length, 8);
+        assert_memory_equal(&out[sizeof(copy)], data, sizeof(data));
+    }
+    assert_int_equal(dynamixel_capture_ring_read(&ring, out, sizeof(out)), 0);
+    assert_int_equal(ring.n_dropped, 0);
+}
+
+static void test_capture_ring_drop(void **state) {
+    uint8_t buffer[64];
+    DynamixelIOCaptureRing ring;
+    dynamixel_capture_ring_init(&ring, buffer, sizeof(buffer));
+    const uint8_t data[16] = {0};
+    DynamixelIOCaptureRecord record = {.tx_length = sizeof(data)};
+
+    // only two fit, the third one is dropped whole
+    assert_true(dynamixel_capture_ring_write(&ring, &record, data, NULL));
+    assert_true(dynamixel_capture_ring_write(&ring, &record, data, NULL));
+    assert_false(dynamixel_capture_ring_write(&ring, &record, data, NULL));
+    assert_int_equal(ring.n_dropped, 1);
+
+    // partial read frees space for it
+    uint8_t out[64];
+    assert_int_equal(dynamixel_capture_ring_read(&ring, out, 40), 40);
+    assert_true(dynamixel_capture_ring_write(&ring, &record, data, NULL));
+    assert_int_equal(dynamixel_capture_ring_read(&ring, out, sizeof(out)), 2 * 32 - 40 + 32);
+    assert_int_equal(ring.n_dropped, 1);
+}
+
+static void test_capture_ring_reserve(void **state) {
+    uint8_t buffer[64];
+    DynamixelIOCaptureRing ring;
+    dynamixel_capture_ring_init(&ring, buffer, sizeof(buffer));
+    const uint8_t ping[] = {0xff, 0xff, 0x01, 0x02, 0x01, 0xfb};
+    const uint8_t status[] = {0xff, 0xff, 0x01, 0x02, 0x00, 0xfc};
+    uint8_t out[64];
+
+    // space for the whole expected response, the record is seen only when it ends
+    assert_false(dynamixel_capture_ring_begin(&ring, ping, sizeof(ping), 64 - 16));
+    assert_int_equal(ring.n_dropped, 1);
+    assert_true(dynamixel_capture_ring_begin(&ring, ping, sizeof(ping), 64 - 16 - sizeof(ping)));
+    assert_int_equal(dynamixel_capture_ring_read(&ring, out, sizeof(out)), 0);
+    DynamixelIOCaptureRecord record = {.time_us = 5, .tx_length = sizeof(ping),
+        .rx_length = sizeof(status), .response_size = sizeof(status), .n_responses = 1};
+    dynamixel_capture_ring_end(&ring, &record, status);
+    assert_int_equal(dynamixel_capture_ring_read(&ring, out, sizeof(out)),
+            sizeof(record) + sizeof(ping) + sizeof(status));
+    assert_memory_equal(&out[sizeof(record)], ping, sizeof(ping));
+    assert_memory_equal(&out[sizeof(record) + sizeof(ping)], status, sizeof(status));
+
+    // nothing is published without a reservation
+    dynamixel_capture_ring_end(&ring, &record, status);
+    assert_int_equal(dynamixel_capture_ring_read(&ring, out, sizeof(out)), 0);
+}
+
+static void test_capture_log_parse(void **state) {
+    uint8_t log[64];
+    DynamixelIOCaptureHeader header;
+    dynamixel_capture_header_init(&header, 2);
+    memcpy(log, &header, sizeof(header));
+    size_t size = sizeof(header);
+    const uint8_t ping[] = {0xff, 0xff, 0x01, 0x02, 0x01, 0xfb};
+    DynamixelIOCaptureRecord timeout = {.time_us = 100, .duration_us = 600, .tx_length = sizeof(ping),
+        .response_size = 6, .n_responses = 1, .status = 4};
+    memcpy(&log[size], &timeout, sizeof(timeout));
+    memcpy(&log[size + sizeof(timeout)], ping, sizeof(ping));
+    size += sizeof(timeout) + sizeof(ping);
+
+    uint8_t protocol = 0;
+    size_t offset = dynamixel_capture_header_check(log, size, &protocol);
+    assert_int_equal(offset, sizeof(header));
+    assert_int_equal(protocol, 2);
+
+    DynamixelIOCaptureRecord record;
+    const uint8_t *tx_data, *rx_data;
+    assert_true(dynamixel_capture_next(log, size, &offset, &record, &tx_data, &rx_data));
+    assert_int_equal(record.response_size, 6);
+    assert_int_equal(record.duration_us, 600);
+    assert_int_equal(record.status, 4);
+    assert_int_equal(record.rx_length, 0);
+    assert_memory_equal(tx_data, ping, sizeof(ping));
+    assert_ptr_equal(rx_data, tx_data + sizeof(ping));
+    assert_false(dynamixel_capture_next(log, size, &offset, &record, &tx_data, &rx_data));
+
+    // truncated record
+    offset = sizeof(header);
+    assert_false(dynamixel_capture_next(log, sizeof(header) + sizeof(timeout) + 2, &offset,
+                &record, &tx_data, &rx_data));
+    // not a log
+    log[0] = 'X';
+    assert_int_equal(dynamixel_capture_header_check(log, size, NULL), 0);
+    assert_int_equal(dynamixel_capture_header_check(log, 4, NULL), 0);
+}
+
+int run_dynamixel_io_capture_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_capture_ring_wrap),
+        cmocka_unit_test(test_capture_ring_drop),
+        cmocka_unit_test(test_capture_ring_reserve),
+        cmocka_unit_test(test_capture_log_parse),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
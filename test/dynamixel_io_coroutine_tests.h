@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "dynamixel.h"
+#include "io_task.h"
+#include "io_coroutine.h"
+#include "virtual_bus.h"
+#include "dynamixel_virtual_bus_fixture.h"
+
+/*
+ * One thread driving two buses of virtual AX-12 servos (virtual time) with coroutines,
+ * servo i of bus b has present position 1000 * b + i.
+ */
+
+#define IO_COROUTINE_TEST_N_BUSES      2
+#define IO_COROUTINE_TEST_N_SERVOS     3
+#define IO_COROUTINE_TEST_N_CYCLES     20
+
+struct IOCoroutineTestBus : VirtualBusFixture {
+    int n_ok;
+    bool done;
+};
+
+static IOCoroutineTestBus io_coroutine_test_buses[IO_COROUTINE_TEST_N_BUSES];
+
+static int io_coroutine_group_setup(void **state)
+{
+    for (int b = 0; b < IO_COROUTINE_TEST_N_BUSES; b++) {
+        IOCoroutineTestBus *test = &io_coroutine_test_buses[b];
+        virtual_bus_fixture_reset_servos(test, IO_COROUTINE_TEST_N_SERVOS);
+        for (int i = 0; i < IO_COROUTINE_TEST_N_SERVOS; i++)
+            dynamixel_virtual_servo_write_u16(&test->servos[i], DYNAMIXEL_PRESENT_POSITION_L,
+                    1000 * b + i + 1);
+        if (!virtual_bus_fixture_init(test, IO_COROUTINE_TEST_N_SERVOS, 4))
+            return -1;
+    }
+    return 0;
+}
+
+// reads positions of all servos of the bus in each cycle
+static Dynamixel::IOCoroutine io_coroutine_test_poll(Dynamixel::IOScheduler &scheduler, int b)
+{
+    IOCoroutineTestBus *test = &io_coroutine_test_buses[b];
+    DynamixelPacket packet;
+    for (int cycle = 0; cycle < IO_COROUTINE_TEST_N_CYCLES; cycle++) {
+        for (int i = 0; i < IO_COROUTINE_TEST_N_SERVOS; i++) {
+            int response_size = dynamixel_prepare_read(&packet, i + 1, DYNAMIXEL_PRESENT_POSITION_L, 2);
+            DynamixelIOResponse response = co_await scheduler.transfer(&test->io_task, &packet,
+                    response_size);
+            if (response.status == dio_OK && response.packet == &packet
+                    && (response.data[0] | (response.data[1] << 8)) == 1000 * b + i + 1)
+                test->n_ok++;
+            dynamixel_io_release_response(&test->io_task, &response);
+        }
+    }
+    test->done = true;
+}
+
+static void test_io_coroutine_buses(void **state)
+{
+    // the first bus receives into the only buffer of its pool, given back by the coroutine
+    static uint8_t storage[16];
+    DynamixelIORxPool pool;
+    assert_true(dynamixel_io_rx_pool_create(&pool, storage, sizeof(storage), 1));
+    dynamixel_io_task_set_rx_pool(&io_coroutine_test_buses[0].io_task, &pool);
+
+    Dynamixel::IOScheduler scheduler(IO_COROUTINE_TEST_N_BUSES);
+    for (int b = 0; b < IO_COROUTINE_TEST_N_BUSES; b++)
+        io_coroutine_test_poll(scheduler, b);
+    // each one waits for its first transaction, both buses are busy
+    assert_int_equal(scheduler.waiting(), IO_COROUTINE_TEST_N_BUSES);
+    scheduler.run();
+    for (int b = 0; b < IO_COROUTINE_TEST_N_BUSES; b++) {
+        assert_true(io_coroutine_test_buses[b].done);
+        assert_int_equal(io_coroutine_test_buses[b].n_ok,
+                IO_COROUTINE_TEST_N_CYCLES * IO_COROUTINE_TEST_N_SERVOS);
+    }
+    dynamixel_io_task_set_rx_pool(&io_coroutine_test_buses[0].io_task, NULL);
+    dynamixel_io_rx_pool_delete(&pool);
+}
+
+static Dynamixel::IOCoroutine io_coroutine_test_missing(Dynamixel::IOScheduler &scheduler,
+        DynamixelIOStatus *status)
+{
+    DynamixelPacket packet;
+    DynamixelIORequest request = {};
+    request.packet = &packet;
+    request.response_size = dynamixel_prepare_ping(&packet, 9);
+    request.n_responses = 1;
+    request.priority = dio_PRIORITY_CONTROL;
+    DynamixelIOResponse response = co_await scheduler.submit(&io_coroutine_test_buses[0].io_task,
+            request);
+    *status = response.status;
+}
+
+static void test_io_coroutine_errors(void **state)
+{
+    Dynamixel::IOScheduler scheduler(1);
+    DynamixelIOStatus status = dio_UNDEFINED;
+    io_coroutine_test_missing(scheduler, &status);
+    scheduler.run();
+    assert_int_equal(status, dio_UART_READ_TIMEOUT);
+}
+
+int run_dynamixel_io_coroutine_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_io_coroutine_buses),
+        cmocka_unit_test(test_io_coroutine_errors),
+    };
+    return cmocka_run_group_tests(tests, io_coroutine_group_setup, NULL);
+}
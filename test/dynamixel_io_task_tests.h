@@ -0,0 +1,899 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include "dynamixel.h"
+#include "io_task.h"
+#include "virtual_bus.h"
+#include "io_timer.h"
+#include "dynamixel_virtual_bus_fixture.h"
+
+/*
+ * Features of the IO task (queueing, routing of responses) tested with
+ * virtual AX-12 servos (ids 1..4, present position = 100 * id) in virtual time,
+ * timeouts with the timer in real time.
+ */
+
+#define IO_TASK_TEST_N_SERVOS        4
+#define IO_TASK_TEST_QUEUES_LENGTH   8
+#define IO_TASK_TEST_N_REQUESTS      50
+
+typedef VirtualBusFixture IOTaskTestState;
+
+static IOTaskTestState io_task_test;
+
+// tick timeouts long enough to be clearly distinguished from the timer ones
+// (which must still include scheduling latency of the host)
+#define IO_TASK_TEST_TIMER_PER_BYTE_US     2000
+#define IO_TASK_TEST_TIMER_READ_DELAY_US   50000
+#define IO_TASK_TEST_FIRST_BYTE_US         10000
+#define IO_TASK_TEST_INTER_BYTE_US         5000
+
+typedef struct {
+    IOTaskTestState base;
+    DynamixelIOTimerThread timer;
+} IOTaskTimerTestState;
+
+static IOTaskTimerTestState io_task_timer_test;
+
+static int io_task_group_setup(void **state)
+{
+    IOTaskTestState *test = &io_task_test;
+    *state = test;
+    return virtual_bus_fixture_init(test, IO_TASK_TEST_N_SERVOS, IO_TASK_TEST_QUEUES_LENGTH) ? 0 : -1;
+}
+
+static int io_task_timer_group_setup(void **state)
+{
+    IOTaskTimerTestState *test = &io_task_timer_test;
+    *state = test;
+    if (!virtual_bus_fixture_init_with_timeouts(&test->base, IO_TASK_TEST_N_SERVOS,
+                IO_TASK_TEST_QUEUES_LENGTH, false,
+                IO_TASK_TEST_TIMER_PER_BYTE_US, IO_TASK_TEST_TIMER_READ_DELAY_US))
+        return -1;
+    if (!dynamixel_io_timer_init(&test->timer, &test->base.io_task))
+        return -1;
+    return 0;
+}
+
+static int io_task_reset_servos(void **state)
+{
+    IOTaskTestState *test = (IOTaskTestState *) *state;
+    virtual_bus_fixture_reset_servos(test, IO_TASK_TEST_N_SERVOS);
+    for (int i = 0; i < IO_TASK_TEST_N_SERVOS; i++)
+        dynamixel_virtual_servo_write_u16(&test->servos[i], DYNAMIXEL_PRESENT_POSITION_L, 100 * (i + 1));
+    return 0;
+}
+
+typedef struct {
+    DynamixelIOTaskHandle *io_task;
+    uint8_t id;
+    QueueHandle_t done;     // number of correct responses is sent here
+} IOTaskTestProducer;
+
+// reads position of its servo, each response must be the one to its own request
+static void io_task_test_producer(void *arguments)
+{
+    IOTaskTestProducer *producer = (IOTaskTestProducer *) arguments;
+    DynamixelIOCompletion completion;
+    DynamixelPacket storage;
+    DynamixelPacket *packet = &storage;
+    int n_ok = 0;
+
+    bool created = dynamixel_io_completion_create(&completion, 1);
+    configASSERT(created);
+    for (int i = 0; i < IO_TASK_TEST_N_REQUESTS; i++) {
+        DynamixelIOResponse response;
+        int response_size = dynamixel_prepare_read(packet, producer->id, DYNAMIXEL_PRESENT_POSITION_L, 2);
+        if (!dynamixel_io_send_request_to(producer->io_task, packet, response_size, &completion))
+            break;
+        if (!dynamixel_io_wait_completion(&completion, &response))
+            break;
+        uint16_t position = response.data[0] | (response.data[1] << 8);
+        if (response.status == dio_OK && response.packet == packet
+                && packet->id == producer->id && position == 100 * producer->id)
+            n_ok++;
+    }
+    dynamixel_io_completion_delete(&completion);
+    xQueueSendToBack(producer->done, &n_ok, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+static void test_io_task_many_producers(void **state) {
+    IOTaskTestState *test = (IOTaskTestState *) *state;
+    IOTaskTestProducer producers[IO_TASK_TEST_N_SERVOS];
+    QueueHandle_t done = xQueueCreate(IO_TASK_TEST_N_SERVOS, sizeof(int));
+    assert_non_null(done);
+
+    for (int i = 0; i < IO_TASK_TEST_N_SERVOS; i++) {
+        producers[i].io_task = &test->io_task;
+        producers[i].id = i + 1;
+        producers[i].done = done;
+        assert_int_equal(xTaskCreate(io_task_test_producer, "producer", configMINIMAL_STACK_SIZE,
+                    &producers[i], 1, NULL), pdPASS);
+    }
+    for (int i = 0; i < IO_TASK_TEST_N_SERVOS; i++) {
+        int n_ok;
+        assert_int_equal(xQueueReceive(done, &n_ok, portMAX_DELAY), pdTRUE);
+        assert_int_equal(n_ok, IO_TASK_TEST_N_REQUESTS);
+    }
+    vQueueDelete(done);
+}
+
+static void test_io_task_outstanding_requests(void **state) {
+    IOTaskTestState *test = (IOTaskTestState *) *state;
+    DynamixelIOCompletion completion;
+    DynamixelPacket packets[IO_TASK_TEST_N_SERVOS];
+    assert_true(dynamixel_io_completion_create(&completion, IO_TASK_TEST_N_SERVOS));
+
+    // all requests are queued before the first response is received
+    for (int i = 0; i < IO_TASK_TEST_N_SERVOS; i++) {
+        DynamixelPacket *packet = &packets[i];
+        int response_size = dynamixel_prepare_read(packet, i + 1, DYNAMIXEL_PRESENT_POSITION_L, 2);
+        assert_true(dynamixel_io_send_request_to(&test->io_task, packet, response_size, &completion));
+    }
+    // responses come in the order of requests
+    for (int i = 0; i < IO_TASK_TEST_N_SERVOS; i++) {
+        DynamixelIOResponse response;
+        assert_true(dynamixel_io_wait_completion(&completion, &response));
+        assert_int_equal(response.status, dio_OK);
+        assert_ptr_equal(response.packet, &packets[i]);
+        assert_int_equal(response.packet->id, i + 1);
+        assert_int_equal(response.data[0] | (response.data[1] << 8), 100 * (i + 1));
+    }
+
+    // requests with the shared response queue are still handled
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    int response_size = dynamixel_prepare_ping(&packet, 2);
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(response.status, dio_OK);
+    assert_ptr_equal(response.packet, &packet);
+    dynamixel_io_completion_delete(&completion);
+}
+
+static void test_io_task_batch(void **state) {
+    IOTaskTestState *test = (IOTaskTestState *) *state;
+    DynamixelIOCompletion completion;
+    DynamixelPacket packets[IO_TASK_TEST_N_SERVOS + 1];
+    DynamixelIOBatchItem items[IO_TASK_TEST_N_SERVOS + 1];
+    DynamixelIOResponse response;
+    assert_true(dynamixel_io_completion_create(&completion, 1));
+
+    // servo 3 does not respond, the rest of the batch is still run
+    test->servos[2].connected = false;
+    for (int i = 0; i < IO_TASK_TEST_N_SERVOS; i++) {
+        items[i].packet = &packets[i];
+        items[i].response_size = dynamixel_prepare_read(&packets[i], i + 1,
+                DYNAMIXEL_PRESENT_POSITION_L, 2);
+    }
+    // and a transaction without response
+    items[4].packet = &packets[4];
+    items[4].response_size = dynamixel_prepare_set_register_u16(&packets[4], 1,
+            DYNAMIXEL_GOAL_POSITION_L, 0x123);
+    uint32_t n_instructions = test->servos[0].n_instructions;
+    assert_true(dynamixel_io_send_request_batch(&test->io_task, items, 5, &completion));
+    assert_true(dynamixel_io_wait_completion(&completion, &response));
+
+    // one response, with status of the first failed transaction
+    assert_int_equal(response.status, dio_UART_READ_TIMEOUT);
+    assert_ptr_equal(response.items, items);
+    assert_null(response.packet);
+    for (int i = 0; i < IO_TASK_TEST_N_SERVOS; i++) {
+        assert_ptr_equal(items[i].response.packet, &packets[i]);
+        if (i == 2) {
+            assert_int_equal(items[i].response.status, dio_UART_READ_TIMEOUT);
+            continue;
+        }
+        assert_int_equal(items[i].response.status, dio_OK);
+        assert_int_equal(items[i].response.data_len, 2);
+        assert_int_equal(items[i].response.data[0] | (items[i].response.data[1] << 8), 100 * (i + 1));
+    }
+    assert_int_equal(items[4].response.status, dio_OK);
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[0], DYNAMIXEL_GOAL_POSITION_L), 0x123);
+    assert_int_equal(test->servos[0].n_instructions - n_instructions, 2);
+
+    // all ok, with the shared response queue
+    test->servos[2].connected = true;
+    for (int i = 0; i < IO_TASK_TEST_N_SERVOS; i++)
+        items[i].response_size = dynamixel_prepare_ping(&packets[i], i + 1);
+    assert_true(dynamixel_io_send_request_batch(&test->io_task, items, IO_TASK_TEST_N_SERVOS, NULL));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(response.status, dio_OK);
+    for (int i = 0; i < IO_TASK_TEST_N_SERVOS; i++)
+        assert_int_equal(items[i].response.status, dio_OK);
+    dynamixel_io_completion_delete(&completion);
+}
+
+static void io_task_test_submit(DynamixelIOTaskHandle *io_task, DynamixelPacket *packet,
+        int response_size, DynamixelIOPriority priority, TickType_t max_queue_wait,
+        DynamixelIOCompletion *completion) {
+    DynamixelIORequest request = {
+        .packet = packet,
+        .response_size = response_size,
+        .n_responses = 1,
+        .completion = completion,
+        .priority = priority,
+        .max_queue_wait = max_queue_wait
+    };
+    assert_true(dynamixel_io_submit(io_task, &request));
+}
+
+// the task takes the second request and blocks on sending its response to the full
+// blocker completion, so that the next requests wait in the queues until io_task_test_unblock()
+static void io_task_test_block(DynamixelIOTaskHandle *io_task, DynamixelIOCompletion *blocker,
+        DynamixelPacket packets[2]) {
+    DynamixelIOQueueStats stats;
+    assert_true(dynamixel_io_completion_create(blocker, 1));
+    dynamixel_io_task_reset_queue_stats(io_task);
+    for (int i = 0; i < 2; i++)
+        io_task_test_submit(io_task, &packets[i], dynamixel_prepare_ping(&packets[i], 1),
+                dio_PRIORITY_NORMAL, 0, blocker);
+    do {
+        vTaskDelay(100);
+        dynamixel_io_task_get_queue_stats(io_task, dio_PRIORITY_NORMAL, &stats);
+    } while (stats.n_requests < 2);
+}
+
+static void io_task_test_unblock(DynamixelIOCompletion *blocker) {
+    DynamixelIOResponse response;
+    for (int i = 0; i < 2; i++) {
+        assert_true(dynamixel_io_wait_completion(blocker, &response));
+        assert_int_equal(response.status, dio_OK);
+    }
+    dynamixel_io_completion_delete(blocker);
+}
+
+static void test_io_task_priorities(void **state) {
+    IOTaskTestState *test = (IOTaskTestState *) *state;
+    DynamixelIOCompletion blocker, completion;
+    DynamixelPacket blocker_packets[2];
+    DynamixelPacket packets[4];
+    DynamixelIOBatchItem expired_item;
+    DynamixelIOResponse response;
+    DynamixelIOQueueStats stats;
+    assert_true(dynamixel_io_completion_create(&completion, 8));
+    io_task_test_block(&test->io_task, &blocker, blocker_packets);
+
+    uint32_t n_instructions = test->servos[3].n_instructions;
+    io_task_test_submit(&test->io_task, &packets[0],
+            dynamixel_prepare_read(&packets[0], 1, DYNAMIXEL_PRESENT_TEMPERATURE, 1),
+            dio_PRIORITY_BACKGROUND, 0, &completion);
+    io_task_test_submit(&test->io_task, &packets[1],
+            dynamixel_prepare_read(&packets[1], 2, DYNAMIXEL_PRESENT_POSITION_L, 2),
+            dio_PRIORITY_NORMAL, 0, &completion);
+    // a batch that will be late
+    expired_item.packet = &packets[3];
+    expired_item.response_size = dynamixel_prepare_ping(&packets[3], 4);
+    DynamixelIORequest batch_request = {
+        .n_responses = 1,
+        .completion = &completion,
+        .items = &expired_item,
+        .n_items = 1,
+        .priority = dio_PRIORITY_BACKGROUND,
+        .max_queue_wait = 1000
+    };
+    assert_true(dynamixel_io_submit(&test->io_task, &batch_request));
+    io_task_test_submit(&test->io_task, &packets[2],
+            dynamixel_prepare_set_register_u16(&packets[2], 3, DYNAMIXEL_GOAL_POSITION_L, 0x200),
+            dio_PRIORITY_CONTROL, 1000000, &completion);
+    vTaskDelay(5000);
+    io_task_test_unblock(&blocker);
+
+    // control, normal, then background in order of submission
+    assert_true(dynamixel_io_wait_completion(&completion, &response));
+    assert_ptr_equal(response.packet, &packets[2]);
+    assert_int_equal(response.status, dio_OK);
+    assert_true(dynamixel_io_wait_completion(&completion, &response));
+    assert_ptr_equal(response.packet, &packets[1]);
+    assert_int_equal(response.status, dio_OK);
+    assert_true(dynamixel_io_wait_completion(&completion, &response));
+    assert_ptr_equal(response.packet, &packets[0]);
+    assert_int_equal(response.status, dio_OK);
+    // expired request is not sent
+    assert_true(dynamixel_io_wait_completion(&completion, &response));
+    assert_ptr_equal(response.items, &expired_item);
+    assert_int_equal(response.status, dio_DEADLINE_EXPIRED);
+    assert_int_equal(expired_item.response.status, dio_DEADLINE_EXPIRED);
+    assert_int_equal(test->servos[3].n_instructions, n_instructions);
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[2], DYNAMIXEL_GOAL_POSITION_L), 0x200);
+
+    dynamixel_io_task_get_queue_stats(&test->io_task, dio_PRIORITY_CONTROL, &stats);
+    assert_int_equal(stats.n_requests, 1);
+    assert_int_equal(stats.n_expired, 0);
+    assert_true(stats.max_wait >= 5000);
+    dynamixel_io_task_get_queue_stats(&test->io_task, dio_PRIORITY_NORMAL, &stats);
+    assert_int_equal(stats.n_requests, 3);
+    assert_int_equal(stats.n_expired, 0);
+    dynamixel_io_task_get_queue_stats(&test->io_task, dio_PRIORITY_BACKGROUND, &stats);
+    assert_int_equal(stats.n_requests, 2);
+    assert_int_equal(stats.n_expired, 1);
+    assert_true(stats.total_wait >= 2 * 5000);
+    assert_true(stats.max_wait >= 5000);
+
+    dynamixel_io_task_reset_queue_stats(&test->io_task);
+    dynamixel_io_task_get_queue_stats(&test->io_task, dio_PRIORITY_BACKGROUND, &stats);
+    assert_int_equal(stats.n_requests, 0);
+    dynamixel_io_completion_delete(&completion);
+}
+
+static void test_io_task_coalescing(void **state) {
+    IOTaskTestState *test = (IOTaskTestState *) *state;
+    DynamixelIOCoalescedWrite slots[3];
+    DynamixelIOCompletion blocker;
+    DynamixelPacket blocker_packets[2];
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    DynamixelIOQueueStats stats;
+    uint32_t n_instructions[IO_TASK_TEST_N_SERVOS];
+    dynamixel_io_task_set_coalescing(&test->io_task, slots, 3);
+    io_task_test_block(&test->io_task, &blocker, blocker_packets);
+    for (int i = 1; i < IO_TASK_TEST_N_SERVOS; i++)
+        n_instructions[i] = test->servos[i].n_instructions;
+
+    // the second write to servo 2 replaces the first one
+    // (servo 1 may still be receiving the blocking request)
+    uint8_t goal[2] = {0x00, 0x01};
+    assert_true(dynamixel_io_write_coalesced(&test->io_task, 2, DYNAMIXEL_GOAL_POSITION_L, goal, 2,
+                dio_PRIORITY_NORMAL));
+    goal[0] = 0x80;
+    assert_true(dynamixel_io_write_coalesced(&test->io_task, 2, DYNAMIXEL_GOAL_POSITION_L, goal, 2,
+                dio_PRIORITY_NORMAL));
+    // different length, not coalesced
+    assert_true(dynamixel_io_write_coalesced(&test->io_task, 2, DYNAMIXEL_GOAL_POSITION_L, goal, 1,
+                dio_PRIORITY_NORMAL));
+    // sync writes of the same block are merged: servo 3 is updated, servo 4 added
+    uint8_t sync1[] = {2, 0x10, 0x00, 3, 0x30, 0x00};
+    uint8_t sync2[] = {3, 0x33, 0x00, 4, 0x44, 0x00};
+    assert_true(dynamixel_io_sync_write_coalesced(&test->io_task, DYNAMIXEL_GOAL_POSITION_L,
+                sync1, 2, 2, dio_PRIORITY_NORMAL));
+    assert_true(dynamixel_io_sync_write_coalesced(&test->io_task, DYNAMIXEL_GOAL_POSITION_L,
+                sync2, 2, 2, dio_PRIORITY_NORMAL));
+    // all slots are pending
+    assert_false(dynamixel_io_write_coalesced(&test->io_task, 3, DYNAMIXEL_GOAL_POSITION_L, goal, 2,
+                dio_PRIORITY_NORMAL));
+    dynamixel_io_task_get_queue_stats(&test->io_task, dio_PRIORITY_NORMAL, &stats);
+    assert_int_equal(stats.n_coalesced, 2);
+    io_task_test_unblock(&blocker);
+
+    // requests of the same class are sent in order, so all writes have been sent
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet,
+                dynamixel_prepare_ping(&packet, 1), false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(response.status, dio_OK);
+    assert_int_equal(test->servos[1].n_instructions - n_instructions[1], 3);
+    assert_int_equal(test->servos[2].n_instructions - n_instructions[2], 1);
+    assert_int_equal(test->servos[3].n_instructions - n_instructions[3], 1);
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[1], DYNAMIXEL_GOAL_POSITION_L), 0x10);
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[2], DYNAMIXEL_GOAL_POSITION_L), 0x33);
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[3], DYNAMIXEL_GOAL_POSITION_L), 0x44);
+
+    // slots are free again
+    for (int i = 0; i < 3; i++)
+        assert_false(slots[i].pending);
+    dynamixel_io_task_set_coalescing(&test->io_task, NULL, 0);
+}
+
+static uint32_t io_task_test_histogram_total(const DynamixelIOHistogram *histogram) {
+    uint32_t total = 0;
+    for (int i = 0; i < DYNAMIXEL_IO_HISTOGRAM_N_BUCKETS; i++)
+        total += histogram->counts[i];
+    return total;
+}
+
+// relations between the counters that hold after every transaction
+static void io_task_test_check_metrics(const DynamixelIOMetrics *metrics) {
+    uint32_t n_statuses = 0;
+    for (int status = 0; status <= dio_UNDEFINED; status++)
+        n_statuses += metrics->n_status[status];
+    uint32_t n_wire_times = 0;
+    for (int kind = 0; kind < dio_N_KINDS; kind++)
+        n_wire_times += io_task_test_histogram_total(&metrics->wire_time[kind]);
+    assert_int_equal(n_statuses - metrics->n_status[dio_DEADLINE_EXPIRED], metrics->n_transactions);
+    assert_int_equal(n_wire_times, metrics->n_transactions);
+}
+
+static void test_io_task_metrics(void **state) {
+    IOTaskTestState *test = (IOTaskTestState *) *state;
+    DynamixelIOMetrics before, after;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+
+    assert_int_equal(dynamixel_io_histogram_bucket(0), 0);
+    assert_int_equal(dynamixel_io_histogram_bucket(15), 0);
+    assert_int_equal(dynamixel_io_histogram_bucket(16), 1);
+    assert_int_equal(dynamixel_io_histogram_bucket(31), 1);
+    assert_int_equal(dynamixel_io_histogram_bucket(32), 2);
+    assert_int_equal(dynamixel_io_histogram_bucket(UINT32_MAX), DYNAMIXEL_IO_HISTOGRAM_N_BUCKETS - 1);
+
+    dynamixel_io_task_get_metrics(&test->io_task, &before);
+    // ping (6 + 6 bytes), read (8 + 8), write (9 + 6) and read of a missing servo (8),
+    // the goal is the present position (the servo reaches it immediately)
+    int response_size = dynamixel_prepare_ping(&packet, 1);
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    response_size = dynamixel_prepare_read(&packet, 2, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    response_size = dynamixel_prepare_set_register_u16(&packet, 3, DYNAMIXEL_GOAL_POSITION_L, 300);
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    response_size = dynamixel_prepare_read(&packet, 9, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    dynamixel_io_task_get_metrics(&test->io_task, &after);
+
+    io_task_test_check_metrics(&after);
+    assert_int_equal(after.n_transactions - before.n_transactions, 4);
+    assert_int_equal(after.tx_bytes - before.tx_bytes, 6 + 8 + 9 + 8);
+    assert_int_equal(after.rx_bytes - before.rx_bytes, 6 + 8 + 6);
+    assert_int_equal(after.n_status[dio_OK] - before.n_status[dio_OK], 3);
+    assert_int_equal(after.n_status[dio_UART_READ_TIMEOUT] - before.n_status[dio_UART_READ_TIMEOUT], 1);
+    static const uint32_t n_of_kind[dio_N_KINDS] = {
+        [dio_KIND_PING] = 1, [dio_KIND_READ] = 2, [dio_KIND_WRITE] = 1
+    };
+    for (int kind = 0; kind < dio_N_KINDS; kind++) {
+        assert_int_equal(io_task_test_histogram_total(&after.wire_time[kind])
+                - io_task_test_histogram_total(&before.wire_time[kind]), n_of_kind[kind]);
+        assert_int_equal(io_task_test_histogram_total(&after.queue_wait[kind])
+                - io_task_test_histogram_total(&before.queue_wait[kind]), n_of_kind[kind]);
+    }
+    // the timeout at least is spent on the bus
+    assert_true(after.busy_us - before.busy_us >= 600);
+    assert_true(after.time_us - before.time_us >= after.busy_us - before.busy_us);
+
+    // snapshots taken while the task updates the counters are consistent
+    IOTaskTestProducer producers[IO_TASK_TEST_N_SERVOS];
+    QueueHandle_t done = xQueueCreate(IO_TASK_TEST_N_SERVOS, sizeof(int));
+    assert_non_null(done);
+    for (int i = 0; i < IO_TASK_TEST_N_SERVOS; i++) {
+        producers[i].io_task = &test->io_task;
+        producers[i].id = i + 1;
+        producers[i].done = done;
+        assert_int_equal(xTaskCreate(io_task_test_producer, "producer", configMINIMAL_STACK_SIZE,
+                    &producers[i], 1, NULL), pdPASS);
+    }
+    for (int n_done = 0; n_done < IO_TASK_TEST_N_SERVOS; ) {
+        int n_ok;
+        if (xQueueReceive(done, &n_ok, 0) == pdTRUE) {
+            assert_int_equal(n_ok, IO_TASK_TEST_N_REQUESTS);
+            n_done++;
+        }
+        dynamixel_io_task_get_metrics(&test->io_task, &after);
+        io_task_test_check_metrics(&after);
+    }
+    vQueueDelete(done);
+    dynamixel_io_task_get_metrics(&test->io_task, &after);
+    assert_int_equal(after.n_transactions - before.n_transactions,
+            4 + IO_TASK_TEST_N_SERVOS * IO_TASK_TEST_N_REQUESTS);
+}
+
+static void test_io_task_trace(void **state) {
+    IOTaskTestState *test = (IOTaskTestState *) *state;
+    DynamixelIOTraceEvent ring[32], events[32];
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    static const DynamixelIOTraceEventType expected[] = {
+        dio_TRACE_ENQUEUED, dio_TRACE_DEQUEUED, dio_TRACE_TX_STARTED, dio_TRACE_TX_COMPLETED,
+        dio_TRACE_WOKEN, dio_TRACE_RX_STARTED, dio_TRACE_RX_FIRST_DATA, dio_TRACE_RX_COMPLETED,
+        dio_TRACE_WOKEN, dio_TRACE_DONE
+    };
+    const int n_expected = sizeof(expected) / sizeof(*expected);
+
+    dynamixel_io_task_set_trace(&test->io_task, ring, 32);
+    int response_size = dynamixel_prepare_read(&packet, 2, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(dynamixel_io_task_read_trace(&test->io_task, events, 32), n_expected);
+    for (int i = 0; i < n_expected; i++) {
+        assert_int_equal(events[i].type, expected[i]);
+        assert_int_equal(events[i].request, events[0].request);
+        if (i > 0)
+            assert_true((int32_t) (events[i].time_us - events[i - 1].time_us) >= 0);
+    }
+    assert_int_equal(events[0].detail, dio_PRIORITY_NORMAL);
+    assert_int_equal(events[2].detail, 2);
+    assert_int_equal(events[7].detail, dio_READ_COMPLETED);
+    assert_int_equal(events[9].detail, dio_OK);
+
+    // a smaller ring keeps the latest events of the next request
+    dynamixel_io_task_set_trace(&test->io_task, ring, 4);
+    response_size = dynamixel_prepare_ping(&packet, 1);
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(dynamixel_io_task_read_trace(&test->io_task, events, 32), 4);
+    for (int i = 0; i < 4; i++) {
+        assert_int_equal(events[i].type, expected[n_expected - 4 + i]);
+        assert_int_equal(events[i].request, events[0].request);
+    }
+    // and no more than asked for
+    assert_int_equal(dynamixel_io_task_read_trace(&test->io_task, events, 2), 2);
+    assert_int_equal(events[1].type, dio_TRACE_DONE);
+
+    dynamixel_io_task_set_trace(&test->io_task, NULL, 0);
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(dynamixel_io_task_read_trace(&test->io_task, events, 32), 0);
+}
+
+static void test_io_task_chained_reception(void **state) {
+    IOTaskTestState *test = (IOTaskTestState *) *state;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+
+    // the same bus time as with reception started by the task
+    int response_size = dynamixel_prepare_read(&packet, 3, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    uint64_t start = dynamixel_virtual_bus_time_us(&test->bus);
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    uint64_t unchained_us = dynamixel_virtual_bus_time_us(&test->bus) - start;
+
+    dynamixel_io_task_set_chained_reception(&test->io_task, true);
+    response_size = dynamixel_prepare_read(&packet, 3, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    start = dynamixel_virtual_bus_time_us(&test->bus);
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(response.status, dio_OK);
+    assert_int_equal(response.data[0] | (response.data[1] << 8), 300);
+    assert_int_equal(dynamixel_virtual_bus_time_us(&test->bus) - start, unchained_us);
+
+    // with exact length reads
+    test->bus.exact_reads = true;
+    response_size = dynamixel_prepare_ping(&packet, 2);
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(response.status, dio_OK);
+    test->bus.exact_reads = false;
+
+    // errors are detected as without chaining
+    const DynamixelIOStatus expected[dvb_N_FAULTS] = {
+        [dvb_FAULT_WRITE_ERROR] = dio_UART_WRITE_ERROR,
+        [dvb_FAULT_DROPPED_BYTE] = dio_UART_READ_TIMEOUT,
+        [dvb_FAULT_CORRUPTED_CHECKSUM] = dio_WRONG_CHECKSUM,
+        [dvb_FAULT_LATE_RESPONSE] = dio_UART_READ_TIMEOUT,
+        [dvb_FAULT_MISSING_SERVO] = dio_UART_READ_TIMEOUT,
+        [dvb_FAULT_SPURIOUS_NOTIFICATION] = dio_WRONG_NOTIFICATION,
+    };
+    for (int fault = 0; fault < dvb_N_FAULTS; fault++) {
+        if (fault == dvb_FAULT_DROPPED_BYTE)
+            continue;  // result depends on the byte
+        dynamixel_virtual_bus_inject(&test->bus, (DynamixelVirtualBusFault) fault);
+        response_size = dynamixel_prepare_ping(&packet, 1);
+        assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+        assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+        assert_int_equal(response.status, expected[fault]);
+    }
+
+    // requests without response are not chained
+    uint8_t data[] = {1, 0x10, 0x00};
+    response_size = dynamixel_prepare_sync_write(&packet, DYNAMIXEL_GOAL_POSITION_L, data, 1, 2);
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(response.status, dio_OK);
+    dynamixel_io_task_set_chained_reception(&test->io_task, false);
+}
+
+static void test_io_task_rx_pool(void **state) {
+    IOTaskTestState *test = (IOTaskTestState *) *state;
+    DynamixelIORxPool pool;
+    uint8_t storage[2 * 16];
+    DynamixelIOCompletion completion;
+    DynamixelPacket packet, prepared;
+    DynamixelIOResponse responses[3];
+    assert_true(dynamixel_io_rx_pool_create(&pool, storage, 16, 2));
+    assert_true(dynamixel_io_completion_create(&completion, 3));
+    dynamixel_io_task_set_rx_pool(&test->io_task, &pool);
+
+    // a packet prepared once can be sent again and again
+    int response_size = dynamixel_prepare_read(&packet, 2, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    memcpy(&prepared, &packet, sizeof(packet));
+    for (int i = 0; i < 3; i++) {
+        DynamixelIOResponse *response = &responses[0];
+        assert_true(dynamixel_io_send_request_to(&test->io_task, &packet, response_size, &completion));
+        assert_true(dynamixel_io_wait_completion(&completion, response));
+        assert_int_equal(response->status, dio_OK);
+        assert_ptr_equal(response->packet, &packet);
+        assert_non_null(response->buffer);
+        assert_ptr_equal(response->status_packet, response->buffer);
+        assert_int_equal(response->status_packet->id, 2);
+        assert_int_equal(response->data[0] | (response->data[1] << 8), 200);
+        assert_memory_equal(&packet, &prepared, sizeof(packet));
+        dynamixel_io_release_response(&test->io_task, response);
+        assert_null(response->buffer);
+    }
+
+    // with all buffers held the next response waits for one to be released
+    for (int i = 0; i < 3; i++)
+        assert_true(dynamixel_io_send_request_to(&test->io_task, &packet, response_size, &completion));
+    for (int i = 0; i < 2; i++)
+        assert_true(dynamixel_io_wait_completion(&completion, &responses[i]));
+    assert_int_equal(xQueueReceive(completion.queue, &responses[2], 10000), pdFALSE);
+    dynamixel_io_release_response(&test->io_task, &responses[0]);
+    assert_true(dynamixel_io_wait_completion(&completion, &responses[2]));
+    assert_int_equal(responses[2].status, dio_OK);
+    assert_int_equal(responses[1].data[0] | (responses[1].data[1] << 8), 200);
+    dynamixel_io_release_response(&test->io_task, &responses[1]);
+    dynamixel_io_release_response(&test->io_task, &responses[2]);
+
+    // responses that do not fit are received into the packet
+    response_size = dynamixel_prepare_read(&packet, 1, DYNAMIXEL_MODEL_NUMBER_L, 12);
+    assert_true(response_size > 16);
+    assert_true(dynamixel_io_send_request_to(&test->io_task, &packet, response_size, &completion));
+    assert_true(dynamixel_io_wait_completion(&completion, &responses[0]));
+    assert_int_equal(responses[0].status, dio_OK);
+    assert_null(responses[0].buffer);
+    assert_ptr_equal(responses[0].status_packet, &packet);
+    assert_int_equal(responses[0].data_len, 12);
+
+    // failed transactions do not keep a buffer
+    test->servos[3].connected = false;
+    response_size = dynamixel_prepare_ping(&packet, 4);
+    assert_true(dynamixel_io_send_request_to(&test->io_task, &packet, response_size, &completion));
+    assert_true(dynamixel_io_wait_completion(&completion, &responses[0]));
+    assert_int_equal(responses[0].status, dio_UART_READ_TIMEOUT);
+    assert_null(responses[0].buffer);
+    test->servos[3].connected = true;
+
+    assert_int_equal(uxQueueMessagesWaiting(pool.free_buffers), 2);
+    dynamixel_io_task_set_rx_pool(&test->io_task, NULL);
+    dynamixel_io_rx_pool_delete(&pool);
+    dynamixel_io_completion_delete(&completion);
+}
+
+typedef struct {
+    DynamixelIOTaskHandle *io_task;
+    int n_responses;
+    uint16_t positions[IO_TASK_TEST_N_SERVOS];
+    TaskHandle_t task;        // of the callback
+} IOTaskTestCallbackState;
+
+static void io_task_test_callback(DynamixelIOResponse *response, void *context) {
+    IOTaskTestCallbackState *callback = (IOTaskTestCallbackState *) context;
+    if (response->status == dio_OK)
+        callback->positions[response->packet->id - 1] = response->data[0] | (response->data[1] << 8);
+    // the buffer belongs to the callback
+    dynamixel_io_release_response(callback->io_task, response);
+    callback->task = xTaskGetCurrentTaskHandle();
+    __atomic_store_n(&callback->n_responses, callback->n_responses + 1, __ATOMIC_RELEASE);
+}
+
+static void test_io_task_callback(void **state) {
+    IOTaskTestState *test = (IOTaskTestState *) *state;
+    IOTaskTestCallbackState callback = {.io_task = &test->io_task};
+    DynamixelIOCompletion completion;
+    DynamixelPacket packets[IO_TASK_TEST_N_SERVOS];
+    // responses go to buffers given back by the callback (there are fewer than requests)
+    static uint8_t storage[16];
+    DynamixelIORxPool pool;
+    assert_true(dynamixel_io_rx_pool_create(&pool, storage, sizeof(storage), 1));
+    dynamixel_io_task_set_rx_pool(&test->io_task, &pool);
+
+    // any number of outstanding requests, no queue to be emptied
+    dynamixel_io_completion_create_callback(&completion, io_task_test_callback, &callback);
+    for (int i = 0; i < IO_TASK_TEST_N_SERVOS; i++) {
+        int response_size = dynamixel_prepare_read(&packets[i], i + 1, DYNAMIXEL_PRESENT_POSITION_L, 2);
+        assert_true(dynamixel_io_send_request_to(&test->io_task, &packets[i], response_size, &completion));
+    }
+    while (__atomic_load_n(&callback.n_responses, __ATOMIC_ACQUIRE) < IO_TASK_TEST_N_SERVOS)
+        vTaskDelay(100);
+    for (int i = 0; i < IO_TASK_TEST_N_SERVOS; i++)
+        assert_int_equal(callback.positions[i], 100 * (i + 1));
+    // called by the IO task
+    assert_ptr_equal(callback.task, test->io_task.task_handle);
+    assert_int_equal(uxQueueMessagesWaiting(pool.free_buffers), 1);
+    dynamixel_io_task_set_rx_pool(&test->io_task, NULL);
+    dynamixel_io_rx_pool_delete(&pool);
+    dynamixel_io_completion_delete(&completion);
+}
+
+static void test_io_task_future(void **state) {
+    IOTaskTestState *test = (IOTaskTestState *) *state;
+    DynamixelIOFuture futures[2];
+    DynamixelPacket packets[2];
+    assert_true(dynamixel_io_future_create(&futures[0]));
+    assert_true(dynamixel_io_future_create(&futures[1]));
+
+    // both requests are in flight while the caller does something else
+    test->servos[1].connected = false;
+    for (int i = 0; i < 2; i++) {
+        int response_size = dynamixel_prepare_read(&packets[i], i + 1, DYNAMIXEL_PRESENT_POSITION_L, 2);
+        assert_true(dynamixel_io_send_request_future(&test->io_task, &packets[i], response_size,
+                    &futures[i]));
+    }
+    // one request at a time
+    assert_false(dynamixel_io_send_request_future(&test->io_task, &packets[0], 8, &futures[0]));
+    int n_polls = 0;
+    while (!dynamixel_io_future_poll(&futures[0]))
+        n_polls++;
+    assert_int_equal(futures[0].response.status, dio_OK);
+    assert_ptr_equal(futures[0].response.packet, &packets[0]);
+    assert_int_equal(futures[0].response.data[0] | (futures[0].response.data[1] << 8), 100);
+    assert_true(dynamixel_io_future_wait(&futures[1], portMAX_DELAY));
+    assert_int_equal(futures[1].response.status, dio_UART_READ_TIMEOUT);
+    test->servos[1].connected = true;
+
+    // the future can be used again
+    int response_size = dynamixel_prepare_ping(&packets[0], 3);
+    assert_true(dynamixel_io_send_request_future(&test->io_task, &packets[0], response_size, &futures[0]));
+    assert_true(dynamixel_io_future_wait(&futures[0], portMAX_DELAY));
+    assert_int_equal(futures[0].response.status, dio_OK);
+    assert_true(dynamixel_io_future_poll(&futures[0]));
+    dynamixel_io_future_delete(&futures[0]);
+    dynamixel_io_future_delete(&futures[1]);
+}
+
+// time of a ping in microseconds
+static uint32_t io_task_timed_ping(DynamixelIOTaskHandle *io_task, uint8_t id,
+        DynamixelIOStatus *status) {
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    TickType_t start = xTaskGetTickCount();
+    int response_size = dynamixel_prepare_ping(&packet, id);
+    assert_true(dynamixel_io_send_request(io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(io_task, &response));
+    *status = response.status;
+    return xTaskGetTickCount() - start;
+}
+
+static void test_io_task_timer_timeouts(void **state) {
+    IOTaskTimerTestState *test = (IOTaskTimerTestState *) *state;
+    DynamixelIOTaskHandle *io_task = &test->base.io_task;
+    DynamixelIOStatus status;
+    uint32_t tick_timeout_us = 6 * IO_TASK_TEST_TIMER_PER_BYTE_US + IO_TASK_TEST_TIMER_READ_DELAY_US;
+
+    // without the timer a missing servo takes the whole timeout
+    assert_true(io_task_timed_ping(io_task, 5, &status) >= tick_timeout_us);
+    assert_int_equal(status, dio_UART_READ_TIMEOUT);
+
+    // with whole response timeout measured by the timer the result is the same
+    dynamixel_io_task_set_timer(io_task, dynamixel_io_timer_driver(&test->timer), 0, 0);
+    assert_true(io_task_timed_ping(io_task, 5, &status) >= tick_timeout_us);
+    assert_int_equal(status, dio_UART_READ_TIMEOUT);
+    io_task_timed_ping(io_task, 1, &status);
+    assert_int_equal(status, dio_OK);
+
+    dynamixel_io_task_set_timer(io_task, dynamixel_io_timer_driver(&test->timer),
+            IO_TASK_TEST_FIRST_BYTE_US, IO_TASK_TEST_INTER_BYTE_US);
+    uint32_t n_expired = test->timer.n_expired;
+    for (int i = 0; i < 10; i++) {
+        io_task_timed_ping(io_task, 1 + i % IO_TASK_TEST_N_SERVOS, &status);
+        assert_int_equal(status, dio_OK);
+    }
+    // the first byte arrives after 500us of return delay
+    assert_int_equal(test->timer.n_expired, n_expired);
+
+    // missing servo, late response and lost byte are detected much earlier
+    uint32_t time_us = io_task_timed_ping(io_task, 5, &status);
+    assert_int_equal(status, dio_UART_READ_TIMEOUT);
+    assert_in_range(time_us, IO_TASK_TEST_FIRST_BYTE_US, tick_timeout_us / 2);
+    dynamixel_virtual_bus_inject(&test->base.bus, dvb_FAULT_LATE_RESPONSE);
+    time_us = io_task_timed_ping(io_task, 1, &status);
+    assert_int_equal(status, dio_UART_READ_TIMEOUT);
+    assert_in_range(time_us, IO_TASK_TEST_FIRST_BYTE_US, tick_timeout_us / 2);
+    // last byte lost: only the inter-byte timeout after the rest
+    dynamixel_virtual_bus_seed(&test->base.bus, 1);
+    dynamixel_virtual_bus_inject(&test->base.bus, dvb_FAULT_DROPPED_BYTE);
+    time_us = io_task_timed_ping(io_task, 1, &status);
+    assert_int_not_equal(status, dio_OK);
+    assert_true(time_us < tick_timeout_us / 2);
+
+    io_task_timed_ping(io_task, 2, &status);
+    assert_int_equal(status, dio_OK);
+
+    // the expiry is traced with its own time, before the task is woken
+    DynamixelIOTraceEvent ring[32], events[32];
+    dynamixel_io_task_set_trace(io_task, ring, 32);
+    io_task_timed_ping(io_task, 5, &status);
+    assert_int_equal(status, dio_UART_READ_TIMEOUT);
+    int n_events = dynamixel_io_task_read_trace(io_task, events, 32);
+    int timeout_index = -1;
+    for (int i = 0; i < n_events; i++) {
+        if (i > 0)
+            assert_true((int32_t) (events[i].time_us - events[i - 1].time_us) >= 0);
+        if (events[i].type == dio_TRACE_TIMEOUT)
+            timeout_index = i;
+    }
+    assert_in_range(timeout_index, 0, n_events - 2);
+    assert_int_equal(events[timeout_index + 1].type, dio_TRACE_WOKEN);
+    dynamixel_io_task_set_trace(io_task, NULL, 0);
+
+    // chained reception starts the first byte timeout at the end of transmission
+    dynamixel_io_task_set_chained_reception(io_task, true);
+    for (int i = 0; i < 10; i++) {
+        io_task_timed_ping(io_task, 1 + i % IO_TASK_TEST_N_SERVOS, &status);
+        assert_int_equal(status, dio_OK);
+    }
+    time_us = io_task_timed_ping(io_task, 5, &status);
+    assert_int_equal(status, dio_UART_READ_TIMEOUT);
+    assert_in_range(time_us, IO_TASK_TEST_FIRST_BYTE_US, tick_timeout_us / 2);
+    dynamixel_io_task_set_chained_reception(io_task, false);
+
+    DynamixelIOTimer no_timer = {0};
+    dynamixel_io_task_set_timer(io_task, no_timer, 0, 0);
+}
+
+static void test_io_task_adaptive_timeouts(void **state) {
+    IOTaskTimerTestState *test = (IOTaskTimerTestState *) *state;
+    DynamixelIOTaskHandle *io_task = &test->base.io_task;
+    DynamixelIOLatencyEstimate estimates[IO_TASK_TEST_N_SERVOS + 2];
+    DynamixelIOLatencyEstimate estimate;
+    DynamixelIOStatus status;
+    uint32_t floor_us = IO_TASK_TEST_FIRST_BYTE_US / 5;
+
+    dynamixel_io_task_set_timer(io_task, dynamixel_io_timer_driver(&test->timer),
+            IO_TASK_TEST_FIRST_BYTE_US, IO_TASK_TEST_INTER_BYTE_US);
+    dynamixel_io_task_set_adaptive_timeouts(io_task, estimates, IO_TASK_TEST_N_SERVOS + 2,
+            floor_us, IO_TASK_TEST_FIRST_BYTE_US);
+    // servo 1 has the default return delay of 500us, servo 2 responds right away
+    dynamixel_virtual_servo_write_u8(&test->base.servos[1], DYNAMIXEL_RETURN_DELAY_TIME, 0);
+    for (int i = 0; i < 2 * DYNAMIXEL_IO_ADAPTIVE_MIN_SAMPLES; i++) {
+        io_task_timed_ping(io_task, 1 + i % 2, &status);
+        assert_int_equal(status, dio_OK);
+    }
+    // servo 1 is slower (not always by 500us, the virtual bus thread may notify
+    // write completion late)
+    assert_true(dynamixel_io_task_get_latency_estimate(io_task, 1, &estimate));
+    uint32_t latency_1_us = estimate.latency_us;
+    assert_true(dynamixel_io_task_get_latency_estimate(io_task, 2, &estimate));
+    assert_true(estimate.latency_us < latency_1_us);
+    assert_int_equal(estimate.n_samples, DYNAMIXEL_IO_ADAPTIVE_MIN_SAMPLES);
+    assert_false(dynamixel_io_task_get_latency_estimate(io_task, 3, &estimate));
+
+    // servo 2 stops responding: detected after the learned timeout (at least the floor),
+    // which doubles with each timeout
+    test->base.servos[1].connected = false;
+    uint32_t time_us = io_task_timed_ping(io_task, 2, &status);
+    assert_int_equal(status, dio_UART_READ_TIMEOUT);
+    assert_in_range(time_us, floor_us, IO_TASK_TEST_FIRST_BYTE_US - 1);
+    time_us = io_task_timed_ping(io_task, 2, &status);
+    assert_int_equal(status, dio_UART_READ_TIMEOUT);
+    assert_true(time_us >= 2 * floor_us);
+    dynamixel_io_task_get_latency_estimate(io_task, 2, &estimate);
+    assert_int_equal(estimate.n_timeouts, 2);
+    test->base.servos[1].connected = true;
+    io_task_timed_ping(io_task, 2, &status);
+    assert_int_equal(status, dio_OK);
+    dynamixel_io_task_get_latency_estimate(io_task, 2, &estimate);
+    assert_int_equal(estimate.n_timeouts, 0);
+
+    // servos without estimates have the static timeout
+    time_us = io_task_timed_ping(io_task, 5, &status);
+    assert_int_equal(status, dio_UART_READ_TIMEOUT);
+    assert_true(time_us >= IO_TASK_TEST_FIRST_BYTE_US);
+
+    dynamixel_io_task_set_adaptive_timeouts(io_task, NULL, 0, 0, 0);
+    DynamixelIOTimer no_timer = {0};
+    dynamixel_io_task_set_timer(io_task, no_timer, 0, 0);
+}
+
+
+int run_dynamixel_io_task_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup(test_io_task_many_producers, io_task_reset_servos),
+        cmocka_unit_test_setup(test_io_task_outstanding_requests, io_task_reset_servos),
+        cmocka_unit_test_setup(test_io_task_batch, io_task_reset_servos),
+        cmocka_unit_test_setup(test_io_task_priorities, io_task_reset_servos),
+        cmocka_unit_test_setup(test_io_task_coalescing, io_task_reset_servos),
+        cmocka_unit_test_setup(test_io_task_metrics, io_task_reset_servos),
+        cmocka_unit_test_setup(test_io_task_trace, io_task_reset_servos),
+        cmocka_unit_test_setup(test_io_task_chained_reception, io_task_reset_servos),
+        cmocka_unit_test_setup(test_io_task_rx_pool, io_task_reset_servos),
+        cmocka_unit_test_setup(test_io_task_callback, io_task_reset_servos),
+        cmocka_unit_test_setup(test_io_task_future, io_task_reset_servos),
+    };
+
+    const struct CMUnitTest timer_tests[] = {
+        cmocka_unit_test_setup(test_io_task_timer_timeouts, io_task_reset_servos),
+        cmocka_unit_test_setup(test_io_task_adaptive_timeouts, io_task_reset_servos),
+    };
+
+    // the IO tasks are never deleted, so the buses are left as they are
+    return cmocka_run_group_tests(tests, io_task_group_setup, NULL)
+        + cmocka_run_group_tests(timer_tests, io_task_timer_group_setup, NULL);
+}
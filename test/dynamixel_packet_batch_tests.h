@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include "dynamixel.h"
+#include "packet_batch.h"
+
+
+static void test_packet_batch_add(void **state) {
+    uint8_t buffer[64];
+    DynamixelPacketBatch batch;
+    dynamixel_packet_batch_init(&batch, buffer, sizeof(buffer));
+    assert_int_equal(batch.size, 0);
+
+    // REG_WRITE to two servos and ACTION
+    DynamixelPacket packets[3];
+    uint8_t value[] = {0x00, 0x02};
+    int response_sizes[] = {
+        dynamixel_prepare_reg_write(&packets[0], DYNAMIXEL_BROADCASTING_ID, 0x1e, value, 2),
+        dynamixel_prepare_reg_write(&packets[1], DYNAMIXEL_BROADCASTING_ID, 0x20, value, 2),
+        dynamixel_prepare_action(&packets[2], DYNAMIXEL_BROADCASTING_ID),
+    };
+    int offset = 0;
+    for (int i = 0; i < 3; i++) {
+        assert_true(dynamixel_packet_batch_add(&batch, &packets[i], response_sizes[i]));
+        int size = dynamixel_packet_size(&packets[i]);
+        assert_memory_equal(&buffer[offset], dynamixel_packet_data(&packets[i]), size);
+        offset += size;
+    }
+    assert_int_equal(batch.size, offset);
+    assert_int_equal(batch.n_packets, 3);
+    assert_int_equal(batch.response_size, 0);
+    assert_ptr_equal(dynamixel_packet_batch_packet(&batch), buffer);
+
+    dynamixel_packet_batch_clear(&batch);
+    assert_int_equal(batch.size, 0);
+    assert_int_equal(batch.n_packets, 0);
+}
+
+static void test_packet_batch_response(void **state) {
+    uint8_t buffer[64];
+    DynamixelPacketBatch batch;
+    dynamixel_packet_batch_init(&batch, buffer, sizeof(buffer));
+    DynamixelPacket write, read;
+    int write_response = dynamixel_prepare_set_register_u8(&write, DYNAMIXEL_BROADCASTING_ID, 0x18, 1);
+    int read_response = dynamixel_prepare_read_register_u16(&read, 1, 0x24);
+    assert_true(dynamixel_packet_batch_add(&batch, &write, write_response));
+    assert_true(dynamixel_packet_batch_add(&batch, &read, read_response));
+    assert_int_equal(batch.response_size, 8);
+    // nothing can be sent after a packet with response
+    int size = batch.size;
+    assert_false(dynamixel_packet_batch_add(&batch, &write, write_response));
+    assert_int_equal(batch.size, size);
+    assert_int_equal(batch.n_packets, 2);
+    // errors from dynamixel_prepare_*
+    dynamixel_packet_batch_clear(&batch);
+    assert_false(dynamixel_packet_batch_add(&batch, &write, -1));
+    assert_int_equal(batch.n_packets, 0);
+}
+
+static void test_packet_batch_full(void **state) {
+    uint8_t buffer[20];
+    DynamixelPacketBatch batch;
+    dynamixel_packet_batch_init(&batch, buffer, sizeof(buffer));
+    DynamixelPacket write;
+    // 8 bytes each
+    int response_size = dynamixel_prepare_set_register_u8(&write, DYNAMIXEL_BROADCASTING_ID, 0x18, 1);
+    assert_true(dynamixel_packet_batch_add(&batch, &write, response_size));
+    assert_true(dynamixel_packet_batch_add(&batch, &write, response_size));
+    assert_false(dynamixel_packet_batch_add(&batch, &write, response_size));
+    assert_int_equal(batch.size, 16);
+    // response must fit into the buffer too
+    dynamixel_packet_batch_clear(&batch);
+    DynamixelPacket read;
+    assert_false(dynamixel_packet_batch_add(&batch, &read, dynamixel_prepare_read(&read, 1, 0x00, 20)));
+}
+
+
+int run_dynamixel_packet_batch_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_packet_batch_add),
+        cmocka_unit_test(test_packet_batch_response),
+        cmocka_unit_test(test_packet_batch_full),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "packet_parser.h"
+
+
+// feeds all the data byte by byte, returns the last result other than dpr_IN_PROGRESS
+static DynamixelParserResult feed_bytes(DynamixelPacketParser *parser, const uint8_t *data, int data_len) {
+    DynamixelParserResult last = dpr_IN_PROGRESS;
+    for (int i = 0; i < data_len; i++) {
+        DynamixelParserResult result = dynamixel_packet_parser_feed_byte(parser, data[i]);
+        if (result != dpr_IN_PROGRESS)
+            last = result;
+    }
+    return last;
+}
+
+static void test_parser_status_packet(void **state) {
+    // Example 2 response
+    uint8_t response[] = {0xff, 0xff, 0x01, 0x03, 0x00, 0x20, 0xdb};
+    DynamixelPacket packet;
+    DynamixelPacketParser parser;
+    dynamixel_packet_parser_init(&parser, &packet);
+    for (int i = 0; i < (int) sizeof(response) - 1; i++)
+        assert_int_equal(dynamixel_packet_parser_feed_byte(&parser, response[i]), dpr_IN_PROGRESS);
+    assert_int_equal(dynamixel_packet_parser_feed_byte(&parser, response[sizeof(response) - 1]),
+            dpr_PACKET_READY);
+    assert_memory_equal(dynamixel_packet_data(&packet), response, sizeof(response));
+    assert_int_equal(dynamixel_packet_n_parameters(&packet), 1);
+    assert_true(dynamixel_packet_checksum_isok(&packet));
+}
+
+static void test_parser_chunks(void **state) {
+    // two packets in one chunk (e.g. DMA buffer), noise before them
+    uint8_t data[] = {0x12, 0xff, 0x00,
+        0xff, 0xff, 0x01, 0x02, 0x00, 0xfc,
+        0xff, 0xff, 0x01, 0x03, 0x00, 0x20, 0xdb};
+    DynamixelPacket packet;
+    DynamixelPacketParser parser;
+    dynamixel_packet_parser_init(&parser, &packet);
+    int n_consumed;
+    DynamixelParserResult result = dynamixel_packet_parser_feed(&parser, data, sizeof(data), &n_consumed);
+    assert_int_equal(result, dpr_PACKET_READY);
+    assert_int_equal(n_consumed, 9);
+    assert_memory_equal(dynamixel_packet_data(&packet), &data[3], 6);
+    result = dynamixel_packet_parser_feed(&parser, &data[n_consumed], sizeof(data) - n_consumed, &n_consumed);
+    assert_int_equal(result, dpr_PACKET_READY);
+    assert_int_equal(n_consumed, 7);
+    assert_memory_equal(dynamixel_packet_data(&packet), &data[9], 7);
+}
+
+static void test_parser_additional_start_bytes(void **state) {
+    uint8_t data[] = {0xff, 0xff, 0xff, 0xff, 0x01, 0x02, 0x00, 0xfc};
+    DynamixelPacket packet;
+    DynamixelPacketParser parser;
+    dynamixel_packet_parser_init(&parser, &packet);
+    assert_int_equal(feed_bytes(&parser, data, sizeof(data)), dpr_PACKET_READY);
+    assert_memory_equal(dynamixel_packet_data(&packet), &data[2], 6);
+}
+
+static void test_parser_wrong_checksum(void **state) {
+    uint8_t data[] = {0xff, 0xff, 0x01, 0x03, 0x00, 0x20, 0xdc};
+    DynamixelPacket packet;
+    DynamixelPacketParser parser;
+    dynamixel_packet_parser_init(&parser, &packet);
+    assert_int_equal(feed_bytes(&parser, data, sizeof(data)), dpr_WRONG_CHECKSUM);
+    // parser is ready for the next packet
+    uint8_t next[] = {0xff, 0xff, 0x01, 0x02, 0x00, 0xfc};
+    assert_int_equal(feed_bytes(&parser, next, sizeof(next)), dpr_PACKET_READY);
+}
+
+static void test_parser_wrong_length(void **state) {
+    uint8_t too_short[] = {0xff, 0xff, 0x01, 0x01};
+    uint8_t too_long[] = {0xff, 0xff, 0x01, DYNAMIXEL_MAX_N_PARAMETERS + 3};
+    DynamixelPacket packet;
+    DynamixelPacketParser parser;
+    dynamixel_packet_parser_init(&parser, &packet);
+    assert_int_equal(feed_bytes(&parser, too_short, sizeof(too_short)), dpr_WRONG_LENGTH);
+    assert_int_equal(feed_bytes(&parser, too_long, sizeof(too_long)), dpr_WRONG_LENGTH);
+    // length byte 0xff may start the next packet
+    uint8_t resync[] = {0xff, 0xff, 0x01, 0xff, 0xff, 0x01, 0x02, 0x00, 0xfc};
+    assert_int_equal(dynamixel_packet_parser_feed(&parser, resync, 4, NULL), dpr_WRONG_LENGTH);
+    assert_int_equal(feed_bytes(&parser, &resync[4], sizeof(resync) - 4), dpr_PACKET_READY);
+    assert_int_equal(packet.id, 0x01);
+}
+
+static void test_parser_reset(void **state) {
+    uint8_t data[] = {0xff, 0xff, 0x01, 0x03, 0x00};
+    uint8_t next[] = {0xff, 0xff, 0x01, 0x02, 0x00, 0xfc};
+    DynamixelPacket packet;
+    DynamixelPacketParser parser;
+    dynamixel_packet_parser_init(&parser, &packet);
+    assert_int_equal(feed_bytes(&parser, data, sizeof(data)), dpr_IN_PROGRESS);
+    dynamixel_packet_parser_reset(&parser);
+    assert_int_equal(feed_bytes(&parser, next, sizeof(next)), dpr_PACKET_READY);
+}
+
+
+int run_dynamixel_packet_parser_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_parser_status_packet),
+        cmocka_unit_test(test_parser_chunks),
+        cmocka_unit_test(test_parser_additional_start_bytes),
+        cmocka_unit_test(test_parser_wrong_checksum),
+        cmocka_unit_test(test_parser_wrong_length),
+        cmocka_unit_test(test_parser_reset),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "dynamixel.h"
+#include "packet_template.h"
+
+
+static void test_packet_template_init(void **state) {
+    DynamixelPacketTemplate tpl;
+    int response_size = dynamixel_prepare_read_register_u16(&tpl.packet, 1, 0x2b);
+    assert_true(dynamixel_packet_template_init(&tpl, response_size));
+    assert_int_equal(tpl.response_size, 8);
+    // broken checksum
+    tpl.packet.parameters_with_checksum[0]++;
+    assert_false(dynamixel_packet_template_init(&tpl, response_size));
+    assert_false(dynamixel_packet_template_init(&tpl, -1));
+}
+
+static void test_packet_template_set_id(void **state) {
+    DynamixelPacketTemplate tpl;
+    DynamixelPacket correct;
+    int response_size = dynamixel_prepare_read_register_u16(&tpl.packet, 1, DYNAMIXEL_PRESENT_POSITION_L);
+    assert_true(dynamixel_packet_template_init(&tpl, response_size));
+    for (int id = 0; id < DYNAMIXEL_BROADCASTING_ID; id++) {
+        dynamixel_packet_template_set_id(&tpl, id);
+        dynamixel_prepare_read_register_u16(&correct, id, DYNAMIXEL_PRESENT_POSITION_L);
+        assert_memory_equal(dynamixel_packet_data(&tpl.packet), dynamixel_packet_data(&correct),
+                dynamixel_packet_size(&correct));
+    }
+}
+
+static void test_packet_template_set_parameter(void **state) {
+    DynamixelPacketTemplate tpl;
+    DynamixelPacket correct;
+    int response_size = dynamixel_prepare_set_register_u16(&tpl.packet, 1, DYNAMIXEL_GOAL_POSITION_L, 0);
+    assert_true(dynamixel_packet_template_init(&tpl, response_size));
+    for (int value = 0; value <= DYNAMIXEL_MAX_ANGLE_INT; value += 7) {
+        assert_true(dynamixel_packet_template_set_parameter_u16(&tpl, 1, value));
+        dynamixel_prepare_set_register_u16(&correct, 1, DYNAMIXEL_GOAL_POSITION_L, value);
+        assert_memory_equal(dynamixel_packet_data(&tpl.packet), dynamixel_packet_data(&correct),
+                dynamixel_packet_size(&correct));
+    }
+    // little-endian on any host
+    assert_true(dynamixel_packet_template_set_parameter_u16(&tpl, 1, 0x0234));
+    assert_int_equal(tpl.packet.parameters_with_checksum[1], 0x34);
+    assert_int_equal(tpl.packet.parameters_with_checksum[2], 0x02);
+    dynamixel_prepare_set_register_u16(&correct, 1, DYNAMIXEL_GOAL_POSITION_L, 0x0234);
+    // outside of the packet, nothing changes
+    assert_false(dynamixel_packet_template_set_parameter_u16(&tpl, 2, 0xffff));
+    assert_false(dynamixel_packet_template_set_parameter(&tpl, 3, 0xff));
+    assert_false(dynamixel_packet_template_set_parameter(&tpl, -1, 0xff));
+    assert_memory_equal(dynamixel_packet_data(&tpl.packet), dynamixel_packet_data(&correct),
+            dynamixel_packet_size(&correct));
+}
+
+static void test_packet_template_set_sync_write_data(void **state) {
+    // Example 5
+    uint8_t correct_packet[] = {0xff, 0xff, 0xfe, 0x18, 0x83,
+        0x1e, 0x04,
+        0x00, 0x10, 0x00, 0x50, 0x01,
+        0x01, 0x20, 0x02, 0x60, 0x03,
+        0x02, 0x30, 0x00, 0x70, 0x01,
+        0x03, 0x20, 0x02, 0x80, 0x03,
+        0x12};
+    uint8_t data[][4] = {
+        {0x10, 0x00, 0x50, 0x01},
+        {0x20, 0x02, 0x60, 0x03},
+        {0x30, 0x00, 0x70, 0x01},
+        {0x20, 0x02, 0x80, 0x03},
+    };
+    uint8_t zeros[] = {
+        0x00, 0x00, 0x00, 0x00, 0x00,
+        0x01, 0x00, 0x00, 0x00, 0x00,
+        0x02, 0x00, 0x00, 0x00, 0x00,
+        0x03, 0x00, 0x00, 0x00, 0x00,
+    };
+    DynamixelPacketTemplate tpl;
+    int response_size = dynamixel_prepare_sync_write(&tpl.packet, 0x1e, zeros, 4, 4);
+    assert_true(dynamixel_packet_template_init(&tpl, response_size));
+    for (int i = 0; i < 4; i++)
+        assert_true(dynamixel_packet_template_set_sync_write_data(&tpl, i, data[i]));
+    assert_false(dynamixel_packet_template_set_sync_write_data(&tpl, 4, data[0]));
+    assert_memory_equal(dynamixel_packet_data(&tpl.packet), correct_packet, sizeof(correct_packet));
+}
+
+static void test_packet_template_copy(void **state) {
+    DynamixelPacketTemplate tpl;
+    DynamixelPacket packet;
+    int response_size = dynamixel_prepare_ping(&tpl.packet, 1);
+    assert_true(dynamixel_packet_template_init(&tpl, response_size));
+    dynamixel_packet_template_copy(&tpl, &packet);
+    uint8_t correct_packet[] = {0xff, 0xff, 0x01, 0x02, 0x01, 0xfb};
+    assert_memory_equal(dynamixel_packet_data(&packet), correct_packet, sizeof(correct_packet));
+}
+
+
+int run_dynamixel_packet_template_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_packet_template_init),
+        cmocka_unit_test(test_packet_template_set_id),
+        cmocka_unit_test(test_packet_template_set_parameter),
+        cmocka_unit_test(test_packet_template_set_sync_write_data),
+        cmocka_unit_test(test_packet_template_copy),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
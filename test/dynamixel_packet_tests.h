@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <setjmp.h>
 #include <cmocka.h>
+#include <string.h>
 
 #include "packet.h"
 
@@ -143,6 +144,31 @@ static void test_dynamixel_packet_space_remaining(void **state) {
             sizeof(p.parameters_with_checksum) - 2);
 }
 
+static void test_dynamixel_packet_sized(void **state) {
+    // small packet followed by guard bytes that must not be touched
+    uint8_t storage[DYNAMIXEL_PACKET_STORAGE_SIZE(2) + 4];
+    memset(storage, 0xaa, sizeof(storage));
+    DynamixelPacket *packet = (DynamixelPacket *) storage;
+    dynamixel_packet_init_sized(packet, 2, 1, 0x02);
+    assert_int_equal(dynamixel_packet_space_remaining_sized(packet, 2), 3);
+    assert_true(dynamixel_packet_add_parameter_u16_sized(packet, 2, 0x1234));
+    assert_false(dynamixel_packet_add_parameter_sized(packet, 2, 0x56));
+    assert_true(dynamixel_packet_add_checksum_sized(packet, 2));
+    assert_true(dynamixel_packet_checksum_isok(packet));
+    assert_int_equal(dynamixel_packet_size(packet), DYNAMIXEL_PACKET_STORAGE_SIZE(2));
+    uint8_t guard[] = {0xaa, 0xaa, 0xaa, 0xaa};
+    assert_memory_equal(&storage[DYNAMIXEL_PACKET_STORAGE_SIZE(2)], guard, sizeof(guard));
+    // large packet
+    uint8_t large_storage[DYNAMIXEL_PACKET_STORAGE_SIZE(DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS)];
+    packet = (DynamixelPacket *) large_storage;
+    dynamixel_packet_init_sized(packet, DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS, 1, 0x03);
+    for (int i = 0; i < DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS; i++)
+        assert_true(dynamixel_packet_add_parameter_sized(packet, DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS, i));
+    assert_true(dynamixel_packet_add_checksum_sized(packet, DYNAMIXEL_PROTOCOL_MAX_N_PARAMETERS));
+    assert_int_equal(dynamixel_packet_size(packet), DYNAMIXEL_PROTOCOL_MAX_PACKET_SIZE);
+    assert_true(dynamixel_packet_checksum_isok(packet));
+}
+
 
 int run_dynamixel_packet_tests(void) {
     const struct CMUnitTest tests[] = {
@@ -159,6 +185,7 @@ int run_dynamixel_packet_tests(void) {
         cmocka_unit_test(test_dynamixel_packet_data),
         cmocka_unit_test(test_dynamixel_packet_size),
         cmocka_unit_test(test_dynamixel_packet_space_remaining),
+        cmocka_unit_test(test_dynamixel_packet_sized),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
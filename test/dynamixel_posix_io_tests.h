@@ -0,0 +1,197 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dynamixel.h"
+#include "io_task.h"
+#include "serial_port.h"
+
+/*
+ * IO task with termios serial port driver, tested against a pseudo-terminal.
+ * A thread on the master side plays the role of servos:
+ *   - id 1 responds to ping and read (data = the lowest address bytes),
+ *   - id 2 responds with wrong checksum,
+ *   - other ids do not respond.
+ */
+
+#define POSIX_IO_TEST_PER_BYTE_US     100
+#define POSIX_IO_TEST_READ_DELAY_US   20000
+
+typedef struct {
+    int master_fd;
+    pthread_t thread;
+    DynamixelIOTaskHandle io_task;
+    DynamixelSerialPort serial;
+} PosixIOTestState;
+
+static void pty_servo_respond(int fd, DynamixelPacket *request)
+{
+    uint8_t data[DYNAMIXEL_MAX_N_PARAMETERS];
+    int data_len = 0;
+    if (request->id != 1 && request->id != 2)
+        return;
+    if (request->instruction == DYNAMIXEL_INST_READ) {
+        data_len = request->parameters_with_checksum[1];
+        for (int i = 0; i < data_len; i++)
+            data[i] = request->parameters_with_checksum[0] + i;
+    } else if (request->instruction != DYNAMIXEL_INST_PING) {
+        return;
+    }
+
+    DynamixelPacket response;
+    dynamixel_packet_init(&response, request->id, 0);
+    dynamixel_packet_add_parameters(&response, data, data_len);
+    dynamixel_packet_add_checksum(&response);
+    if (request->id == 2)
+        response.parameters_with_checksum[data_len] ^= 0xff;
+    write(fd, dynamixel_packet_data(&response), dynamixel_packet_size(&response));
+}
+
+static void *pty_servo_thread(void *arguments)
+{
+    int fd = *(int *) arguments;
+    DynamixelPacket request;
+    DynamixelPacketParser parser;
+    uint8_t buffer[64];
+    dynamixel_packet_parser_init(&parser, &request);
+
+    while (1) {
+        ssize_t n_read = read(fd, buffer, sizeof(buffer));
+        if (n_read <= 0)
+            return NULL;
+        const uint8_t *data = buffer;
+        while (n_read > 0) {
+            int n_consumed;
+            DynamixelParserResult result = dynamixel_packet_parser_feed(&parser, data,
+                    (int) n_read, &n_consumed);
+            data += n_consumed;
+            n_read -= n_consumed;
+            if (result == dpr_IN_PROGRESS)
+                continue;
+            if (result == dpr_PACKET_READY)
+                pty_servo_respond(fd, &request);
+            dynamixel_packet_parser_reset(&parser);
+        }
+    }
+}
+
+static int posix_io_setup(void **state)
+{
+    PosixIOTestState *test = calloc(1, sizeof(PosixIOTestState));
+    if (test == NULL)
+        return -1;
+    test->master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (test->master_fd < 0 || grantpt(test->master_fd) != 0 || unlockpt(test->master_fd) != 0)
+        return -1;
+    if (!dynamixel_serial_port_open(&test->serial, &test->io_task,
+                ptsname(test->master_fd), 1000000))
+        return -1;
+    dynamixel_io_task_create_with_driver(&test->io_task, "dxl", 1, 1,
+            dynamixel_serial_port_driver(&test->serial),
+            POSIX_IO_TEST_PER_BYTE_US, POSIX_IO_TEST_READ_DELAY_US);
+    if (pthread_create(&test->thread, NULL, pty_servo_thread, &test->master_fd) != 0)
+        return -1;
+    *state = test;
+    return 0;
+}
+
+static int posix_io_teardown(void **state)
+{
+    // IO task keeps waiting for requests, it is left as is
+    PosixIOTestState *test = (PosixIOTestState *) *state;
+    // servo thread ends when the slave side is closed
+    dynamixel_serial_port_close(&test->serial);
+    pthread_join(test->thread, NULL);
+    close(test->master_fd);
+    return 0;
+}
+
+static DynamixelIOStatus posix_io_transfer(void **state, DynamixelPacket *packet,
+        int response_size, DynamixelIOResponse *response)
+{
+    PosixIOTestState *test = (PosixIOTestState *) *state;
+    assert_true(dynamixel_io_send_request(&test->io_task, packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, response));
+    return response->status;
+}
+
+static void test_posix_io_ping(void **state) {
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    int response_size = dynamixel_prepare_ping(&packet, 1);
+    assert_int_equal(posix_io_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_int_equal(packet.id, 1);
+    assert_int_equal(response.data_len, 0);
+}
+
+static void test_posix_io_read(void **state) {
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    int response_size = dynamixel_prepare_read(&packet, 1, DYNAMIXEL_PRESENT_POSITION_L, 4);
+    assert_int_equal(posix_io_transfer(state, &packet, response_size, &response), dio_OK);
+    uint8_t expected[] = {0x24, 0x25, 0x26, 0x27};
+    assert_int_equal(response.data_len, 4);
+    assert_memory_equal(response.data, expected, 4);
+
+    // many requests one after another
+    for (int i = 0; i < 50; i++) {
+        response_size = dynamixel_prepare_read(&packet, 1, i, 2);
+        assert_int_equal(posix_io_transfer(state, &packet, response_size, &response), dio_OK);
+        assert_int_equal(response.data[0], i);
+        assert_int_equal(response.data[1], i + 1);
+    }
+}
+
+static void test_posix_io_timeout(void **state) {
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    int response_size = dynamixel_prepare_ping(&packet, 5);
+    TickType_t start = xTaskGetTickCount();
+    assert_int_equal(posix_io_transfer(state, &packet, response_size, &response),
+            dio_UART_READ_TIMEOUT);
+    TickType_t elapsed_us = xTaskGetTickCount() - start;
+    assert_true(elapsed_us >= POSIX_IO_TEST_READ_DELAY_US);
+
+    // communication works after timeout
+    response_size = dynamixel_prepare_ping(&packet, 1);
+    assert_int_equal(posix_io_transfer(state, &packet, response_size, &response), dio_OK);
+}
+
+static void test_posix_io_wrong_checksum(void **state) {
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    int response_size = dynamixel_prepare_read(&packet, 2, 0x10, 2);
+    assert_int_equal(posix_io_transfer(state, &packet, response_size, &response),
+            dio_WRONG_CHECKSUM);
+}
+
+static void test_posix_io_no_response(void **state) {
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    uint8_t value = 1;
+    // broadcast write, nothing to receive
+    dynamixel_prepare_write(&packet, DYNAMIXEL_BROADCASTING_ID, DYNAMIXEL_LED, &value, 1);
+    assert_int_equal(posix_io_transfer(state, &packet, 0, &response), dio_OK);
+}
+
+
+int run_dynamixel_posix_io_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_posix_io_ping),
+        cmocka_unit_test(test_posix_io_read),
+        cmocka_unit_test(test_posix_io_timeout),
+        cmocka_unit_test(test_posix_io_wrong_checksum),
+        cmocka_unit_test(test_posix_io_no_response),
+    };
+
+    return cmocka_run_group_tests(tests, posix_io_setup, posix_io_teardown);
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <string.h>
+
+#include "protocol2.h"
+
+
+static void test_protocol2_crc16(void **state) {
+    uint8_t ping[] = {0xff, 0xff, 0xfd, 0x00, 0x01, 0x03, 0x00, 0x01};
+    assert_int_equal(dynamixel2_crc16(0, ping, sizeof(ping)), 0x4e19);
+    // computing in chunks gives the same result
+    uint16_t crc = dynamixel2_crc16(0, ping, 3);
+    assert_int_equal(dynamixel2_crc16(crc, &ping[3], sizeof(ping) - 3), 0x4e19);
+}
+
+static void test_protocol2_prepare_ping(void **state) {
+    uint8_t correct_packet[] = {0xff, 0xff, 0xfd, 0x00, 0x01, 0x03, 0x00, 0x01, 0x19, 0x4e};
+    Dynamixel2Packet packet;
+    int response_size = dynamixel2_prepare_ping(&packet, 1);
+    assert_int_equal(dynamixel2_packet_size(&packet), sizeof(correct_packet));
+    assert_memory_equal(dynamixel2_packet_data(&packet), correct_packet, sizeof(correct_packet));
+    assert_int_equal(response_size, 14);
+}
+
+static void test_protocol2_prepare_read(void **state) {
+    uint8_t correct_packet[] = {0xff, 0xff, 0xfd, 0x00, 0x01, 0x07, 0x00, 0x02,
+        0x84, 0x00, 0x04, 0x00, 0x1d, 0x15};
+    Dynamixel2Packet packet;
+    int response_size = dynamixel2_prepare_read(&packet, 1, 132, 4);
+    assert_int_equal(dynamixel2_packet_size(&packet), sizeof(correct_packet));
+    assert_memory_equal(dynamixel2_packet_data(&packet), correct_packet, sizeof(correct_packet));
+    assert_int_equal(response_size, 15);
+}
+
+static void test_protocol2_prepare_write(void **state) {
+    uint8_t correct_packet[] = {0xff, 0xff, 0xfd, 0x00, 0x01, 0x09, 0x00, 0x03,
+        0x74, 0x00, 0x00, 0x02, 0x00, 0x00, 0xca, 0x89};
+    uint8_t data[] = {0x00, 0x02, 0x00, 0x00};
+    Dynamixel2Packet packet;
+    int response_size = dynamixel2_prepare_write(&packet, 1, 116, data, sizeof(data));
+    assert_int_equal(dynamixel2_packet_size(&packet), sizeof(correct_packet));
+    assert_memory_equal(dynamixel2_packet_data(&packet), correct_packet, sizeof(correct_packet));
+    assert_int_equal(response_size, 11);
+}
+
+static void test_protocol2_add_parameter_u16_u32(void **state) {
+    // little-endian on any host
+    Dynamixel2Packet packet;
+    dynamixel2_packet_init(&packet, 1, 0x03);
+    assert_true(dynamixel2_packet_add_parameter_u16(&packet, 0x0074));
+    assert_true(dynamixel2_packet_add_parameter_u32(&packet, 0x12345678));
+    assert_int_equal(dynamixel2_packet_n_parameters(&packet), 6);
+    uint8_t correct_parameters[] = {0x74, 0x00, 0x78, 0x56, 0x34, 0x12};
+    assert_memory_equal(packet.parameters_with_crc, correct_parameters, sizeof(correct_parameters));
+}
+
+static void test_protocol2_prepare_sync_read(void **state) {
+    uint8_t correct_packet[] = {0xff, 0xff, 0xfd, 0x00, 0xfe, 0x09, 0x00, 0x82,
+        0x84, 0x00, 0x04, 0x00, 0x01, 0x02, 0xce, 0xfa};
+    uint8_t ids[] = {1, 2};
+    Dynamixel2Packet packet;
+    int response_size = dynamixel2_prepare_sync_read(&packet, 132, 4, ids, 2);
+    assert_memory_equal(dynamixel2_packet_data(&packet), correct_packet, sizeof(correct_packet));
+    assert_int_equal(response_size, 2 * 15);
+}
+
+static void test_protocol2_stuffing(void **state) {
+    uint8_t data[] = {0xff, 0xff, 0xfd, 0x01, 0xff, 0xff, 0xff, 0xfd};
+    uint8_t stuffed[] = {0xff, 0xff, 0xfd, 0xfd, 0x01, 0xff, 0xff, 0xff, 0xfd, 0xfd};
+    Dynamixel2Packet packet;
+    dynamixel2_prepare_write(&packet, 1, 0x0010, data, sizeof(data));
+    assert_int_equal(dynamixel2_packet_n_parameters(&packet), 2 + sizeof(stuffed));
+    assert_memory_equal(&packet.parameters_with_crc[2], stuffed, sizeof(stuffed));
+    assert_true(dynamixel2_packet_crc_isok(&packet));
+    // decoding removes stuffing
+    assert_true(dynamixel2_packet_decode(&packet, dynamixel2_packet_size(&packet)));
+    assert_int_equal(dynamixel2_packet_n_parameters(&packet), 2 + sizeof(data));
+    assert_memory_equal(&packet.parameters_with_crc[2], data, sizeof(data));
+}
+
+static void test_protocol2_decode(void **state) {
+    // ping response: model number 0x0406, firmware 0x26
+    uint8_t response[] = {0xff, 0xff, 0xfd, 0x00, 0x01, 0x07, 0x00, 0x55,
+        0x00, 0x06, 0x04, 0x26, 0x65, 0x5d};
+    Dynamixel2Packet packet;
+    memcpy(&packet, response, sizeof(response));
+    assert_true(dynamixel2_packet_decode(&packet, sizeof(response)));
+    assert_int_equal(dynamixel2_packet_error(&packet), 0);
+    assert_int_equal(dynamixel2_packet_status_data_len(&packet), 3);
+    assert_memory_equal(dynamixel2_packet_status_data(&packet), &response[9], 3);
+    // wrong size and wrong CRC
+    memcpy(&packet, response, sizeof(response));
+    assert_false(dynamixel2_packet_decode(&packet, sizeof(response) - 1));
+    response[10] ^= 0x10;
+    memcpy(&packet, response, sizeof(response));
+    assert_false(dynamixel2_packet_decode(&packet, sizeof(response)));
+}
+
+static void test_protocol2_parser(void **state) {
+    // noise, ping response, then stuffed packet
+    Dynamixel2Packet stuffed;
+    uint8_t data[] = {0xff, 0xff, 0xfd, 0x07};
+    dynamixel2_prepare_write(&stuffed, 1, 0x0010, data, sizeof(data));
+    stuffed.instruction = DYNAMIXEL2_INST_STATUS;
+    dynamixel2_packet_add_crc(&stuffed);
+    uint8_t stream[64] = {0x00, 0xff, 0xff, 0xff, 0xfd, 0x01,
+        0xff, 0xff, 0xfd, 0x00, 0x01, 0x07, 0x00, 0x55, 0x00, 0x06, 0x04, 0x26, 0x65, 0x5d};
+    int stream_len = 20;
+    memcpy(&stream[stream_len], &stuffed, dynamixel2_packet_size(&stuffed));
+    stream_len += dynamixel2_packet_size(&stuffed);
+
+    Dynamixel2Packet packet;
+    Dynamixel2PacketParser parser;
+    dynamixel2_packet_parser_init(&parser, &packet, DYNAMIXEL2_MAX_N_PARAMETERS);
+    int n_consumed;
+    assert_int_equal(dynamixel2_packet_parser_feed(&parser, stream, stream_len, &n_consumed),
+            dpr_PACKET_READY);
+    assert_int_equal(n_consumed, 20);
+    assert_memory_equal(&packet, &stream[6], 14);
+    assert_int_equal(dynamixel2_packet_parser_feed(&parser, &stream[n_consumed], stream_len - n_consumed,
+                NULL), dpr_PACKET_READY);
+    assert_int_equal(dynamixel2_packet_n_parameters(&packet), 2 + sizeof(data));
+    assert_memory_equal(&packet.parameters_with_crc[2], data, sizeof(data));
+
+    // broken CRC
+    stream[15] ^= 0x01;
+    assert_int_equal(dynamixel2_packet_parser_feed(&parser, stream, 20, NULL), dpr_WRONG_CHECKSUM);
+    // too long for the packet
+    dynamixel2_packet_parser_init(&parser, &packet, 2);
+    assert_int_equal(dynamixel2_packet_parser_feed(&parser, &stream[20], stream_len - 20, NULL),
+            dpr_WRONG_LENGTH);
+}
+
+static void test_protocol2_fast_sync_read(void **state) {
+    uint8_t ids[] = {3, 7};
+    Dynamixel2Packet packet;
+    int response_size = dynamixel2_prepare_fast_sync_read(&packet, 132, 4, ids, 2);
+    assert_int_equal(packet.instruction, DYNAMIXEL2_INST_FAST_SYNC_READ);
+    assert_int_equal(response_size, DYNAMIXEL2_PACKET_BASE_SIZE + 2 * (4 + 4));
+    // response: error, id, data, crc for each servo (last crc is the packet crc)
+    uint8_t params[] = {0x00, 3, 0x11, 0x12, 0x13, 0x14, 0xaa, 0xbb,
+        0x80, 7, 0x21, 0x22, 0x23, 0x24};
+    dynamixel2_packet_init(&packet, DYNAMIXEL_BROADCASTING_ID, DYNAMIXEL2_INST_STATUS);
+    dynamixel2_packet_add_parameters(&packet, params, sizeof(params));
+    dynamixel2_packet_add_crc(&packet);
+    assert_int_equal(dynamixel2_packet_size(&packet), response_size);
+    assert_true(dynamixel2_packet_decode(&packet, response_size));
+    uint8_t error, id;
+    uint8_t *data = dynamixel2_fast_sync_read_data(&packet, 1, 4, &error, &id);
+    assert_non_null(data);
+    assert_int_equal(error, 0x80);
+    assert_int_equal(id, 7);
+    assert_memory_equal(data, &params[10], 4);
+    data = dynamixel2_fast_sync_read_data(&packet, 0, 4, &error, &id);
+    assert_int_equal(id, 3);
+    assert_memory_equal(data, &params[2], 4);
+    assert_null(dynamixel2_fast_sync_read_data(&packet, 2, 4, NULL, NULL));
+}
+
+static void test_protocol2_status_packets_next(void **state) {
+    // two status packets of sync read, as received by the IO task
+    uint8_t status[] = {
+        0xff, 0xff, 0xfd, 0x00, 0x01, 0x07, 0x00, 0x55, 0x00, 0x06, 0x04, 0x26, 0x65, 0x5d};
+    uint8_t data[2 * sizeof(status)];
+    memcpy(data, status, sizeof(status));
+    memcpy(data + sizeof(status), status, sizeof(status));
+    int offset = 0;
+    for (int i = 0; i < 2; i++) {
+        Dynamixel2Packet *packet = dynamixel2_status_packets_next(data, sizeof(data), &offset);
+        assert_non_null(packet);
+        assert_int_equal(packet->id, 1);
+        assert_int_equal(dynamixel2_packet_status_data_len(packet), 3);
+        assert_int_equal(offset, (i + 1) * sizeof(status));
+    }
+    assert_null(dynamixel2_status_packets_next(data, sizeof(data), &offset));
+}
+
+int run_dynamixel_protocol2_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_protocol2_crc16),
+        cmocka_unit_test(test_protocol2_prepare_ping),
+        cmocka_unit_test(test_protocol2_prepare_read),
+        cmocka_unit_test(test_protocol2_prepare_write),
+        cmocka_unit_test(test_protocol2_add_parameter_u16_u32),
+        cmocka_unit_test(test_protocol2_prepare_sync_read),
+        cmocka_unit_test(test_protocol2_stuffing),
+        cmocka_unit_test(test_protocol2_decode),
+        cmocka_unit_test(test_protocol2_parser),
+        cmocka_unit_test(test_protocol2_fast_sync_read),
+        cmocka_unit_test(test_protocol2_status_packets_next),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
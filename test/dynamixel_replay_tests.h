@@ -0,0 +1,348 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dynamixel.h"
+#include "io_task.h"
+#include "io_capture.h"
+#include "virtual_bus.h"
+#include "replay_uart.h"
+#include "capture_file.h"
+#include "dynamixel_virtual_bus_fixture.h"
+
+/*
+ * Traffic of an IO task with virtual MX-28 servos (ids 1 and 2, in virtual time)
+ * captured and replayed through other IO tasks.
+ */
+
+#define REPLAY_TEST_N_SERVOS        2
+// replays with the timeouts of the captured IO task
+#define REPLAY_TEST_PER_BYTE_US     VIRTUAL_BUS_FIXTURE_PER_BYTE_US
+#define REPLAY_TEST_READ_DELAY_US   VIRTUAL_BUS_FIXTURE_READ_DELAY_US
+#define REPLAY_TEST_N_REPLAYS       5
+#define REPLAY_TEST_LOG_SIZE        1024
+
+typedef struct {
+    DynamixelIOTaskHandle io_task;
+    DynamixelReplayUART replay;
+} ReplayTestTask;
+
+typedef struct {
+    VirtualBusFixture fixture;
+    uint8_t ring_buffer[REPLAY_TEST_LOG_SIZE];
+    DynamixelIOCaptureRing ring;
+    uint8_t log[REPLAY_TEST_LOG_SIZE];
+    size_t log_size;
+    // IO tasks are never deleted, each test replays with its own
+    ReplayTestTask replays[REPLAY_TEST_N_REPLAYS];
+    int n_replays;
+} ReplayTestState;
+
+static ReplayTestState replay_test;
+
+static DynamixelIOStatus replay_test_transfer(DynamixelIOTaskHandle *io_task,
+        DynamixelPacket *packet, int response_size, DynamixelIOResponse *response)
+{
+    assert_true(dynamixel_io_send_request(io_task, packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(io_task, response));
+    return response->status;
+}
+
+// captured transactions, one of each outcome
+static const DynamixelIOStatus replay_test_statuses[] = {
+    dio_OK, dio_OK, dio_UART_READ_TIMEOUT, dio_WRONG_CHECKSUM, dio_UART_WRITE_ERROR,
+    dio_WRONG_NOTIFICATION, dio_OK, dio_UART_READ_TIMEOUT, dio_UART_READ_TIMEOUT,
+    dio_UART_READ_TIMEOUT, dio_OK,
+};
+#define REPLAY_TEST_N_TRANSACTIONS   (int) (sizeof(replay_test_statuses) / sizeof(*replay_test_statuses))
+
+static void replay_test_traffic(DynamixelIOTaskHandle *io_task, DynamixelVirtualBus *bus,
+        DynamixelIOStatus *statuses)
+{
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    int n = 0;
+    int response_size = dynamixel_prepare_ping(&packet, 1);
+    statuses[n++] = replay_test_transfer(io_task, &packet, response_size, &response);
+    response_size = dynamixel_prepare_read(&packet, 2, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    statuses[n++] = replay_test_transfer(io_task, &packet, response_size, &response);
+    if (bus != NULL)
+        dynamixel_virtual_bus_inject(bus, dvb_FAULT_MISSING_SERVO);
+    response_size = dynamixel_prepare_read(&packet, 1, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    statuses[n++] = replay_test_transfer(io_task, &packet, response_size, &response);
+    if (bus != NULL)
+        dynamixel_virtual_bus_inject(bus, dvb_FAULT_CORRUPTED_CHECKSUM);
+    response_size = dynamixel_prepare_read(&packet, 2, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    statuses[n++] = replay_test_transfer(io_task, &packet, response_size, &response);
+    if (bus != NULL)
+        dynamixel_virtual_bus_inject(bus, dvb_FAULT_WRITE_ERROR);
+    response_size = dynamixel_prepare_ping(&packet, 2);
+    statuses[n++] = replay_test_transfer(io_task, &packet, response_size, &response);
+    if (bus != NULL)
+        dynamixel_virtual_bus_inject(bus, dvb_FAULT_SPURIOUS_NOTIFICATION);
+    response_size = dynamixel_prepare_ping(&packet, 2);
+    statuses[n++] = replay_test_transfer(io_task, &packet, response_size, &response);
+    uint8_t data[] = {1, 0x10, 0x01, 2, 0x20, 0x02};
+    response_size = dynamixel_prepare_sync_write(&packet, DYNAMIXEL_GOAL_POSITION_L, data, 2, 2);
+    statuses[n++] = replay_test_transfer(io_task, &packet, response_size, &response);
+    // no such servo
+    response_size = dynamixel_prepare_ping(&packet, 3);
+    statuses[n++] = replay_test_transfer(io_task, &packet, response_size, &response);
+    // a part of the response before the timeout: status packet of servo 1, not of servo 3
+    uint8_t bulk[] = {2, 1, DYNAMIXEL_PRESENT_POSITION_L, 2, 3, DYNAMIXEL_PRESENT_POSITION_L};
+    response_size = dynamixel_prepare_bulk_read(&packet, bulk, 2);
+    assert_true(dynamixel_io_send_multi_request(io_task, &packet, response_size, 2, false));
+    assert_true(dynamixel_io_wait_response(io_task, &response));
+    statuses[n++] = response.status;
+    dynamixel_io_release_response(io_task, &response);
+    // a status packet without its 6th byte (for the seed 5), the rest of it before the timeout
+    if (bus != NULL) {
+        dynamixel_virtual_bus_seed(bus, 5);
+        dynamixel_virtual_bus_inject(bus, dvb_FAULT_DROPPED_BYTE);
+    }
+    response_size = dynamixel_prepare_read(&packet, 2, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    statuses[n++] = replay_test_transfer(io_task, &packet, response_size, &response);
+    response_size = dynamixel_prepare_read(&packet, 2, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    statuses[n++] = replay_test_transfer(io_task, &packet, response_size, &response);
+    assert_int_equal(response.data[0] | response.data[1] << 8, 0x220);
+}
+
+static int replay_group_setup(void **state)
+{
+    ReplayTestState *test = &replay_test;
+    *state = test;
+    for (int i = 0; i < REPLAY_TEST_N_SERVOS; i++)
+        dynamixel_virtual_servo_init_model(&test->fixture.servos[i], i + 1, DYNAMIXEL_MX28_MODEL_NUMBER);
+    if (!virtual_bus_fixture_init(&test->fixture, REPLAY_TEST_N_SERVOS, 1))
+        return -1;
+    dynamixel_capture_ring_init(&test->ring, test->ring_buffer, sizeof(test->ring_buffer));
+
+    // the log of the whole traffic
+    DynamixelIOStatus statuses[REPLAY_TEST_N_TRANSACTIONS];
+    dynamixel_io_task_set_capture(&test->fixture.io_task, &test->ring);
+    replay_test_traffic(&test->fixture.io_task, &test->fixture.bus, statuses);
+    dynamixel_io_task_set_capture(&test->fixture.io_task, NULL);
+    if (memcmp(statuses, replay_test_statuses, sizeof(statuses)) != 0)
+        return -1;
+
+    DynamixelIOCaptureHeader header;
+    dynamixel_capture_header_init(&header, dio_PROTOCOL_1);
+    memcpy(test->log, &header, sizeof(header));
+    test->log_size = sizeof(header) + dynamixel_capture_ring_read(&test->ring,
+            &test->log[sizeof(header)], sizeof(test->log) - sizeof(header));
+    return test->ring.n_dropped == 0 ? 0 : -1;
+}
+
+// new IO task replaying the log
+static ReplayTestTask *replay_test_task(ReplayTestState *test)
+{
+    assert_true(test->n_replays < REPLAY_TEST_N_REPLAYS);
+    ReplayTestTask *task = &test->replays[test->n_replays++];
+    assert_true(dynamixel_replay_uart_init(&task->replay, &task->io_task, test->log, test->log_size));
+    dynamixel_io_task_create_with_driver(&task->io_task, "replay", 1, 1,
+            dynamixel_replay_uart_driver(&task->replay), REPLAY_TEST_PER_BYTE_US, REPLAY_TEST_READ_DELAY_US);
+    return task;
+}
+
+static void test_replay_log_records(void **state) {
+    ReplayTestState *test = (ReplayTestState *) *state;
+    DynamixelIOCaptureRecord record;
+    const uint8_t *tx_data, *rx_data;
+    size_t offset = dynamixel_capture_header_check(test->log, test->log_size, NULL);
+    assert_int_equal(offset, sizeof(DynamixelIOCaptureHeader));
+
+    // one record for each transaction, in order, with the bytes received
+    uint32_t last_us = 0;
+    for (int i = 0; i < REPLAY_TEST_N_TRANSACTIONS; i++) {
+        assert_true(dynamixel_capture_next(test->log, test->log_size, &offset, &record, &tx_data, &rx_data));
+        assert_int_equal(record.status, replay_test_statuses[i]);
+        assert_int_equal(tx_data[0], 0xff);
+        assert_true(record.time_us >= last_us);
+        assert_int_equal(record.n_responses, i == 8 ? 2 : 1);
+        bool received = record.status == dio_OK || record.status == dio_WRONG_CHECKSUM;
+        if (i == 8)
+            // the status packet of servo 1 only
+            assert_int_equal(record.rx_length, 8);
+        else if (i == 9)
+            assert_int_equal(record.rx_length, 7);
+        else if (received && i != 6)
+            assert_int_equal(record.rx_length, record.response_size);
+        else
+            // sync write has no response
+            assert_int_equal(record.rx_length, 0);
+        if (record.rx_length > 0)
+            assert_int_equal(rx_data[0], 0xff);
+        last_us = record.time_us + record.duration_us;
+    }
+    assert_false(dynamixel_capture_next(test->log, test->log_size, &offset, &record, &tx_data, &rx_data));
+}
+
+static void test_replay_run(void **state) {
+    ReplayTestState *test = (ReplayTestState *) *state;
+    ReplayTestTask *task = replay_test_task(test);
+    int n_different;
+    assert_int_equal(dynamixel_replay_run(&task->replay, &n_different), REPLAY_TEST_N_TRANSACTIONS);
+    assert_int_equal(n_different, 0);
+    assert_int_equal(task->replay.n_transfers, REPLAY_TEST_N_TRANSACTIONS);
+    assert_int_equal(task->replay.n_mismatches, 0);
+    assert_int_equal(task->replay.n_overruns, 0);
+}
+
+static void test_replay_application(void **state) {
+    ReplayTestState *test = (ReplayTestState *) *state;
+    ReplayTestTask *task = replay_test_task(test);
+    task->replay.exact_reads = true;
+
+    // the same code gets the same results without the servos
+    DynamixelIOStatus statuses[REPLAY_TEST_N_TRANSACTIONS];
+    replay_test_traffic(&task->io_task, NULL, statuses);
+    assert_memory_equal(statuses, replay_test_statuses, sizeof(statuses));
+    assert_int_equal(task->replay.n_mismatches, 0);
+
+    // past the end of the log
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    int response_size = dynamixel_prepare_ping(&packet, 1);
+    assert_int_equal(replay_test_transfer(&task->io_task, &packet, response_size, &response),
+            dio_UART_WRITE_ERROR);
+    assert_int_equal(task->replay.n_overruns, 1);
+}
+
+static void test_replay_mismatch(void **state) {
+    ReplayTestState *test = (ReplayTestState *) *state;
+    ReplayTestTask *task = replay_test_task(test);
+
+    // recorded ping of servo 1 gets its response, though the packet differs
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    int response_size = dynamixel_prepare_ping(&packet, 2);
+    assert_int_equal(replay_test_transfer(&task->io_task, &packet, response_size, &response), dio_OK);
+    assert_int_equal(task->replay.n_mismatches, 1);
+    response_size = dynamixel_prepare_read(&packet, 2, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    assert_int_equal(replay_test_transfer(&task->io_task, &packet, response_size, &response), dio_OK);
+    assert_int_equal(task->replay.n_mismatches, 1);
+    assert_int_equal(task->replay.n_transfers, 2);
+}
+
+static void test_replay_capture_file(void **state) {
+    ReplayTestState *test = (ReplayTestState *) *state;
+    FILE *file = tmpfile();
+    assert_non_null(file);
+    DynamixelCaptureFileWriter writer;
+    assert_true(dynamixel_capture_file_start(&writer, &test->ring, file, dio_PROTOCOL_1, 1000));
+    dynamixel_io_task_set_capture(&test->fixture.io_task, &test->ring);
+    for (int i = 0; i < 20; i++) {
+        DynamixelPacket packet;
+        DynamixelIOResponse response;
+        int response_size = dynamixel_prepare_read(&packet, 1 + i % 2, DYNAMIXEL_PRESENT_POSITION_L, 2);
+        assert_int_equal(replay_test_transfer(&test->fixture.io_task, &packet, response_size, &response), dio_OK);
+    }
+    dynamixel_io_task_set_capture(&test->fixture.io_task, NULL);
+    assert_true(dynamixel_capture_file_stop(&writer));
+
+    // the same as captured into memory
+    static uint8_t log[4096];
+    long size = ftell(file);
+    assert_true(size > 0 && size <= (long) sizeof(log));
+    rewind(file);
+    assert_int_equal(fread(log, 1, size, file), size);
+    fclose(file);
+    size_t offset = dynamixel_capture_header_check(log, size, NULL);
+    assert_int_not_equal(offset, 0);
+    DynamixelIOCaptureRecord record;
+    const uint8_t *tx_data, *rx_data;
+    int n_records = 0;
+    while (dynamixel_capture_next(log, size, &offset, &record, &tx_data, &rx_data)) {
+        assert_int_equal(record.status, dio_OK);
+        assert_int_equal(rx_data[2], 1 + n_records % 2);
+        n_records++;
+    }
+    assert_int_equal(offset, size);
+    assert_int_equal(n_records, 20);
+    assert_int_equal(test->ring.n_dropped, 0);
+}
+
+
+static void test_replay_dropped_record(void **state) {
+    ReplayTestState *test = (ReplayTestState *) *state;
+    // the log without the transaction that has failed with a wrong checksum, as if
+    // the ring had no space for it
+    static uint8_t log[REPLAY_TEST_LOG_SIZE];
+    size_t offset = dynamixel_capture_header_check(test->log, test->log_size, NULL);
+    memcpy(log, test->log, offset);
+    size_t log_size = offset;
+    DynamixelIOCaptureRecord record;
+    const uint8_t *tx_data, *rx_data;
+    for (int i = 0; i < REPLAY_TEST_N_TRANSACTIONS; i++) {
+        size_t start = offset;
+        assert_true(dynamixel_capture_next(test->log, test->log_size, &offset, &record, &tx_data, &rx_data));
+        if (i == 3)
+            continue;
+        memcpy(&log[log_size], &test->log[start], offset - start);
+        log_size += offset - start;
+    }
+
+    // each of the other packets gets its own response
+    ReplayTestTask *task = replay_test_task(test);
+    assert_true(dynamixel_replay_uart_init(&task->replay, &task->io_task, log, log_size));
+    int n_different;
+    assert_int_equal(dynamixel_replay_run(&task->replay, &n_different), REPLAY_TEST_N_TRANSACTIONS - 1);
+    assert_int_equal(n_different, 0);
+    assert_int_equal(task->replay.n_mismatches, 0);
+    assert_int_equal(task->replay.n_overruns, 0);
+}
+
+static void test_replay_wrong_length(void **state) {
+    ReplayTestState *test = (ReplayTestState *) *state;
+    // a status packet without its length byte (for the seed 3): the bytes up to the one
+    // taken for the length are recorded, so that the replay is rejected the same way
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    dynamixel_io_task_set_capture(&test->fixture.io_task, &test->ring);
+    dynamixel_virtual_bus_seed(&test->fixture.bus, 3);
+    dynamixel_virtual_bus_inject(&test->fixture.bus, dvb_FAULT_DROPPED_BYTE);
+    int response_size = dynamixel_prepare_read(&packet, 2, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    assert_int_equal(replay_test_transfer(&test->fixture.io_task, &packet, response_size, &response),
+            dio_WRONG_FRAMING);
+    dynamixel_io_task_set_capture(&test->fixture.io_task, NULL);
+
+    static uint8_t log[REPLAY_TEST_LOG_SIZE];
+    DynamixelIOCaptureHeader header;
+    dynamixel_capture_header_init(&header, dio_PROTOCOL_1);
+    memcpy(log, &header, sizeof(header));
+    size_t log_size = sizeof(header) + dynamixel_capture_ring_read(&test->ring,
+            &log[sizeof(header)], sizeof(log) - sizeof(header));
+    size_t offset = sizeof(header);
+    DynamixelIOCaptureRecord record;
+    const uint8_t *tx_data, *rx_data;
+    assert_true(dynamixel_capture_next(log, log_size, &offset, &record, &tx_data, &rx_data));
+    assert_int_equal(record.status, dio_WRONG_FRAMING);
+    assert_int_equal(record.rx_length, 4);
+    assert_int_equal(rx_data[2], 2);
+    assert_int_equal(rx_data[3], 0);
+
+    ReplayTestTask *task = replay_test_task(test);
+    assert_true(dynamixel_replay_uart_init(&task->replay, &task->io_task, log, log_size));
+    int n_different;
+    assert_int_equal(dynamixel_replay_run(&task->replay, &n_different), 1);
+    assert_int_equal(n_different, 0);
+}
+
+int run_dynamixel_replay_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_replay_log_records),
+        cmocka_unit_test(test_replay_run),
+        cmocka_unit_test(test_replay_application),
+        cmocka_unit_test(test_replay_mismatch),
+        cmocka_unit_test(test_replay_dropped_record),
+        cmocka_unit_test(test_replay_wrong_length),
+        cmocka_unit_test(test_replay_capture_file),
+    };
+    return cmocka_run_group_tests(tests, replay_group_setup, NULL);
+}
@@ -0,0 +1,389 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "dynamixel.h"
+#include "io_task.h"
+#include "servo_group.h"
+#include "virtual_bus.h"
+#include "dynamixel_virtual_bus_fixture.h"
+
+/*
+ * ServoGroup (initialisation, reads and writes, partial results, circuit breaker)
+ * with virtual AX-12 servos (MX-28 for bulk reads, ids 1..20, present position = 100 * id)
+ * in virtual time, groups of ids 1..4 unless they test group size, backoff of probes
+ * in ticks (real time).
+ */
+
+#define SERVO_GROUP_TEST_N_SERVOS       4
+#define SERVO_GROUP_TEST_N_BUS_SERVOS   VIRTUAL_BUS_FIXTURE_MAX_N_SERVOS
+// long enough not to be exceeded by scheduling latency of the host
+#define SERVO_GROUP_TEST_MIN_BACKOFF    50000
+#define SERVO_GROUP_TEST_MAX_BACKOFF    100000
+#define SERVO_GROUP_TEST_MAX_GROUPS     8
+#define SERVO_GROUP_TEST_MAX_ALL_GROUPS 2
+
+using namespace Dynamixel;
+
+struct ServoGroupTestState : VirtualBusFixture {
+    ServoGroup *groups[SERVO_GROUP_TEST_MAX_GROUPS];
+    int n_groups;
+};
+
+static ServoGroupTestState servo_group_test;
+
+static int servo_group_group_setup(void **state)
+{
+    ServoGroupTestState *test = &servo_group_test;
+    *state = test;
+    return virtual_bus_fixture_init(test, SERVO_GROUP_TEST_N_BUS_SERVOS, 4) ? 0 : -1;
+}
+
+static int servo_group_reset_servos(void **state)
+{
+    ServoGroupTestState *test = (ServoGroupTestState *) *state;
+    virtual_bus_fixture_reset_servos(test, SERVO_GROUP_TEST_N_BUS_SERVOS);
+    return 0;
+}
+
+// after initialise() (writes move servos to their goal positions)
+static void servo_group_test_set_positions(ServoGroupTestState *test) {
+    for (int i = 0; i < SERVO_GROUP_TEST_N_BUS_SERVOS; i++) {
+        dynamixel_virtual_servo_write_u16(&test->servos[i], DYNAMIXEL_GOAL_POSITION_L, 100 * (i + 1));
+        dynamixel_virtual_servo_write_u16(&test->servos[i], DYNAMIXEL_PRESENT_POSITION_L, 100 * (i + 1));
+    }
+}
+
+// groups are never deleted (the IO task outlives the tests), one for each test
+template<int N>
+static ServoGroup *servo_group_test_add(ServoGroupTestState *test, Servo *servos,
+        ServoGroup::Storage<N> &storage) {
+    configASSERT(test->n_groups < SERVO_GROUP_TEST_MAX_GROUPS);
+    ServoGroup *group = new ServoGroup(&test->io_task, servos, N, storage);
+    test->groups[test->n_groups++] = group;
+    return group;
+}
+
+static ServoGroup *servo_group_test_create(ServoGroupTestState *test) {
+    static Servo servos[SERVO_GROUP_TEST_MAX_GROUPS][SERVO_GROUP_TEST_N_SERVOS] = {
+        {1, 2, 3, 4}, {1, 2, 3, 4}, {1, 2, 3, 4}, {1, 2, 3, 4},
+        {1, 2, 3, 4}, {1, 2, 3, 4}, {1, 2, 3, 4}, {1, 2, 3, 4}
+    };
+    static ServoGroup::Storage<SERVO_GROUP_TEST_N_SERVOS> storage[SERVO_GROUP_TEST_MAX_GROUPS];
+    return servo_group_test_add(test, servos[test->n_groups], storage[test->n_groups]);
+}
+
+// of all the servos on the bus
+static ServoGroup *servo_group_test_create_all(ServoGroupTestState *test) {
+    static Servo servos[SERVO_GROUP_TEST_MAX_ALL_GROUPS][SERVO_GROUP_TEST_N_BUS_SERVOS] = {
+        {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20},
+        {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20},
+    };
+    static ServoGroup::Storage<SERVO_GROUP_TEST_N_BUS_SERVOS> storage[SERVO_GROUP_TEST_MAX_ALL_GROUPS];
+    static int n_all_groups = 0;
+    configASSERT(n_all_groups < SERVO_GROUP_TEST_MAX_ALL_GROUPS);
+    int i = n_all_groups++;
+    return servo_group_test_add(test, servos[i], storage[i]);
+}
+
+// bulk reads need MX servos, accepted by the group
+static void servo_group_test_use_mx(ServoGroupTestState *test, ServoGroup &group) {
+    for (int i = 0; i < SERVO_GROUP_TEST_N_BUS_SERVOS; i++)
+        dynamixel_virtual_servo_init_model(&test->servos[i], i + 1, DYNAMIXEL_MX28_MODEL_NUMBER);
+    group.set_models(ServoGroup::mx_models, 4);
+}
+
+static uint32_t servo_group_test_n_timeouts(ServoGroupTestState *test) {
+    DynamixelIOMetrics metrics;
+    dynamixel_io_task_get_metrics(&test->io_task, &metrics);
+    return metrics.n_status[dio_UART_READ_TIMEOUT];
+}
+
+static uint32_t servo_group_test_n_transactions(ServoGroupTestState *test) {
+    DynamixelIOMetrics metrics;
+    dynamixel_io_task_get_metrics(&test->io_task, &metrics);
+    return metrics.n_transactions;
+}
+
+static void test_servo_group_initialise(void **state) {
+    ServoGroupTestState *test = (ServoGroupTestState *) *state;
+    ServoGroup &group = *servo_group_test_create(test);
+    for (int i = 0; i < SERVO_GROUP_TEST_N_SERVOS; i++)
+        dynamixel_virtual_servo_write_u8(&test->servos[i], DYNAMIXEL_TORQUE_ENABLE, 1);
+
+    // defaults are written to all the servos
+    assert_true(group.initialise());
+    assert_true(group.is_initialised());
+    for (int i = 0; i < SERVO_GROUP_TEST_N_SERVOS; i++) {
+        DynamixelVirtualServo *servo = &test->servos[i];
+        assert_int_equal(dynamixel_virtual_servo_read_u8(servo, DYNAMIXEL_TORQUE_ENABLE), 0);
+        assert_int_equal(dynamixel_virtual_servo_read_u8(servo, DYNAMIXEL_ALARM_SHUTDOWN),
+                DYNAMIXEL_ERROR_OVERHEATING_MASK | DYNAMIXEL_ERROR_INPUT_VOLTAGE_MASK);
+        assert_int_equal(group[i].last_status(), dio_OK);
+    }
+
+    // goal positions of selected servos with one sync write, read back one by one
+    group[0].prepare<AX::GOAL_POSITION>(100);
+    group[2].prepare<AX::GOAL_POSITION>(300);
+    assert_true(group.sync_selected());
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[0], DYNAMIXEL_GOAL_POSITION_L), 100);
+    // not selected: the factory default
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[1], DYNAMIXEL_GOAL_POSITION_L), 512);
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[2], DYNAMIXEL_GOAL_POSITION_L), 300);
+    group.prepare_all_read<AX::PRESENT_POSITION>();
+    assert_true(group.read_selected());
+    assert_int_equal(group[0].data_u16(), 100);
+    assert_int_equal(group[2].data_u16(), 300);
+    assert_false(group[0].is_selected());
+
+    // out of range value is not sent
+    assert_false(group[1].prepare<AX::GOAL_POSITION>(1024));
+    assert_false(group[1].is_selected());
+}
+
+static void test_servo_group_bulk_read(void **state) {
+    ServoGroupTestState *test = (ServoGroupTestState *) *state;
+    ServoGroup &group = *servo_group_test_create_all(test);
+    servo_group_test_use_mx(test, group);
+    assert_true(group.initialise());
+    servo_group_test_set_positions(test);
+
+    // each servo with its own register, all of them in one transaction
+    group.prepare_all_read<AX::PRESENT_POSITION>();
+    group[1].prepare_read<AX::ID>();
+    group[7].prepare_read<AX::MODEL_NUMBER>();
+    uint32_t n_transactions = servo_group_test_n_transactions(test);
+    assert_true(group.bulk_read_selected());
+    assert_int_equal(servo_group_test_n_transactions(test) - n_transactions, 1);
+    for (int i = 0; i < SERVO_GROUP_TEST_N_BUS_SERVOS; i++) {
+        assert_int_equal(group[i].last_status(), dio_OK);
+        assert_false(group[i].is_selected());
+        if (i == 1)
+            assert_int_equal(group[i].data_u8(), 2);
+        else if (i == 7)
+            assert_int_equal(group[i].data_u16(), DYNAMIXEL_MX28_MODEL_NUMBER);
+        else
+            assert_int_equal(group[i].data_u16(), 100 * (i + 1));
+    }
+
+    // only the selected ones
+    dynamixel_virtual_servo_write_u16(&test->servos[19], DYNAMIXEL_PRESENT_POSITION_L, 1000);
+    group[19].prepare_read<AX::PRESENT_POSITION>();
+    assert_true(group.bulk_read_selected());
+    assert_int_equal(group[19].data_u16(), 1000);
+    assert_int_equal(servo_group_test_n_transactions(test) - n_transactions, 2);
+    // nothing to read
+    assert_true(group.bulk_read_selected());
+    assert_int_equal(servo_group_test_n_transactions(test) - n_transactions, 2);
+}
+
+static uint32_t servo_group_test_n_requests(ServoGroupTestState *test) {
+    DynamixelIOQueueStats stats;
+    dynamixel_io_task_get_queue_stats(&test->io_task, dio_PRIORITY_NORMAL, &stats);
+    return stats.n_requests;
+}
+
+static void test_servo_group_batch_read(void **state) {
+    ServoGroupTestState *test = (ServoGroupTestState *) *state;
+    ServoGroup &group = *servo_group_test_create_all(test);
+    // pings and reads of model numbers, each of the whole group in one batch request
+    // (sync writes have the control priority)
+    uint32_t n_requests = servo_group_test_n_requests(test);
+    assert_true(group.initialise());
+    assert_int_equal(servo_group_test_n_requests(test) - n_requests, 2);
+    servo_group_test_set_positions(test);
+
+    // a read of each servo
+    n_requests = servo_group_test_n_requests(test);
+    uint32_t n_transactions = servo_group_test_n_transactions(test);
+    group.prepare_all_read<AX::PRESENT_POSITION>();
+    assert_true(group.read_selected());
+    assert_int_equal(servo_group_test_n_requests(test) - n_requests, 1);
+    assert_int_equal(servo_group_test_n_transactions(test) - n_transactions,
+            SERVO_GROUP_TEST_N_BUS_SERVOS);
+    for (int i = 0; i < SERVO_GROUP_TEST_N_BUS_SERVOS; i++)
+        assert_int_equal(group[i].data_u16(), 100 * (i + 1));
+}
+
+static void test_servo_group_partial_reads(void **state) {
+    ServoGroupTestState *test = (ServoGroupTestState *) *state;
+    ServoGroup &group = *servo_group_test_create(test);
+    assert_true(group.initialise());
+    servo_group_test_set_positions(test);
+
+    // the others are read also after the failed one
+    test->servos[2].connected = false;
+    for (int cycle = 1; cycle <= 3; cycle++) {
+        group.prepare_all_read<AX::PRESENT_POSITION>();
+        assert_false(group.read_selected());
+        for (int i = 0; i < SERVO_GROUP_TEST_N_SERVOS; i++) {
+            if (i == 2)
+                continue;
+            assert_int_equal(group[i].last_status(), dio_OK);
+            assert_int_equal(group[i].data_u16(), 100 * (i + 1));
+        }
+        assert_int_equal(group[2].last_status(), dio_UART_READ_TIMEOUT);
+        assert_int_equal(group[2].n_failures(), cycle);
+        // without the circuit breaker it is not skipped
+        assert_false(group[2].is_quarantined());
+    }
+
+    test->servos[2].connected = true;
+    group.prepare_all_read<AX::PRESENT_POSITION>();
+    assert_true(group.read_selected());
+    assert_int_equal(group[2].n_failures(), 0);
+    assert_int_equal(group[2].data_u16(), 300);
+}
+
+static void test_servo_group_circuit_breaker(void **state) {
+    ServoGroupTestState *test = (ServoGroupTestState *) *state;
+    ServoGroup &group = *servo_group_test_create(test);
+    group.set_circuit_breaker(2, SERVO_GROUP_TEST_MIN_BACKOFF, SERVO_GROUP_TEST_MAX_BACKOFF);
+
+    // a missing servo does not fail initialisation, it is pinged only twice
+    test->servos[1].connected = false;
+    uint32_t n_timeouts = servo_group_test_n_timeouts(test);
+    assert_true(group.initialise());
+    assert_true(group[1].is_quarantined());
+    assert_int_equal(servo_group_test_n_timeouts(test) - n_timeouts, 2);
+    servo_group_test_set_positions(test);
+
+    // skipped by reads and sync writes until the probe is due
+    n_timeouts = servo_group_test_n_timeouts(test);
+    group.prepare_all_read<AX::PRESENT_POSITION>();
+    assert_true(group.read_selected());
+    assert_int_equal(group[3].data_u16(), 400);
+    assert_true(group.prepare_all<AX::GOAL_POSITION>(500));
+    assert_true(group.sync_selected());
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[0], DYNAMIXEL_GOAL_POSITION_L), 500);
+    assert_int_equal(servo_group_test_n_timeouts(test), n_timeouts);
+
+    // a failed probe doubles the interval
+    vTaskDelay(SERVO_GROUP_TEST_MIN_BACKOFF * 6 / 5);
+    assert_int_equal(group.probe_quarantined(), 0);
+    assert_int_equal(servo_group_test_n_timeouts(test) - n_timeouts, 1);
+    assert_true(group[1].is_quarantined());
+    vTaskDelay(SERVO_GROUP_TEST_MIN_BACKOFF * 6 / 5);
+    group.prepare_all_read<AX::PRESENT_POSITION>();
+    assert_true(group.read_selected());
+    assert_int_equal(servo_group_test_n_timeouts(test) - n_timeouts, 1);
+
+    // restored by a successful probe and read in the same cycle
+    test->servos[1].connected = true;
+    vTaskDelay(SERVO_GROUP_TEST_MIN_BACKOFF);
+    group.prepare_all_read<AX::PRESENT_POSITION>();
+    assert_true(group.read_selected());
+    assert_false(group[1].is_quarantined());
+    assert_int_equal(group[1].last_status(), dio_OK);
+    assert_int_equal(group[1].data_u16(), 200);
+}
+
+static void test_servo_group_breaker_failures(void **state) {
+    ServoGroupTestState *test = (ServoGroupTestState *) *state;
+    ServoGroup &group = *servo_group_test_create(test);
+    group.set_circuit_breaker(3, SERVO_GROUP_TEST_MIN_BACKOFF, SERVO_GROUP_TEST_MAX_BACKOFF);
+    assert_true(group.initialise());
+
+    // quarantined after consecutive failures only
+    test->servos[0].connected = false;
+    group.prepare_all_read<AX::PRESENT_POSITION>();
+    assert_false(group.read_selected());
+    assert_false(group.read_selected());
+    test->servos[0].connected = true;
+    assert_true(group.read_selected());
+    assert_int_equal(group[0].n_failures(), 0);
+    test->servos[0].connected = false;
+    for (int i = 0; i < 3; i++)
+        assert_false(group.read_selected());
+    assert_true(group[0].is_quarantined());
+    assert_true(group.read_selected());
+
+    // back to normal without the breaker
+    group.set_circuit_breaker(0, 0, 0);
+    assert_false(group[0].is_quarantined());
+    test->servos[0].connected = true;
+    assert_true(group.ping_servo(0));
+    assert_true(group.read_selected());
+}
+
+static void test_servo_group_bulk_read_failures(void **state) {
+    ServoGroupTestState *test = (ServoGroupTestState *) *state;
+    ServoGroup &group = *servo_group_test_create(test);
+    servo_group_test_use_mx(test, group);
+    group.set_circuit_breaker(2, SERVO_GROUP_TEST_MIN_BACKOFF, SERVO_GROUP_TEST_MAX_BACKOFF);
+    assert_true(group.initialise());
+    servo_group_test_set_positions(test);
+
+    // the others get their data, the missing one is recorded
+    test->servos[2].connected = false;
+    uint32_t n_timeouts = servo_group_test_n_timeouts(test);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        group.prepare_all_read<AX::PRESENT_POSITION>();
+        assert_false(group.bulk_read_selected());
+        for (int i = 0; i < SERVO_GROUP_TEST_N_SERVOS; i++) {
+            if (i == 2)
+                continue;
+            assert_int_equal(group[i].last_status(), dio_OK);
+            assert_int_equal(group[i].data_u16(), 100 * (i + 1));
+        }
+        assert_int_equal(group[2].last_status(), dio_UART_READ_TIMEOUT);
+        assert_int_equal(group[2].n_failures(), attempt + 1);
+    }
+    assert_int_equal(servo_group_test_n_timeouts(test) - n_timeouts, 2);
+
+    // quarantined, then skipped without timeouts
+    assert_true(group[2].is_quarantined());
+    dynamixel_virtual_servo_write_u16(&test->servos[0], DYNAMIXEL_PRESENT_POSITION_L, 1000);
+    group.prepare_all_read<AX::PRESENT_POSITION>();
+    assert_true(group.bulk_read_selected());
+    assert_int_equal(group[0].data_u16(), 1000);
+    assert_int_equal(servo_group_test_n_timeouts(test) - n_timeouts, 2);
+
+    // probed by the bulk read, restored and read in the same cycle
+    test->servos[2].connected = true;
+    vTaskDelay(SERVO_GROUP_TEST_MIN_BACKOFF * 6 / 5);
+    group.prepare_all_read<AX::PRESENT_POSITION>();
+    assert_true(group.bulk_read_selected());
+    assert_false(group[2].is_quarantined());
+    assert_int_equal(group[2].last_status(), dio_OK);
+    assert_int_equal(group[2].data_u16(), 300);
+}
+
+static void test_servo_group_small_rx_pool(void **state) {
+    ServoGroupTestState *test = (ServoGroupTestState *) *state;
+    // fewer buffers than servos: the rest of a batch is received into its packets
+    static uint8_t storage[2 * 16];
+    DynamixelIORxPool pool;
+    assert_true(dynamixel_io_rx_pool_create(&pool, storage, 16, 2));
+    dynamixel_io_task_set_rx_pool(&test->io_task, &pool);
+
+    ServoGroup &group = *servo_group_test_create(test);
+    assert_true(group.initialise());
+    servo_group_test_set_positions(test);
+    group.prepare_all_read<AX::PRESENT_POSITION>();
+    assert_true(group.read_selected());
+    for (int i = 0; i < SERVO_GROUP_TEST_N_SERVOS; i++)
+        assert_int_equal(group[i].data_u16(), 100 * (i + 1));
+    // all of them given back
+    assert_int_equal(uxQueueMessagesWaiting(pool.free_buffers), 2);
+
+    dynamixel_io_task_set_rx_pool(&test->io_task, NULL);
+    dynamixel_io_rx_pool_delete(&pool);
+}
+
+int run_dynamixel_servo_group_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup(test_servo_group_initialise, servo_group_reset_servos),
+        cmocka_unit_test_setup(test_servo_group_bulk_read, servo_group_reset_servos),
+        cmocka_unit_test_setup(test_servo_group_batch_read, servo_group_reset_servos),
+        cmocka_unit_test_setup(test_servo_group_partial_reads, servo_group_reset_servos),
+        cmocka_unit_test_setup(test_servo_group_circuit_breaker, servo_group_reset_servos),
+        cmocka_unit_test_setup(test_servo_group_breaker_failures, servo_group_reset_servos),
+        cmocka_unit_test_setup(test_servo_group_bulk_read_failures, servo_group_reset_servos),
+        cmocka_unit_test_setup(test_servo_group_small_rx_pool, servo_group_reset_servos),
+    };
+    return cmocka_run_group_tests(tests, servo_group_group_setup, NULL);
+}
@@ -195,6 +195,98 @@ static void test_prepare_read_register_u16(void **state) {
     assert_int_equal(response_size, correct_response_size);
 }
 
+static void test_prepare_sync_write_sized(void **state) {
+    // 16-bit sync-write to 26 servos does not fit into default DynamixelPacket
+    enum { N_SERVOS = 26, N_PARAMETERS = 2 + N_SERVOS * 3 };
+    uint8_t data[N_SERVOS * 3];
+    for (int i = 0; i < N_SERVOS; i++) {
+        data[3 * i] = i;
+        data[3 * i + 1] = 0x10 + i;
+        data[3 * i + 2] = 0x01;
+    }
+    DynamixelPacket packet;
+    assert_int_equal(dynamixel_prepare_sync_write(&packet, 0x1e, data, N_SERVOS, 2), -1);
+
+    uint8_t storage[DYNAMIXEL_PACKET_STORAGE_SIZE(N_PARAMETERS)];
+    DynamixelPacket *large = (DynamixelPacket *) storage;
+    int response_size = dynamixel_prepare_sync_write_sized(large, N_PARAMETERS, 0x1e, data, N_SERVOS, 2);
+    assert_int_equal(response_size, 0);
+    assert_int_equal(dynamixel_packet_size(large), sizeof(storage));
+    assert_int_equal(large->length, N_PARAMETERS + 2);
+    assert_memory_equal(&large->parameters_with_checksum[2], data, sizeof(data));
+    assert_true(dynamixel_packet_checksum_isok(large));
+
+    // the same using incremental interface
+    uint8_t storage2[DYNAMIXEL_PACKET_STORAGE_SIZE(N_PARAMETERS)];
+    DynamixelPacket *large2 = (DynamixelPacket *) storage2;
+    assert_int_equal(dynamixel_prepare_sync_write_init_sized(large2, N_PARAMETERS, 0x1e, 2), 0);
+    for (int i = 0; i < N_SERVOS; i++)
+        assert_int_equal(dynamixel_prepare_sync_write_add_next_sized(large2, N_PARAMETERS,
+                    i, &data[3 * i + 1]), 0);
+    assert_int_equal(dynamixel_prepare_sync_write_add_next_sized(large2, N_PARAMETERS,
+                0, &data[1]), -1);
+    assert_int_equal(dynamixel_prepare_sync_write_end_sized(large2, N_PARAMETERS), 0);
+    assert_memory_equal(storage2, storage, sizeof(storage));
+}
+
+static void test_prepare_bulk_read(void **state) {
+    // MX-28 manual example: 2 bytes from 0x1e of ID=1, 2 bytes from 0x24 of ID=2
+    uint8_t correct_packet[] = {0xff, 0xff, 0xfe, 0x09, 0x92, 0x00,
+        0x02, 0x01, 0x1e,
+        0x02, 0x02, 0x24,
+        0x1d};
+    int correct_response_size = 2 * (6 + 2);
+    DynamixelPacket packet;
+    uint8_t data[] = {0x02, 0x01, 0x1e, 0x02, 0x02, 0x24};
+    int response_size = dynamixel_prepare_bulk_read(&packet, data, 2);
+    assert_int_equal(response_size, correct_response_size);
+    assert_int_equal(dynamixel_packet_size(&packet), sizeof(correct_packet));
+    assert_memory_equal(dynamixel_packet_data(&packet), correct_packet, sizeof(correct_packet));
+
+    DynamixelPacket packet2;
+    assert_int_equal(dynamixel_prepare_bulk_read_init(&packet2), 0);
+    assert_int_equal(dynamixel_prepare_bulk_read_add_next(&packet2, 0x01, 0x1e, 2), 0);
+    assert_int_equal(dynamixel_prepare_bulk_read_add_next(&packet2, 0x02, 0x24, 2), 0);
+    assert_int_equal(dynamixel_prepare_bulk_read_end(&packet2), correct_response_size);
+    assert_memory_equal(dynamixel_packet_data(&packet2), correct_packet, sizeof(correct_packet));
+}
+
+static void test_prepare_bulk_read_too_long(void **state) {
+    // 1 + 3 * 3 parameters do not fit into 9
+    uint8_t storage[DYNAMIXEL_PACKET_STORAGE_SIZE(9)];
+    DynamixelPacket *packet = (DynamixelPacket *) storage;
+    uint8_t data[] = {1, 1, 0x24, 1, 2, 0x24, 1, 3, 0x24};
+    assert_int_equal(dynamixel_prepare_bulk_read_sized(packet, 9, data, 3), -1);
+    assert_int_equal(dynamixel_prepare_bulk_read_sized(packet, 9, data, 2), 2 * (6 + 1));
+    assert_int_equal(dynamixel_prepare_bulk_read_add_next_sized(packet, 9, 3, 0x24, 1), -1);
+}
+
+static void test_status_packets_next(void **state) {
+    // responses to the bulk read above, ID=2 reports overload error
+    uint8_t data[] = {
+        0xff, 0xff, 0x01, 0x04, 0x00, 0x00, 0x80, 0x7a,
+        0xff, 0xff, 0x02, 0x04, 0x20, 0x00, 0x02, 0xd7,
+    };
+    int offset = 0;
+    DynamixelPacket *status = dynamixel_status_packets_next(data, sizeof(data), &offset);
+    assert_non_null(status);
+    assert_int_equal(status->id, 1);
+    assert_int_equal(dynamixel_packet_n_parameters(status), 2);
+    assert_true(dynamixel_packet_checksum_isok(status));
+    assert_int_equal(offset, 8);
+    status = dynamixel_status_packets_next(data, sizeof(data), &offset);
+    assert_non_null(status);
+    assert_int_equal(status->id, 2);
+    assert_int_equal(status->error, DYNAMIXEL_ERROR_OVERLOAD_MASK);
+    assert_int_equal(status->parameters_with_checksum[1], 0x02);
+    assert_true(dynamixel_packet_checksum_isok(status));
+    assert_null(dynamixel_status_packets_next(data, sizeof(data), &offset));
+    // truncated packet
+    offset = 0;
+    assert_null(dynamixel_status_packets_next(data, 7, &offset));
+    assert_int_equal(offset, 0);
+}
+
 int run_dynamixel_tests(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_prepare_ping),
@@ -210,6 +302,10 @@ int run_dynamixel_tests(void) {
         cmocka_unit_test(test_prepare_set_register_u16),
         cmocka_unit_test(test_prepare_read_register_u8),
         cmocka_unit_test(test_prepare_read_register_u16),
+        cmocka_unit_test(test_prepare_sync_write_sized),
+        cmocka_unit_test(test_prepare_bulk_read),
+        cmocka_unit_test(test_prepare_bulk_read_too_long),
+        cmocka_unit_test(test_status_packets_next),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
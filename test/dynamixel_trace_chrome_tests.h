@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace_chrome.h"
+
+// event with zeroed reserved bytes
+#define TRACE_CHROME_TEST_EVENT(time, request_number, event_type, event_detail) \
+    {.time_us = (time), .request = (request_number), .type = (event_type), .detail = (event_detail)}
+
+// converted JSON (to be freed)
+static char *trace_chrome_test_convert(const DynamixelIOTraceEvent *events, int n_events) {
+    FILE *file = tmpfile();
+    assert_non_null(file);
+    assert_true(dynamixel_trace_write_chrome(file, events, n_events));
+    long size = ftell(file);
+    char *json = calloc(size + 1, 1);
+    assert_non_null(json);
+    rewind(file);
+    assert_int_equal(fread(json, 1, size, file), size);
+    fclose(file);
+    return json;
+}
+
+static void test_trace_chrome_phases(void **state) {
+    // the clock wraps in the middle
+    const uint32_t t0 = UINT32_MAX - 99;
+    const DynamixelIOTraceEvent events[] = {
+        TRACE_CHROME_TEST_EVENT(t0 + 0, 0, dio_TRACE_ENQUEUED, 1),
+        TRACE_CHROME_TEST_EVENT(t0 + 50, 0, dio_TRACE_DEQUEUED, 1),
+        TRACE_CHROME_TEST_EVENT(t0 + 60, 0, dio_TRACE_TX_STARTED, 3),
+        TRACE_CHROME_TEST_EVENT(t0 + 70, 1, dio_TRACE_ENQUEUED, 0),
+        TRACE_CHROME_TEST_EVENT(t0 + 120, 0, dio_TRACE_TX_COMPLETED, 0),
+        TRACE_CHROME_TEST_EVENT(t0 + 130, 0, dio_TRACE_WOKEN, 0),
+        TRACE_CHROME_TEST_EVENT(t0 + 135, 0, dio_TRACE_RX_STARTED, 0),
+        TRACE_CHROME_TEST_EVENT(t0 + 160, 0, dio_TRACE_RX_FIRST_DATA, 0),
+        TRACE_CHROME_TEST_EVENT(t0 + 200, 0, dio_TRACE_RX_COMPLETED, 1),
+        TRACE_CHROME_TEST_EVENT(t0 + 210, 0, dio_TRACE_WOKEN, 0),
+        TRACE_CHROME_TEST_EVENT(t0 + 212, 0, dio_TRACE_DONE, 0),
+        TRACE_CHROME_TEST_EVENT(t0 + 220, 1, dio_TRACE_DEQUEUED, 0),
+        TRACE_CHROME_TEST_EVENT(t0 + 221, 1, dio_TRACE_DONE, 8),
+    };
+    char *json = trace_chrome_test_convert(events, sizeof(events) / sizeof(*events));
+
+    assert_non_null(strstr(json, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    assert_non_null(strstr(json, "\"args\":{\"name\":\"bus\"}"));
+    assert_non_null(strstr(json, "\"ph\":\"b\",\"id\":0,\"pid\":1,\"tid\":1,\"ts\":0,"));
+    assert_non_null(strstr(json, "\"ph\":\"e\",\"id\":0,\"pid\":1,\"tid\":1,\"ts\":50,"));
+    assert_non_null(strstr(json, "\"ph\":\"e\",\"id\":1,\"pid\":1,\"tid\":1,\"ts\":220,"));
+    assert_non_null(strstr(json, "{\"name\":\"tx\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":60,\"dur\":60}"));
+    assert_non_null(strstr(json, "{\"name\":\"return delay\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":120,\"dur\":40}"));
+    assert_non_null(strstr(json, "{\"name\":\"rx\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":160,\"dur\":40,"
+                "\"args\":{\"state\":1}}"));
+    assert_non_null(strstr(json, "{\"name\":\"wakeup\",\"ph\":\"X\",\"pid\":1,\"tid\":3,\"ts\":120,\"dur\":10}"));
+    assert_non_null(strstr(json, "{\"name\":\"wakeup\",\"ph\":\"X\",\"pid\":1,\"tid\":3,\"ts\":200,\"dur\":10}"));
+    assert_non_null(strstr(json, "{\"name\":\"transaction\",\"ph\":\"X\",\"pid\":1,\"tid\":3,\"ts\":60,\"dur\":152,"
+                "\"args\":{\"request\":0,\"id\":3,\"status\":0}}"));
+    assert_non_null(strstr(json, "{\"name\":\"expired\",\"ph\":\"X\",\"pid\":1,\"tid\":3,\"ts\":220,\"dur\":1,"
+                "\"args\":{\"request\":1,\"id\":0,\"status\":8}}"));
+    assert_non_null(strstr(json, "\n]}\n"));
+    free(json);
+}
+
+static void test_trace_chrome_timeout(void **state) {
+    // exact reads: no first data, rx includes the return delay
+    const DynamixelIOTraceEvent events[] = {
+        TRACE_CHROME_TEST_EVENT(1000, 5, dio_TRACE_DEQUEUED, 0),
+        TRACE_CHROME_TEST_EVENT(1010, 5, dio_TRACE_TX_STARTED, 9),
+        TRACE_CHROME_TEST_EVENT(1050, 5, dio_TRACE_TX_COMPLETED, 0),
+        TRACE_CHROME_TEST_EVENT(1055, 5, dio_TRACE_WOKEN, 0),
+        TRACE_CHROME_TEST_EVENT(1060, 5, dio_TRACE_RX_STARTED, 0),
+        TRACE_CHROME_TEST_EVENT(1900, 5, dio_TRACE_TIMEOUT, 0),
+        TRACE_CHROME_TEST_EVENT(1920, 5, dio_TRACE_WOKEN, 0),
+        TRACE_CHROME_TEST_EVENT(1930, 5, dio_TRACE_DONE, 4),
+    };
+    char *json = trace_chrome_test_convert(events, sizeof(events) / sizeof(*events));
+    assert_non_null(strstr(json, "{\"name\":\"timeout\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":2,\"ts\":900}"));
+    assert_non_null(strstr(json, "{\"name\":\"wakeup\",\"ph\":\"X\",\"pid\":1,\"tid\":3,\"ts\":900,\"dur\":20}"));
+    assert_non_null(strstr(json, "\"ts\":10,\"dur\":920,\"args\":{\"request\":5,\"id\":9,\"status\":4}}"));
+    assert_null(strstr(json, "\"name\":\"rx\""));
+    free(json);
+}
+
+
+int run_dynamixel_trace_chrome_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_trace_chrome_phases),
+        cmocka_unit_test(test_trace_chrome_timeout),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
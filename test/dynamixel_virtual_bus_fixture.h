@@ -0,0 +1,48 @@
+#pragma once
+
+#include "dynamixel.h"
+#include "io_task.h"
+#include "virtual_bus.h"
+
+/*
+ * IO task communicating with virtual AX-12 servos at 1Mbps (10us per byte),
+ * shared by tests with the virtual bus.
+ */
+
+// more than fits into a packet of status packets
+#define VIRTUAL_BUS_FIXTURE_MAX_N_SERVOS    20
+// timeouts of the IO task in virtual time
+#define VIRTUAL_BUS_FIXTURE_PER_BYTE_US     12
+#define VIRTUAL_BUS_FIXTURE_READ_DELAY_US   600
+
+typedef struct {
+    DynamixelIOTaskHandle io_task;
+    DynamixelVirtualBus bus;
+    DynamixelVirtualServo servos[VIRTUAL_BUS_FIXTURE_MAX_N_SERVOS];
+} VirtualBusFixture;
+
+// the IO task on a bus of the first n_servos servos (initialised by the caller)
+static bool virtual_bus_fixture_init_with_timeouts(VirtualBusFixture *fixture, int n_servos,
+        int queues_length, bool virtual_time, int per_byte_us, int read_delay_us)
+{
+    configASSERT(n_servos <= VIRTUAL_BUS_FIXTURE_MAX_N_SERVOS);
+    if (!dynamixel_virtual_bus_init(&fixture->bus, &fixture->io_task, fixture->servos,
+                n_servos, 1000000, virtual_time))
+        return false;
+    dynamixel_io_task_create_with_driver(&fixture->io_task, "dxl", 1, queues_length,
+            dynamixel_virtual_bus_driver(&fixture->bus), per_byte_us, read_delay_us);
+    return true;
+}
+
+static bool virtual_bus_fixture_init(VirtualBusFixture *fixture, int n_servos, int queues_length)
+{
+    return virtual_bus_fixture_init_with_timeouts(fixture, n_servos, queues_length, true,
+            VIRTUAL_BUS_FIXTURE_PER_BYTE_US, VIRTUAL_BUS_FIXTURE_READ_DELAY_US);
+}
+
+// servos with ids 1..n_servos in factory state
+static void virtual_bus_fixture_reset_servos(VirtualBusFixture *fixture, int n_servos)
+{
+    for (int i = 0; i < n_servos; i++)
+        dynamixel_virtual_servo_init(&fixture->servos[i], i + 1);
+}
@@ -0,0 +1,474 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include "dynamixel.h"
+#include "io_task.h"
+#include "virtual_bus.h"
+#include "dynamixel_virtual_bus_fixture.h"
+
+/*
+ * IO task communicating with virtual AX-12 servos (ids 1..3) at 1Mbps (10us per byte),
+ * default Return Delay Time is 500us.
+ */
+
+#define VIRTUAL_BUS_TEST_N_SERVOS        3
+// in real time mode timeouts must include scheduling latency of the host
+#define VIRTUAL_BUS_TEST_REAL_TIME_PER_BYTE_US     2000
+#define VIRTUAL_BUS_TEST_REAL_TIME_READ_DELAY_US   20000
+
+typedef VirtualBusFixture VirtualBusTestState;
+
+static VirtualBusTestState virtual_bus_test;
+static VirtualBusTestState virtual_bus_real_time_test;
+
+static int virtual_bus_setup(void **state, VirtualBusTestState *test, bool virtual_time)
+{
+    *state = test;
+    if (!virtual_bus_fixture_init_with_timeouts(test, VIRTUAL_BUS_TEST_N_SERVOS, 1, virtual_time,
+                virtual_time ? VIRTUAL_BUS_FIXTURE_PER_BYTE_US : VIRTUAL_BUS_TEST_REAL_TIME_PER_BYTE_US,
+                virtual_time ? VIRTUAL_BUS_FIXTURE_READ_DELAY_US : VIRTUAL_BUS_TEST_REAL_TIME_READ_DELAY_US))
+        return -1;
+    return 0;
+}
+
+static int virtual_bus_group_setup(void **state)
+{
+    return virtual_bus_setup(state, &virtual_bus_test, true);
+}
+
+static int virtual_bus_real_time_group_setup(void **state)
+{
+    return virtual_bus_setup(state, &virtual_bus_real_time_test, false);
+}
+
+// each test starts with servos in factory state
+static int virtual_bus_reset_servos(void **state)
+{
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    virtual_bus_fixture_reset_servos(test, VIRTUAL_BUS_TEST_N_SERVOS);
+    test->bus.exact_reads = false;
+    for (int i = 0; i < dvb_N_FAULTS; i++)
+        dynamixel_virtual_bus_set_fault_rate(&test->bus, (DynamixelVirtualBusFault) i, 0);
+    return 0;
+}
+
+static DynamixelIOStatus virtual_bus_transfer(void **state, DynamixelPacket *packet,
+        int response_size, DynamixelIOResponse *response)
+{
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    assert_true(dynamixel_io_send_request(&test->io_task, packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, response));
+    return response->status;
+}
+
+static void test_virtual_bus_ping_timing(void **state) {
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    int response_size = dynamixel_prepare_ping(&packet, 2);
+
+    uint64_t start = dynamixel_virtual_bus_time_us(&test->bus);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_int_equal(packet.id, 2);
+    // 6 bytes of ping, 500us of return delay, 6 bytes of status
+    assert_int_equal(dynamixel_virtual_bus_time_us(&test->bus) - start, 60 + 500 + 60);
+
+    // shorter return delay
+    dynamixel_virtual_servo_write_u8(&test->servos[1], DYNAMIXEL_RETURN_DELAY_TIME, 5);
+    start = dynamixel_virtual_bus_time_us(&test->bus);
+    response_size = dynamixel_prepare_ping(&packet, 2);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_int_equal(dynamixel_virtual_bus_time_us(&test->bus) - start, 60 + 10 + 60);
+}
+
+static void test_virtual_bus_write_read(void **state) {
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    uint8_t goal[] = {0x34, 0x01};
+    int response_size = dynamixel_prepare_write(&packet, 3, DYNAMIXEL_GOAL_POSITION_L, goal, 2);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[2], DYNAMIXEL_GOAL_POSITION_L), 0x134);
+
+    response_size = dynamixel_prepare_read(&packet, 3, DYNAMIXEL_PRESENT_POSITION_L, 2);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_int_equal(response.data_len, 2);
+    assert_memory_equal(response.data, goal, 2);
+
+    // the same with reception of exact number of bytes
+    test->bus.exact_reads = true;
+    response_size = dynamixel_prepare_read(&packet, 1, DYNAMIXEL_MODEL_NUMBER_L, 2);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_int_equal(response.data[0], DYNAMIXEL_AX12_MODEL_NUMBER);
+
+    // read-only register
+    response_size = dynamixel_prepare_write(&packet, 1, DYNAMIXEL_PRESENT_POSITION_L, goal, 2);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_true(DYNAMIXEL_IS_RANGE_ERROR(packet.instruction));
+}
+
+static void test_virtual_bus_sync_write(void **state) {
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    uint8_t data[] = {1, 0x10, 0x00, 3, 0x30, 0x00};
+    int response_size = dynamixel_prepare_sync_write(&packet, DYNAMIXEL_GOAL_POSITION_L, data, 2, 2);
+    assert_int_equal(response_size, 0);
+
+    uint64_t start = dynamixel_virtual_bus_time_us(&test->bus);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_int_equal(dynamixel_virtual_bus_time_us(&test->bus) - start,
+            10 * dynamixel_packet_size(&packet));
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[0], DYNAMIXEL_GOAL_POSITION_L), 0x10);
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[1], DYNAMIXEL_GOAL_POSITION_L), 0x200);
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[2], DYNAMIXEL_GOAL_POSITION_L), 0x30);
+}
+
+static void test_virtual_bus_bulk_read(void **state) {
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    for (int i = 0; i < 3; i++)
+        dynamixel_virtual_servo_init_model(&test->servos[i], i + 1, DYNAMIXEL_MX28_MODEL_NUMBER);
+    dynamixel_virtual_servo_write_u16(&test->servos[0], DYNAMIXEL_PRESENT_POSITION_L, 0x123);
+    uint8_t data[] = {
+        2, 1, DYNAMIXEL_PRESENT_POSITION_L,
+        1, 3, DYNAMIXEL_ID,
+        2, 2, DYNAMIXEL_MODEL_NUMBER_L,
+    };
+    int response_size = dynamixel_prepare_bulk_read(&packet, data, 3);
+    assert_int_equal(response_size, 8 + 7 + 8);
+    int request_size = dynamixel_packet_size(&packet);
+
+    uint64_t start = dynamixel_virtual_bus_time_us(&test->bus);
+    assert_true(dynamixel_io_send_multi_request(&test->io_task, &packet, response_size, 3, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(response.status, dio_OK);
+    // status packets back to back after return delay of the first servo
+    assert_int_equal(dynamixel_virtual_bus_time_us(&test->bus) - start,
+            10 * request_size + 500 + 10 * response_size);
+
+    // in the order of the request
+    int offset = 0;
+    DynamixelPacket *status = dynamixel_status_packets_next(response.data, response.data_len, &offset);
+    assert_non_null(status);
+    assert_int_equal(status->id, 1);
+    assert_int_equal(dynamixel_packet_n_parameters(status), 2);
+    assert_int_equal(status->parameters_with_checksum[0] | status->parameters_with_checksum[1] << 8, 0x123);
+    status = dynamixel_status_packets_next(response.data, response.data_len, &offset);
+    assert_non_null(status);
+    assert_int_equal(status->id, 3);
+    assert_int_equal(status->parameters_with_checksum[0], 3);
+    status = dynamixel_status_packets_next(response.data, response.data_len, &offset);
+    assert_non_null(status);
+    assert_int_equal(status->id, 2);
+    assert_int_equal(status->parameters_with_checksum[0] | status->parameters_with_checksum[1] << 8,
+            DYNAMIXEL_MX28_MODEL_NUMBER);
+    assert_null(dynamixel_status_packets_next(response.data, response.data_len, &offset));
+
+    // a servo missing from the bus makes the transfer time out
+    test->servos[2].connected = false;
+    response_size = dynamixel_prepare_bulk_read(&packet, data, 3);
+    assert_true(dynamixel_io_send_multi_request(&test->io_task, &packet, response_size, 3, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(response.status, dio_UART_READ_TIMEOUT);
+    // the status packets that have been received are in the response
+    assert_int_equal(response.data_len, 8 + 8);
+    offset = 0;
+    status = dynamixel_status_packets_next(response.data, response.data_len, &offset);
+    assert_non_null(status);
+    assert_int_equal(status->id, 1);
+    status = dynamixel_status_packets_next(response.data, response.data_len, &offset);
+    assert_non_null(status);
+    assert_int_equal(status->id, 2);
+    assert_null(dynamixel_status_packets_next(response.data, response.data_len, &offset));
+
+    // AX servos ignore it (reset keeps the model)
+    dynamixel_virtual_servo_init(&test->servos[0], 1);
+    response_size = dynamixel_prepare_bulk_read(&packet, data, 1);
+    assert_true(dynamixel_io_send_multi_request(&test->io_task, &packet, response_size, 1, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(response.status, dio_UART_READ_TIMEOUT);
+    assert_int_equal(response.data_len, 0);
+    assert_int_equal(test->servos[0].n_instructions, 0);
+    response_size = dynamixel_prepare_reset(&packet, 2);
+    assert_true(dynamixel_io_send_request(&test->io_task, &packet, response_size, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(response.status, dio_OK);
+    assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[1], DYNAMIXEL_MODEL_NUMBER_L),
+            DYNAMIXEL_MX28_MODEL_NUMBER);
+}
+
+static void test_virtual_bus_reg_write_action(void **state) {
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    uint8_t led = 1;
+    int response_size = dynamixel_prepare_reg_write(&packet, 1, DYNAMIXEL_LED, &led, 1);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_int_equal(dynamixel_virtual_servo_read_u8(&test->servos[0], DYNAMIXEL_LED), 0);
+    assert_int_equal(dynamixel_virtual_servo_read_u8(&test->servos[0], DYNAMIXEL_REGISTERED_INSTRUCTION), 1);
+
+    response_size = dynamixel_prepare_action(&packet, DYNAMIXEL_BROADCASTING_ID);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_int_equal(dynamixel_virtual_servo_read_u8(&test->servos[0], DYNAMIXEL_LED), 1);
+    assert_int_equal(dynamixel_virtual_servo_read_u8(&test->servos[0], DYNAMIXEL_REGISTERED_INSTRUCTION), 0);
+}
+
+static void test_virtual_bus_packet_batch(void **state) {
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    uint8_t buffer[128];
+    DynamixelPacketBatch batch;
+    dynamixel_packet_batch_init(&batch, buffer, sizeof(buffer));
+
+    // registered goal positions of each servo (without responses) started by one action,
+    // then read back from the last one
+    for (int i = 0; i < VIRTUAL_BUS_TEST_N_SERVOS; i++) {
+        dynamixel_virtual_servo_write_u8(&test->servos[i], DYNAMIXEL_RETURN_LEVEL,
+                DYNAMIXEL_STATUS_RESPONSE_READ_DATA);
+        uint8_t goal[] = {(uint8_t) (0x10 * (i + 1)), 0x01};
+        // no response with this status return level
+        dynamixel_prepare_reg_write(&packet, i + 1, DYNAMIXEL_GOAL_POSITION_L, goal, 2);
+        assert_true(dynamixel_packet_batch_add(&batch, &packet, 0));
+    }
+    assert_true(dynamixel_packet_batch_add(&batch, &packet,
+                dynamixel_prepare_action(&packet, DYNAMIXEL_BROADCASTING_ID)));
+    assert_true(dynamixel_packet_batch_add(&batch, &packet,
+                dynamixel_prepare_read(&packet, 3, DYNAMIXEL_PRESENT_POSITION_L, 2)));
+    int batch_size = batch.size;
+
+    uint64_t start = dynamixel_virtual_bus_time_us(&test->bus);
+    assert_true(dynamixel_io_send_batch(&test->io_task, &batch, false));
+    assert_true(dynamixel_io_wait_response(&test->io_task, &response));
+    assert_int_equal(response.status, dio_OK);
+    // one transfer: the packets back to back, then the status packet
+    assert_int_equal(dynamixel_virtual_bus_time_us(&test->bus) - start, 10 * batch_size + 500 + 80);
+    for (int i = 0; i < VIRTUAL_BUS_TEST_N_SERVOS; i++) {
+        assert_int_equal(dynamixel_virtual_servo_read_u16(&test->servos[i], DYNAMIXEL_GOAL_POSITION_L),
+                0x100 + 0x10 * (i + 1));
+        assert_int_equal(dynamixel_virtual_servo_read_u8(&test->servos[i], DYNAMIXEL_REGISTERED_INSTRUCTION), 0);
+    }
+    assert_int_equal(response.data_len, 2);
+    assert_int_equal(response.data[0] | response.data[1] << 8, 0x130);
+}
+
+static void test_virtual_bus_no_response(void **state) {
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    uint8_t led = 1;
+
+    // status return level 1: only ping and read get response
+    dynamixel_virtual_servo_write_u8(&test->servos[0], DYNAMIXEL_RETURN_LEVEL,
+            DYNAMIXEL_STATUS_RESPONSE_READ_DATA);
+    int response_size = dynamixel_prepare_write(&packet, 1, DYNAMIXEL_LED, &led, 1);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response),
+            dio_UART_READ_TIMEOUT);
+    response_size = dynamixel_prepare_ping(&packet, 1);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+
+    // return delay longer than the task waits, the whole timeout passes
+    test->io_task.max_wait_read_delay_us = 300;
+    uint64_t start = dynamixel_virtual_bus_time_us(&test->bus);
+    response_size = dynamixel_prepare_ping(&packet, 2);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response),
+            dio_UART_READ_TIMEOUT);
+    assert_int_equal(dynamixel_virtual_bus_time_us(&test->bus) - start,
+            60 + 6 * VIRTUAL_BUS_FIXTURE_PER_BYTE_US + 300);
+    test->io_task.max_wait_read_delay_us = VIRTUAL_BUS_FIXTURE_READ_DELAY_US;
+
+    // servo with different baud rate and missing servo
+    dynamixel_virtual_servo_write_u8(&test->servos[2], DYNAMIXEL_BAUD_RATE, DYNAMIXEL_BAUD_RATE_57600);
+    response_size = dynamixel_prepare_ping(&packet, 3);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response),
+            dio_UART_READ_TIMEOUT);
+    response_size = dynamixel_prepare_ping(&packet, 4);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response),
+            dio_UART_READ_TIMEOUT);
+}
+
+static void virtual_bus_test_timer_start(void *context, uint32_t timeout_us) {
+    (void) context;
+    (void) timeout_us;
+}
+
+static void virtual_bus_test_timer_stop(void *context) {
+    (void) context;
+}
+
+static void test_virtual_bus_armed_timeouts(void **state) {
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+
+    // the bus keeps to the timeouts armed by the IO task, the timer itself never expires
+    DynamixelIOTimer timer = {virtual_bus_test_timer_start, virtual_bus_test_timer_stop, NULL, NULL};
+    dynamixel_io_task_set_timer(&test->io_task, timer, 300, 50);
+
+    // default return delay of 500us is longer than the first byte timeout
+    uint64_t start = dynamixel_virtual_bus_time_us(&test->bus);
+    int response_size = dynamixel_prepare_ping(&packet, 1);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response),
+            dio_UART_READ_TIMEOUT);
+    assert_int_equal(dynamixel_virtual_bus_time_us(&test->bus) - start, 60 + 300);
+
+    dynamixel_virtual_servo_write_u8(&test->servos[0], DYNAMIXEL_RETURN_DELAY_TIME, 100);
+    start = dynamixel_virtual_bus_time_us(&test->bus);
+    response_size = dynamixel_prepare_ping(&packet, 1);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_int_equal(dynamixel_virtual_bus_time_us(&test->bus) - start, 60 + 200 + 60);
+
+    // late response misses the first byte timeout, not the whole response one
+    dynamixel_virtual_bus_inject(&test->bus, dvb_FAULT_LATE_RESPONSE);
+    start = dynamixel_virtual_bus_time_us(&test->bus);
+    response_size = dynamixel_prepare_ping(&packet, 1);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response),
+            dio_UART_READ_TIMEOUT);
+    assert_int_equal(dynamixel_virtual_bus_time_us(&test->bus) - start, 60 + 300);
+
+    // each byte arms the inter-byte timeout, a longer response is not cut off
+    response_size = dynamixel_prepare_read(&packet, 1, DYNAMIXEL_MODEL_NUMBER_L, 20);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_int_equal(response.data_len, 20);
+
+    DynamixelIOTimer no_timer = {0};
+    dynamixel_io_task_set_timer(&test->io_task, no_timer, 0, 0);
+}
+
+static void test_virtual_bus_real_time(void **state) {
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    int response_size = dynamixel_prepare_read(&packet, 1, DYNAMIXEL_PRESENT_VOLTAGE, 2);
+
+    uint64_t start = dynamixel_virtual_bus_time_us(&test->bus);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_int_equal(response.data[0], 120);
+    assert_int_equal(response.data[1], 30);
+    assert_true(dynamixel_virtual_bus_time_us(&test->bus) - start >= 80 + 500 + 80);
+
+    response_size = dynamixel_prepare_ping(&packet, 4);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response),
+            dio_UART_READ_TIMEOUT);
+}
+
+static void test_virtual_bus_injected_faults(void **state) {
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    const DynamixelIOStatus expected[dvb_N_FAULTS] = {
+        [dvb_FAULT_WRITE_ERROR] = dio_UART_WRITE_ERROR,
+        [dvb_FAULT_DROPPED_BYTE] = dio_UART_READ_TIMEOUT,  // or framing, depends on the byte
+        [dvb_FAULT_CORRUPTED_CHECKSUM] = dio_WRONG_CHECKSUM,
+        [dvb_FAULT_LATE_RESPONSE] = dio_UART_READ_TIMEOUT,
+        [dvb_FAULT_MISSING_SERVO] = dio_UART_READ_TIMEOUT,
+        [dvb_FAULT_SPURIOUS_NOTIFICATION] = dio_WRONG_NOTIFICATION,
+    };
+
+    for (int fault = 0; fault < dvb_N_FAULTS; fault++) {
+        uint32_t count = test->bus.fault_counts[fault];
+        dynamixel_virtual_bus_inject(&test->bus, (DynamixelVirtualBusFault) fault);
+        int response_size = dynamixel_prepare_read(&packet, 2, DYNAMIXEL_PRESENT_POSITION_L, 2);
+        DynamixelIOStatus status = virtual_bus_transfer(state, &packet, response_size, &response);
+        if (fault == dvb_FAULT_DROPPED_BYTE && status != dio_UART_READ_TIMEOUT)
+            assert_true(status == dio_WRONG_FRAMING || status == dio_WRONG_CHECKSUM);
+        else
+            assert_int_equal(status, expected[fault]);
+        assert_int_equal(test->bus.fault_counts[fault], count + 1);
+
+        // only the next transfer is affected
+        response_size = dynamixel_prepare_read(&packet, 2, DYNAMIXEL_PRESENT_POSITION_L, 2);
+        assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+        assert_int_equal(response.data[1], 0x02);
+    }
+
+    // response faults have no effect without response
+    uint32_t count = test->bus.fault_counts[dvb_FAULT_CORRUPTED_CHECKSUM];
+    dynamixel_virtual_bus_inject(&test->bus, dvb_FAULT_CORRUPTED_CHECKSUM);
+    uint8_t data[] = {1, 0x10, 0x00};
+    int response_size = dynamixel_prepare_sync_write(&packet, DYNAMIXEL_GOAL_POSITION_L, data, 1, 2);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+    assert_int_equal(test->bus.fault_counts[dvb_FAULT_CORRUPTED_CHECKSUM], count);
+}
+
+static void test_virtual_bus_fault_rates(void **state) {
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+    int statuses[2][100];
+
+    dynamixel_virtual_bus_set_fault_rate(&test->bus, dvb_FAULT_CORRUPTED_CHECKSUM, 0.25f);
+    dynamixel_virtual_bus_set_fault_rate(&test->bus, dvb_FAULT_MISSING_SERVO, 0.25f);
+    for (int run = 0; run < 2; run++) {
+        // the same seed gives the same faults
+        dynamixel_virtual_bus_seed(&test->bus, 1234);
+        int n_ok = 0;
+        for (int i = 0; i < 100; i++) {
+            int response_size = dynamixel_prepare_ping(&packet, 1);
+            statuses[run][i] = virtual_bus_transfer(state, &packet, response_size, &response);
+            n_ok += statuses[run][i] == dio_OK;
+        }
+        // 0.75 * 0.75 of transfers
+        assert_in_range(n_ok, 40, 72);
+    }
+    assert_memory_equal(statuses[0], statuses[1], sizeof(statuses[0]));
+
+    dynamixel_virtual_bus_set_fault_rate(&test->bus, dvb_FAULT_CORRUPTED_CHECKSUM, 0);
+    dynamixel_virtual_bus_set_fault_rate(&test->bus, dvb_FAULT_MISSING_SERVO, 1);
+    for (int i = 0; i < 10; i++) {
+        int response_size = dynamixel_prepare_ping(&packet, 1);
+        assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response),
+                dio_UART_READ_TIMEOUT);
+    }
+}
+
+static void test_virtual_bus_real_time_faults(void **state) {
+    VirtualBusTestState *test = (VirtualBusTestState *) *state;
+    DynamixelPacket packet;
+    DynamixelIOResponse response;
+
+    dynamixel_virtual_bus_inject(&test->bus, dvb_FAULT_SPURIOUS_NOTIFICATION);
+    int response_size = dynamixel_prepare_ping(&packet, 1);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response),
+            dio_WRONG_NOTIFICATION);
+
+    dynamixel_virtual_bus_inject(&test->bus, dvb_FAULT_LATE_RESPONSE);
+    response_size = dynamixel_prepare_ping(&packet, 1);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response),
+            dio_UART_READ_TIMEOUT);
+
+    response_size = dynamixel_prepare_ping(&packet, 1);
+    assert_int_equal(virtual_bus_transfer(state, &packet, response_size, &response), dio_OK);
+}
+
+
+int run_dynamixel_virtual_bus_tests(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup(test_virtual_bus_ping_timing, virtual_bus_reset_servos),
+        cmocka_unit_test_setup(test_virtual_bus_write_read, virtual_bus_reset_servos),
+        cmocka_unit_test_setup(test_virtual_bus_sync_write, virtual_bus_reset_servos),
+        cmocka_unit_test_setup(test_virtual_bus_bulk_read, virtual_bus_reset_servos),
+        cmocka_unit_test_setup(test_virtual_bus_reg_write_action, virtual_bus_reset_servos),
+        cmocka_unit_test_setup(test_virtual_bus_packet_batch, virtual_bus_reset_servos),
+        cmocka_unit_test_setup(test_virtual_bus_no_response, virtual_bus_reset_servos),
+        cmocka_unit_test_setup(test_virtual_bus_armed_timeouts, virtual_bus_reset_servos),
+        cmocka_unit_test_setup(test_virtual_bus_injected_faults, virtual_bus_reset_servos),
+        cmocka_unit_test_setup(test_virtual_bus_fault_rates, virtual_bus_reset_servos),
+    };
+    const struct CMUnitTest real_time_tests[] = {
+        cmocka_unit_test_setup(test_virtual_bus_real_time, virtual_bus_reset_servos),
+        cmocka_unit_test_setup(test_virtual_bus_real_time_faults, virtual_bus_reset_servos),
+    };
+
+    // IO tasks are never deleted, so the buses are left as they are
+    return cmocka_run_group_tests(tests, virtual_bus_group_setup, NULL)
+        + cmocka_run_group_tests(real_time_tests, virtual_bus_real_time_group_setup, NULL);
+}
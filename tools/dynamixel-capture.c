@@ -0,0 +1,96 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "io_capture.h"
+
+/*
+ * Prints a log of bus traffic captured from the IO task (see io_capture.h) as text,
+ * one line per transaction (record), then its sent and received bytes:
+ *   dynamixel-capture bus.dxcp
+ *        time_us    delta duration  status  n_responses response_size
+ *     TX bytes
+ *     RX bytes (if any have been received)
+ */
+
+// in the order of DynamixelIOStatus (io_task.h)
+static const char *const status_names[] = {
+    "OK", "UART_WRITE_ERROR", "UART_READ_ERROR", "UART_WRITE_TIMEOUT", "UART_READ_TIMEOUT",
+    "WRONG_NOTIFICATION", "WRONG_CHECKSUM", "WRONG_FRAMING", "DEADLINE_EXPIRED", "UNDEFINED",
+};
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s LOG\n", program);
+}
+
+static void print_bytes(const uint8_t *data, int len) {
+    for (int i = 0; i < len; i++)
+        printf(" %02x", data[i]);
+    putchar('\n');
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    size_t capacity = 1 << 16, size = 0;
+    uint8_t *log = malloc(capacity);
+    size_t n_read;
+    while (log != NULL && (n_read = fread(&log[size], 1, capacity - size, in)) > 0) {
+        size += n_read;
+        if (size == capacity) {
+            capacity *= 2;
+            uint8_t *grown = realloc(log, capacity);
+            if (grown == NULL)
+                free(log);
+            log = grown;
+        }
+    }
+    if (log == NULL) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 1;
+    }
+    fclose(in);
+
+    uint8_t protocol;
+    size_t offset = dynamixel_capture_header_check(log, size, &protocol);
+    if (offset == 0) {
+        fprintf(stderr, "%s: not a capture log (version %d)\n", argv[1], DYNAMIXEL_CAPTURE_VERSION);
+        return 1;
+    }
+    printf("# protocol %d\n", protocol);
+
+    DynamixelIOCaptureRecord record;
+    const uint8_t *tx_data, *rx_data;
+    uint32_t last_us = 0;
+    int n_records = 0, n_failed = 0;
+    int n_statuses = (int) (sizeof(status_names) / sizeof(*status_names));
+    while (dynamixel_capture_next(log, size, &offset, &record, &tx_data, &rx_data)) {
+        // the clock wraps around
+        uint32_t delta_us = n_records > 0 ? record.time_us - last_us : 0;
+        last_us = record.time_us;
+        n_records++;
+        n_failed += record.status != 0;
+        printf("%10" PRIu32 " %8" PRIu32 " %8" PRIu32 "  %-20s %3d %5d\n",
+                record.time_us, delta_us, record.duration_us,
+                record.status < n_statuses ? status_names[record.status] : "?",
+                record.n_responses, record.response_size);
+        printf("    TX");
+        print_bytes(tx_data, record.tx_length);
+        if (record.rx_length > 0) {
+            printf("    RX");
+            print_bytes(rx_data, record.rx_length);
+        }
+    }
+    if (offset != size)
+        fprintf(stderr, "%s: truncated record at %zu\n", argv[1], offset);
+    printf("# %d transactions, %d failed\n", n_records, n_failed);
+    free(log);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace_chrome.h"
+
+/*
+ * Converts a dump of trace events of the IO task (an array of DynamixelIOTraceEvent,
+ * see io_trace.h) to Chrome trace-event JSON:
+ *   dynamixel-trace trace.bin > trace.json
+ * then open trace.json in chrome://tracing or https://ui.perfetto.dev.
+ */
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s DUMP [OUTPUT.json]\n", program);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    size_t capacity = 1024, n_events = 0;
+    DynamixelIOTraceEvent *events = malloc(capacity * sizeof(*events));
+    size_t n_read;
+    while (events != NULL
+            && (n_read = fread(&events[n_events], sizeof(*events), capacity - n_events, in)) > 0) {
+        n_events += n_read;
+        if (n_events == capacity) {
+            capacity *= 2;
+            DynamixelIOTraceEvent *grown = realloc(events, capacity * sizeof(*events));
+            if (grown == NULL)
+                free(events);
+            events = grown;
+        }
+    }
+    if (events == NULL) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 1;
+    }
+    if (ferror(in) || fgetc(in) != EOF) {
+        fprintf(stderr, "%s: not a dump of trace events (size is not a multiple of %zu)\n",
+                argv[1], sizeof(*events));
+        return 1;
+    }
+    fclose(in);
+
+    FILE *out = argc == 3 ? fopen(argv[2], "w") : stdout;
+    if (out == NULL) {
+        perror(argv[2]);
+        return 1;
+    }
+    bool ok = dynamixel_trace_write_chrome(out, events, (int) n_events);
+    ok = fclose(out) == 0 && ok;
+    free(events);
+    if (!ok) {
+        perror(argc == 3 ? argv[2] : "stdout");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <inttypes.h>
+
+#include "trace_chrome.h"
+
+enum {
+    TRACE_PID = 1,
+    TRACE_TID_QUEUE = 1,
+    TRACE_TID_BUS,
+    TRACE_TID_TASK,
+};
+
+// times of the phases of the transaction being converted
+typedef struct {
+    uint64_t dequeued;
+    uint64_t tx_started;
+    uint64_t tx_completed;
+    uint64_t rx_started;
+    uint64_t rx_first_data;
+    uint64_t notified;        // the last completion or timeout
+    bool sent;
+    bool has_first_data;
+    bool has_notification;    // not yet followed by wakeup
+    uint8_t id;
+} TraceTransaction;
+
+static void begin_event(FILE *out, bool *first)
+{
+    fputs(*first ? "\n" : ",\n", out);
+    *first = false;
+}
+
+static void write_slice(FILE *out, bool *first, const char *name, int tid,
+        uint64_t start, uint64_t end)
+{
+    begin_event(out, first);
+    fprintf(out, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+            "\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 "",
+            name, TRACE_PID, tid, start, end >= start ? end - start : 0);
+}
+
+static void write_thread_name(FILE *out, bool *first, int tid, const char *name)
+{
+    begin_event(out, first);
+    fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}}", TRACE_PID, tid, name);
+}
+
+bool dynamixel_trace_write_chrome(FILE *out, const DynamixelIOTraceEvent *events, int n_events)
+{
+    TraceTransaction transaction = {0};
+    bool first = true;
+    uint64_t time = 0;
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+    write_thread_name(out, &first, TRACE_TID_QUEUE, "queue");
+    write_thread_name(out, &first, TRACE_TID_BUS, "bus");
+    write_thread_name(out, &first, TRACE_TID_TASK, "task");
+
+    for (int i = 0; i < n_events; i++) {
+        const DynamixelIOTraceEvent *event = &events[i];
+        // events are recorded in order, the difference is right also after wrapping
+        if (i > 0)
+            time += (int32_t) (event->time_us - events[i - 1].time_us);
+
+        switch (event->type) {
+            case dio_TRACE_ENQUEUED:
+            case dio_TRACE_DEQUEUED:
+                begin_event(out, &first);
+                fprintf(out, "{\"name\":\"queue wait\",\"cat\":\"queue\",\"ph\":\"%s\","
+                        "\"id\":%" PRIu32 ",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64 ","
+                        "\"args\":{\"priority\":%d}}",
+                        event->type == dio_TRACE_ENQUEUED ? "b" : "e", event->request,
+                        TRACE_PID, TRACE_TID_QUEUE, time, event->detail);
+                if (event->type == dio_TRACE_DEQUEUED) {
+                    transaction = (TraceTransaction) {0};
+                    transaction.dequeued = time;
+                }
+                break;
+            case dio_TRACE_TX_STARTED:
+                // each transaction of a batch request starts with its write
+                transaction = (TraceTransaction) {
+                    .dequeued = transaction.dequeued,
+                    .tx_started = time,
+                    .sent = true,
+                    .id = event->detail
+                };
+                break;
+            case dio_TRACE_TX_COMPLETED:
+                write_slice(out, &first, "tx", TRACE_TID_BUS, transaction.tx_started, time);
+                fputs("}", out);
+                transaction.tx_completed = time;
+                transaction.notified = time;
+                transaction.has_notification = true;
+                break;
+            case dio_TRACE_RX_STARTED:
+                transaction.rx_started = time;
+                break;
+            case dio_TRACE_RX_FIRST_DATA:
+                write_slice(out, &first, "return delay", TRACE_TID_BUS,
+                        transaction.tx_completed, time);
+                fputs("}", out);
+                transaction.rx_first_data = time;
+                transaction.has_first_data = true;
+                break;
+            case dio_TRACE_RX_COMPLETED:
+                // without streaming reception the return delay cannot be told from rx
+                write_slice(out, &first, "rx", TRACE_TID_BUS, transaction.has_first_data ?
+                        transaction.rx_first_data : transaction.rx_started, time);
+                fprintf(out, ",\"args\":{\"state\":%d}}", event->detail);
+                transaction.notified = time;
+                transaction.has_notification = true;
+                break;
+            case dio_TRACE_TIMEOUT:
+                begin_event(out, &first);
+                fprintf(out, "{\"name\":\"timeout\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,"
+                        "\"tid\":%d,\"ts\":%" PRIu64 "}", TRACE_PID, TRACE_TID_BUS, time);
+                transaction.notified = time;
+                transaction.has_notification = true;
+                break;
+            case dio_TRACE_WOKEN:
+                if (transaction.has_notification) {
+                    write_slice(out, &first, "wakeup", TRACE_TID_TASK, transaction.notified, time);
+                    fputs("}", out);
+                }
+                transaction.has_notification = false;
+                break;
+            case dio_TRACE_DONE:
+                write_slice(out, &first, transaction.sent ? "transaction" : "expired",
+                        TRACE_TID_TASK, transaction.sent ? transaction.tx_started
+                        : transaction.dequeued, time);
+                fprintf(out, ",\"args\":{\"request\":%" PRIu32 ",\"id\":%d,\"status\":%d}}",
+                        event->request, transaction.id, event->detail);
+                transaction.sent = false;
+                break;
+            default:
+                break;
+        }
+    }
+    fputs("\n]}\n", out);
+    return !ferror(out);
+}
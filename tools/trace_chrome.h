@@ -0,0 +1,28 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Conversion of trace events of the IO task (io_trace.h) to Chrome trace-event JSON,
+ * to be viewed on a timeline (chrome://tracing, https://ui.perfetto.dev).
+ *
+ * Queue waits are async slices (they overlap) of the "queue" thread, phases on the wire
+ * (tx, return delay, rx) are slices of the "bus" thread, transactions with wakeups
+ * of the task nested in them are slices of the "task" thread. Timestamps are microseconds
+ * since the first event.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "io_trace.h"
+
+// events in order of recording (like from dynamixel_io_task_read_trace()),
+// returns false on write error
+bool dynamixel_trace_write_chrome(FILE *out, const DynamixelIOTraceEvent *events, int n_events);
+
+#ifdef __cplusplus
+}
+#endif